@@ -97,6 +97,12 @@ use_cpu_jit =
 # Range is any positive integer (but we suspect 25 - 400 is a good idea) Default is 100
 cpu_clock_percentage =
 
+# Whether to run the emulated CPU until the next scheduled event instead of synchronizing the cores
+# and the hardware at a fixed rate. Reduces the scheduling overhead when few events are pending,
+# but events signaled from other threads, such as audio or network, may be handled later.
+# 0 (default): Off, 1: On
+adaptive_slicing =
+
 [Renderer]
 # Whether to render using GLES or OpenGL
 # 0 (default): OpenGL, 1: GLES
@@ -122,6 +128,27 @@ shaders_accurate_mul =
 # 0: Interpreter (slow), 1 (default): JIT (fast)
 use_shader_jit =
 
+# Whether the shader JIT runs batches of vertices in lockstep, using one SIMD lane per vertex
+# 0 (default): Off, 1: On (requires SSE4.1)
+use_batch_shader_jit =
+
+# Whether shaders compiled by the shader JIT are stored to disk and reused by later sessions
+# 0 (default): Off, 1: On
+use_shader_jit_disk_cache =
+
+# Whether the shader JIT compiles new shaders on a background thread, running them with the
+# interpreter until they are compiled
+# 0 (default): Off, 1: On
+use_async_shader_jit =
+
+# Number of threads the software renderer rasterizes triangles on
+# 0: One per host core, 1 (default): Rasterize on the emulation thread, Otherwise: Number of threads
+sw_rasterizer_threads =
+
+# Number of threads the vertices of large indexed draws are shaded on, without hardware shaders
+# 0: One per host core, 1 (default): Shade on the emulation thread, Otherwise: Number of threads
+vertex_shader_threads =
+
 # Forces VSync on the display thread. Usually doesn't impact performance, but on some drivers it can
 # so only turn this off if you notice a speed difference.
 # 0: Off, 1 (default): On
@@ -217,6 +244,20 @@ custom_textures =
 # 0 (default): Off, 1: On
 preload_textures =
 
+# Saves savestates as the memory pages changed since the previously saved or loaded savestate.
+# Such a state can only be loaded as long as the states it was created against exist.
+# 0 (default): Off, 1: On
+delta_savestates =
+
+# Number of frames between the snapshots kept in memory for rewinding the emulation.
+# Taking a snapshot interrupts emulation, so low values slow it down.
+# 0 (default): Off, 60: About once per second
+rewind_interval =
+
+# Size in MiB of the memory used to keep compressed snapshots for rewinding
+# 512 (default)
+rewind_buffer_size =
+
 [Audio]
 # Whether or not to enable DSP LLE
 # 0 (default): No, 1: Yes
@@ -250,6 +291,10 @@ volume =
 # 1 (default): Yes, 0: No
 use_virtual_sd =
 
+# Size in KiB of the cache of decrypted RomFS data, which speeds up small reads from the game files
+# 0: Off, 4096 (default)
+romfs_cache_size =
+
 [System]
 # The system model that Citra will try to emulate
 # 0: Old 3DS, 1: New 3DS (default)
@@ -284,6 +284,12 @@ void Config::ReadUtilityValues() {
         ReadSetting(QStringLiteral("custom_textures"), false).toBool();
     Settings::values.preload_textures =
         ReadSetting(QStringLiteral("preload_textures"), false).toBool();
+    Settings::values.delta_savestates =
+        ReadSetting(QStringLiteral("delta_savestates"), false).toBool();
+    Settings::values.rewind_interval =
+        ReadSetting(QStringLiteral("rewind_interval"), 0).toUInt();
+    Settings::values.rewind_buffer_size =
+        ReadSetting(QStringLiteral("rewind_buffer_size"), 512).toUInt();
     Settings::values.use_disk_shader_cache =
         ReadSetting(QStringLiteral("use_disk_shader_cache"), true).toBool();
 
@@ -296,6 +302,8 @@ void Config::ReadCoreValues() {
     Settings::values.use_cpu_jit = ReadSetting(QStringLiteral("use_cpu_jit"), true).toBool();
     Settings::values.cpu_clock_percentage =
         ReadSetting(QStringLiteral("cpu_clock_percentage"), 100).toInt();
+    Settings::values.adaptive_slicing =
+        ReadSetting(QStringLiteral("adaptive_slicing"), false).toBool();
 
     qt_config->endGroup();
 }
@@ -304,6 +312,8 @@ void Config::ReadDataStorageValues() {
     qt_config->beginGroup(QStringLiteral("Data Storage"));
 
     Settings::values.use_virtual_sd = ReadSetting(QStringLiteral("use_virtual_sd"), true).toBool();
+    Settings::values.romfs_cache_size =
+        ReadSetting(QStringLiteral("romfs_cache_size"), 4096).toUInt();
 
     qt_config->endGroup();
 }
@@ -480,6 +490,16 @@ void Config::ReadRendererValues() {
     Settings::values.shaders_accurate_mul =
         ReadSetting(QStringLiteral("shaders_accurate_mul"), false).toBool();
     Settings::values.use_shader_jit = ReadSetting(QStringLiteral("use_shader_jit"), true).toBool();
+    Settings::values.use_batch_shader_jit =
+        ReadSetting(QStringLiteral("use_batch_shader_jit"), false).toBool();
+    Settings::values.use_shader_jit_disk_cache =
+        ReadSetting(QStringLiteral("use_shader_jit_disk_cache"), false).toBool();
+    Settings::values.use_async_shader_jit =
+        ReadSetting(QStringLiteral("use_async_shader_jit"), false).toBool();
+    Settings::values.sw_rasterizer_threads =
+        static_cast<u16>(ReadSetting(QStringLiteral("sw_rasterizer_threads"), 1).toInt());
+    Settings::values.vertex_shader_threads =
+        static_cast<u16>(ReadSetting(QStringLiteral("vertex_shader_threads"), 1).toInt());
     Settings::values.use_vsync_new = ReadSetting(QStringLiteral("use_vsync_new"), true).toBool();
     Settings::values.resolution_factor =
         static_cast<u16>(ReadSetting(QStringLiteral("resolution_factor"), 1).toInt());
@@ -834,6 +854,9 @@ void Config::SaveUtilityValues() {
     WriteSetting(QStringLiteral("dump_textures"), Settings::values.dump_textures, false);
     WriteSetting(QStringLiteral("custom_textures"), Settings::values.custom_textures, false);
     WriteSetting(QStringLiteral("preload_textures"), Settings::values.preload_textures, false);
+    WriteSetting(QStringLiteral("delta_savestates"), Settings::values.delta_savestates, false);
+    WriteSetting(QStringLiteral("rewind_interval"), Settings::values.rewind_interval, 0);
+    WriteSetting(QStringLiteral("rewind_buffer_size"), Settings::values.rewind_buffer_size, 512);
     WriteSetting(QStringLiteral("use_disk_shader_cache"), Settings::values.use_disk_shader_cache,
                  true);
 
@@ -846,6 +869,7 @@ void Config::SaveCoreValues() {
     WriteSetting(QStringLiteral("use_cpu_jit"), Settings::values.use_cpu_jit, true);
     WriteSetting(QStringLiteral("cpu_clock_percentage"), Settings::values.cpu_clock_percentage,
                  100);
+    WriteSetting(QStringLiteral("adaptive_slicing"), Settings::values.adaptive_slicing, false);
 
     qt_config->endGroup();
 }
@@ -854,6 +878,7 @@ void Config::SaveDataStorageValues() {
     qt_config->beginGroup(QStringLiteral("Data Storage"));
 
     WriteSetting(QStringLiteral("use_virtual_sd"), Settings::values.use_virtual_sd, true);
+    WriteSetting(QStringLiteral("romfs_cache_size"), Settings::values.romfs_cache_size, 4096);
 
     qt_config->endGroup();
 }
@@ -983,6 +1008,16 @@ void Config::SaveRendererValues() {
     WriteSetting(QStringLiteral("shaders_accurate_mul"), Settings::values.shaders_accurate_mul,
                  false);
     WriteSetting(QStringLiteral("use_shader_jit"), Settings::values.use_shader_jit, true);
+    WriteSetting(QStringLiteral("use_batch_shader_jit"), Settings::values.use_batch_shader_jit,
+                 false);
+    WriteSetting(QStringLiteral("use_shader_jit_disk_cache"),
+                 Settings::values.use_shader_jit_disk_cache, false);
+    WriteSetting(QStringLiteral("use_async_shader_jit"), Settings::values.use_async_shader_jit,
+                 false);
+    WriteSetting(QStringLiteral("sw_rasterizer_threads"), Settings::values.sw_rasterizer_threads,
+                 1);
+    WriteSetting(QStringLiteral("vertex_shader_threads"), Settings::values.vertex_shader_threads,
+                 1);
     WriteSetting(QStringLiteral("use_vsync_new"), Settings::values.use_vsync_new, true);
     WriteSetting(QStringLiteral("resolution_factor"), Settings::values.resolution_factor, 1);
     WriteSetting(QStringLiteral("frame_limit"), Settings::values.frame_limit, 100);
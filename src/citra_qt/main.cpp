@@ -288,8 +288,12 @@ void GMainWindow::InitializeWidgets() {
     emu_frametime_label->setToolTip(
         tr("Time taken to emulate a 3DS frame, not counting framelimiting or v-sync. For "
            "full-speed emulation this should be at most 16.67 ms."));
+    emu_slices_label = new QLabel();
+    emu_slices_label->setToolTip(
+        tr("How many times per emulated second the CPU cores stop to process scheduled events. "
+           "Lower values mean less overhead."));
 
-    for (auto& label : {emu_speed_label, game_fps_label, emu_frametime_label}) {
+    for (auto& label : {emu_speed_label, game_fps_label, emu_frametime_label, emu_slices_label}) {
         label->setVisible(false);
         label->setFrameStyle(QFrame::NoFrame);
         label->setContentsMargins(4, 0, 4, 0);
@@ -416,6 +420,12 @@ void GMainWindow::InitializeSaveStateMenuActions() {
         actions_save_state[i]->setData(i + 1);
         connect(actions_save_state[i], &QAction::triggered, this, &GMainWindow::OnSaveState);
         ui.menu_Save_State->addAction(actions_save_state[i]);
+
+        actions_compact_state[i] = new QAction(this);
+        actions_compact_state[i]->setData(i + 1);
+        connect(actions_compact_state[i], &QAction::triggered, this,
+                &GMainWindow::OnCompactState);
+        ui.menu_Compact_State->addAction(actions_compact_state[i]);
     }
 
     connect(ui.action_Load_from_Newest_Slot, &QAction::triggered, [this] {
@@ -433,6 +443,8 @@ void GMainWindow::InitializeSaveStateMenuActions() {
             &GMainWindow::UpdateSaveStates);
     connect(ui.menu_Save_State->menuAction(), &QAction::hovered, this,
             &GMainWindow::UpdateSaveStates);
+    connect(ui.menu_Compact_State->menuAction(), &QAction::hovered, this,
+            &GMainWindow::UpdateSaveStates);
 
     UpdateSaveStates();
 }
@@ -1183,6 +1195,7 @@ void GMainWindow::ShutdownGame() {
     emu_speed_label->setVisible(false);
     game_fps_label->setVisible(false);
     emu_frametime_label->setVisible(false);
+    emu_slices_label->setVisible(false);
 
     UpdateSaveStates();
 
@@ -1236,11 +1249,13 @@ void GMainWindow::UpdateSaveStates() {
     if (!Core::System::GetInstance().IsPoweredOn()) {
         ui.menu_Load_State->setEnabled(false);
         ui.menu_Save_State->setEnabled(false);
+        ui.menu_Compact_State->setEnabled(false);
         return;
     }
 
     ui.menu_Load_State->setEnabled(true);
     ui.menu_Save_State->setEnabled(true);
+    ui.menu_Compact_State->setEnabled(true);
     ui.action_Load_from_Newest_Slot->setEnabled(false);
 
     oldest_slot = newest_slot = 0;
@@ -1257,6 +1272,9 @@ void GMainWindow::UpdateSaveStates() {
         actions_load_state[i]->setEnabled(false);
         actions_load_state[i]->setText(tr("Slot %1").arg(i + 1));
         actions_save_state[i]->setText(tr("Slot %1").arg(i + 1));
+        // Only delta states depend on other states and can be compacted
+        actions_compact_state[i]->setEnabled(false);
+        actions_compact_state[i]->setText(tr("Slot %1").arg(i + 1));
     }
     for (const auto& savestate : savestates) {
         const auto text = tr("Slot %1 - %2")
@@ -1266,6 +1284,8 @@ void GMainWindow::UpdateSaveStates() {
         actions_load_state[savestate.slot - 1]->setEnabled(true);
         actions_load_state[savestate.slot - 1]->setText(text);
         actions_save_state[savestate.slot - 1]->setText(text);
+        actions_compact_state[savestate.slot - 1]->setEnabled(savestate.delta);
+        actions_compact_state[savestate.slot - 1]->setText(text);
 
         ui.action_Load_from_Newest_Slot->setEnabled(true);
 
@@ -1739,6 +1759,15 @@ void GMainWindow::OnLoadState() {
     Core::System::GetInstance().frame_limiter.AdvanceFrame();
 }
 
+void GMainWindow::OnCompactState() {
+    QAction* action = qobject_cast<QAction*>(sender());
+    assert(action);
+
+    Core::System::GetInstance().SendSignal(Core::System::Signal::Compact,
+                                           action->data().toUInt());
+    Core::System::GetInstance().frame_limiter.AdvanceFrame();
+}
+
 void GMainWindow::OnConfigure() {
     ConfigureDialog configureDialog(this, hotkey_registry,
                                     !multiplayer_state->IsHostingPublicRoom());
@@ -2030,10 +2059,12 @@ void GMainWindow::UpdateStatusBar() {
     }
     game_fps_label->setText(tr("Game: %1 FPS").arg(results.game_fps, 0, 'f', 0));
     emu_frametime_label->setText(tr("Frame: %1 ms").arg(results.frametime * 1000.0, 0, 'f', 2));
+    emu_slices_label->setText(tr("Slices: %1/s").arg(results.slices_per_second, 0, 'f', 0));
 
     emu_speed_label->setVisible(true);
     game_fps_label->setVisible(true);
     emu_frametime_label->setVisible(true);
+    emu_slices_label->setVisible(true);
 }
 
 void GMainWindow::HideMouseCursor() {
@@ -2343,6 +2374,9 @@ void GMainWindow::RetranslateStatusBar() {
     emu_frametime_label->setToolTip(
         tr("Time taken to emulate a 3DS frame, not counting framelimiting or v-sync. For "
            "full-speed emulation this should be at most 16.67 ms."));
+    emu_slices_label->setToolTip(
+        tr("How many times per emulated second the CPU cores stop to process scheduled events. "
+           "Lower values mean less overhead."));
 
     multiplayer_state->retranslateUi();
 }
@@ -170,6 +170,7 @@ private slots:
     void OnStopGame();
     void OnSaveState();
     void OnLoadState();
+    void OnCompactState();
     void OnMenuReportCompatibility();
     /// Called whenever a user selects a game in the game list widget.
     void OnGameListLoadFile(QString game_path);
@@ -242,6 +243,7 @@ private:
     QLabel* emu_speed_label = nullptr;
     QLabel* game_fps_label = nullptr;
     QLabel* emu_frametime_label = nullptr;
+    QLabel* emu_slices_label = nullptr;
     QTimer status_bar_update_timer;
     bool message_label_used_for_movie = false;
 
@@ -295,6 +297,7 @@ private:
     QAction* actions_recent_files[max_recent_files_item];
     std::array<QAction*, Core::SaveStateSlotCount> actions_load_state;
     std::array<QAction*, Core::SaveStateSlotCount> actions_save_state;
+    std::array<QAction*, Core::SaveStateSlotCount> actions_compact_state;
 
     u32 oldest_slot;
     u64 oldest_slot_time;
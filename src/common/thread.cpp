@@ -18,6 +18,7 @@
 #include <sched.h>
 #endif
 #ifndef _WIN32
+#include <ctime>
 #include <unistd.h>
 #endif
 #include <string>
@@ -83,4 +84,49 @@ void SetCurrentThreadName(const char* name) {
 
 #endif
 
+#ifdef _WIN32
+static std::chrono::nanoseconds ToNanoseconds(const FILETIME& kernel_time,
+                                              const FILETIME& user_time) {
+    const auto to_u64 = [](const FILETIME& time) {
+        return static_cast<u64>(time.dwHighDateTime) << 32 | time.dwLowDateTime;
+    };
+    // FILETIME counts in units of 100 nanoseconds
+    return std::chrono::nanoseconds((to_u64(kernel_time) + to_u64(user_time)) * 100);
+}
+
+std::chrono::nanoseconds GetCurrentThreadCpuTime() {
+    FILETIME creation_time, exit_time, kernel_time, user_time;
+    if (!GetThreadTimes(GetCurrentThread(), &creation_time, &exit_time, &kernel_time,
+                        &user_time)) {
+        return {};
+    }
+    return ToNanoseconds(kernel_time, user_time);
+}
+
+std::chrono::nanoseconds GetProcessCpuTime() {
+    FILETIME creation_time, exit_time, kernel_time, user_time;
+    if (!GetProcessTimes(GetCurrentProcess(), &creation_time, &exit_time, &kernel_time,
+                         &user_time)) {
+        return {};
+    }
+    return ToNanoseconds(kernel_time, user_time);
+}
+#else
+static std::chrono::nanoseconds GetClockTime(clockid_t clock) {
+    timespec time;
+    if (clock_gettime(clock, &time) != 0) {
+        return {};
+    }
+    return std::chrono::seconds(time.tv_sec) + std::chrono::nanoseconds(time.tv_nsec);
+}
+
+std::chrono::nanoseconds GetCurrentThreadCpuTime() {
+    return GetClockTime(CLOCK_THREAD_CPUTIME_ID);
+}
+
+std::chrono::nanoseconds GetProcessCpuTime() {
+    return GetClockTime(CLOCK_PROCESS_CPUTIME_ID);
+}
+#endif
+
 } // namespace Common
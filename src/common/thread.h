@@ -94,4 +94,10 @@ private:
 
 void SetCurrentThreadName(const char* name);
 
+/// Returns the CPU time consumed by the calling thread so far
+std::chrono::nanoseconds GetCurrentThreadCpuTime();
+
+/// Returns the CPU time consumed by all threads of the process so far
+std::chrono::nanoseconds GetProcessCpuTime();
+
 } // namespace Common
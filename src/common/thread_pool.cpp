@@ -0,0 +1,102 @@
+// Copyright 2020 Citra Emulator Project
+// Licensed under GPLv2 or any later version
+// Refer to the license.txt file included.
+
+#include <algorithm>
+#include <utility>
+#include "common/microprofile.h"
+#include "common/thread.h"
+#include "common/thread_pool.h"
+
+namespace Common {
+
+ThreadPool::ThreadPool(std::size_t num_threads, std::string name_) : name(std::move(name_)) {
+    if (num_threads == 0) {
+        num_threads = std::max<std::size_t>(std::thread::hardware_concurrency(), 1);
+    }
+
+    workers.reserve(num_threads - 1);
+    for (std::size_t i = 1; i < num_threads; ++i) {
+        workers.emplace_back(&ThreadPool::WorkerLoop, this, i);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard lock{mutex};
+        stop = true;
+    }
+    work_cv.notify_all();
+
+    for (auto& worker : workers) {
+        worker.join();
+    }
+}
+
+void ThreadPool::ParallelFor(std::size_t count, const std::function<void(std::size_t)>& func) {
+    if (count == 0) {
+        return;
+    }
+
+    if (workers.empty() || count == 1) {
+        for (std::size_t i = 0; i < count; ++i) {
+            func(i);
+        }
+        return;
+    }
+
+    {
+        std::lock_guard lock{mutex};
+        job = &func;
+        job_count = count;
+        next_item = 0;
+        busy_workers = workers.size();
+        ++generation;
+    }
+    work_cv.notify_all();
+
+    RunItems();
+
+    std::unique_lock lock{mutex};
+    done_cv.wait(lock, [this] { return busy_workers == 0; });
+    job = nullptr;
+}
+
+void ThreadPool::RunItems() {
+    for (;;) {
+        const std::size_t item = next_item.fetch_add(1, std::memory_order_relaxed);
+        if (item >= job_count) {
+            break;
+        }
+        (*job)(item);
+    }
+}
+
+void ThreadPool::WorkerLoop(std::size_t index) {
+    const std::string thread_name = name + "_" + std::to_string(index);
+    SetCurrentThreadName(thread_name.c_str());
+    MicroProfileOnThreadCreate(thread_name.c_str());
+
+    std::size_t last_generation = 0;
+    for (;;) {
+        {
+            std::unique_lock lock{mutex};
+            work_cv.wait(lock, [&] { return stop || generation != last_generation; });
+            if (stop) {
+                break;
+            }
+            last_generation = generation;
+        }
+
+        RunItems();
+
+        {
+            std::lock_guard lock{mutex};
+            if (--busy_workers == 0) {
+                done_cv.notify_one();
+            }
+        }
+    }
+}
+
+} // namespace Common
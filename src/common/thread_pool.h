@@ -0,0 +1,69 @@
+// Copyright 2020 Citra Emulator Project
+// Licensed under GPLv2 or any later version
+// Refer to the license.txt file included.
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace Common {
+
+/**
+ * A fixed set of worker threads used to split data-parallel work (e.g. rasterizing screen tiles)
+ * across host cores.
+ *
+ * Work is submitted in fork-join style through ParallelFor: the calling thread takes part in the
+ * work and only returns once every item has been processed, so callers need no further
+ * synchronization to observe the results.
+ */
+class ThreadPool {
+public:
+    /**
+     * Creates a pool which runs work on `num_threads` threads in total, counting the thread
+     * calling ParallelFor. A value of 0 selects one thread per host core, and a value of 1 creates
+     * no worker threads at all (all work runs on the caller).
+     */
+    explicit ThreadPool(std::size_t num_threads, std::string name = "ThreadPool");
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    /// Returns the number of threads work is distributed across, including the calling thread
+    std::size_t NumThreads() const {
+        return workers.size() + 1;
+    }
+
+    /**
+     * Calls func(i) for every i in [0, count), distributing the calls dynamically across the pool.
+     * Blocks until all calls have returned. Must not be called concurrently or re-entrantly.
+     */
+    void ParallelFor(std::size_t count, const std::function<void(std::size_t)>& func);
+
+private:
+    void WorkerLoop(std::size_t index);
+    void RunItems();
+
+    std::vector<std::thread> workers;
+    std::string name;
+
+    std::mutex mutex;
+    std::condition_variable work_cv;
+    std::condition_variable done_cv;
+
+    const std::function<void(std::size_t)>* job = nullptr;
+    std::size_t job_count = 0;
+    std::atomic<std::size_t> next_item{0};
+    std::size_t busy_workers = 0;
+    std::size_t generation = 0;
+    bool stop = false;
+};
+
+} // namespace Common
@@ -11,6 +11,7 @@
 #include <condition_variable>
 #include <cstddef>
 #include <mutex>
+#include <thread>
 #include <utility>
 
 namespace Common {
@@ -124,49 +125,144 @@ private:
     std::condition_variable cv;
 };
 
-// a simple thread-safe,
+// a lock-free thread-safe,
 // single reader, multiple writer queue
 
 template <typename T>
 class MPSCQueue {
 public:
+    MPSCQueue() {
+        head = tail = new Node();
+    }
+    ~MPSCQueue() {
+        DeleteNodes();
+    }
+
     [[nodiscard]] std::size_t Size() const {
-        return spsc_queue.Size();
+        return size.load();
     }
 
     [[nodiscard]] bool Empty() const {
-        return spsc_queue.Empty();
+        return Size() == 0;
     }
 
     [[nodiscard]] T& Front() const {
-        return spsc_queue.Front();
+        return WaitNext()->current;
     }
 
     template <typename Arg>
     void Push(Arg&& t) {
-        std::lock_guard lock{write_lock};
-        spsc_queue.Push(t);
+        Node* new_node = new Node();
+        new_node->current = std::forward<Arg>(t);
+        // The size is updated first so that it never drops below the number of elements the
+        // reader can see
+        size++;
+
+        // Claim the end of the queue, then link the previous end to the new element. The element
+        // becomes visible to the reader once it is linked.
+        Node* previous = head.exchange(new_node, std::memory_order_acq_rel);
+        previous->next.store(new_node, std::memory_order_release);
+
+        // The reader registers as a waiter before checking the size, and the size was increased
+        // before checking for waiters, so either the reader sees the new element or this sees the
+        // reader. Taking the mutex makes sure that the reader is either about to check the size
+        // again or already waiting, so the notification can't get lost.
+        if (waiters.load() != 0) {
+            {
+                std::lock_guard lock{cv_mutex};
+            }
+            cv.notify_one();
+        }
     }
 
     void Pop() {
-        return spsc_queue.Pop();
+        Node* next = WaitNext();
+        --size;
+        delete tail;
+        tail = next;
     }
 
+    // Returns false if the queue is empty, or if the next element is still being pushed
     bool Pop(T& t) {
-        return spsc_queue.Pop(t);
+        Node* next = tail->next.load(std::memory_order_acquire);
+        if (!next)
+            return false;
+
+        --size;
+        t = std::move(next->current);
+        delete tail;
+        tail = next;
+        return true;
     }
 
     T PopWait() {
-        return spsc_queue.PopWait();
+        if (Empty()) {
+            std::unique_lock lock{cv_mutex};
+            ++waiters;
+            cv.wait(lock, [this]() { return !Empty(); });
+            --waiters;
+        }
+        T t = std::move(Front());
+        Pop();
+        return t;
+    }
+
+    /**
+     * Pops all elements that are visible to the reader in one pass, calling func with each of
+     * them in order.
+     * @returns the number of popped elements
+     */
+    template <typename Func>
+    std::size_t PopAll(Func&& func) {
+        std::size_t count = 0;
+        for (Node* next; (next = tail->next.load(std::memory_order_acquire)); ++count) {
+            func(std::move(next->current));
+            delete tail;
+            tail = next;
+        }
+        size -= count;
+        return count;
     }
 
     // not thread-safe
     void Clear() {
-        spsc_queue.Clear();
+        DeleteNodes();
+        size.store(0);
+        head = tail = new Node();
     }
 
 private:
-    SPSCQueue<T> spsc_queue;
-    std::mutex write_lock;
+    // The element of a node is only valid once the node is reachable from tail, the first node
+    // being a placeholder for the element that has already been popped
+    struct Node {
+        T current{};
+        std::atomic<Node*> next{nullptr};
+    };
+
+    // Returns the node of the next element, waiting for the writer that is pushing it if the size
+    // was already updated but the node isn't linked yet
+    Node* WaitNext() const {
+        Node* next;
+        while (!(next = tail->next.load(std::memory_order_acquire))) {
+            std::this_thread::yield();
+        }
+        return next;
+    }
+
+    void DeleteNodes() {
+        while (tail) {
+            Node* next = tail->next.load();
+            delete tail;
+            tail = next;
+        }
+    }
+
+    std::atomic<Node*> head; // written by the writers
+    Node* tail;              // owned by the reader
+    std::atomic_size_t size{0};
+    /// Number of readers waiting in PopWait, so that writers only notify when necessary
+    std::atomic_size_t waiters{0};
+    std::mutex cv_mutex;
+    std::condition_variable cv;
 };
 } // namespace Common
@@ -4,6 +4,15 @@
 
 #pragma once
 
+// Marks a function as using instructions of the given extension, so that code paths selected at
+// runtime through GetCPUCaps can use intrinsics without enabling the extension for the whole
+// translation unit. MSVC allows using any intrinsics without this.
+#if defined(__GNUC__) || defined(__clang__)
+#define CPU_TARGET(extension) __attribute__((target(extension)))
+#else
+#define CPU_TARGET(extension)
+#endif
+
 namespace Common {
 
 /// x86/x64 CPU capabilities that may be detected by this module
@@ -3,9 +3,11 @@
 // Refer to the license.txt file included.
 
 #include <algorithm>
+#include <cstring>
 #include <zstd.h>
 
 #include "common/assert.h"
+#include "common/logging/log.h"
 #include "common/zstd_compression.h"
 
 namespace Common::Compression {
@@ -48,4 +50,229 @@ std::vector<u8> DecompressDataZSTD(const std::vector<u8>& compressed) {
     return decompressed;
 }
 
+std::vector<u8> CompressDataZSTDWithPrefix(const u8* source, std::size_t source_size,
+                                           const u8* prefix, std::size_t prefix_size,
+                                           s32 compression_level, u32 num_workers) {
+    ZSTD_CCtx* context = ZSTD_createCCtx();
+    compression_level = std::clamp(compression_level, ZSTD_minCLevel(), ZSTD_maxCLevel());
+    ZSTD_CCtx_setParameter(context, ZSTD_c_compressionLevel, compression_level);
+    ZSTD_CCtx_setParameter(context, ZSTD_c_nbWorkers, static_cast<int>(num_workers));
+
+    // Matches can only reach back as far as the window, which therefore has to span the prefix
+    const ZSTD_bounds window_log_bounds = ZSTD_cParam_getBounds(ZSTD_c_windowLog);
+    int window_log = window_log_bounds.lowerBound;
+    while (window_log < window_log_bounds.upperBound &&
+           (std::size_t{1} << window_log) < prefix_size + source_size) {
+        ++window_log;
+    }
+    ZSTD_CCtx_setParameter(context, ZSTD_c_windowLog, window_log);
+    ZSTD_CCtx_setParameter(context, ZSTD_c_enableLongDistanceMatching, 1);
+    ZSTD_CCtx_refPrefix(context, prefix, prefix_size);
+
+    std::vector<u8> compressed(ZSTD_compressBound(source_size));
+    const std::size_t compressed_size =
+        ZSTD_compress2(context, compressed.data(), compressed.size(), source, source_size);
+    ZSTD_freeCCtx(context);
+
+    if (ZSTD_isError(compressed_size)) {
+        // Compression failed
+        return {};
+    }
+
+    compressed.resize(compressed_size);
+
+    return compressed;
+}
+
+std::vector<u8> DecompressDataZSTDWithPrefix(const std::vector<u8>& compressed, const u8* prefix,
+                                             std::size_t prefix_size) {
+    const unsigned long long decompressed_size =
+        ZSTD_getFrameContentSize(compressed.data(), compressed.size());
+    if (decompressed_size == ZSTD_CONTENTSIZE_UNKNOWN ||
+        decompressed_size == ZSTD_CONTENTSIZE_ERROR) {
+        return {};
+    }
+    std::vector<u8> decompressed(decompressed_size);
+
+    ZSTD_DCtx* context = ZSTD_createDCtx();
+    ZSTD_DCtx_setParameter(context, ZSTD_d_windowLogMax,
+                           ZSTD_dParam_getBounds(ZSTD_d_windowLogMax).upperBound);
+    ZSTD_DCtx_refPrefix(context, prefix, prefix_size);
+    const std::size_t uncompressed_result_size = ZSTD_decompressDCtx(
+        context, decompressed.data(), decompressed.size(), compressed.data(), compressed.size());
+    ZSTD_freeDCtx(context);
+
+    if (decompressed_size != uncompressed_result_size || ZSTD_isError(uncompressed_result_size)) {
+        // Decompression failed
+        return {};
+    }
+    return decompressed;
+}
+
+ZSTDCompressStreamBuf::ZSTDCompressStreamBuf(Sink sink_, u32 num_workers,
+                                             s32 compression_level)
+    : context(ZSTD_createCCtx()), sink(std::move(sink_)), in_buffer(ZSTD_CStreamInSize()),
+      out_buffer(ZSTD_CStreamOutSize()) {
+    if (compression_level == 0) {
+        compression_level = ZSTD_CLEVEL_DEFAULT;
+    }
+    compression_level = std::clamp(compression_level, ZSTD_minCLevel(), ZSTD_maxCLevel());
+    ZSTD_CCtx_setParameter(context, ZSTD_c_compressionLevel, compression_level);
+    // Lets the decompressing side detect corrupted data that still decodes
+    ZSTD_CCtx_setParameter(context, ZSTD_c_checksumFlag, 1);
+
+    // This fails if zstd was built without multithreading support, which leaves compression on the
+    // writing thread
+    ZSTD_CCtx_setParameter(context, ZSTD_c_nbWorkers, static_cast<int>(num_workers));
+
+    setp(in_buffer.data(), in_buffer.data() + in_buffer.size());
+}
+
+ZSTDCompressStreamBuf::~ZSTDCompressStreamBuf() {
+    ZSTD_freeCCtx(context);
+}
+
+bool ZSTDCompressStreamBuf::Finish() {
+    return Compress(nullptr, 0, false, true);
+}
+
+ZSTDCompressStreamBuf::int_type ZSTDCompressStreamBuf::overflow(int_type ch) {
+    if (!Compress(nullptr, 0, false, false)) {
+        return traits_type::eof();
+    }
+    if (!traits_type::eq_int_type(ch, traits_type::eof())) {
+        *pptr() = traits_type::to_char_type(ch);
+        pbump(1);
+    }
+    return traits_type::not_eof(ch);
+}
+
+std::streamsize ZSTDCompressStreamBuf::xsputn(const char_type* s, std::streamsize count) {
+    if (count <= epptr() - pptr()) {
+        std::memcpy(pptr(), s, static_cast<std::size_t>(count));
+        pbump(static_cast<int>(count));
+        return count;
+    }
+
+    // Compress large writes straight from the caller's memory
+    return Compress(s, static_cast<std::size_t>(count), false, false) ? count : 0;
+}
+
+int ZSTDCompressStreamBuf::sync() {
+    return Compress(nullptr, 0, true, false) ? 0 : -1;
+}
+
+bool ZSTDCompressStreamBuf::Compress(const char_type* data, std::size_t size, bool flush,
+                                     bool end) {
+    if (failed) {
+        return false;
+    }
+
+    const auto compress = [this](ZSTD_inBuffer& input, ZSTD_EndDirective directive) {
+        std::size_t remaining;
+        do {
+            ZSTD_outBuffer output{out_buffer.data(), out_buffer.size(), 0};
+            remaining = ZSTD_compressStream2(context, &output, &input, directive);
+            if (ZSTD_isError(remaining) ||
+                (output.pos != 0 && !sink(out_buffer.data(), output.pos))) {
+                return false;
+            }
+        } while (directive == ZSTD_e_continue ? input.pos != input.size : remaining != 0);
+        return true;
+    };
+
+    ZSTD_inBuffer pending{pbase(), static_cast<std::size_t>(pptr() - pbase()), 0};
+    ZSTD_inBuffer input{data, size, 0};
+    const ZSTD_EndDirective directive = end ? ZSTD_e_end : flush ? ZSTD_e_flush : ZSTD_e_continue;
+    if (!compress(pending, ZSTD_e_continue) || !compress(input, directive)) {
+        failed = true;
+        return false;
+    }
+
+    setp(in_buffer.data(), in_buffer.data() + in_buffer.size());
+    return true;
+}
+
+ZSTDDecompressStreamBuf::ZSTDDecompressStreamBuf(Source source_)
+    : context(ZSTD_createDCtx()), source(std::move(source_)), in_buffer(ZSTD_DStreamInSize()),
+      out_buffer(ZSTD_DStreamOutSize()) {
+    setg(out_buffer.data(), out_buffer.data(), out_buffer.data());
+}
+
+ZSTDDecompressStreamBuf::~ZSTDDecompressStreamBuf() {
+    ZSTD_freeDCtx(context);
+}
+
+ZSTDDecompressStreamBuf::int_type ZSTDDecompressStreamBuf::underflow() {
+    if (gptr() == egptr()) {
+        const std::size_t size = Decompress(out_buffer.data(), out_buffer.size());
+        setg(out_buffer.data(), out_buffer.data(), out_buffer.data() + size);
+        if (size == 0) {
+            return traits_type::eof();
+        }
+    }
+    return traits_type::to_int_type(*gptr());
+}
+
+std::streamsize ZSTDDecompressStreamBuf::xsgetn(char_type* s, std::streamsize count) {
+    std::streamsize read = 0;
+    while (read < count) {
+        if (gptr() == egptr() && static_cast<std::size_t>(count - read) >= out_buffer.size()) {
+            // Decompress large reads straight into the caller's memory
+            const std::size_t size = Decompress(s + read, static_cast<std::size_t>(count - read));
+            if (size == 0) {
+                break;
+            }
+            read += size;
+            continue;
+        }
+
+        if (traits_type::eq_int_type(underflow(), traits_type::eof())) {
+            break;
+        }
+        const std::streamsize size = std::min(count - read, egptr() - gptr());
+        std::memcpy(s + read, gptr(), static_cast<std::size_t>(size));
+        gbump(static_cast<int>(size));
+        read += size;
+    }
+    return read;
+}
+
+std::size_t ZSTDDecompressStreamBuf::Decompress(char_type* data, std::size_t size) {
+    ZSTD_outBuffer output{data, size, 0};
+    while (output.pos < output.size) {
+        ZSTD_inBuffer input{in_buffer.data(), in_size, in_pos};
+        const std::size_t previous_pos = output.pos;
+        const bool had_input = in_pos < in_size;
+        const std::size_t result = ZSTD_decompressStream(context, &output, &input);
+        in_pos = input.pos;
+        if (ZSTD_isError(result)) {
+            LOG_ERROR(Common, "ZSTD decompression failed: {}", ZSTD_getErrorName(result));
+            failed = true;
+            break;
+        }
+        // A result of 0 means that a frame has been decoded and flushed completely. Without any
+        // input, a nonzero result only hints at the header of a frame that may never come.
+        if (result == 0) {
+            frame_incomplete = false;
+        } else if (had_input) {
+            frame_incomplete = true;
+        }
+
+        if (output.pos == previous_pos && in_pos == in_size) {
+            // All buffered input has been consumed
+            in_size = source(in_buffer.data(), in_buffer.size());
+            in_pos = 0;
+            if (in_size == 0) {
+                if (frame_incomplete) {
+                    LOG_ERROR(Common, "ZSTD compressed data is truncated");
+                    failed = true;
+                }
+                break;
+            }
+        }
+    }
+    return output.pos;
+}
+
 } // namespace Common::Compression
@@ -4,10 +4,15 @@
 
 #pragma once
 
+#include <functional>
+#include <streambuf>
 #include <vector>
 
 #include "common/common_types.h"
 
+struct ZSTD_CCtx_s;
+struct ZSTD_DCtx_s;
+
 namespace Common::Compression {
 
 /**
@@ -42,4 +47,119 @@ namespace Common::Compression {
  */
 [[nodiscard]] std::vector<u8> DecompressDataZSTD(const std::vector<u8>& compressed);
 
+/**
+ * Compresses a source memory region with Zstandard, using a prefix that precedes it as a
+ * dictionary. Data that is similar to the prefix, e.g. a newer version of it, compresses to the
+ * differences between the two. The prefix is required to decompress the data again.
+ *
+ * @param source the uncompressed source memory region.
+ * @param source_size the size in bytes of the uncompressed source memory region.
+ * @param prefix the memory region referenced by the compressed data.
+ * @param prefix_size the size in bytes of the prefix.
+ * @param compression_level the used compression level. Should be between 1 and 22.
+ * @param num_workers the number of threads compressing in the background, 0 compresses on the
+ *                    calling thread.
+ *
+ * @return the compressed data, or an empty vector if compression failed.
+ */
+[[nodiscard]] std::vector<u8> CompressDataZSTDWithPrefix(const u8* source, std::size_t source_size,
+                                                         const u8* prefix, std::size_t prefix_size,
+                                                         s32 compression_level,
+                                                         u32 num_workers = 0);
+
+/**
+ * Decompresses data compressed by CompressDataZSTDWithPrefix and returns the uncompressed data in
+ * a vector.
+ *
+ * @param compressed the compressed source memory region.
+ * @param prefix the prefix the data was compressed with.
+ * @param prefix_size the size in bytes of the prefix.
+ *
+ * @return the decompressed data, or an empty vector if decompression failed.
+ */
+[[nodiscard]] std::vector<u8> DecompressDataZSTDWithPrefix(const std::vector<u8>& compressed,
+                                                           const u8* prefix,
+                                                           std::size_t prefix_size);
+
+/**
+ * Stream buffer compressing everything written to it into a single Zstandard frame, which is
+ * passed to a sink piece by piece as it is produced. This allows compressing large amounts of data
+ * without holding all of it in memory.
+ */
+class ZSTDCompressStreamBuf final : public std::streambuf {
+public:
+    /// Receives a piece of the compressed data, returning false on failure
+    using Sink = std::function<bool(const u8* data, std::size_t size)>;
+
+    /**
+     * @param sink the sink receiving the compressed data.
+     * @param num_workers the number of threads compressing in the background, 0 compresses on the
+     *                    writing thread.
+     * @param compression_level the used compression level, 0 selects the default level.
+     */
+    explicit ZSTDCompressStreamBuf(Sink sink, u32 num_workers = 0, s32 compression_level = 0);
+    ~ZSTDCompressStreamBuf() override;
+
+    /**
+     * Compresses the remaining data and ends the frame. Must be called once all data was written.
+     *
+     * @return false if compressing or writing to the sink failed at any point.
+     */
+    bool Finish();
+
+protected:
+    int_type overflow(int_type ch) override;
+    std::streamsize xsputn(const char_type* s, std::streamsize count) override;
+    int sync() override;
+
+private:
+    /// Compresses the data in the put area followed by the given data
+    bool Compress(const char_type* data, std::size_t size, bool flush, bool end);
+
+    ZSTD_CCtx_s* context;
+    Sink sink;
+    std::vector<char_type> in_buffer;
+    std::vector<u8> out_buffer;
+    bool failed = false;
+};
+
+/**
+ * Stream buffer decompressing Zstandard frames read piece by piece from a source.
+ */
+class ZSTDDecompressStreamBuf final : public std::streambuf {
+public:
+    /// Reads up to `size` bytes of compressed data, returning the number of bytes read
+    using Source = std::function<std::size_t(u8* data, std::size_t size)>;
+
+    explicit ZSTDDecompressStreamBuf(Source source);
+    ~ZSTDDecompressStreamBuf() override;
+
+    /**
+     * Returns whether decompression stopped because the compressed data is corrupt or ends in the
+     * middle of a frame. The stream buffer reports the end of the data in both cases, so readers
+     * have to check this to tell them apart from the regular end of the data.
+     */
+    bool HasFailed() const {
+        return failed;
+    }
+
+protected:
+    int_type underflow() override;
+    std::streamsize xsgetn(char_type* s, std::streamsize count) override;
+
+private:
+    /// Decompresses up to `size` bytes into `data`, returning the number of bytes decompressed
+    std::size_t Decompress(char_type* data, std::size_t size);
+
+    ZSTD_DCtx_s* context;
+    Source source;
+    std::vector<u8> in_buffer;
+    std::size_t in_pos = 0;
+    std::size_t in_size = 0;
+    std::vector<char_type> out_buffer;
+    /// Whether the input read so far ends inside a frame
+    bool frame_incomplete = false;
+    bool failed = false;
+};
+
 } // namespace Common::Compression
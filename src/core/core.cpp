@@ -41,6 +41,7 @@
 #include "core/hw/lcd.h"
 #include "core/loader/loader.h"
 #include "core/movie.h"
+#include "core/rewind.h"
 #include "core/rpc/rpc_server.h"
 #include "core/settings.h"
 #include "network/network.h"
@@ -135,10 +136,45 @@ System::ResultStatus System::RunLoop(bool tight_loop) {
         frame_limiter.WaitOnce();
         return ResultStatus::Success;
     }
+    case Signal::Compact: {
+        LOG_INFO(Core, "Begin compaction");
+        try {
+            System::CompactState(param);
+            LOG_INFO(Core, "Compaction completed");
+        } catch (const std::exception& e) {
+            LOG_ERROR(Core, "Error compacting: {}", e.what());
+            status_details = e.what();
+            return ResultStatus::ErrorSavestate;
+        }
+        frame_limiter.WaitOnce();
+        return ResultStatus::Success;
+    }
+    case Signal::Rewind: {
+        try {
+            if (!System::Rewind()) {
+                LOG_WARNING(Core, "No snapshot to rewind to");
+            }
+        } catch (const std::exception& e) {
+            LOG_ERROR(Core, "Error rewinding: {}", e.what());
+            status_details = e.what();
+            return ResultStatus::ErrorSavestate;
+        }
+        frame_limiter.WaitOnce();
+        return ResultStatus::Success;
+    }
     default:
         break;
     }
 
+    if (rewind_buffer && timing->GetGlobalTicks() >= next_rewind_ticks) {
+        try {
+            CaptureRewindSnapshot();
+        } catch (const std::exception& e) {
+            LOG_ERROR(Core, "Error capturing rewind snapshot, disabling rewinding: {}", e.what());
+            rewind_buffer.reset();
+        }
+    }
+
     // All cores should have executed the same amount of ticks. If this is not the case an event was
     // scheduled with a cycles_into_future smaller then the current downcount.
     // So we have to get those cores to the same global time first
@@ -185,9 +221,11 @@ System::ResultStatus System::RunLoop(bool tight_loop) {
         }
     } else {
         // Now all cores are at the same global time. So we will run them one after the other
-        // with a max slice that is the minimum of all max slices of all cores
+        // with a max slice that is the minimum of all max slices of all cores. With adaptive
+        // slicing this is the time until the next event of any core, which also lets idle cores
+        // skip ahead to it at once.
         // TODO: Make special check for idle since we can easily revert the time of idle cores
-        s64 max_slice = Timing::MAX_SLICE_LENGTH;
+        s64 max_slice = timing->GetMaxSliceLength();
         for (const auto& cpu_core : cpu_cores) {
             kernel->SetRunningCPU(cpu_core.get());
             cpu_core->GetTimer().Advance();
@@ -223,6 +261,10 @@ System::ResultStatus System::RunLoop(bool tight_loop) {
         GDBStub::SetCpuStepFlag(false);
     }
 
+    if (perf_stats) {
+        perf_stats->AddSlice();
+    }
+
     HW::Update();
     Reschedule();
 
@@ -307,6 +349,11 @@ System::ResultStatus System::Load(Frontend::EmuWindow& emu_window, const std::st
                   static_cast<u32>(load_result));
     }
     perf_stats = std::make_unique<PerfStats>(title_id);
+    if (Settings::values.rewind_interval != 0) {
+        rewind_buffer = std::make_unique<RewindBuffer>(
+            static_cast<std::size_t>(Settings::values.rewind_buffer_size) * 1024 * 1024);
+    }
+    next_rewind_ticks = 0;
     custom_tex_cache = std::make_unique<Core::CustomTexCache>();
 
     if (Settings::values.custom_textures) {
@@ -358,6 +405,7 @@ System::ResultStatus System::Init(Frontend::EmuWindow& emu_window, u32 system_mo
     memory = std::make_unique<Memory::MemorySystem>();
 
     timing = std::make_unique<Timing>(num_cores, Settings::values.cpu_clock_percentage);
+    timing->SetAdaptiveSlicing(Settings::values.adaptive_slicing);
 
     kernel = std::make_unique<Kernel::KernelSystem>(
         *memory, *timing, [this] { PrepareReschedule(); }, system_mode, num_cores, n3ds_mode);
@@ -532,6 +580,7 @@ void System::Shutdown(bool is_deserializing) {
     if (!is_deserializing) {
         GDBStub::Shutdown();
         perf_stats.reset();
+        rewind_buffer.reset();
         cheat_engine.reset();
         app_loader.reset();
     }
@@ -575,6 +624,13 @@ void System::serialize(Archive& ar, const unsigned int file_version) {
     }
     ar& num_cores;
 
+    const auto begin_section = [this](const char* name) {
+        if (savestate_profiler) {
+            savestate_profiler->BeginSection(name);
+        }
+    };
+
+    begin_section("Setup");
     if (Archive::is_loading::value) {
         // When loading, we want to make sure any lingering state gets cleared out before we begin.
         // Shutdown, but persist a few things between loads...
@@ -589,17 +645,22 @@ void System::serialize(Archive& ar, const unsigned int file_version) {
     // flush on save, don't flush on load
     bool should_flush = !Archive::is_loading::value;
     Memory::RasterizerClearAll(should_flush);
+    begin_section("Timing");
     ar&* timing.get();
+    begin_section("CPU");
     for (u32 i = 0; i < num_cores; i++) {
         ar&* cpu_cores[i].get();
     }
+    begin_section("Services");
     ar&* service_manager.get();
     ar&* archive_manager.get();
+    begin_section("GPU");
     ar& GPU::g_regs;
     ar& LCD::g_regs;
 
     // NOTE: DSP doesn't like being destroyed and recreated. So instead we do an inline
     // serialization; this means that the DSP Settings need to match for loading to work.
+    begin_section("DSP");
     auto dsp_hle = dynamic_cast<AudioCore::DspHle*>(dsp_core.get());
     if (dsp_hle) {
         ar&* dsp_hle;
@@ -607,10 +668,14 @@ void System::serialize(Archive& ar, const unsigned int file_version) {
         throw std::runtime_error("LLE audio not supported for save states");
     }
 
+    begin_section("Memory");
     ar&* memory.get();
+    begin_section("Kernel");
     ar&* kernel.get();
+    begin_section("Video");
     VideoCore::serialize(ar, file_version);
     if (file_version >= 1) {
+        begin_section("Movie");
         ar& Movie::GetInstance();
     }
 
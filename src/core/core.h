@@ -16,6 +16,7 @@
 #include "core/loader/loader.h"
 #include "core/memory.h"
 #include "core/perf_stats.h"
+#include "core/savestate.h"
 #include "core/telemetry_session.h"
 
 class ARM_Interface;
@@ -61,6 +62,7 @@ class RendererBase;
 
 namespace Core {
 
+class RewindBuffer;
 class Timing;
 
 class System {
@@ -120,7 +122,7 @@ public:
     /// Shutdown and then load again
     void Reset();
 
-    enum class Signal : u32 { None, Shutdown, Reset, Save, Load };
+    enum class Signal : u32 { None, Shutdown, Reset, Save, Load, Compact, Rewind };
 
     bool SendSignal(Signal signal, u32 param = 0);
 
@@ -134,6 +136,11 @@ public:
         SendSignal(Signal::Shutdown);
     }
 
+    /// Request rewinding the emulation to the most recent rewind snapshot
+    void RequestRewind() {
+        SendSignal(Signal::Rewind);
+    }
+
     /**
      * Load an executable application.
      * @param emu_window Reference to the host-system window used for video output and keyboard
@@ -304,10 +311,37 @@ public:
         return registered_image_interface;
     }
 
-    void SaveState(u32 slot) const;
+    /**
+     * Saves the emulation state to a slot. With delta savestates enabled, only the memory pages
+     * changed since the last saved or loaded state are stored, which then has to be kept. A state
+     * replacing one that other delta states depend on is always saved in full.
+     */
+    void SaveState(u32 slot);
 
+    /// Loads the emulation state from a slot, along with the states a delta state depends on
     void LoadState(u32 slot);
 
+    /**
+     * Replaces the delta state in a slot with a full state that doesn't depend on other states,
+     * so that the states it was based on can be overwritten. This loads the state in the process.
+     */
+    void CompactState(u32 slot);
+
+    /**
+     * Restores the emulation state of the most recent snapshot in the rewind buffer and removes
+     * it, so that repeated calls step further back in time.
+     * @returns false if there is no snapshot to restore
+     */
+    bool Rewind();
+
+    /// Returns the number of snapshots the emulation can currently be rewound by
+    std::size_t GetRewindSnapshotCount() const;
+
+    /// Returns the size and timing of each part of the most recently saved or loaded state
+    const SaveStateStats& GetSaveStateStats() const {
+        return savestate_stats;
+    }
+
 private:
     /**
      * Initialize the emulated system.
@@ -322,6 +356,15 @@ private:
     /// Reschedule the core emulation
     void Reschedule();
 
+    void SaveState(u32 slot, u64 time, u64 id, bool delta);
+
+    /// Serializes the emulation state to a savestate stream, or deserializes it from one
+    void SerializeState(std::ostream& stream, SaveStateProfiler& profiler, bool delta);
+    void DeserializeState(std::istream& stream, SaveStateProfiler& profiler);
+
+    /// Adds a snapshot of the emulation state to the rewind buffer
+    void CaptureRewindSnapshot();
+
     /// AppLoader used to load the current executing application
     std::unique_ptr<Loader::AppLoader> app_loader;
 
@@ -382,6 +425,19 @@ private:
     Signal current_signal;
     u32 signal_param;
 
+    /// Slot and id of the last saved or loaded state, which delta states are created against
+    u32 delta_base_slot = 0;
+    u64 delta_base_id = 0;
+
+    /// Profiler of the state being saved or loaded, nullptr when not profiling
+    SaveStateProfiler* savestate_profiler = nullptr;
+    SaveStateStats savestate_stats;
+
+    /// Snapshots for rewinding, nullptr if rewinding is disabled
+    std::unique_ptr<RewindBuffer> rewind_buffer;
+    /// Global tick count at which the next rewind snapshot is taken
+    u64 next_rewind_ticks = 0;
+
     friend class boost::serialization::access;
     template <typename Archive>
     void serialize(Archive& ar, const unsigned int file_version);
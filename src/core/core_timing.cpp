@@ -6,6 +6,7 @@
 #include <cinttypes>
 #include <tuple>
 #include "common/assert.h"
+#include "common/bit_set.h"
 #include "common/logging/log.h"
 #include "core/core_timing.h"
 
@@ -20,6 +21,265 @@ bool Timing::Event::operator<(const Timing::Event& right) const {
     return std::tie(time, fifo_order) < std::tie(right.time, right.fifo_order);
 }
 
+Timing::EventQueue::EventQueue() {
+    slots.fill(INVALID_NODE);
+}
+
+Timing::EventQueue::~EventQueue() = default;
+
+void Timing::EventQueue::Push(const Event& event) {
+    const u32 index = AllocateNode(event);
+    Node& node = nodes[index];
+
+    u32& type_head = type_heads.try_emplace(event.type, INVALID_NODE).first->second;
+    node.type_prev = INVALID_NODE;
+    node.type_next = type_head;
+    if (type_head != INVALID_NODE) {
+        nodes[type_head].type_prev = index;
+    }
+    type_head = index;
+
+    s64 slot = event.time >> SLOT_SHIFT;
+    if (wheel_size == 0 && slot > wheel_start) {
+        // Turning an empty wheel forward keeps later events from ending up in the heap
+        wheel_start = slot;
+    }
+    // Events in the past are put in the first slot, which is searched first
+    slot = std::max(slot, wheel_start);
+    if (slot - wheel_start < static_cast<s64>(WHEEL_SLOTS)) {
+        LinkSlot(index, static_cast<std::size_t>(slot) & (WHEEL_SLOTS - 1));
+    } else {
+        HeapPush(index);
+    }
+    ++size;
+
+    if (top != INVALID_NODE && event < nodes[top].event) {
+        top = index;
+    }
+}
+
+const Timing::Event& Timing::EventQueue::Top() const {
+    ASSERT(size != 0);
+    if (top == INVALID_NODE) {
+        top = FindWheelTop();
+        if (!heap.empty() &&
+            (top == INVALID_NODE || nodes[heap.front()].event < nodes[top].event)) {
+            top = heap.front();
+        }
+    }
+    return nodes[top].event;
+}
+
+void Timing::EventQueue::Pop() {
+    Top();
+    RemoveNode(top);
+}
+
+void Timing::EventQueue::Remove(const TimingEventType* type) {
+    const auto it = type_heads.find(type);
+    if (it == type_heads.end()) {
+        return;
+    }
+    for (u32 index = it->second; index != INVALID_NODE;) {
+        const u32 next = nodes[index].type_next;
+        RemoveNode(index);
+        index = next;
+    }
+}
+
+void Timing::EventQueue::Remove(const TimingEventType* type, u64 userdata) {
+    const auto it = type_heads.find(type);
+    if (it == type_heads.end()) {
+        return;
+    }
+    for (u32 index = it->second; index != INVALID_NODE;) {
+        const u32 next = nodes[index].type_next;
+        if (nodes[index].event.userdata == userdata) {
+            RemoveNode(index);
+        }
+        index = next;
+    }
+}
+
+void Timing::EventQueue::Clear() {
+    nodes.clear();
+    free_nodes.clear();
+    size = 0;
+    slots.fill(INVALID_NODE);
+    occupied_slots.fill(0);
+    wheel_size = 0;
+    wheel_start = 0;
+    heap.clear();
+    type_heads.clear();
+    top = INVALID_NODE;
+}
+
+std::vector<Timing::Event> Timing::EventQueue::GetEvents() const {
+    std::vector<Event> events;
+    events.reserve(size);
+    for (u32 head : slots) {
+        for (u32 index = head; index != INVALID_NODE; index = nodes[index].next) {
+            events.push_back(nodes[index].event);
+        }
+    }
+    for (u32 index : heap) {
+        events.push_back(nodes[index].event);
+    }
+    std::sort(events.begin(), events.end());
+    return events;
+}
+
+u32 Timing::EventQueue::AllocateNode(const Event& event) {
+    if (!free_nodes.empty()) {
+        const u32 index = free_nodes.back();
+        free_nodes.pop_back();
+        nodes[index].event = event;
+        return index;
+    }
+    nodes.push_back(Node{event});
+    return static_cast<u32>(nodes.size() - 1);
+}
+
+void Timing::EventQueue::RemoveNode(u32 index) {
+    Node& node = nodes[index];
+    if (node.slot == IN_HEAP) {
+        HeapRemove(index);
+    } else {
+        UnlinkSlot(index);
+    }
+
+    if (node.type_prev != INVALID_NODE) {
+        nodes[node.type_prev].type_next = node.type_next;
+    } else {
+        type_heads[node.event.type] = node.type_next;
+    }
+    if (node.type_next != INVALID_NODE) {
+        nodes[node.type_next].type_prev = node.type_prev;
+    }
+
+    free_nodes.push_back(index);
+    --size;
+    if (top == index) {
+        top = INVALID_NODE;
+    }
+}
+
+void Timing::EventQueue::LinkSlot(u32 index, std::size_t slot) {
+    Node& node = nodes[index];
+    node.slot = static_cast<u32>(slot);
+    node.prev = INVALID_NODE;
+    node.next = slots[slot];
+    if (node.next != INVALID_NODE) {
+        nodes[node.next].prev = index;
+    }
+    slots[slot] = index;
+    occupied_slots[slot / 64] |= u64{1} << (slot % 64);
+    ++wheel_size;
+}
+
+void Timing::EventQueue::UnlinkSlot(u32 index) {
+    const Node& node = nodes[index];
+    if (node.prev != INVALID_NODE) {
+        nodes[node.prev].next = node.next;
+    } else {
+        slots[node.slot] = node.next;
+        if (node.next == INVALID_NODE) {
+            occupied_slots[node.slot / 64] &= ~(u64{1} << (node.slot % 64));
+        }
+    }
+    if (node.next != INVALID_NODE) {
+        nodes[node.next].prev = node.prev;
+    }
+    --wheel_size;
+}
+
+void Timing::EventQueue::HeapPush(u32 index) {
+    nodes[index].slot = IN_HEAP;
+    nodes[index].heap_index = static_cast<u32>(heap.size());
+    heap.push_back(index);
+    HeapSiftUp(heap.size() - 1);
+}
+
+void Timing::EventQueue::HeapRemove(u32 index) {
+    const std::size_t position = nodes[index].heap_index;
+    const u32 last = heap.back();
+    heap.pop_back();
+    if (position < heap.size()) {
+        heap[position] = last;
+        nodes[last].heap_index = static_cast<u32>(position);
+        HeapSiftUp(position);
+        HeapSiftDown(nodes[last].heap_index);
+    }
+}
+
+void Timing::EventQueue::HeapSiftUp(std::size_t position) {
+    while (position > 0) {
+        const std::size_t parent = (position - 1) / 2;
+        if (!HeapLess(position, parent)) {
+            break;
+        }
+        std::swap(heap[position], heap[parent]);
+        nodes[heap[position]].heap_index = static_cast<u32>(position);
+        nodes[heap[parent]].heap_index = static_cast<u32>(parent);
+        position = parent;
+    }
+}
+
+void Timing::EventQueue::HeapSiftDown(std::size_t position) {
+    while (true) {
+        const std::size_t left = position * 2 + 1;
+        if (left >= heap.size()) {
+            break;
+        }
+        const std::size_t right = left + 1;
+        const std::size_t child = right < heap.size() && HeapLess(right, left) ? right : left;
+        if (!HeapLess(child, position)) {
+            break;
+        }
+        std::swap(heap[position], heap[child]);
+        nodes[heap[position]].heap_index = static_cast<u32>(position);
+        nodes[heap[child]].heap_index = static_cast<u32>(child);
+        position = child;
+    }
+}
+
+bool Timing::EventQueue::HeapLess(std::size_t a, std::size_t b) const {
+    return nodes[heap[a]].event < nodes[heap[b]].event;
+}
+
+u32 Timing::EventQueue::FindWheelTop() const {
+    if (wheel_size == 0) {
+        return INVALID_NODE;
+    }
+
+    // Find the first occupied slot. All slots before it are empty, so the wheel can be turned
+    // forward to it: any event scheduled before it later is put in that slot.
+    std::size_t slot = static_cast<std::size_t>(wheel_start) & (WHEEL_SLOTS - 1);
+    std::size_t distance = 0;
+    while (true) {
+        const u64 bits = occupied_slots[slot / 64] >> (slot % 64);
+        if (bits != 0) {
+            const std::size_t offset = Common::LeastSignificantSetBit(bits);
+            distance += offset;
+            slot += offset;
+            break;
+        }
+        const std::size_t skipped = 64 - slot % 64;
+        distance += skipped;
+        slot = (slot + skipped) & (WHEEL_SLOTS - 1);
+    }
+    wheel_start += static_cast<s64>(distance);
+
+    // Events within a slot aren't sorted
+    u32 earliest = slots[slot];
+    for (u32 index = nodes[earliest].next; index != INVALID_NODE; index = nodes[index].next) {
+        if (nodes[index].event < nodes[earliest].event) {
+            earliest = index;
+        }
+    }
+    return earliest;
+}
+
 Timing::Timing(std::size_t num_cores, u32 cpu_clock_percentage) {
     timers.resize(num_cores);
     for (std::size_t i = 0; i < num_cores; ++i) {
@@ -35,6 +295,16 @@ void Timing::UpdateClockSpeed(u32 cpu_clock_percentage) {
     }
 }
 
+void Timing::SetAdaptiveSlicing(bool enabled) {
+    for (auto& timer : timers) {
+        timer->max_slice_length = enabled ? MAX_ADAPTIVE_SLICE_LENGTH : MAX_SLICE_LENGTH;
+    }
+}
+
+s64 Timing::GetMaxSliceLength() const {
+    return timers[0]->max_slice_length;
+}
+
 TimingEventType* Timing::RegisterEvent(const std::string& name, TimedCallback callback) {
     // check for existing type with same name.
     // we want event type names to remain unique so that we can use them for serialization.
@@ -64,9 +334,7 @@ void Timing::ScheduleEvent(s64 cycles_into_future, const TimingEventType* event_
         if (!timer->is_timer_sane)
             timer->ForceExceptionCheck(cycles_into_future);
 
-        timer->event_queue.emplace_back(
-            Event{timeout, timer->event_fifo_id++, userdata, event_type});
-        std::push_heap(timer->event_queue.begin(), timer->event_queue.end(), std::greater<>());
+        timer->event_queue.Push(Event{timeout, timer->event_fifo_id++, userdata, event_type});
     } else {
         timer->ts_queue.Push(Event{static_cast<s64>(timer->GetTicks() + cycles_into_future), 0,
                                    userdata, event_type});
@@ -75,29 +343,14 @@ void Timing::ScheduleEvent(s64 cycles_into_future, const TimingEventType* event_
 
 void Timing::UnscheduleEvent(const TimingEventType* event_type, u64 userdata) {
     for (auto timer : timers) {
-        auto itr = std::remove_if(
-            timer->event_queue.begin(), timer->event_queue.end(),
-            [&](const Event& e) { return e.type == event_type && e.userdata == userdata; });
-
-        // Removing random items breaks the invariant so we have to re-establish it.
-        if (itr != timer->event_queue.end()) {
-            timer->event_queue.erase(itr, timer->event_queue.end());
-            std::make_heap(timer->event_queue.begin(), timer->event_queue.end(), std::greater<>());
-        }
+        timer->event_queue.Remove(event_type, userdata);
     }
     // TODO:remove events from ts_queue
 }
 
 void Timing::RemoveEvent(const TimingEventType* event_type) {
     for (auto timer : timers) {
-        auto itr = std::remove_if(timer->event_queue.begin(), timer->event_queue.end(),
-                                  [&](const Event& e) { return e.type == event_type; });
-
-        // Removing random items breaks the invariant so we have to re-establish it.
-        if (itr != timer->event_queue.end()) {
-            timer->event_queue.erase(itr, timer->event_queue.end());
-            std::make_heap(timer->event_queue.begin(), timer->event_queue.end(), std::greater<>());
-        }
+        timer->event_queue.Remove(event_type);
     }
     // TODO:remove events from ts_queue
 }
@@ -157,20 +410,19 @@ void Timing::Timer::ForceExceptionCheck(s64 cycles) {
 }
 
 void Timing::Timer::MoveEvents() {
-    for (Event ev; ts_queue.Pop(ev);) {
+    ts_queue.PopAll([this](Event&& ev) {
         ev.fifo_order = event_fifo_id++;
-        event_queue.emplace_back(std::move(ev));
-        std::push_heap(event_queue.begin(), event_queue.end(), std::greater<>());
-    }
+        event_queue.Push(ev);
+    });
 }
 
 s64 Timing::Timer::GetMaxSliceLength() const {
-    const auto& next_event = event_queue.begin();
-    if (next_event != event_queue.end()) {
-        ASSERT(next_event->time - executed_ticks > 0);
-        return next_event->time - executed_ticks;
+    if (!event_queue.Empty()) {
+        const Event& next_event = event_queue.Top();
+        ASSERT(next_event.time - executed_ticks > 0);
+        return next_event.time - executed_ticks;
     }
-    return MAX_SLICE_LENGTH;
+    return max_slice_length;
 }
 
 void Timing::Timer::Advance() {
@@ -184,10 +436,9 @@ void Timing::Timer::Advance() {
 
     is_timer_sane = true;
 
-    while (!event_queue.empty() && event_queue.front().time <= executed_ticks) {
-        Event evt = std::move(event_queue.front());
-        std::pop_heap(event_queue.begin(), event_queue.end(), std::greater<>());
-        event_queue.pop_back();
+    while (!event_queue.Empty() && event_queue.Top().time <= executed_ticks) {
+        Event evt = event_queue.Top();
+        event_queue.Pop();
         if (evt.type->callback != nullptr) {
             evt.type->callback(evt.userdata, executed_ticks - evt.time);
         } else {
@@ -202,9 +453,9 @@ void Timing::Timer::SetNextSlice(s64 max_slice_length) {
     slice_length = max_slice_length;
 
     // Still events left (scheduled in the future)
-    if (!event_queue.empty()) {
+    if (!event_queue.Empty()) {
         slice_length = static_cast<int>(
-            std::min<s64>(event_queue.front().time - executed_ticks, max_slice_length));
+            std::min<s64>(event_queue.Top().time - executed_ticks, max_slice_length));
     }
 
     downcount = slice_length;
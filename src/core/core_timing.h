@@ -17,6 +17,7 @@
  *   ScheduleEvent(periodInCycles - cyclesLate, callback, "whatever")
  */
 
+#include <array>
 #include <chrono>
 #include <functional>
 #include <limits>
@@ -171,6 +172,97 @@ public:
         BOOST_SERIALIZATION_SPLIT_MEMBER()
     };
 
+    /**
+     * Priority queue of the events scheduled on a timer, implemented as a hashed timer wheel.
+     * Events within WHEEL_SLOTS slots of the earliest slot are kept in unsorted per-slot lists,
+     * which makes scheduling and cancelling them O(1), and finding the earliest event amortized
+     * O(1) as the wheel only turns forward. Events further in the future are kept in a binary
+     * heap. Events with the same time are ordered by their fifo_order.
+     */
+    class EventQueue {
+    public:
+        /// Number of cycles covered by each slot of the wheel
+        static constexpr unsigned SLOT_SHIFT = 14;
+        /// Number of slots, which cover about 60ms
+        static constexpr std::size_t WHEEL_SLOTS = 1024;
+
+        EventQueue();
+        ~EventQueue();
+
+        bool Empty() const {
+            return size == 0;
+        }
+
+        std::size_t Size() const {
+            return size;
+        }
+
+        void Push(const Event& event);
+
+        /// Returns the earliest event. The queue must not be empty.
+        const Event& Top() const;
+
+        /// Removes the earliest event. The queue must not be empty.
+        void Pop();
+
+        /// Removes all events of a type, or only those with the given userdata
+        void Remove(const TimingEventType* type);
+        void Remove(const TimingEventType* type, u64 userdata);
+
+        void Clear();
+
+        /// Returns all events, sorted from the earliest to the latest
+        std::vector<Event> GetEvents() const;
+
+    private:
+        static constexpr u32 INVALID_NODE = std::numeric_limits<u32>::max();
+        static constexpr u32 IN_HEAP = std::numeric_limits<u32>::max();
+
+        struct Node {
+            Event event;
+            u32 slot;       ///< Wheel slot holding the event, or IN_HEAP
+            u32 prev;       ///< Previous node in the slot
+            u32 next;       ///< Next node in the slot
+            u32 heap_index; ///< Position in the heap
+            u32 type_prev;  ///< Previous node with the same event type
+            u32 type_next;  ///< Next node with the same event type
+        };
+
+        u32 AllocateNode(const Event& event);
+        void RemoveNode(u32 index);
+
+        void LinkSlot(u32 index, std::size_t slot);
+        void UnlinkSlot(u32 index);
+
+        void HeapPush(u32 index);
+        void HeapRemove(u32 index);
+        void HeapSiftUp(std::size_t position);
+        void HeapSiftDown(std::size_t position);
+        bool HeapLess(std::size_t a, std::size_t b) const;
+
+        /// Finds the earliest event in the wheel, turning it to the first occupied slot
+        u32 FindWheelTop() const;
+
+        std::vector<Node> nodes;
+        std::vector<u32> free_nodes;
+        std::size_t size = 0;
+
+        std::array<u32, WHEEL_SLOTS> slots;
+        std::array<u64, WHEEL_SLOTS / 64> occupied_slots{};
+        std::size_t wheel_size = 0;
+        /// Absolute slot number (time >> SLOT_SHIFT) of the first slot of the wheel
+        mutable s64 wheel_start = 0;
+
+        /// Min-heap of the nodes of the events beyond the wheel
+        std::vector<u32> heap;
+
+        /// First node of each event type, for cancelling events
+        std::unordered_map<const TimingEventType*, u32> type_heads;
+
+        /// Earliest event, or INVALID_NODE if it has to be searched for
+        mutable u32 top = INVALID_NODE;
+    };
+
     // currently Service::HID::pad_update_ticks is the smallest interval for an event that gets
     // always scheduled. Therfore we use this as orientation for the MAX_SLICE_LENGTH
     // For performance bigger slice length are desired, though this will lead to cores desync
@@ -179,6 +271,10 @@ public:
     // scheduled and repated.
     static constexpr int MAX_SLICE_LENGTH = BASE_CLOCK_RATE_ARM11 / 234;
 
+    // With adaptive slicing, the cores run until the next event is due and this only bounds the
+    // slices when no event is scheduled. The LCD VBlank event is scheduled about as often anyway.
+    static constexpr int MAX_ADAPTIVE_SLICE_LENGTH = BASE_CLOCK_RATE_ARM11 / 60;
+
     class Timer {
     public:
         Timer();
@@ -205,11 +301,7 @@ public:
 
     private:
         friend class Timing;
-        // The queue is a min-heap using std::make_heap/push_heap/pop_heap.
-        // We don't use std::priority_queue because we need to be able to serialize, unserialize and
-        // erase arbitrary events (RemoveEvent()) regardless of the queue order. These aren't
-        // accomodated by the standard adaptor class.
-        std::vector<Event> event_queue;
+        EventQueue event_queue;
         u64 event_fifo_id = 0;
         // the queue for storing the events from other threads threadsafe until they will be added
         // to the event_queue by the emu thread
@@ -227,6 +319,8 @@ public:
         s64 downcount = MAX_SLICE_LENGTH;
         s64 executed_ticks = 0;
         u64 idled_cycles = 0;
+        // Length of the slices when no event is scheduled
+        s64 max_slice_length = MAX_SLICE_LENGTH;
         // Stores a scaling for the internal clockspeed. Changing this number results in
         // under/overclocking the guest cpu
         double cpu_clock_scale = 1.0;
@@ -238,7 +332,19 @@ public:
             // TODO(SaveState): Remove the next two lines when we break compatibility
             s64 x;
             ar& x; // to keep compatibility with old save states that stored global_timer
-            ar& event_queue;
+            // The events are stored as a vector sorted by time, which is also a valid min-heap as
+            // stored by older versions
+            std::vector<Event> events;
+            if (Archive::is_saving::value) {
+                events = event_queue.GetEvents();
+            }
+            ar& events;
+            if (Archive::is_loading::value) {
+                event_queue.Clear();
+                for (const Event& event : events) {
+                    event_queue.Push(event);
+                }
+            }
             ar& event_fifo_id;
             ar& slice_length;
             ar& downcount;
@@ -276,6 +382,15 @@ public:
      */
     void UpdateClockSpeed(u32 cpu_clock_percentage);
 
+    /**
+     * Sets whether the cores run until the next scheduled event (up to MAX_ADAPTIVE_SLICE_LENGTH),
+     * instead of at most MAX_SLICE_LENGTH ticks at a time.
+     */
+    void SetAdaptiveSlicing(bool enabled);
+
+    /// Returns the longest slice the cores may run
+    s64 GetMaxSliceLength() const;
+
     std::chrono::microseconds GetGlobalTimeUs() const;
 
     std::shared_ptr<Timer> GetTimer(std::size_t cpu_id);
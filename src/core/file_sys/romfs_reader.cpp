@@ -1,25 +1,107 @@
 #include <algorithm>
+#include <cstring>
 #include <cryptopp/aes.h>
 #include <cryptopp/modes.h>
 #include "common/archives.h"
+#include "common/logging/log.h"
 #include "core/file_sys/romfs_reader.h"
+#include "core/settings.h"
 
 SERIALIZE_EXPORT_IMPL(FileSys::DirectRomFSReader)
 
 namespace FileSys {
 
+struct DirectRomFSReader::Decryption {
+    CryptoPP::CTR_Mode<CryptoPP::AES>::Decryption cipher;
+};
+
+DirectRomFSReader::DirectRomFSReader(FileUtil::IOFile&& file, std::size_t file_offset,
+                                     std::size_t data_size)
+    : is_encrypted(false), file(std::move(file)), file_offset(file_offset), data_size(data_size) {}
+
+DirectRomFSReader::DirectRomFSReader(FileUtil::IOFile&& file, std::size_t file_offset,
+                                     std::size_t data_size, const std::array<u8, 16>& key,
+                                     const std::array<u8, 16>& ctr, std::size_t crypto_offset)
+    : is_encrypted(true), file(std::move(file)), key(key), ctr(ctr), file_offset(file_offset),
+      crypto_offset(crypto_offset), data_size(data_size) {}
+
+DirectRomFSReader::DirectRomFSReader() = default;
+
+DirectRomFSReader::~DirectRomFSReader() {
+    if (cache_stats.hits != 0 || cache_stats.misses != 0) {
+        LOG_DEBUG(Service_FS, "RomFS block cache: {} hits, {} misses", cache_stats.hits,
+                  cache_stats.misses);
+    }
+}
+
 std::size_t DirectRomFSReader::ReadFile(std::size_t offset, std::size_t length, u8* buffer) {
-    if (length == 0)
+    if (length == 0 || offset >= data_size)
         return 0; // Crypto++ does not like zero size buffer
+    length = std::min(length, static_cast<std::size_t>(data_size) - offset);
+
+    // Large reads would only evict the cache, while gaining little from it
+    const std::size_t capacity = Settings::values.romfs_cache_size * 1024 / BLOCK_SIZE;
+    if (length > capacity * BLOCK_SIZE / 4) {
+        return ReadDirect(offset, length, buffer);
+    }
+
+    std::size_t read_length = 0;
+    while (read_length < length) {
+        const std::size_t position = offset + read_length;
+        const CachedBlock& block = GetBlock(position / BLOCK_SIZE, capacity);
+        const std::size_t block_offset = position % BLOCK_SIZE;
+        if (block_offset >= block.size) {
+            break; // The file is shorter than expected
+        }
+
+        const std::size_t copy_length = std::min(length - read_length, block.size - block_offset);
+        std::memcpy(buffer + read_length, block.data.data() + block_offset, copy_length);
+        read_length += copy_length;
+    }
+    return read_length;
+}
+
+std::size_t DirectRomFSReader::ReadDirect(std::size_t offset, std::size_t length, u8* buffer) {
     file.Seek(file_offset + offset, SEEK_SET);
-    std::size_t read_length = std::min(length, static_cast<std::size_t>(data_size) - offset);
-    read_length = file.ReadBytes(buffer, read_length);
-    if (is_encrypted) {
-        CryptoPP::CTR_Mode<CryptoPP::AES>::Decryption d(key.data(), key.size(), ctr.data());
-        d.Seek(crypto_offset + offset);
-        d.ProcessData(buffer, buffer, read_length);
+    const std::size_t read_length = file.ReadBytes(buffer, length);
+    if (is_encrypted && read_length != 0) {
+        if (!decryption) {
+            decryption = std::make_unique<Decryption>();
+            decryption->cipher.SetKeyWithIV(key.data(), key.size(), ctr.data());
+        }
+        decryption->cipher.Seek(crypto_offset + offset);
+        decryption->cipher.ProcessData(buffer, buffer, read_length);
     }
     return read_length;
 }
 
+const DirectRomFSReader::CachedBlock& DirectRomFSReader::GetBlock(std::size_t index,
+                                                                  std::size_t capacity) {
+    auto iter = block_map.find(index);
+    if (iter != block_map.end()) {
+        ++cache_stats.hits;
+        blocks.splice(blocks.begin(), blocks, iter->second);
+        return blocks.front();
+    }
+    ++cache_stats.misses;
+
+    // Evict the least recently used blocks, reusing the buffer of the last one. There may be more
+    // than one to evict if the capacity was lowered since the blocks were cached.
+    std::vector<u8> data;
+    while (!blocks.empty() && blocks.size() >= capacity) {
+        block_map.erase(blocks.back().index);
+        data = std::move(blocks.back().data);
+        blocks.pop_back();
+    }
+    data.resize(BLOCK_SIZE);
+
+    const std::size_t block_offset = index * BLOCK_SIZE;
+    const std::size_t size = ReadDirect(
+        block_offset, std::min(BLOCK_SIZE, static_cast<std::size_t>(data_size) - block_offset),
+        data.data());
+    blocks.push_front({index, size, std::move(data)});
+    block_map.emplace(index, blocks.begin());
+    return blocks.front();
+}
+
 } // namespace FileSys
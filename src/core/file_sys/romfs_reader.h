@@ -1,6 +1,10 @@
 #pragma once
 
 #include <array>
+#include <list>
+#include <memory>
+#include <unordered_map>
+#include <vector>
 #include <boost/serialization/array.hpp>
 #include <boost/serialization/base_object.hpp>
 #include <boost/serialization/export.hpp>
@@ -26,21 +30,26 @@ private:
 };
 
 /**
- * A RomFS reader that directly reads the RomFS file.
+ * A RomFS reader that directly reads the RomFS file. Small reads go through an LRU cache of
+ * decrypted blocks, whose size is set by Settings::values.romfs_cache_size.
  */
 class DirectRomFSReader : public RomFSReader {
 public:
-    DirectRomFSReader(FileUtil::IOFile&& file, std::size_t file_offset, std::size_t data_size)
-        : is_encrypted(false), file(std::move(file)), file_offset(file_offset),
-          data_size(data_size) {}
+    /// Size of the blocks held by the cache
+    static constexpr std::size_t BLOCK_SIZE = 0x4000;
+
+    struct CacheStats {
+        u64 hits = 0;   ///< Number of blocks found in the cache
+        u64 misses = 0; ///< Number of blocks read from the file into the cache
+    };
+
+    DirectRomFSReader(FileUtil::IOFile&& file, std::size_t file_offset, std::size_t data_size);
 
     DirectRomFSReader(FileUtil::IOFile&& file, std::size_t file_offset, std::size_t data_size,
                       const std::array<u8, 16>& key, const std::array<u8, 16>& ctr,
-                      std::size_t crypto_offset)
-        : is_encrypted(true), file(std::move(file)), key(key), ctr(ctr), file_offset(file_offset),
-          crypto_offset(crypto_offset), data_size(data_size) {}
+                      std::size_t crypto_offset);
 
-    ~DirectRomFSReader() override = default;
+    ~DirectRomFSReader() override;
 
     std::size_t GetSize() const override {
         return data_size;
@@ -48,7 +57,23 @@ public:
 
     std::size_t ReadFile(std::size_t offset, std::size_t length, u8* buffer) override;
 
+    const CacheStats& GetCacheStats() const {
+        return cache_stats;
+    }
+
 private:
+    struct CachedBlock {
+        std::size_t index;
+        std::size_t size;
+        std::vector<u8> data;
+    };
+
+    /// Reads and decrypts data from the file, bypassing the cache
+    std::size_t ReadDirect(std::size_t offset, std::size_t length, u8* buffer);
+
+    /// Returns the block with the given index, reading it into the cache if needed
+    const CachedBlock& GetBlock(std::size_t index, std::size_t capacity);
+
     bool is_encrypted;
     FileUtil::IOFile file;
     std::array<u8, 16> key;
@@ -57,7 +82,16 @@ private:
     u64 crypto_offset;
     u64 data_size;
 
-    DirectRomFSReader() = default;
+    /// Cipher context reused by all reads, created on first use
+    struct Decryption;
+    std::unique_ptr<Decryption> decryption;
+
+    /// Cached blocks, most recently used first
+    std::list<CachedBlock> blocks;
+    std::unordered_map<std::size_t, std::list<CachedBlock>::iterator> block_map;
+    CacheStats cache_stats;
+
+    DirectRomFSReader();
 
     template <class Archive>
     void serialize(Archive& ar, const unsigned int) {
@@ -13,6 +13,7 @@
 #include "core/hle/kernel/ipc_debugger/recorder.h"
 #include "core/hle/kernel/kernel.h"
 #include "core/hle/kernel/process.h"
+#include "core/memory.h"
 
 namespace Kernel {
 
@@ -316,6 +317,52 @@ void MappedBuffer::Write(const void* src_buffer, std::size_t offset, std::size_t
     memory->WriteBlock(*process, address + static_cast<VAddr>(offset), src_buffer, size);
 }
 
+std::optional<MappedBuffer::HostSpans> MappedBuffer::GetReadSpans(std::size_t offset,
+                                                                   std::size_t size) {
+    ASSERT(perms & IPC::R);
+    return GetSpans(offset, size, Memory::FlushMode::Flush);
+}
+
+std::optional<MappedBuffer::HostSpans> MappedBuffer::GetWriteSpans(std::size_t offset,
+                                                                    std::size_t size) {
+    ASSERT(perms & IPC::W);
+    // The caller may write less than the whole range, so the rest has to be written back first
+    return GetSpans(offset, size, Memory::FlushMode::FlushAndInvalidate);
+}
+
+std::optional<MappedBuffer::HostSpans> MappedBuffer::GetSpans(std::size_t offset,
+                                                               std::size_t size,
+                                                               Memory::FlushMode mode) {
+    ASSERT(offset + size <= this->size);
+
+    // Check all pages before flushing any of them, so that a failure leaves the cache untouched
+    if (!memory->IsBlockBackedByMemory(*process, address + static_cast<VAddr>(offset), size)) {
+        return std::nullopt;
+    }
+
+    HostSpans spans;
+    VAddr current_vaddr = address + static_cast<VAddr>(offset);
+    std::size_t remaining_size = size;
+    while (remaining_size > 0) {
+        const std::size_t span_size = std::min<std::size_t>(
+            Memory::PAGE_SIZE - (current_vaddr & Memory::PAGE_MASK), remaining_size);
+        u8* data = memory->GetBlockPointer(*process, current_vaddr, span_size, mode);
+        if (!data) {
+            return std::nullopt;
+        }
+
+        if (!spans.empty() && spans.back().data + spans.back().size == data) {
+            spans.back().size += span_size;
+        } else {
+            spans.push_back({data, span_size});
+        }
+
+        current_vaddr += static_cast<VAddr>(span_size);
+        remaining_size -= span_size;
+    }
+    return spans;
+}
+
 } // namespace Kernel
 
 SERIALIZE_EXPORT_IMPL(Kernel::HLERequestContext::ThreadCallback)
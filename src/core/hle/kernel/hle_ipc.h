@@ -8,6 +8,7 @@
 #include <array>
 #include <chrono>
 #include <memory>
+#include <optional>
 #include <string>
 #include <vector>
 #include <boost/container/small_vector.hpp>
@@ -28,6 +29,7 @@ class ServiceFrameworkBase;
 
 namespace Memory {
 class MemorySystem;
+enum class FlushMode;
 }
 
 namespace Kernel {
@@ -129,6 +131,13 @@ public:
     MappedBuffer(Memory::MemorySystem& memory, std::shared_ptr<Process> process, u32 descriptor,
                  VAddr address, u32 id);
 
+    /// A block of host memory backing part of the buffer
+    struct HostSpan {
+        u8* data;
+        std::size_t size;
+    };
+    using HostSpans = boost::container::small_vector<HostSpan, 4>;
+
     // interface for service
     void Read(void* dest_buffer, std::size_t offset, std::size_t size);
     void Write(const void* src_buffer, std::size_t offset, std::size_t size);
@@ -136,6 +145,17 @@ public:
         return size;
     }
 
+    /**
+     * Gets the host memory backing part of the buffer, so that it can be read or written directly
+     * instead of being copied through Read or Write. Pages that are adjacent in host memory are
+     * merged into a single span. Rasterizer cached memory is flushed before reading, and flushed
+     * and invalidated before writing, so that parts of the range left unwritten stay intact.
+     * @returns std::nullopt if part of the range isn't backed by regular memory, in which case
+     *          Read or Write must be used instead
+     */
+    std::optional<HostSpans> GetReadSpans(std::size_t offset, std::size_t size);
+    std::optional<HostSpans> GetWriteSpans(std::size_t offset, std::size_t size);
+
     // interface for ipc helper
     u32 GenerateDescriptor() const {
         return IPC::MappedBufferDesc(size, perms);
@@ -156,6 +176,9 @@ private:
 
     MappedBuffer();
 
+    std::optional<HostSpans> GetSpans(std::size_t offset, std::size_t size,
+                                      Memory::FlushMode mode);
+
     template <class Archive>
     void serialize(Archive& ar, const unsigned int) {
         ar& id;
@@ -2,6 +2,8 @@
 // Licensed under GPLv2 or any later version
 // Refer to the license.txt file included.
 
+#include <optional>
+#include <vector>
 #include <boost/serialization/unique_ptr.hpp>
 #include "common/archives.h"
 #include "common/logging/log.h"
@@ -53,6 +55,73 @@ File::File(Kernel::KernelSystem& kernel)
     RegisterHandlers(functions);
 }
 
+/**
+ * Reads from the backend directly into the guest memory backing the buffer, falling back to an
+ * intermediate copy if the buffer isn't entirely backed by regular memory.
+ */
+static ResultVal<std::size_t> ReadToBuffer(const FileSys::FileBackend& backend,
+                                           Kernel::MappedBuffer& buffer, u64 offset,
+                                           std::size_t length) {
+    std::optional<Kernel::MappedBuffer::HostSpans> spans;
+    if (length <= buffer.GetSize()) {
+        spans = buffer.GetWriteSpans(0, length);
+    }
+
+    if (!spans) {
+        std::vector<u8> data(length);
+        ResultVal<std::size_t> read = backend.Read(offset, data.size(), data.data());
+        if (read.Succeeded()) {
+            buffer.Write(data.data(), 0, *read);
+        }
+        return read;
+    }
+
+    std::size_t total_read = 0;
+    for (const auto& span : *spans) {
+        ResultVal<std::size_t> read = backend.Read(offset + total_read, span.size, span.data);
+        if (read.Failed()) {
+            return read;
+        }
+        total_read += *read;
+        if (*read < span.size) {
+            break;
+        }
+    }
+    return MakeResult<std::size_t>(total_read);
+}
+
+/**
+ * Writes to the backend directly from the guest memory backing the buffer, falling back to an
+ * intermediate copy if the buffer isn't entirely backed by regular memory.
+ */
+static ResultVal<std::size_t> WriteFromBuffer(FileSys::FileBackend& backend,
+                                              Kernel::MappedBuffer& buffer, u64 offset,
+                                              std::size_t length, bool flush) {
+    std::optional<Kernel::MappedBuffer::HostSpans> spans = buffer.GetReadSpans(0, length);
+
+    if (!spans) {
+        std::vector<u8> data(length);
+        buffer.Read(data.data(), 0, data.size());
+        return backend.Write(offset, data.size(), flush, data.data());
+    }
+
+    std::size_t total_written = 0;
+    for (std::size_t i = 0; i < spans->size(); ++i) {
+        const auto& span = (*spans)[i];
+        const bool last = i + 1 == spans->size();
+        ResultVal<std::size_t> written =
+            backend.Write(offset + total_written, span.size, flush && last, span.data);
+        if (written.Failed()) {
+            return written;
+        }
+        total_written += *written;
+        if (*written < span.size) {
+            break;
+        }
+    }
+    return MakeResult<std::size_t>(total_written);
+}
+
 void File::Read(Kernel::HLERequestContext& ctx) {
     IPC::RequestParser rp(ctx, 0x0802, 3, 2);
     u64 offset = rp.Pop<u64>();
@@ -78,13 +147,11 @@ void File::Read(Kernel::HLERequestContext& ctx) {
 
     IPC::RequestBuilder rb = rp.MakeBuilder(2, 2);
 
-    std::vector<u8> data(length);
-    ResultVal<std::size_t> read = backend->Read(offset, data.size(), data.data());
+    ResultVal<std::size_t> read = ReadToBuffer(*backend, buffer, offset, length);
     if (read.Failed()) {
         rb.Push(read.Code());
         rb.Push<u32>(0);
     } else {
-        buffer.Write(data.data(), 0, *read);
         rb.Push(RESULT_SUCCESS);
         rb.Push<u32>(static_cast<u32>(*read));
     }
@@ -115,9 +182,7 @@ void File::Write(Kernel::HLERequestContext& ctx) {
         return;
     }
 
-    std::vector<u8> data(length);
-    buffer.Read(data.data(), 0, data.size());
-    ResultVal<std::size_t> written = backend->Write(offset, data.size(), flush != 0, data.data());
+    ResultVal<std::size_t> written = WriteFromBuffer(*backend, buffer, offset, length, flush != 0);
 
     // Update file size
     file->size = backend->GetSize();
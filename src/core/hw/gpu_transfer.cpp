@@ -0,0 +1,458 @@
+// Copyright 2020 Citra Emulator Project
+// Licensed under GPLv2 or any later version
+// Refer to the license.txt file included.
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <vector>
+#include "common/color.h"
+#include "common/logging/log.h"
+#include "common/thread_pool.h"
+#include "common/vector_math.h"
+#include "core/hw/gpu_transfer.h"
+#include "video_core/utils.h"
+
+namespace GPU {
+
+namespace {
+
+using PixelFormat = Regs::PixelFormat;
+using ScalingMode = Regs::DisplayTransferConfig::ScalingMode;
+
+/// Number of 8-row strips handed to a thread at once
+constexpr u32 STRIPS_PER_JOB = 4;
+/// Transfers with fewer output pixels than this aren't worth splitting across threads
+constexpr u32 PARALLEL_TRANSFER_MIN_PIXELS = 64 * 1024;
+
+template <PixelFormat format>
+constexpr std::size_t BytesPerPixel() {
+    return format == PixelFormat::RGBA8 ? 4 : format == PixelFormat::RGB8 ? 3 : 2;
+}
+
+template <PixelFormat format>
+Common::Vec4<u8> DecodePixel(const u8* pixel) {
+    if constexpr (format == PixelFormat::RGBA8) {
+        return Color::DecodeRGBA8(pixel);
+    } else if constexpr (format == PixelFormat::RGB8) {
+        return Color::DecodeRGB8(pixel);
+    } else if constexpr (format == PixelFormat::RGB565) {
+        return Color::DecodeRGB565(pixel);
+    } else if constexpr (format == PixelFormat::RGB5A1) {
+        return Color::DecodeRGB5A1(pixel);
+    } else {
+        return Color::DecodeRGBA4(pixel);
+    }
+}
+
+template <PixelFormat format>
+void EncodePixel(const Common::Vec4<u8>& color, u8* pixel) {
+    if constexpr (format == PixelFormat::RGBA8) {
+        Color::EncodeRGBA8(color, pixel);
+    } else if constexpr (format == PixelFormat::RGB8) {
+        Color::EncodeRGB8(color, pixel);
+    } else if constexpr (format == PixelFormat::RGB565) {
+        Color::EncodeRGB565(color, pixel);
+    } else if constexpr (format == PixelFormat::RGB5A1) {
+        Color::EncodeRGB5A1(color, pixel);
+    } else {
+        Color::EncodeRGBA4(color, pixel);
+    }
+}
+
+/**
+ * Converts one output row from linear input rows.
+ * @param src First input row of the output row. Downscaling also reads the next input pixel
+ *            and, in ScaleXY mode, the input row `src_stride` bytes further.
+ * @param dst Output row
+ * @param width Number of output pixels
+ */
+using ConvertRowFn = void (*)(const u8* src, std::ptrdiff_t src_stride, u8* dst, u32 width);
+
+template <PixelFormat input_format, PixelFormat output_format, ScalingMode scaling>
+void ConvertRow(const u8* src, std::ptrdiff_t src_stride, u8* dst, u32 width) {
+    constexpr std::size_t src_bytes_per_pixel = BytesPerPixel<input_format>();
+    constexpr std::size_t dst_bytes_per_pixel = BytesPerPixel<output_format>();
+
+    if constexpr (input_format == output_format && scaling == ScalingMode::NoScale) {
+        std::memcpy(dst, src, width * dst_bytes_per_pixel);
+        return;
+    }
+
+    for (u32 x = 0; x < width; ++x) {
+        Common::Vec4<u8> color = DecodePixel<input_format>(src);
+        if constexpr (scaling == ScalingMode::ScaleX) {
+            const Common::Vec4<u8> pixel = DecodePixel<input_format>(src + src_bytes_per_pixel);
+            color = ((color + pixel) / 2).Cast<u8>();
+        } else if constexpr (scaling == ScalingMode::ScaleXY) {
+            const Common::Vec4<u8> pixel1 = DecodePixel<input_format>(src + src_bytes_per_pixel);
+            const Common::Vec4<u8> pixel2 = DecodePixel<input_format>(src + src_stride);
+            const Common::Vec4<u8> pixel3 =
+                DecodePixel<input_format>(src + src_stride + src_bytes_per_pixel);
+            color = (((color + pixel1) + (pixel2 + pixel3)) / 4).Cast<u8>();
+        }
+        EncodePixel<output_format>(color, dst);
+
+        src += scaling == ScalingMode::NoScale ? src_bytes_per_pixel : 2 * src_bytes_per_pixel;
+        dst += dst_bytes_per_pixel;
+    }
+}
+
+template <PixelFormat input_format, PixelFormat output_format>
+ConvertRowFn GetConvertRowFn(ScalingMode scaling) {
+    switch (scaling) {
+    case ScalingMode::NoScale:
+        return ConvertRow<input_format, output_format, ScalingMode::NoScale>;
+    case ScalingMode::ScaleX:
+        return ConvertRow<input_format, output_format, ScalingMode::ScaleX>;
+    case ScalingMode::ScaleXY:
+        return ConvertRow<input_format, output_format, ScalingMode::ScaleXY>;
+    }
+    return nullptr;
+}
+
+template <PixelFormat input_format>
+ConvertRowFn GetConvertRowFn(PixelFormat output_format, ScalingMode scaling) {
+    switch (output_format) {
+    case PixelFormat::RGBA8:
+        return GetConvertRowFn<input_format, PixelFormat::RGBA8>(scaling);
+    case PixelFormat::RGB8:
+        return GetConvertRowFn<input_format, PixelFormat::RGB8>(scaling);
+    case PixelFormat::RGB565:
+        return GetConvertRowFn<input_format, PixelFormat::RGB565>(scaling);
+    case PixelFormat::RGB5A1:
+        return GetConvertRowFn<input_format, PixelFormat::RGB5A1>(scaling);
+    case PixelFormat::RGBA4:
+        return GetConvertRowFn<input_format, PixelFormat::RGBA4>(scaling);
+    }
+    return nullptr;
+}
+
+ConvertRowFn GetConvertRowFn(PixelFormat input_format, PixelFormat output_format,
+                             ScalingMode scaling) {
+    switch (input_format) {
+    case PixelFormat::RGBA8:
+        return GetConvertRowFn<PixelFormat::RGBA8>(output_format, scaling);
+    case PixelFormat::RGB8:
+        return GetConvertRowFn<PixelFormat::RGB8>(output_format, scaling);
+    case PixelFormat::RGB565:
+        return GetConvertRowFn<PixelFormat::RGB565>(output_format, scaling);
+    case PixelFormat::RGB5A1:
+        return GetConvertRowFn<PixelFormat::RGB5A1>(output_format, scaling);
+    case PixelFormat::RGBA4:
+        return GetConvertRowFn<PixelFormat::RGBA4>(output_format, scaling);
+    }
+    return nullptr;
+}
+
+void UnswizzleImage(std::size_t bytes_per_pixel, const u8* tiled, u32 tiled_width, u8* linear,
+                    std::ptrdiff_t stride, u32 width, u32 height) {
+    switch (bytes_per_pixel) {
+    case 4:
+        VideoCore::UnswizzleImage<4>(tiled, tiled_width, linear, stride, width, height);
+        break;
+    case 3:
+        VideoCore::UnswizzleImage<3>(tiled, tiled_width, linear, stride, width, height);
+        break;
+    default:
+        VideoCore::UnswizzleImage<2>(tiled, tiled_width, linear, stride, width, height);
+        break;
+    }
+}
+
+void SwizzleImage(std::size_t bytes_per_pixel, const u8* linear, std::ptrdiff_t stride,
+                  u8* tiled, u32 tiled_width, u32 width, u32 height) {
+    switch (bytes_per_pixel) {
+    case 4:
+        VideoCore::SwizzleImage<4>(linear, stride, tiled, tiled_width, width, height);
+        break;
+    case 3:
+        VideoCore::SwizzleImage<3>(linear, stride, tiled, tiled_width, width, height);
+        break;
+    default:
+        VideoCore::SwizzleImage<2>(linear, stride, tiled, tiled_width, width, height);
+        break;
+    }
+}
+
+/// Parameters of a display transfer shared by all of its strips
+struct Transfer {
+    ConvertRowFn convert_row;
+    /// Whether the rows are copied without any conversion or scaling
+    bool copy_rows;
+
+    const u8* src;
+    u8* dst;
+    bool input_tiled;
+    bool output_tiled;
+    bool flip;
+
+    /// Output dimensions
+    u32 width;
+    u32 height;
+    /// Width of the rows of the input image
+    u32 input_width;
+    u32 horizontal_scale;
+    u32 vertical_scale;
+    std::size_t src_bytes_per_pixel;
+    std::size_t dst_bytes_per_pixel;
+};
+
+/// Scratch rows used to convert between tiled and linear strips
+struct StripBuffers {
+    std::vector<u8> src;
+    std::vector<u8> dst;
+};
+
+/// Transfers the output rows [y, y + rows), which must be a whole tile row for tiled images
+void TransferStrip(const Transfer& t, u32 y, u32 rows, StripBuffers& buffers) {
+    const std::ptrdiff_t dst_row_size = t.width * t.dst_bytes_per_pixel;
+
+    // Position of the output rows, which are written in reverse order when flipping
+    u8* dst_row = t.dst + static_cast<std::ptrdiff_t>(t.flip ? t.height - 1 - y : y) * dst_row_size;
+    std::ptrdiff_t dst_stride = t.flip ? -dst_row_size : dst_row_size;
+    u8* const tiled_dst = t.dst + static_cast<std::ptrdiff_t>(t.flip ? t.height - rows - y : y) *
+                                      dst_row_size;
+
+    const u8* src_row;
+    std::ptrdiff_t src_stride;
+    if (t.input_tiled) {
+        const u32 input_y = y << t.vertical_scale;
+        const u32 input_rows = rows << t.vertical_scale;
+        const u32 input_row_width = t.width << t.horizontal_scale;
+        const u8* const tiled_src = t.src + static_cast<std::size_t>(input_y) * t.input_width *
+                                                t.src_bytes_per_pixel;
+        src_stride = input_row_width * t.src_bytes_per_pixel;
+
+        if (t.copy_rows && !t.output_tiled) {
+            UnswizzleImage(t.src_bytes_per_pixel, tiled_src, t.input_width, dst_row, dst_stride,
+                           t.width, rows);
+            return;
+        }
+
+        buffers.src.resize(input_rows * src_stride);
+        UnswizzleImage(t.src_bytes_per_pixel, tiled_src, t.input_width, buffers.src.data(),
+                       src_stride, input_row_width, input_rows);
+        src_row = buffers.src.data();
+    } else {
+        src_stride = t.input_width * t.src_bytes_per_pixel;
+        src_row = t.src + static_cast<std::ptrdiff_t>(y) * src_stride;
+
+        if (t.copy_rows && t.output_tiled) {
+            // Tile rows are stored top to bottom, so a flipped strip starts with the last row
+            const u8* const first_row = t.flip ? src_row + (rows - 1) * src_stride : src_row;
+            SwizzleImage(t.dst_bytes_per_pixel, first_row, t.flip ? -src_stride : src_stride,
+                         tiled_dst, t.width, t.width, rows);
+            return;
+        }
+    }
+
+    if (t.output_tiled) {
+        buffers.dst.resize(rows * dst_row_size);
+        dst_row = buffers.dst.data();
+        dst_stride = dst_row_size;
+    }
+
+    const std::ptrdiff_t src_row_step = src_stride << t.vertical_scale;
+    for (u32 row = 0; row < rows; ++row) {
+        t.convert_row(src_row, src_stride, dst_row, t.width);
+        src_row += src_row_step;
+        dst_row += dst_stride;
+    }
+
+    if (t.output_tiled) {
+        const u8* const first_row =
+            t.flip ? buffers.dst.data() + (rows - 1) * dst_row_size : buffers.dst.data();
+        SwizzleImage(t.dst_bytes_per_pixel, first_row, t.flip ? -dst_row_size : dst_row_size,
+                     tiled_dst, t.width, t.width, rows);
+    }
+}
+
+Common::Vec4<u8> DecodePixel(PixelFormat input_format, const u8* src_pixel) {
+    switch (input_format) {
+    case PixelFormat::RGBA8:
+        return Color::DecodeRGBA8(src_pixel);
+
+    case PixelFormat::RGB8:
+        return Color::DecodeRGB8(src_pixel);
+
+    case PixelFormat::RGB565:
+        return Color::DecodeRGB565(src_pixel);
+
+    case PixelFormat::RGB5A1:
+        return Color::DecodeRGB5A1(src_pixel);
+
+    case PixelFormat::RGBA4:
+        return Color::DecodeRGBA4(src_pixel);
+
+    default:
+        LOG_ERROR(HW_GPU, "Unknown source framebuffer format {:x}", static_cast<u32>(input_format));
+        return {0, 0, 0, 0};
+    }
+}
+
+/// Transfers the image pixel by pixel, which also handles tiled images of partial tiles
+void TransferPixels(const Regs::DisplayTransferConfig& config, const u8* src_pointer,
+                    u8* dst_pointer, u32 output_width, u32 output_height, int horizontal_scale,
+                    int vertical_scale) {
+    for (u32 y = 0; y < output_height; ++y) {
+        for (u32 x = 0; x < output_width; ++x) {
+            Common::Vec4<u8> src_color;
+
+            // Calculate the [x,y] position of the input image
+            // based on the current output position and the scale
+            u32 input_x = x << horizontal_scale;
+            u32 input_y = y << vertical_scale;
+
+            u32 output_y;
+            if (config.flip_vertically) {
+                // Flip the y value of the output data,
+                // we do this after calculating the [x,y] position of the input image
+                // to account for the scaling options.
+                output_y = output_height - y - 1;
+            } else {
+                output_y = y;
+            }
+
+            u32 dst_bytes_per_pixel = GPU::Regs::BytesPerPixel(config.output_format);
+            u32 src_bytes_per_pixel = GPU::Regs::BytesPerPixel(config.input_format);
+            u32 src_offset;
+            u32 dst_offset;
+
+            if (config.input_linear) {
+                if (!config.dont_swizzle) {
+                    // Interpret the input as linear and the output as tiled
+                    u32 coarse_y = output_y & ~7;
+                    u32 stride = output_width * dst_bytes_per_pixel;
+
+                    src_offset = (input_x + input_y * config.input_width) * src_bytes_per_pixel;
+                    dst_offset = VideoCore::GetMortonOffset(x, output_y, dst_bytes_per_pixel) +
+                                 coarse_y * stride;
+                } else {
+                    // Both input and output are linear
+                    src_offset = (input_x + input_y * config.input_width) * src_bytes_per_pixel;
+                    dst_offset = (x + output_y * output_width) * dst_bytes_per_pixel;
+                }
+            } else {
+                if (!config.dont_swizzle) {
+                    // Interpret the input as tiled and the output as linear
+                    u32 coarse_y = input_y & ~7;
+                    u32 stride = config.input_width * src_bytes_per_pixel;
+
+                    src_offset = VideoCore::GetMortonOffset(input_x, input_y, src_bytes_per_pixel) +
+                                 coarse_y * stride;
+                    dst_offset = (x + output_y * output_width) * dst_bytes_per_pixel;
+                } else {
+                    // Both input and output are tiled
+                    u32 out_coarse_y = output_y & ~7;
+                    u32 out_stride = output_width * dst_bytes_per_pixel;
+
+                    u32 in_coarse_y = input_y & ~7;
+                    u32 in_stride = config.input_width * src_bytes_per_pixel;
+
+                    src_offset = VideoCore::GetMortonOffset(input_x, input_y, src_bytes_per_pixel) +
+                                 in_coarse_y * in_stride;
+                    dst_offset = VideoCore::GetMortonOffset(x, output_y, dst_bytes_per_pixel) +
+                                 out_coarse_y * out_stride;
+                }
+            }
+
+            const u8* src_pixel = src_pointer + src_offset;
+            src_color = DecodePixel(config.input_format, src_pixel);
+            if (config.scaling == config.ScaleX) {
+                Common::Vec4<u8> pixel =
+                    DecodePixel(config.input_format, src_pixel + src_bytes_per_pixel);
+                src_color = ((src_color + pixel) / 2).Cast<u8>();
+            } else if (config.scaling == config.ScaleXY) {
+                Common::Vec4<u8> pixel1 =
+                    DecodePixel(config.input_format, src_pixel + 1 * src_bytes_per_pixel);
+                Common::Vec4<u8> pixel2 =
+                    DecodePixel(config.input_format, src_pixel + 2 * src_bytes_per_pixel);
+                Common::Vec4<u8> pixel3 =
+                    DecodePixel(config.input_format, src_pixel + 3 * src_bytes_per_pixel);
+                src_color = (((src_color + pixel1) + (pixel2 + pixel3)) / 4).Cast<u8>();
+            }
+
+            u8* dst_pixel = dst_pointer + dst_offset;
+            switch (config.output_format) {
+            case PixelFormat::RGBA8:
+                Color::EncodeRGBA8(src_color, dst_pixel);
+                break;
+
+            case PixelFormat::RGB8:
+                Color::EncodeRGB8(src_color, dst_pixel);
+                break;
+
+            case PixelFormat::RGB565:
+                Color::EncodeRGB565(src_color, dst_pixel);
+                break;
+
+            case PixelFormat::RGB5A1:
+                Color::EncodeRGB5A1(src_color, dst_pixel);
+                break;
+
+            case PixelFormat::RGBA4:
+                Color::EncodeRGBA4(src_color, dst_pixel);
+                break;
+
+            default:
+                LOG_ERROR(HW_GPU, "Unknown destination framebuffer format {:x}",
+                          static_cast<u32>(config.output_format.Value()));
+                break;
+            }
+        }
+    }
+}
+
+} // Anonymous namespace
+
+void PerformDisplayTransfer(const Regs::DisplayTransferConfig& config, const u8* src_pointer,
+                            u8* dst_pointer, Common::ThreadPool* pool) {
+    const u32 horizontal_scale = config.scaling != config.NoScale ? 1 : 0;
+    const u32 vertical_scale = config.scaling == config.ScaleXY ? 1 : 0;
+
+    Transfer t;
+    t.convert_row = GetConvertRowFn(config.input_format, config.output_format, config.scaling);
+    t.copy_rows = config.input_format == config.output_format && config.scaling == config.NoScale;
+    t.src = src_pointer;
+    t.dst = dst_pointer;
+    t.input_tiled = !config.input_linear;
+    t.output_tiled = config.input_linear != config.dont_swizzle;
+    t.flip = config.flip_vertically;
+    t.width = config.output_width >> horizontal_scale;
+    t.height = config.output_height >> vertical_scale;
+    t.input_width = config.input_width;
+    t.horizontal_scale = horizontal_scale;
+    t.vertical_scale = vertical_scale;
+
+    const bool tiled = t.input_tiled || t.output_tiled;
+    if (t.convert_row == nullptr || (tiled && (t.width % 8 != 0 || t.height % 8 != 0))) {
+        TransferPixels(config, src_pointer, dst_pointer, t.width, t.height, horizontal_scale,
+                       vertical_scale);
+        return;
+    }
+
+    t.src_bytes_per_pixel = Regs::BytesPerPixel(config.input_format);
+    t.dst_bytes_per_pixel = Regs::BytesPerPixel(config.output_format);
+
+    const u32 num_strips = (t.height + 7) / 8;
+    const u32 num_jobs = (num_strips + STRIPS_PER_JOB - 1) / STRIPS_PER_JOB;
+    const auto transfer_job = [&t, num_strips](std::size_t job) {
+        StripBuffers buffers;
+        const u32 end = std::min(static_cast<u32>(job + 1) * STRIPS_PER_JOB, num_strips);
+        for (u32 strip = static_cast<u32>(job) * STRIPS_PER_JOB; strip < end; ++strip) {
+            const u32 y = strip * 8;
+            TransferStrip(t, y, std::min(8u, t.height - y), buffers);
+        }
+    };
+
+    if (pool == nullptr || num_jobs == 1 || t.width * t.height < PARALLEL_TRANSFER_MIN_PIXELS) {
+        for (u32 job = 0; job < num_jobs; ++job) {
+            transfer_job(job);
+        }
+    } else {
+        pool->ParallelFor(num_jobs, transfer_job);
+    }
+}
+
+} // namespace GPU
@@ -0,0 +1,32 @@
+// Copyright 2020 Citra Emulator Project
+// Licensed under GPLv2 or any later version
+// Refer to the license.txt file included.
+
+#pragma once
+
+#include "common/common_types.h"
+#include "core/hw/gpu.h"
+
+namespace Common {
+class ThreadPool;
+}
+
+namespace GPU {
+
+/**
+ * Performs a display transfer on the CPU, for when the renderer can't accelerate it.
+ *
+ * The routine converting the pixels is selected once for the combination of formats and scaling
+ * mode, and the image is processed in strips of 8 rows, which are spread over the threads of the
+ * given pool for large images.
+ *
+ * @param config Transfer configuration. The output dimensions must be non-zero and the scaling
+ *               mode must be supported, which DisplayTransfer checks beforehand.
+ * @param src_pointer Host pointer to the input image
+ * @param dst_pointer Host pointer to the output image
+ * @param pool Thread pool to distribute large transfers across, or nullptr
+ */
+void PerformDisplayTransfer(const Regs::DisplayTransferConfig& config, const u8* src_pointer,
+                            u8* dst_pointer, Common::ThreadPool* pool = nullptr);
+
+} // namespace GPU
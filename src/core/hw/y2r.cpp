@@ -5,15 +5,22 @@
 #include <algorithm>
 #include <array>
 #include <cstddef>
+#include <cstring>
 #include <memory>
+#include <thread>
+#include <vector>
 #include "common/assert.h"
-#include "common/color.h"
 #include "common/common_types.h"
-#include "common/vector_math.h"
+#include "common/thread_pool.h"
 #include "core/core.h"
 #include "core/hle/service/y2r_u.h"
 #include "core/hw/y2r.h"
 #include "core/memory.h"
+#include "video_core/utils.h"
+
+#ifdef ARCHITECTURE_x86_64
+#include <emmintrin.h>
+#endif
 
 namespace HW::Y2R {
 
@@ -23,57 +30,191 @@ static const std::size_t MAX_TILES = 1024 / 8;
 static const std::size_t TILE_SIZE = 8 * 8;
 using ImageTile = std::array<u32, TILE_SIZE>;
 
-/// Converts a image strip from the source YUV format into individual 8x8 RGB32 tiles.
-static void ConvertYUVToRGB(InputFormat input_format, const u8* input_Y, const u8* input_U,
-                            const u8* input_V, ImageTile output[], unsigned int width,
-                            unsigned int height, const CoefficientSet& coefficients) {
+/// Maximum number of threads strips of large images are converted on
+static const std::size_t MAX_CONVERSION_THREADS = 4;
+/// Images with fewer pixels than this aren't worth splitting across threads
+static const std::size_t PARALLEL_CONVERSION_MIN_PIXELS = 32 * 1024;
+
+#ifdef ARCHITECTURE_x86_64
+
+/// Coefficients arranged for multiplying interleaved pairs of 16-bit values with _mm_madd_epi16
+struct CoefficientVectors {
+    explicit CoefficientVectors(const CoefficientSet& c)
+        : y_v_r(Pair(c[0], c[1])), y_nv_g(Pair(c[0], c[2])), nu_g(Pair(c[3], 0)),
+          y_u_b(Pair(c[0], c[4])), offset_r(_mm_set1_epi32(c[5] + 0x18)),
+          offset_g(_mm_set1_epi32(c[6] + 0x18)), offset_b(_mm_set1_epi32(c[7] + 0x18)) {}
+
+    static __m128i Pair(s16 low, s16 high) {
+        return _mm_set1_epi32(static_cast<int>((static_cast<u32>(static_cast<u16>(high)) << 16) |
+                                               static_cast<u16>(low)));
+    }
+
+    __m128i y_v_r;
+    __m128i y_nv_g;
+    __m128i nu_g;
+    __m128i y_u_b;
+    __m128i offset_r;
+    __m128i offset_g;
+    __m128i offset_b;
+};
+
+/// Reads the Y, U and V values of 8 horizontally adjacent pixels into 16-bit lanes
+template <InputFormat input_format>
+static void LoadYUV8(const u8* input_Y, const u8* input_U, const u8* input_V, unsigned int x,
+                     unsigned int y, unsigned int width, __m128i& Y, __m128i& U, __m128i& V) {
+    const __m128i zero = _mm_setzero_si128();
+    if constexpr (input_format == InputFormat::YUYV422_Interleaved) {
+        // Each pair of pixels is stored as Y0 U Y1 V
+        const __m128i data =
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(input_Y + (y * width + x) * 2));
+        Y = _mm_and_si128(data, _mm_set1_epi16(0xFF));
+        const __m128i chroma = _mm_srli_epi16(data, 8);
+        constexpr int u_order = _MM_SHUFFLE(2, 2, 0, 0);
+        constexpr int v_order = _MM_SHUFFLE(3, 3, 1, 1);
+        U = _mm_shufflehi_epi16(_mm_shufflelo_epi16(chroma, u_order), u_order);
+        V = _mm_shufflehi_epi16(_mm_shufflelo_epi16(chroma, v_order), v_order);
+    } else {
+        constexpr bool is_420 = input_format == InputFormat::YUV420_Indiv8 ||
+                                input_format == InputFormat::YUV420_Indiv16;
+        const unsigned int chroma_y = is_420 ? y / 2 : y;
+        const std::size_t chroma_offset = (chroma_y * width + x) / 2;
+
+        Y = _mm_unpacklo_epi8(
+            _mm_loadl_epi64(reinterpret_cast<const __m128i*>(input_Y + y * width + x)), zero);
+
+        // Every chroma sample is shared by two horizontally adjacent pixels
+        u32 packed_U;
+        u32 packed_V;
+        std::memcpy(&packed_U, input_U + chroma_offset, sizeof(u32));
+        std::memcpy(&packed_V, input_V + chroma_offset, sizeof(u32));
+        const __m128i chroma_U = _mm_cvtsi32_si128(static_cast<int>(packed_U));
+        const __m128i chroma_V = _mm_cvtsi32_si128(static_cast<int>(packed_V));
+        U = _mm_unpacklo_epi8(_mm_unpacklo_epi8(chroma_U, chroma_U), zero);
+        V = _mm_unpacklo_epi8(_mm_unpacklo_epi8(chroma_V, chroma_V), zero);
+    }
+}
+
+/// Scales, offsets and clamps 8 color components computed in two vectors of 32-bit lanes
+static __m128i FinishComponent(__m128i low, __m128i high, __m128i offset) {
+    low = _mm_srai_epi32(_mm_add_epi32(_mm_srai_epi32(low, 3), offset), 5);
+    high = _mm_srai_epi32(_mm_add_epi32(_mm_srai_epi32(high, 3), offset), 5);
+    // The saturating packs clamp the components to [0, 255]
+    const __m128i packed = _mm_packs_epi32(low, high);
+    return _mm_packus_epi16(packed, packed);
+}
+
+/// Converts 8 YUV tuples to intermediate RGB32 values, bit-exact with the scalar YUVToRGB
+static void YUVToRGB8(__m128i Y, __m128i U, __m128i V, const CoefficientVectors& c, u32* output) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i neg_U = _mm_sub_epi16(zero, U);
+    const __m128i neg_V = _mm_sub_epi16(zero, V);
+
+    const __m128i r = FinishComponent(_mm_madd_epi16(_mm_unpacklo_epi16(Y, V), c.y_v_r),
+                                      _mm_madd_epi16(_mm_unpackhi_epi16(Y, V), c.y_v_r),
+                                      c.offset_r);
+    const __m128i g = FinishComponent(
+        _mm_add_epi32(_mm_madd_epi16(_mm_unpacklo_epi16(Y, neg_V), c.y_nv_g),
+                      _mm_madd_epi16(_mm_unpacklo_epi16(neg_U, zero), c.nu_g)),
+        _mm_add_epi32(_mm_madd_epi16(_mm_unpackhi_epi16(Y, neg_V), c.y_nv_g),
+                      _mm_madd_epi16(_mm_unpackhi_epi16(neg_U, zero), c.nu_g)),
+        c.offset_g);
+    const __m128i b = FinishComponent(_mm_madd_epi16(_mm_unpacklo_epi16(Y, U), c.y_u_b),
+                                      _mm_madd_epi16(_mm_unpackhi_epi16(Y, U), c.y_u_b),
+                                      c.offset_b);
+
+    // Assemble (r << 24) | (g << 16) | (b << 8)
+    const __m128i low_half = _mm_unpacklo_epi8(zero, b);
+    const __m128i high_half = _mm_unpacklo_epi8(g, r);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(output), _mm_unpacklo_epi16(low_half, high_half));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(output + 4),
+                     _mm_unpackhi_epi16(low_half, high_half));
+}
+
+#else
+
+/// Reads the Y, U and V values of the pixel at (x, y) of a strip in the given input format
+template <InputFormat input_format>
+static void LoadYUV(const u8* input_Y, const u8* input_U, const u8* input_V, unsigned int x,
+                    unsigned int y, unsigned int width, s32& Y, s32& U, s32& V) {
+    if constexpr (input_format == InputFormat::YUYV422_Interleaved) {
+        Y = input_Y[(y * width + x) * 2];
+        U = input_Y[(y * width + (x / 2) * 2) * 2 + 1];
+        V = input_Y[(y * width + (x / 2) * 2) * 2 + 3];
+    } else {
+        // Chroma planes of 4:2:0 formats have one line for every two image lines
+        constexpr bool is_420 = input_format == InputFormat::YUV420_Indiv8 ||
+                                input_format == InputFormat::YUV420_Indiv16;
+        const unsigned int chroma_y = is_420 ? y / 2 : y;
+        Y = input_Y[y * width + x];
+        U = input_U[(chroma_y * width + x) / 2];
+        V = input_V[(chroma_y * width + x) / 2];
+    }
+}
+
+/// Converts a YUV tuple to an intermediate RGB32 value
+static u32 YUVToRGB(s32 Y, s32 U, s32 V, const CoefficientSet& coefficients) {
+    // This conversion process is bit-exact with hardware, as far as could be tested.
+    auto& c = coefficients;
+    s32 cY = c[0] * Y;
+
+    s32 r = cY + c[1] * V;
+    s32 g = cY - c[2] * V - c[3] * U;
+    s32 b = cY + c[4] * U;
 
+    const s32 rounding_offset = 0x18;
+    r = (r >> 3) + c[5] + rounding_offset;
+    g = (g >> 3) + c[6] + rounding_offset;
+    b = (b >> 3) + c[7] + rounding_offset;
+
+    return ((u32)std::clamp(r >> 5, 0, 0xFF) << 24) | ((u32)std::clamp(g >> 5, 0, 0xFF) << 16) |
+           ((u32)std::clamp(b >> 5, 0, 0xFF) << 8);
+}
+
+#endif // ARCHITECTURE_x86_64
+
+/// Converts a image strip from the source YUV format into individual 8x8 RGB32 tiles.
+template <InputFormat input_format>
+static void ConvertYUVToRGB(const u8* input_Y, const u8* input_U, const u8* input_V,
+                            ImageTile output[], unsigned int width, unsigned int height,
+                            const CoefficientSet& coefficients) {
+#ifdef ARCHITECTURE_x86_64
+    // Each row of a tile is converted at once
+    const CoefficientVectors vectors(coefficients);
+    for (unsigned int y = 0; y < height; ++y) {
+        for (unsigned int x = 0; x < width; x += 8) {
+            __m128i Y, U, V;
+            LoadYUV8<input_format>(input_Y, input_U, input_V, x, y, width, Y, U, V);
+            YUVToRGB8(Y, U, V, vectors, &output[x / 8][y * 8]);
+        }
+    }
+#else
     for (unsigned int y = 0; y < height; ++y) {
         for (unsigned int x = 0; x < width; ++x) {
-            s32 Y = 0;
-            s32 U = 0;
-            s32 V = 0;
-            switch (input_format) {
-            case InputFormat::YUV422_Indiv8:
-            case InputFormat::YUV422_Indiv16:
-                Y = input_Y[y * width + x];
-                U = input_U[(y * width + x) / 2];
-                V = input_V[(y * width + x) / 2];
-                break;
-            case InputFormat::YUV420_Indiv8:
-            case InputFormat::YUV420_Indiv16:
-                Y = input_Y[y * width + x];
-                U = input_U[((y / 2) * width + x) / 2];
-                V = input_V[((y / 2) * width + x) / 2];
-                break;
-            case InputFormat::YUYV422_Interleaved:
-                Y = input_Y[(y * width + x) * 2];
-                U = input_Y[(y * width + (x / 2) * 2) * 2 + 1];
-                V = input_Y[(y * width + (x / 2) * 2) * 2 + 3];
-                break;
-            }
-
-            // This conversion process is bit-exact with hardware, as far as could be tested.
-            auto& c = coefficients;
-            s32 cY = c[0] * Y;
-
-            s32 r = cY + c[1] * V;
-            s32 g = cY - c[2] * V - c[3] * U;
-            s32 b = cY + c[4] * U;
-
-            const s32 rounding_offset = 0x18;
-            r = (r >> 3) + c[5] + rounding_offset;
-            g = (g >> 3) + c[6] + rounding_offset;
-            b = (b >> 3) + c[7] + rounding_offset;
-
-            unsigned int tile = x / 8;
-            unsigned int tile_x = x % 8;
-            u32* out = &output[tile][y * 8 + tile_x];
-            *out = ((u32)std::clamp(r >> 5, 0, 0xFF) << 24) |
-                   ((u32)std::clamp(g >> 5, 0, 0xFF) << 16) |
-                   ((u32)std::clamp(b >> 5, 0, 0xFF) << 8);
+            s32 Y, U, V;
+            LoadYUV<input_format>(input_Y, input_U, input_V, x, y, width, Y, U, V);
+            output[x / 8][y * 8 + x % 8] = YUVToRGB(Y, U, V, coefficients);
         }
     }
+#endif
+}
+
+using ConvertYUVToRGBFn = void (*)(const u8*, const u8*, const u8*, ImageTile[], unsigned int,
+                                   unsigned int, const CoefficientSet&);
+
+static ConvertYUVToRGBFn GetConvertYUVToRGBFn(InputFormat input_format) {
+    switch (input_format) {
+    case InputFormat::YUV422_Indiv8:
+        return ConvertYUVToRGB<InputFormat::YUV422_Indiv8>;
+    case InputFormat::YUV420_Indiv8:
+        return ConvertYUVToRGB<InputFormat::YUV420_Indiv8>;
+    case InputFormat::YUV422_Indiv16:
+        return ConvertYUVToRGB<InputFormat::YUV422_Indiv16>;
+    case InputFormat::YUV420_Indiv16:
+        return ConvertYUVToRGB<InputFormat::YUV420_Indiv16>;
+    case InputFormat::YUYV422_Interleaved:
+        return ConvertYUVToRGB<InputFormat::YUYV422_Interleaved>;
+    }
+    UNREACHABLE();
 }
 
 /// Simulates an incoming CDMA transfer. The N parameter is used to automatically convert 16-bit
@@ -87,8 +228,12 @@ static void ReceiveData(Memory::MemorySystem& memory, u8* output, ConversionBuff
     ASSERT(amount_of_data % output_unit == 0);
 
     while (amount_of_data > 0) {
-        for (std::size_t i = 0; i < output_unit; ++i) {
-            output[i] = input[i * N];
+        if constexpr (N == 1) {
+            std::memcpy(output, input, output_unit);
+        } else {
+            for (std::size_t i = 0; i < output_unit; ++i) {
+                output[i] = input[i * N];
+            }
         }
 
         output += output_unit;
@@ -100,38 +245,70 @@ static void ReceiveData(Memory::MemorySystem& memory, u8* output, ConversionBuff
     }
 }
 
+/// Advances a buffer past the data ReceiveData<N> would read, without reading it.
+template <std::size_t N>
+static void SkipReceiveData(ConversionBuffer& buf, std::size_t amount_of_data) {
+    const std::size_t units = amount_of_data / (buf.transfer_unit / N);
+    buf.address += static_cast<VAddr>(units * (buf.transfer_unit + buf.gap));
+    buf.image_size -= static_cast<u32>(units * buf.transfer_unit);
+}
+
+template <OutputFormat output_format>
+constexpr std::size_t BytesPerPixel() {
+    return output_format == OutputFormat::RGBA8 ? 4 : output_format == OutputFormat::RGB8 ? 3 : 2;
+}
+
+static std::size_t BytesPerPixel(OutputFormat output_format) {
+    switch (output_format) {
+    case OutputFormat::RGBA8:
+        return 4;
+    case OutputFormat::RGB8:
+        return 3;
+    case OutputFormat::RGB5A1:
+    case OutputFormat::RGB565:
+        return 2;
+    }
+    UNREACHABLE();
+}
+
+/// Encodes an intermediate RGB32 value in the output format
+template <OutputFormat output_format>
+static void EncodePixel(u32 color, u8 alpha, u8* output) {
+    const u32 r = color >> 24;
+    const u32 g = (color >> 16) & 0xFF;
+    const u32 b = (color >> 8) & 0xFF;
+
+    if constexpr (output_format == OutputFormat::RGBA8) {
+        const u32_le data = color | alpha;
+        std::memcpy(output, &data, sizeof(data));
+    } else if constexpr (output_format == OutputFormat::RGB8) {
+        output[0] = static_cast<u8>(b);
+        output[1] = static_cast<u8>(g);
+        output[2] = static_cast<u8>(r);
+    } else if constexpr (output_format == OutputFormat::RGB5A1) {
+        const u16_le data = static_cast<u16>(((r >> 3) << 11) | ((g >> 3) << 6) |
+                                             ((b >> 3) << 1) | (alpha >> 7));
+        std::memcpy(output, &data, sizeof(data));
+    } else {
+        const u16_le data = static_cast<u16>(((r >> 3) << 11) | ((g >> 2) << 5) | (b >> 3));
+        std::memcpy(output, &data, sizeof(data));
+    }
+}
+
 /// Convert intermediate RGB32 format to the final output format while simulating an outgoing CDMA
 /// transfer.
+template <OutputFormat output_format>
 static void SendData(Memory::MemorySystem& memory, const u32* input, ConversionBuffer& buf,
-                     int amount_of_data, OutputFormat output_format, u8 alpha) {
+                     int amount_of_data, u8 alpha) {
+    constexpr std::size_t bytes_per_pixel = BytesPerPixel<output_format>();
 
     u8* output = memory.GetPointer(buf.address);
 
     while (amount_of_data > 0) {
         u8* unit_end = output + buf.transfer_unit;
         while (output < unit_end) {
-            u32 color = *input++;
-            Common::Vec4<u8> col_vec{(u8)(color >> 24), (u8)(color >> 16), (u8)(color >> 8), alpha};
-
-            switch (output_format) {
-            case OutputFormat::RGBA8:
-                Color::EncodeRGBA8(col_vec, output);
-                output += 4;
-                break;
-            case OutputFormat::RGB8:
-                Color::EncodeRGB8(col_vec, output);
-                output += 3;
-                break;
-            case OutputFormat::RGB5A1:
-                Color::EncodeRGB5A1(col_vec, output);
-                output += 2;
-                break;
-            case OutputFormat::RGB565:
-                Color::EncodeRGB565(col_vec, output);
-                output += 2;
-                break;
-            }
-
+            EncodePixel<output_format>(*input++, alpha, output);
+            output += bytes_per_pixel;
             amount_of_data -= 1;
         }
 
@@ -141,6 +318,31 @@ static void SendData(Memory::MemorySystem& memory, const u32* input, ConversionB
     }
 }
 
+using SendDataFn = void (*)(Memory::MemorySystem&, const u32*, ConversionBuffer&, int, u8);
+
+static SendDataFn GetSendDataFn(OutputFormat output_format) {
+    switch (output_format) {
+    case OutputFormat::RGBA8:
+        return SendData<OutputFormat::RGBA8>;
+    case OutputFormat::RGB8:
+        return SendData<OutputFormat::RGB8>;
+    case OutputFormat::RGB5A1:
+        return SendData<OutputFormat::RGB5A1>;
+    case OutputFormat::RGB565:
+        return SendData<OutputFormat::RGB565>;
+    }
+    UNREACHABLE();
+}
+
+/// Advances a buffer past the data SendData would write, without writing it.
+static void SkipSendData(ConversionBuffer& buf, std::size_t amount_of_data,
+                         std::size_t bytes_per_pixel) {
+    const std::size_t pixels_per_unit = (buf.transfer_unit + bytes_per_pixel - 1) / bytes_per_pixel;
+    const std::size_t units = (amount_of_data + pixels_per_unit - 1) / pixels_per_unit;
+    buf.address += static_cast<VAddr>(units * (buf.transfer_unit + buf.gap));
+    buf.image_size -= static_cast<u32>(units * buf.transfer_unit);
+}
+
 static const u8 linear_lut[TILE_SIZE] = {
     // clang-format off
      0,  1,  2,  3,  4,  5,  6,  7,
@@ -167,13 +369,6 @@ static const u8 morton_lut[TILE_SIZE] = {
     // clang-format on
 };
 
-static void RotateTile0(const ImageTile& input, ImageTile& output, int height,
-                        const u8 out_map[64]) {
-    for (int i = 0; i < height * 8; ++i) {
-        output[out_map[i]] = input[i];
-    }
-}
-
 static void RotateTile90(const ImageTile& input, ImageTile& output, int height,
                          const u8 out_map[64]) {
     int out_i = 0;
@@ -210,6 +405,227 @@ static void WriteTileToOutput(u32* output, const ImageTile& tile, int height, in
     }
 }
 
+/// Positions of the DMA buffers at the start of a strip
+struct StripBuffers {
+    ConversionBuffer src_Y;
+    ConversionBuffer src_U;
+    ConversionBuffer src_V;
+    ConversionBuffer src_YUYV;
+    ConversionBuffer dst;
+};
+
+/// Storage used while converting a strip
+struct StripScratch {
+    explicit StripScratch(std::size_t line_width)
+        : data_buffer(line_width * 8 * 4), tiles(line_width / 8) {}
+
+    /// Buffer used as a CDMA source/target.
+    std::vector<u8> data_buffer;
+    /// Intermediate storage for decoded 8x8 image tiles. Always stored as RGB32.
+    std::vector<ImageTile> tiles;
+};
+
+/// Advances the buffers past the data the conversion of a strip of `row_height` lines transfers
+static void SkipStrip(const ConversionConfiguration& cvt, StripBuffers& buffers,
+                      unsigned int row_height) {
+    const std::size_t row_data_size = row_height * cvt.input_line_width;
+
+    switch (cvt.input_format) {
+    case InputFormat::YUV422_Indiv8:
+        SkipReceiveData<1>(buffers.src_Y, row_data_size);
+        SkipReceiveData<1>(buffers.src_U, row_data_size / 2);
+        SkipReceiveData<1>(buffers.src_V, row_data_size / 2);
+        break;
+    case InputFormat::YUV420_Indiv8:
+        SkipReceiveData<1>(buffers.src_Y, row_data_size);
+        SkipReceiveData<1>(buffers.src_U, row_data_size / 4);
+        SkipReceiveData<1>(buffers.src_V, row_data_size / 4);
+        break;
+    case InputFormat::YUV422_Indiv16:
+        SkipReceiveData<2>(buffers.src_Y, row_data_size);
+        SkipReceiveData<2>(buffers.src_U, row_data_size / 2);
+        SkipReceiveData<2>(buffers.src_V, row_data_size / 2);
+        break;
+    case InputFormat::YUV420_Indiv16:
+        SkipReceiveData<2>(buffers.src_Y, row_data_size);
+        SkipReceiveData<2>(buffers.src_U, row_data_size / 4);
+        SkipReceiveData<2>(buffers.src_V, row_data_size / 4);
+        break;
+    case InputFormat::YUYV422_Interleaved:
+        SkipReceiveData<1>(buffers.src_YUYV, row_data_size * 2);
+        break;
+    }
+
+    SkipSendData(buffers.dst, row_data_size, BytesPerPixel(cvt.output_format));
+}
+
+/**
+ * Checks whether SkipStrip can find where each strip of a conversion starts. This requires every
+ * output transfer to stay within the units of its own strip, and no transfer unit to be too small
+ * to hold any data, as SkipStrip divides by the units.
+ */
+static bool CanSkipStrips(const ConversionConfiguration& cvt) {
+    const bool is_16bit = cvt.input_format == InputFormat::YUV422_Indiv16 ||
+                          cvt.input_format == InputFormat::YUV420_Indiv16;
+    const std::size_t bytes_per_pixel = BytesPerPixel(cvt.output_format);
+    const std::size_t strip_size = 8 * cvt.input_line_width * bytes_per_pixel;
+    if (cvt.dst.transfer_unit == 0 || cvt.dst.transfer_unit % bytes_per_pixel != 0 ||
+        strip_size % cvt.dst.transfer_unit != 0) {
+        return false;
+    }
+
+    if (cvt.input_format == InputFormat::YUYV422_Interleaved) {
+        return cvt.src_YUYV.transfer_unit != 0;
+    }
+    const std::size_t n = is_16bit ? 2 : 1;
+    return cvt.src_Y.transfer_unit / n != 0 && cvt.src_U.transfer_unit / n != 0 &&
+           cvt.src_V.transfer_unit / n != 0;
+}
+
+/**
+ * Checks whether the strips of a conversion can be converted independently of each other, which
+ * requires the output not to overwrite any input.
+ * @param start Positions of the buffers at the start of the conversion
+ * @param end Positions of the buffers at the end of the conversion
+ */
+static bool AreStripsIndependent(const ConversionConfiguration& cvt, const StripBuffers& start,
+                                 const StripBuffers& end) {
+    const auto is_independent = [&](const ConversionBuffer& input,
+                                    const ConversionBuffer& input_end) {
+        return input_end.address <= start.dst.address || end.dst.address <= input.address;
+    };
+
+    if (cvt.input_format == InputFormat::YUYV422_Interleaved) {
+        return is_independent(start.src_YUYV, end.src_YUYV);
+    }
+    return is_independent(start.src_Y, end.src_Y) && is_independent(start.src_U, end.src_U) &&
+           is_independent(start.src_V, end.src_V);
+}
+
+static Common::ThreadPool* GetConversionPool() {
+    static std::unique_ptr<Common::ThreadPool> pool;
+    if (pool == nullptr) {
+        const std::size_t num_threads = std::clamp<std::size_t>(
+            std::thread::hardware_concurrency(), 1, MAX_CONVERSION_THREADS);
+        pool = std::make_unique<Common::ThreadPool>(num_threads, "Y2R");
+    }
+    return pool.get();
+}
+
+/// Converts the strip starting at line `y`, advancing the buffers past the data it transfers
+static void ConvertStrip(Memory::MemorySystem& memory, const ConversionConfiguration& cvt,
+                         ConvertYUVToRGBFn convert_yuv_to_rgb, SendDataFn send_data,
+                         StripBuffers& buffers, unsigned int y, StripScratch& scratch) {
+    // Tiles per row
+    const std::size_t num_tiles = cvt.input_line_width / 8;
+    ImageTile tmp_tile;
+
+    // LUT used to remap writes to a tile. Used to allow linear or swizzled output without
+    // requiring two different code paths.
+    const u8* tile_remap = nullptr;
+    switch (cvt.block_alignment) {
+    case BlockAlignment::Linear:
+        tile_remap = linear_lut;
+        break;
+    case BlockAlignment::Block8x8:
+        tile_remap = morton_lut;
+        break;
+    }
+
+    unsigned int row_height = std::min(cvt.input_lines - y, 8u);
+
+    // Total size in pixels of incoming data required for this strip.
+    const std::size_t row_data_size = row_height * cvt.input_line_width;
+
+    u8* input_Y = scratch.data_buffer.data();
+    u8* input_U = input_Y + 8 * cvt.input_line_width;
+    u8* input_V = input_U + 8 * cvt.input_line_width / 2;
+
+    switch (cvt.input_format) {
+    case InputFormat::YUV422_Indiv8:
+        ReceiveData<1>(memory, input_Y, buffers.src_Y, row_data_size);
+        ReceiveData<1>(memory, input_U, buffers.src_U, row_data_size / 2);
+        ReceiveData<1>(memory, input_V, buffers.src_V, row_data_size / 2);
+        break;
+    case InputFormat::YUV420_Indiv8:
+        ReceiveData<1>(memory, input_Y, buffers.src_Y, row_data_size);
+        ReceiveData<1>(memory, input_U, buffers.src_U, row_data_size / 4);
+        ReceiveData<1>(memory, input_V, buffers.src_V, row_data_size / 4);
+        break;
+    case InputFormat::YUV422_Indiv16:
+        ReceiveData<2>(memory, input_Y, buffers.src_Y, row_data_size);
+        ReceiveData<2>(memory, input_U, buffers.src_U, row_data_size / 2);
+        ReceiveData<2>(memory, input_V, buffers.src_V, row_data_size / 2);
+        break;
+    case InputFormat::YUV420_Indiv16:
+        ReceiveData<2>(memory, input_Y, buffers.src_Y, row_data_size);
+        ReceiveData<2>(memory, input_U, buffers.src_U, row_data_size / 4);
+        ReceiveData<2>(memory, input_V, buffers.src_V, row_data_size / 4);
+        break;
+    case InputFormat::YUYV422_Interleaved:
+        input_U = nullptr;
+        input_V = nullptr;
+        ReceiveData<1>(memory, input_Y, buffers.src_YUYV, row_data_size * 2);
+        break;
+    }
+
+    ImageTile* const tiles = scratch.tiles.data();
+    convert_yuv_to_rgb(input_Y, input_U, input_V, tiles, cvt.input_line_width, row_height,
+                       cvt.coefficients);
+
+    u32* output_buffer = reinterpret_cast<u32*>(scratch.data_buffer.data());
+
+    for (std::size_t i = 0; i < num_tiles; ++i) {
+        int image_strip_width = 0;
+        int output_stride = 0;
+
+        switch (cvt.rotation) {
+        case Rotation::None:
+            // Unrotated tiles are written to the output directly
+            if (cvt.block_alignment == BlockAlignment::Linear) {
+                WriteTileToOutput(output_buffer, tiles[i], row_height, cvt.input_line_width);
+                output_buffer += 8;
+            } else {
+                VideoCore::SwizzleTile<4>(reinterpret_cast<const u8*>(tiles[i].data()), 8 * 4,
+                                          reinterpret_cast<u8*>(output_buffer));
+                output_buffer += TILE_SIZE;
+            }
+            continue;
+        case Rotation::Clockwise_90:
+            RotateTile90(tiles[i], tmp_tile, row_height, tile_remap);
+            image_strip_width = 8;
+            output_stride = 8 * row_height;
+            break;
+        case Rotation::Clockwise_180:
+            // For 180 and 270 degree rotations we also invert the order of tiles in the strip,
+            // since the rotates are done individually on each tile.
+            RotateTile180(tiles[num_tiles - i - 1], tmp_tile, row_height, tile_remap);
+            image_strip_width = cvt.input_line_width;
+            output_stride = 8;
+            break;
+        case Rotation::Clockwise_270:
+            RotateTile270(tiles[num_tiles - i - 1], tmp_tile, row_height, tile_remap);
+            image_strip_width = 8;
+            output_stride = 8 * row_height;
+            break;
+        }
+
+        switch (cvt.block_alignment) {
+        case BlockAlignment::Linear:
+            WriteTileToOutput(output_buffer, tmp_tile, row_height, image_strip_width);
+            output_buffer += output_stride;
+            break;
+        case BlockAlignment::Block8x8:
+            WriteTileToOutput(output_buffer, tmp_tile, 8, 8);
+            output_buffer += TILE_SIZE;
+            break;
+        }
+    }
+
+    send_data(memory, reinterpret_cast<u32*>(scratch.data_buffer.data()), buffers.dst,
+              (int)row_data_size, (u8)cvt.alpha);
+}
+
 /**
  * Performs a Y2R colorspace conversion.
  *
@@ -246,7 +662,8 @@ static void WriteTileToOutput(u32* output, const ImageTile& tile, int height, in
  * In this implementation, to avoid the combinatorial explosion of parameter combinations, common
  * intermediate formats are used and where possible tables or parameters are used instead of
  * diverging code paths to keep the amount of branches in check. Some steps are also merged to
- * increase efficiency.
+ * increase efficiency. Since strips are converted independently, the strips of large images are
+ * spread across several threads.
  *
  * Output for all valid settings combinations matches hardware, however output in some edge-cases
  * differs:
@@ -267,114 +684,48 @@ void PerformConversion(Memory::MemorySystem& memory, ConversionConfiguration& cv
     std::size_t num_tiles = cvt.input_line_width / 8;
     ASSERT(num_tiles <= MAX_TILES);
 
-    // Buffer used as a CDMA source/target.
-    std::unique_ptr<u8[]> data_buffer(new u8[cvt.input_line_width * 8 * 4]);
-    // Intermediate storage for decoded 8x8 image tiles. Always stored as RGB32.
-    std::unique_ptr<ImageTile[]> tiles(new ImageTile[num_tiles]);
-    ImageTile tmp_tile;
-
-    // LUT used to remap writes to a tile. Used to allow linear or swizzled output without
-    // requiring two different code paths.
-    const u8* tile_remap = nullptr;
-    switch (cvt.block_alignment) {
-    case BlockAlignment::Linear:
-        tile_remap = linear_lut;
-        break;
-    case BlockAlignment::Block8x8:
-        tile_remap = morton_lut;
-        break;
-    }
-
-    for (unsigned int y = 0; y < cvt.input_lines; y += 8) {
-        unsigned int row_height = std::min(cvt.input_lines - y, 8u);
-
-        // Total size in pixels of incoming data required for this strip.
-        const std::size_t row_data_size = row_height * cvt.input_line_width;
-
-        u8* input_Y = data_buffer.get();
-        u8* input_U = input_Y + 8 * cvt.input_line_width;
-        u8* input_V = input_U + 8 * cvt.input_line_width / 2;
-
-        switch (cvt.input_format) {
-        case InputFormat::YUV422_Indiv8:
-            ReceiveData<1>(memory, input_Y, cvt.src_Y, row_data_size);
-            ReceiveData<1>(memory, input_U, cvt.src_U, row_data_size / 2);
-            ReceiveData<1>(memory, input_V, cvt.src_V, row_data_size / 2);
-            break;
-        case InputFormat::YUV420_Indiv8:
-            ReceiveData<1>(memory, input_Y, cvt.src_Y, row_data_size);
-            ReceiveData<1>(memory, input_U, cvt.src_U, row_data_size / 4);
-            ReceiveData<1>(memory, input_V, cvt.src_V, row_data_size / 4);
-            break;
-        case InputFormat::YUV422_Indiv16:
-            ReceiveData<2>(memory, input_Y, cvt.src_Y, row_data_size);
-            ReceiveData<2>(memory, input_U, cvt.src_U, row_data_size / 2);
-            ReceiveData<2>(memory, input_V, cvt.src_V, row_data_size / 2);
-            break;
-        case InputFormat::YUV420_Indiv16:
-            ReceiveData<2>(memory, input_Y, cvt.src_Y, row_data_size);
-            ReceiveData<2>(memory, input_U, cvt.src_U, row_data_size / 4);
-            ReceiveData<2>(memory, input_V, cvt.src_V, row_data_size / 4);
-            break;
-        case InputFormat::YUYV422_Interleaved:
-            input_U = nullptr;
-            input_V = nullptr;
-            ReceiveData<1>(memory, input_Y, cvt.src_YUYV, row_data_size * 2);
-            break;
+    const ConvertYUVToRGBFn convert_yuv_to_rgb = GetConvertYUVToRGBFn(cvt.input_format);
+    const SendDataFn send_data = GetSendDataFn(cvt.output_format);
+
+    const StripBuffers start{cvt.src_Y, cvt.src_U, cvt.src_V, cvt.src_YUYV, cvt.dst};
+    StripBuffers buffers = start;
+    const std::size_t num_strips = (cvt.input_lines + 7) / 8;
+
+    bool converted = false;
+    if (num_strips > 1 &&
+        static_cast<std::size_t>(cvt.input_line_width) * cvt.input_lines >=
+            PARALLEL_CONVERSION_MIN_PIXELS &&
+        CanSkipStrips(cvt)) {
+        // Find where each strip starts transferring, so that they can be converted in any order
+        std::vector<StripBuffers> strip_buffers(num_strips);
+        for (std::size_t strip = 0; strip < num_strips; ++strip) {
+            strip_buffers[strip] = buffers;
+            SkipStrip(cvt, buffers, std::min(cvt.input_lines - strip * 8, std::size_t{8}));
         }
 
-        // Note(yuriks): If additional optimization is required, input_format can be moved to a
-        // template parameter, so that its dispatch can be moved to outside the inner loop.
-        ConvertYUVToRGB(cvt.input_format, input_Y, input_U, input_V, tiles.get(),
-                        cvt.input_line_width, row_height, cvt.coefficients);
-
-        u32* output_buffer = reinterpret_cast<u32*>(data_buffer.get());
-
-        for (std::size_t i = 0; i < num_tiles; ++i) {
-            int image_strip_width = 0;
-            int output_stride = 0;
-
-            switch (cvt.rotation) {
-            case Rotation::None:
-                RotateTile0(tiles[i], tmp_tile, row_height, tile_remap);
-                image_strip_width = cvt.input_line_width;
-                output_stride = 8;
-                break;
-            case Rotation::Clockwise_90:
-                RotateTile90(tiles[i], tmp_tile, row_height, tile_remap);
-                image_strip_width = 8;
-                output_stride = 8 * row_height;
-                break;
-            case Rotation::Clockwise_180:
-                // For 180 and 270 degree rotations we also invert the order of tiles in the strip,
-                // since the rotates are done individually on each tile.
-                RotateTile180(tiles[num_tiles - i - 1], tmp_tile, row_height, tile_remap);
-                image_strip_width = cvt.input_line_width;
-                output_stride = 8;
-                break;
-            case Rotation::Clockwise_270:
-                RotateTile270(tiles[num_tiles - i - 1], tmp_tile, row_height, tile_remap);
-                image_strip_width = 8;
-                output_stride = 8 * row_height;
-                break;
-            }
-
-            switch (cvt.block_alignment) {
-            case BlockAlignment::Linear:
-                WriteTileToOutput(output_buffer, tmp_tile, row_height, image_strip_width);
-                output_buffer += output_stride;
-                break;
-            case BlockAlignment::Block8x8:
-                WriteTileToOutput(output_buffer, tmp_tile, 8, 8);
-                output_buffer += TILE_SIZE;
-                break;
-            }
+        if (AreStripsIndependent(cvt, start, buffers)) {
+            GetConversionPool()->ParallelFor(num_strips, [&](std::size_t strip) {
+                StripScratch scratch(cvt.input_line_width);
+                ConvertStrip(memory, cvt, convert_yuv_to_rgb, send_data, strip_buffers[strip],
+                             static_cast<unsigned int>(strip * 8), scratch);
+            });
+            converted = true;
+        } else {
+            buffers = start;
         }
+    }
 
-        // Note(yuriks): If additional optimization is required, output_format can be moved to a
-        // template parameter, so that its dispatch can be moved to outside the inner loop.
-        SendData(memory, reinterpret_cast<u32*>(data_buffer.get()), cvt.dst, (int)row_data_size,
-                 cvt.output_format, (u8)cvt.alpha);
+    if (!converted) {
+        StripScratch scratch(cvt.input_line_width);
+        for (unsigned int y = 0; y < cvt.input_lines; y += 8) {
+            ConvertStrip(memory, cvt, convert_yuv_to_rgb, send_data, buffers, y, scratch);
+        }
     }
+
+    cvt.src_Y = buffers.src_Y;
+    cvt.src_U = buffers.src_U;
+    cvt.src_V = buffers.src_V;
+    cvt.src_YUYV = buffers.src_YUYV;
+    cvt.dst = buffers.dst;
 }
 } // namespace HW::Y2R
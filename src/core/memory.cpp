@@ -2,14 +2,18 @@
 // Licensed under GPLv2 or any later version
 // Refer to the license.txt file included.
 
+#include <algorithm>
 #include <array>
 #include <cstring>
+#include <optional>
 #include <boost/serialization/array.hpp>
 #include <boost/serialization/binary_object.hpp>
+#include <boost/serialization/vector.hpp>
 #include "audio_core/dsp_interface.h"
 #include "common/archives.h"
 #include "common/assert.h"
 #include "common/common_types.h"
+#include "common/hash.h"
 #include "common/logging/log.h"
 #include "common/swap.h"
 #include "core/arm/arm_interface.h"
@@ -44,6 +48,13 @@ public:
             *p = cached;
     }
 
+    /// Marks num_pages pages starting at addr, which must all be part of the same region
+    void MarkRange(VAddr addr, u32 num_pages, bool cached) {
+        bool* p = At(addr);
+        if (p)
+            std::fill_n(p, num_pages, cached);
+    }
+
     bool IsCached(VAddr addr) {
         bool* p = At(addr);
         if (p)
@@ -79,6 +90,26 @@ private:
     }
 };
 
+/// Number of physical pages of VRAM and FCRAM, which are the memory the rasterizer caches
+constexpr std::size_t NUM_RASTERIZER_PAGES = (VRAM_SIZE + FCRAM_N3DS_SIZE) / PAGE_SIZE;
+
+/**
+ * Returns the index of the physical page of VRAM or FCRAM mapped at a virtual address used by the
+ * rasterizer cache, counting the pages of VRAM first, or std::nullopt for other addresses.
+ */
+static std::optional<std::size_t> RasterizerPageIndex(VAddr vaddr) {
+    if (vaddr >= VRAM_VADDR && vaddr < VRAM_VADDR_END) {
+        return (vaddr - VRAM_VADDR) / PAGE_SIZE;
+    }
+    if (vaddr >= LINEAR_HEAP_VADDR && vaddr < LINEAR_HEAP_VADDR_END) {
+        return (VRAM_SIZE + vaddr - LINEAR_HEAP_VADDR) / PAGE_SIZE;
+    }
+    if (vaddr >= NEW_LINEAR_HEAP_VADDR && vaddr < NEW_LINEAR_HEAP_VADDR_END) {
+        return (VRAM_SIZE + vaddr - NEW_LINEAR_HEAP_VADDR) / PAGE_SIZE;
+    }
+    return std::nullopt;
+}
+
 class MemorySystem::Impl {
 public:
     // Visual Studio would try to allocate these on compile time if they are std::array, which would
@@ -91,6 +122,18 @@ public:
     RasterizerCacheMarker cache_marker;
     std::vector<std::shared_ptr<PageTable>> page_table_list;
 
+    struct RasterizerMapping {
+        PageTable* page_table;
+        u32 vpage;
+    };
+
+    /**
+     * For each physical page of VRAM and FCRAM, the virtual pages mapping it as memory in the
+     * registered page tables, at the addresses used by the rasterizer cache. This lets
+     * RasterizerMarkRegionCached update only the pages that are actually mapped.
+     */
+    std::vector<std::vector<RasterizerMapping>> rasterizer_mappings{NUM_RASTERIZER_PAGES};
+
     AudioCore::DspInterface* dsp = nullptr;
 
     std::shared_ptr<BackingMem> fcram_mem;
@@ -98,8 +141,61 @@ public:
     std::shared_ptr<BackingMem> n3ds_extra_ram_mem;
     std::shared_ptr<BackingMem> dsp_mem;
 
+    /// Savestate options, see MemorySystem::SetSerializationMode
+    bool track_changes = false;
+    bool save_delta = false;
+    /// Whether the serialized state records if it is a delta state, which older versions don't
+    bool has_delta_flag = true;
+
+    /// Hashes of the pages of VRAM, FCRAM and N3DS extra RAM (in this order) at the time of the
+    /// last tracked savestate, empty if there is none
+    std::vector<u64> page_hashes;
+
+    static constexpr std::size_t NUM_TRACKED_PAGES =
+        (VRAM_SIZE + FCRAM_N3DS_SIZE + N3DS_EXTRA_RAM_SIZE) / PAGE_SIZE;
+
     Impl();
 
+    bool IsRegistered(const PageTable& page_table) const {
+        return std::any_of(page_table_list.begin(), page_table_list.end(),
+                           [&page_table](const auto& p) { return p.get() == &page_table; });
+    }
+
+    /// Updates the rasterizer mapping of a virtual page of a registered page table
+    void UpdateRasterizerMapping(PageTable& page_table, u32 vpage, bool mapped) {
+        const auto index = RasterizerPageIndex(vpage << PAGE_BITS);
+        if (!index) {
+            return;
+        }
+        auto& mappings = rasterizer_mappings[*index];
+        const auto it = std::find_if(mappings.begin(), mappings.end(), [&](const auto& m) {
+            return m.page_table == &page_table && m.vpage == vpage;
+        });
+        if (mapped && it == mappings.end()) {
+            mappings.push_back({&page_table, vpage});
+        } else if (!mapped && it != mappings.end()) {
+            *it = mappings.back();
+            mappings.pop_back();
+        }
+    }
+
+    /// Adds or removes the rasterizer mappings of all pages of a page table
+    void UpdateRasterizerMappings(PageTable& page_table, bool registered) {
+        static constexpr std::array<std::pair<VAddr, VAddr>, 3> regions{{
+            {VRAM_VADDR, VRAM_VADDR_END},
+            {LINEAR_HEAP_VADDR, LINEAR_HEAP_VADDR_END},
+            {NEW_LINEAR_HEAP_VADDR, NEW_LINEAR_HEAP_VADDR_END},
+        }};
+        for (const auto& [base, end] : regions) {
+            for (u32 vpage = base >> PAGE_BITS; vpage < (end >> PAGE_BITS); ++vpage) {
+                const PageType type = page_table.attributes[vpage];
+                UpdateRasterizerMapping(page_table, vpage,
+                                        registered && (type == PageType::Memory ||
+                                                       type == PageType::RasterizerCachedMemory));
+            }
+        }
+    }
+
     const u8* GetPtr(Region r) const {
         switch (r) {
         case Region::VRAM:
@@ -146,18 +242,92 @@ public:
     }
 
 private:
+    /**
+     * Serializes a RAM region. Delta states only contain the pages whose hash differs from the
+     * reference, which is updated to the serialized contents when tracking changes.
+     */
+    template <class Archive>
+    void SerializeRegion(Archive& ar, u8* memory, std::size_t size, std::size_t first_page,
+                         bool delta, bool rehash_all) {
+        const std::size_t num_pages = size / PAGE_SIZE;
+        const auto hash_page = [memory](std::size_t page) {
+            return Common::ComputeHash64(memory + page * PAGE_SIZE, PAGE_SIZE);
+        };
+
+        std::vector<u32> changed_pages;
+        if (!delta) {
+            ar& boost::serialization::make_binary_object(memory, size);
+        } else {
+            if (Archive::is_saving::value) {
+                for (std::size_t page = 0; page < num_pages; ++page) {
+                    const u64 hash = hash_page(page);
+                    if (hash != page_hashes[first_page + page]) {
+                        changed_pages.push_back(static_cast<u32>(page));
+                        if (track_changes) {
+                            page_hashes[first_page + page] = hash;
+                        }
+                    }
+                }
+            }
+            ar& changed_pages;
+            for (u32 page : changed_pages) {
+                if (page >= num_pages) {
+                    throw std::runtime_error("Invalid page in delta savestate");
+                }
+                ar& boost::serialization::make_binary_object(memory + page * PAGE_SIZE, PAGE_SIZE);
+            }
+        }
+
+        if (!track_changes) {
+            return;
+        }
+        if (rehash_all) {
+            for (std::size_t page = 0; page < num_pages; ++page) {
+                page_hashes[first_page + page] = hash_page(page);
+            }
+        } else if (Archive::is_loading::value) {
+            for (u32 page : changed_pages) {
+                page_hashes[first_page + page] = hash_page(page);
+            }
+        }
+    }
+
     friend class boost::serialization::access;
     template <class Archive>
     void serialize(Archive& ar, const unsigned int file_version) {
         bool save_n3ds_ram = Settings::values.is_new_3ds;
         ar& save_n3ds_ram;
-        ar& boost::serialization::make_binary_object(vram.get(), Memory::VRAM_SIZE);
-        ar& boost::serialization::make_binary_object(
-            fcram.get(), save_n3ds_ram ? Memory::FCRAM_N3DS_SIZE : Memory::FCRAM_SIZE);
-        ar& boost::serialization::make_binary_object(
-            n3ds_extra_ram.get(), save_n3ds_ram ? Memory::N3DS_EXTRA_RAM_SIZE : 0);
+
+        // When loading a delta state, the pages that aren't part of it are expected to have been
+        // loaded from the state it was created against
+        const bool had_reference = page_hashes.size() == NUM_TRACKED_PAGES;
+        bool delta = save_delta && had_reference;
+        if (has_delta_flag) {
+            ar& delta;
+        } else {
+            delta = false;
+        }
+        if (track_changes) {
+            page_hashes.resize(NUM_TRACKED_PAGES);
+        }
+        const bool rehash_all = !delta || !had_reference;
+
+        SerializeRegion(ar, vram.get(), Memory::VRAM_SIZE, 0, delta, rehash_all);
+        SerializeRegion(ar, fcram.get(),
+                        save_n3ds_ram ? Memory::FCRAM_N3DS_SIZE : Memory::FCRAM_SIZE,
+                        VRAM_SIZE / PAGE_SIZE, delta, rehash_all);
+        SerializeRegion(ar, n3ds_extra_ram.get(), save_n3ds_ram ? Memory::N3DS_EXTRA_RAM_SIZE : 0,
+                        (VRAM_SIZE + FCRAM_N3DS_SIZE) / PAGE_SIZE, delta, rehash_all);
         ar& cache_marker;
         ar& page_table_list;
+        if (Archive::is_loading::value) {
+            for (auto& mappings : rasterizer_mappings) {
+                mappings.clear();
+            }
+            for (const auto& page_table : page_table_list) {
+                UpdateRasterizerMappings(*page_table, true);
+            }
+        }
         // dsp is set from Core::System at startup
         ar& current_page_table;
         ar& fcram_mem;
@@ -205,11 +375,22 @@ MemorySystem::~MemorySystem() = default;
 
 template <class Archive>
 void MemorySystem::serialize(Archive& ar, const unsigned int file_version) {
+    // Version 1 added delta savestates
+    impl->has_delta_flag = file_version >= 1;
     ar&* impl.get();
 }
 
 SERIALIZE_IMPL(MemorySystem)
 
+void MemorySystem::SetSerializationMode(bool track_changes, bool delta) {
+    impl->track_changes = track_changes;
+    impl->save_delta = delta;
+}
+
+bool MemorySystem::HasDeltaReference() const {
+    return impl->page_hashes.size() == Impl::NUM_TRACKED_PAGES;
+}
+
 void MemorySystem::SetCurrentPageTable(std::shared_ptr<PageTable> page_table) {
     impl->current_page_table = page_table;
 }
@@ -226,12 +407,17 @@ void MemorySystem::MapPages(PageTable& page_table, u32 base, u32 size, MemoryRef
     RasterizerFlushVirtualRegion(base << PAGE_BITS, size * PAGE_SIZE,
                                  FlushMode::FlushAndInvalidate);
 
+    const bool registered = impl->IsRegistered(page_table);
+
     u32 end = base + size;
     while (base != end) {
         ASSERT_MSG(base < PAGE_TABLE_NUM_ENTRIES, "out of range mapping at {:08X}", base);
 
         page_table.attributes[base] = type;
         page_table.pointers[base] = memory;
+        if (registered) {
+            impl->UpdateRasterizerMapping(page_table, base, type == PageType::Memory);
+        }
 
         // If the memory to map is already rasterizer-cached, mark the page
         if (type == PageType::Memory && impl->cache_marker.IsCached(base * PAGE_SIZE)) {
@@ -281,12 +467,14 @@ MemoryRef MemorySystem::GetPointerForRasterizerCache(VAddr addr) const {
 
 void MemorySystem::RegisterPageTable(std::shared_ptr<PageTable> page_table) {
     impl->page_table_list.push_back(page_table);
+    impl->UpdateRasterizerMappings(*page_table, true);
 }
 
 void MemorySystem::UnregisterPageTable(std::shared_ptr<PageTable> page_table) {
     auto it = std::find(impl->page_table_list.begin(), impl->page_table_list.end(), page_table);
     if (it != impl->page_table_list.end()) {
         impl->page_table_list.erase(it);
+        impl->UpdateRasterizerMappings(*page_table, false);
     }
 }
 
@@ -504,50 +692,38 @@ MemoryRef MemorySystem::GetPhysicalRef(PAddr address) const {
 }
 
 /// For a rasterizer-accessible PAddr, gets a list of all possible VAddr
-static std::vector<VAddr> PhysicalToVirtualAddressForRasterizer(PAddr addr) {
-    if (addr >= VRAM_PADDR && addr < VRAM_PADDR_END) {
-        return {addr - VRAM_PADDR + VRAM_VADDR};
-    }
-    if (addr >= FCRAM_PADDR && addr < FCRAM_PADDR_END) {
-        return {addr - FCRAM_PADDR + LINEAR_HEAP_VADDR, addr - FCRAM_PADDR + NEW_LINEAR_HEAP_VADDR};
-    }
-    if (addr >= FCRAM_PADDR_END && addr < FCRAM_N3DS_PADDR_END) {
-        return {addr - FCRAM_PADDR + NEW_LINEAR_HEAP_VADDR};
-    }
-    // While the physical <-> virtual mapping is 1:1 for the regions supported by the cache,
-    // some games (like Pokemon Super Mystery Dungeon) will try to use textures that go beyond
-    // the end address of VRAM, causing the Virtual->Physical translation to fail when flushing
-    // parts of the texture.
-    LOG_ERROR(HW_Memory,
-              "Trying to use invalid physical address for rasterizer: {:08X} at PC 0x{:08X}", addr,
-              Core::GetRunningCore().GetPC());
-    return {};
-}
-
 void MemorySystem::RasterizerMarkRegionCached(PAddr start, u32 size, bool cached) {
     if (start == 0) {
         return;
     }
 
-    u32 num_pages = ((start + size - 1) >> PAGE_BITS) - (start >> PAGE_BITS) + 1;
-    PAddr paddr = start;
+    const u32 first_page = start >> PAGE_BITS;
+    const u32 end_page = ((start + size - 1) >> PAGE_BITS) + 1;
+    u32 num_marked = 0;
 
-    for (unsigned i = 0; i < num_pages; ++i, paddr += PAGE_SIZE) {
-        for (VAddr vaddr : PhysicalToVirtualAddressForRasterizer(paddr)) {
-            impl->cache_marker.Mark(vaddr, cached);
-            for (auto page_table : impl->page_table_list) {
-                PageType& page_type = page_table->attributes[vaddr >> PAGE_BITS];
+    // Marks the pages of the region between paddr_start and paddr_end that overlap the range, and
+    // the pages of the registered page tables mapping them
+    const auto mark_run = [&](PAddr paddr_start, PAddr paddr_end, std::size_t first_index) {
+        const u32 run_start = std::max(first_page, paddr_start >> PAGE_BITS);
+        const u32 run_end = std::min(end_page, paddr_end >> PAGE_BITS);
+        if (run_start >= run_end) {
+            return;
+        }
+        num_marked += run_end - run_start;
 
+        const std::size_t index = first_index + run_start - (paddr_start >> PAGE_BITS);
+        for (std::size_t i = index; i < index + (run_end - run_start); ++i) {
+            for (const auto& [page_table, vpage] : impl->rasterizer_mappings[i]) {
+                PageType& page_type = page_table->attributes[vpage];
                 if (cached) {
                     // Switch page type to cached if now cached
                     switch (page_type) {
                     case PageType::Unmapped:
-                        // It is not necessary for a process to have this region mapped into its
-                        // address space, for example, a system module need not have a VRAM mapping.
+                        // The page table may have been cleared without unmapping its pages
                         break;
                     case PageType::Memory:
                         page_type = PageType::RasterizerCachedMemory;
-                        page_table->pointers[vaddr >> PAGE_BITS] = nullptr;
+                        page_table->pointers[vpage] = nullptr;
                         break;
                     default:
                         UNREACHABLE();
@@ -556,13 +732,12 @@ void MemorySystem::RasterizerMarkRegionCached(PAddr start, u32 size, bool cached
                     // Switch page type to uncached if now uncached
                     switch (page_type) {
                     case PageType::Unmapped:
-                        // It is not necessary for a process to have this region mapped into its
-                        // address space, for example, a system module need not have a VRAM mapping.
+                        // The page table may have been cleared without unmapping its pages
                         break;
                     case PageType::RasterizerCachedMemory: {
                         page_type = PageType::Memory;
-                        page_table->pointers[vaddr >> PAGE_BITS] =
-                            GetPointerForRasterizerCache(vaddr & ~PAGE_MASK);
+                        page_table->pointers[vpage] =
+                            GetPointerForRasterizerCache(vpage << PAGE_BITS);
                         break;
                     }
                     default:
@@ -571,6 +746,32 @@ void MemorySystem::RasterizerMarkRegionCached(PAddr start, u32 size, bool cached
                 }
             }
         }
+    };
+    mark_run(VRAM_PADDR, VRAM_PADDR_END, 0);
+    mark_run(FCRAM_PADDR, FCRAM_N3DS_PADDR_END, VRAM_SIZE / PAGE_SIZE);
+
+    // The cache marker keeps the state of the pages that get mapped later
+    const auto mark_range = [&](PAddr paddr_start, PAddr paddr_end, VAddr vaddr_start) {
+        const u32 run_start = std::max(first_page, paddr_start >> PAGE_BITS);
+        const u32 run_end = std::min(end_page, paddr_end >> PAGE_BITS);
+        if (run_start < run_end) {
+            const VAddr vaddr = vaddr_start + ((run_start << PAGE_BITS) - paddr_start);
+            impl->cache_marker.MarkRange(vaddr, run_end - run_start, cached);
+        }
+    };
+    mark_range(VRAM_PADDR, VRAM_PADDR_END, VRAM_VADDR);
+    mark_range(FCRAM_PADDR, FCRAM_PADDR_END, LINEAR_HEAP_VADDR);
+    mark_range(FCRAM_PADDR, FCRAM_N3DS_PADDR_END, NEW_LINEAR_HEAP_VADDR);
+
+    if (num_marked != end_page - first_page) {
+        // While the physical <-> virtual mapping is 1:1 for the regions supported by the cache,
+        // some games (like Pokemon Super Mystery Dungeon) will try to use textures that go beyond
+        // the end address of VRAM, causing the Virtual->Physical translation to fail when flushing
+        // parts of the texture.
+        LOG_ERROR(HW_Memory,
+                  "Trying to use invalid physical address for rasterizer: {:08X}-{:08X} at PC "
+                  "0x{:08X}",
+                  start, start + size, Core::GetRunningCore().GetPC());
     }
 }
 
@@ -781,6 +982,42 @@ void MemorySystem::WriteBlock(const Kernel::Process& process, const VAddr dest_a
     }
 }
 
+u8* MemorySystem::GetBlockPointer(const Kernel::Process& process, const VAddr vaddr,
+                                  const std::size_t size, const FlushMode mode) {
+    DEBUG_ASSERT((vaddr & PAGE_MASK) + size <= PAGE_SIZE);
+
+    auto& page_table = *process.vm_manager.page_table;
+    const std::size_t page_index = vaddr >> PAGE_BITS;
+
+    switch (page_table.attributes[page_index]) {
+    case PageType::Memory:
+        DEBUG_ASSERT(page_table.pointers[page_index]);
+        return page_table.pointers[page_index] + (vaddr & PAGE_MASK);
+    case PageType::RasterizerCachedMemory:
+        RasterizerFlushVirtualRegion(vaddr, static_cast<u32>(size), mode);
+        return GetPointerForRasterizerCache(vaddr);
+    default:
+        return nullptr;
+    }
+}
+
+bool MemorySystem::IsBlockBackedByMemory(const Kernel::Process& process, const VAddr vaddr,
+                                         const std::size_t size) const {
+    if (size == 0) {
+        return true;
+    }
+    const auto& page_table = *process.vm_manager.page_table;
+    const std::size_t first_page = vaddr >> PAGE_BITS;
+    const std::size_t last_page = (vaddr + size - 1) >> PAGE_BITS;
+    for (std::size_t page_index = first_page; page_index <= last_page; ++page_index) {
+        const PageType type = page_table.attributes[page_index];
+        if (type != PageType::Memory && type != PageType::RasterizerCachedMemory) {
+            return false;
+        }
+    }
+    return true;
+}
+
 void MemorySystem::ZeroBlock(const Kernel::Process& process, const VAddr dest_addr,
                              const std::size_t size) {
     auto& page_table = *process.vm_manager.page_table;
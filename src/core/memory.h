@@ -332,6 +332,24 @@ public:
     void WriteBlock(const Kernel::Process& process, VAddr dest_addr, const void* src_buffer,
                     std::size_t size);
     void ZeroBlock(const Kernel::Process& process, VAddr dest_addr, const std::size_t size);
+
+    /**
+     * Gets a pointer to the host memory backing a range of virtual memory of a process, so that it
+     * can be accessed directly instead of through ReadBlock or WriteBlock. The range must not cross
+     * a page boundary. Rasterizer cached memory is flushed or invalidated with the given mode
+     * first.
+     * @returns nullptr if the page is unmapped or backed by MMIO
+     */
+    u8* GetBlockPointer(const Kernel::Process& process, VAddr vaddr, std::size_t size,
+                        FlushMode mode);
+
+    /**
+     * Checks whether a range of virtual memory of a process is entirely backed by regular or
+     * rasterizer cached memory, so that GetBlockPointer succeeds for all of its pages. Doesn't
+     * touch the rasterizer cache.
+     */
+    bool IsBlockBackedByMemory(const Kernel::Process& process, VAddr vaddr,
+                               std::size_t size) const;
     void CopyBlock(const Kernel::Process& process, VAddr dest_addr, VAddr src_addr,
                    std::size_t size);
     void CopyBlock(const Kernel::Process& dest_process, const Kernel::Process& src_process,
@@ -377,6 +395,17 @@ public:
 
     void SetDSP(AudioCore::DspInterface& dsp);
 
+    /**
+     * Selects how the RAM is serialized by the following savestates.
+     * @param track_changes Remember the contents of each page as reference for delta savestates
+     * @param delta Only save the pages that changed since the reference was taken. The resulting
+     *              state can only be loaded on top of the state the reference was taken from.
+     */
+    void SetSerializationMode(bool track_changes, bool delta);
+
+    /// Returns whether a savestate tracking changes was serialized or loaded since startup
+    bool HasDeltaReference() const;
+
 private:
     template <typename T>
     T Read(const VAddr vaddr);
@@ -416,3 +445,4 @@ BOOST_CLASS_EXPORT_KEY(Memory::MemorySystem::BackingMemImpl<Memory::Region::FCRA
 BOOST_CLASS_EXPORT_KEY(Memory::MemorySystem::BackingMemImpl<Memory::Region::VRAM>)
 BOOST_CLASS_EXPORT_KEY(Memory::MemorySystem::BackingMemImpl<Memory::Region::DSP>)
 BOOST_CLASS_EXPORT_KEY(Memory::MemorySystem::BackingMemImpl<Memory::Region::N3DS>)
+BOOST_CLASS_VERSION(Memory::MemorySystem, 1)
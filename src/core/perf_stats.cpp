@@ -100,6 +100,10 @@ PerfStats::Results PerfStats::GetAndResetStats(microseconds current_system_time_
     results.frametime = duration_cast<DoubleSecs>(accumulated_frametime).count() /
                         static_cast<double>(system_frames);
     results.emulation_speed = system_us_per_second.count() / 1'000'000.0;
+    const auto system_interval = duration_cast<DoubleSecs>(current_system_time_us -
+                                                           reset_point_system_us).count();
+    const u32 slice_count = slices.exchange(0, std::memory_order_relaxed);
+    results.slices_per_second = system_interval > 0 ? slice_count / system_interval : 0.0;
 
     // Reset counters
     reset_point = now;
@@ -34,11 +34,17 @@ public:
         double frametime;
         /// Ratio of walltime / emulated time elapsed
         double emulation_speed;
+        /// Number of slices the cores were run for per emulated second
+        double slices_per_second;
     };
 
     void BeginSystemFrame();
     void EndSystemFrame();
     void EndGameFrame();
+    /// Counts a slice run by System::RunLoop. Only called from the emulation thread.
+    void AddSlice() {
+        slices.fetch_add(1, std::memory_order_relaxed);
+    }
 
     Results GetAndResetStats(std::chrono::microseconds current_system_time_us);
 
@@ -75,6 +81,8 @@ private:
     u32 system_frames = 0;
     /// Cumulative number of game frames (GSP frame submissions) since last reset
     u32 game_frames = 0;
+    /// Cumulative number of slices run since last reset
+    std::atomic<u32> slices{0};
 
     /// Point when the previous system frame ended
     Clock::time_point previous_frame_end = reset_point;
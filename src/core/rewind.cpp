@@ -0,0 +1,154 @@
+// Copyright 2020 Citra Emulator Project
+// Licensed under GPLv2 or any later version
+// Refer to the license.txt file included.
+
+#include <algorithm>
+#include "common/logging/log.h"
+#include "common/thread.h"
+#include "common/zstd_compression.h"
+#include "core/rewind.h"
+
+namespace Core {
+
+/// Snapshots are taken while emulating, so compression speed matters more than the ratio
+constexpr s32 CompressionLevel = 1;
+
+RewindBuffer::RewindBuffer(std::size_t capacity) : capacity(capacity) {
+    compressor_thread = std::thread([this] { CompressorLoop(); });
+}
+
+RewindBuffer::~RewindBuffer() {
+    compress_queue.Push(nullptr);
+    compressor_thread.join();
+}
+
+bool RewindBuffer::IsBusy() const {
+    std::lock_guard lock{mutex};
+    return pending_jobs != 0;
+}
+
+void RewindBuffer::Push(std::vector<u8> state) {
+    auto job = std::make_unique<CompressJob>();
+    job->state = std::make_shared<const std::vector<u8>>(std::move(state));
+    {
+        std::lock_guard lock{mutex};
+        if (compression_failed) {
+            compression_failed = false;
+            last_state = nullptr;
+        }
+        ++pending_jobs;
+    }
+
+    if (last_state && snapshots_since_keyframe + 1 < KeyframeInterval) {
+        job->base = std::move(last_state);
+        ++snapshots_since_keyframe;
+    } else {
+        snapshots_since_keyframe = 0;
+    }
+    last_state = job->state;
+    compress_queue.Push(std::move(job));
+}
+
+std::shared_ptr<const std::vector<u8>> RewindBuffer::Pop() {
+    std::unique_lock lock{mutex};
+    compressed_cv.wait(lock, [this] { return pending_jobs == 0; });
+
+    if (snapshots.empty() || !last_state) {
+        last_state = nullptr;
+        return nullptr;
+    }
+
+    // The state of the most recent snapshot is always kept uncompressed, so only the state of the
+    // snapshot before it has to be restored, for the next Pop and for compressing against it
+    auto state = std::move(last_state);
+    size -= snapshots.back().data.size();
+    snapshots.pop_back();
+
+    if (!snapshots.empty()) {
+        const auto keyframe = std::find_if(snapshots.rbegin(), snapshots.rend(),
+                                           [](const Snapshot& s) { return s.keyframe; });
+        std::vector<u8> previous;
+        for (auto it = keyframe.base() - 1; it != snapshots.end(); ++it) {
+            previous = Common::Compression::DecompressDataZSTDWithPrefix(it->data, previous.data(),
+                                                                         previous.size());
+            if (previous.empty()) {
+                break;
+            }
+        }
+        if (!previous.empty()) {
+            snapshots_since_keyframe = static_cast<std::size_t>(keyframe - snapshots.rbegin());
+            last_state = std::make_shared<const std::vector<u8>>(std::move(previous));
+        } else {
+            LOG_ERROR(Core, "Failed to decompress rewind snapshot, discarding older snapshots");
+            snapshots.clear();
+            size = 0;
+        }
+    }
+
+    return state;
+}
+
+std::size_t RewindBuffer::GetSnapshotCount() const {
+    std::lock_guard lock{mutex};
+    return snapshots.size() + pending_jobs;
+}
+
+std::size_t RewindBuffer::GetSize() const {
+    std::lock_guard lock{mutex};
+    return size;
+}
+
+std::size_t RewindBuffer::GetLastStateSize() const {
+    return last_state ? last_state->size() : 0;
+}
+
+void RewindBuffer::CompressorLoop() {
+    Common::SetCurrentThreadName("RewindCompressor");
+
+    const u32 num_workers = std::thread::hardware_concurrency();
+    std::unique_ptr<CompressJob> job;
+    while ((job = compress_queue.PopWait())) {
+        Snapshot snapshot;
+        snapshot.keyframe = job->base == nullptr;
+        const u8* base = snapshot.keyframe ? nullptr : job->base->data();
+        const std::size_t base_size = snapshot.keyframe ? 0 : job->base->size();
+        snapshot.data = Common::Compression::CompressDataZSTDWithPrefix(
+            job->state->data(), job->state->size(), base, base_size, CompressionLevel,
+            num_workers);
+        job.reset();
+
+        std::lock_guard lock{mutex};
+        if (snapshot.data.empty()) {
+            // The following snapshots are compressed against this one, so the chain is broken
+            LOG_ERROR(Core, "Failed to compress rewind snapshot, discarding older snapshots");
+            snapshots.clear();
+            size = 0;
+            compression_failed = true;
+        } else {
+            size += snapshot.data.size();
+            snapshots.push_back(std::move(snapshot));
+            Evict();
+        }
+        --pending_jobs;
+        compressed_cv.notify_all();
+    }
+}
+
+void RewindBuffer::Evict() {
+    while (size > capacity) {
+        // Deltas can't be restored without the keyframe they follow, so they are dropped with it.
+        // The most recent keyframe and its deltas are always kept.
+        const auto next_keyframe =
+            std::find_if(snapshots.begin() + 1, snapshots.end(),
+                         [](const Snapshot& s) { return s.keyframe; });
+        if (next_keyframe == snapshots.end()) {
+            break;
+        }
+        for (auto it = snapshots.begin(); it != next_keyframe; ++it) {
+            size -= it->data.size();
+        }
+        snapshots.erase(snapshots.begin(), next_keyframe);
+    }
+}
+
+} // namespace Core
@@ -0,0 +1,92 @@
+// Copyright 2020 Citra Emulator Project
+// Licensed under GPLv2 or any later version
+// Refer to the license.txt file included.
+
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "common/common_types.h"
+#include "common/threadsafe_queue.h"
+
+namespace Core {
+
+/**
+ * Bounded ring buffer of compressed in-memory savestates, which allows stepping backwards through
+ * the emulation. Snapshots are compressed on a background thread, each one against the previous
+ * snapshot so that only the differences between the two are stored, with a full snapshot every
+ * KeyframeInterval snapshots. When the buffer exceeds its capacity, the oldest snapshots are
+ * dropped along with the snapshots depending on them.
+ */
+class RewindBuffer {
+public:
+    /// Number of snapshots between two snapshots that are compressed on their own
+    static constexpr std::size_t KeyframeInterval = 10;
+
+    /// @param capacity Maximum size in bytes of the compressed snapshots
+    explicit RewindBuffer(std::size_t capacity);
+    ~RewindBuffer();
+
+    /// Returns whether the previous snapshot is still being compressed
+    bool IsBusy() const;
+
+    /// Adds a snapshot of the serialized emulation state, which is compressed in the background
+    void Push(std::vector<u8> state);
+
+    /**
+     * Removes the most recent snapshot from the buffer.
+     * @returns the serialized emulation state of the snapshot, or nullptr if the buffer is empty
+     */
+    std::shared_ptr<const std::vector<u8>> Pop();
+
+    /// Returns the number of snapshots in the buffer, including those still being compressed
+    std::size_t GetSnapshotCount() const;
+
+    /// Returns the size in bytes of the compressed snapshots
+    std::size_t GetSize() const;
+
+    /// Returns the uncompressed size of the most recent snapshot, or 0 if there is none
+    std::size_t GetLastStateSize() const;
+
+private:
+    struct Snapshot {
+        std::vector<u8> data;
+        bool keyframe;
+    };
+
+    struct CompressJob {
+        std::shared_ptr<const std::vector<u8>> state;
+        std::shared_ptr<const std::vector<u8>> base; ///< Previous snapshot, nullptr for keyframes
+    };
+
+    void CompressorLoop();
+
+    /// Drops the oldest snapshots until the buffer fits its capacity. Requires the mutex.
+    void Evict();
+
+    const std::size_t capacity;
+
+    mutable std::mutex mutex;
+    std::condition_variable compressed_cv;
+    std::deque<Snapshot> snapshots;
+    std::size_t size = 0;
+    std::size_t pending_jobs = 0;
+
+    /**
+     * Uncompressed state of the most recent snapshot, which the next snapshot is compressed
+     * against. nullptr if the next snapshot has to be a keyframe.
+     */
+    std::shared_ptr<const std::vector<u8>> last_state;
+    std::size_t snapshots_since_keyframe = 0;
+    bool compression_failed = false;
+
+    Common::SPSCQueue<std::unique_ptr<CompressJob>> compress_queue;
+    std::thread compressor_thread;
+};
+
+} // namespace Core
@@ -2,17 +2,27 @@
 // Licensed under GPLv2 or any later version
 // Refer to the license.txt file included.
 
+#include <algorithm>
 #include <chrono>
+#include <istream>
+#include <optional>
+#include <ostream>
+#include <thread>
 #include <boost/serialization/binary_object.hpp>
 #include <cryptopp/hex.h>
 #include "common/archives.h"
 #include "common/logging/log.h"
+#include "common/scope_exit.h"
 #include "common/scm_rev.h"
+#include "common/thread.h"
 #include "common/zstd_compression.h"
 #include "core/cheats/cheats.h"
 #include "core/core.h"
+#include "core/hw/gpu.h"
 #include "core/movie.h"
+#include "core/rewind.h"
 #include "core/savestate.h"
+#include "core/settings.h"
 #include "network/network.h"
 #include "video_core/video_core.h"
 
@@ -24,8 +34,11 @@ struct CSTHeader {
     u64_le program_id;           /// ID of the ROM being executed. Also called title_id
     std::array<u8, 20> revision; /// Git hash of the revision this savestate was created with
     u64_le time;                 /// The time when this save state was created
+    u64_le id;                   /// Unique identifier of this save state
+    u32_le base_slot;            /// Slot of the state a delta state was created against, or 0
+    u64_le base_id;              /// Identifier of the state a delta state was created against
 
-    std::array<u8, 216> reserved; /// Make heading 256 bytes so it has consistent size
+    std::array<u8, 196> reserved; /// Make heading 256 bytes so it has consistent size
 
     template <class Archive>
     void serialize(Archive& ar, const unsigned int) {
@@ -79,6 +92,7 @@ std::vector<SaveStateInfo> ListSaveStates(u64 program_id) {
             continue;
         }
         info.time = header.time;
+        info.delta = header.base_slot != 0;
 
         if (header.program_id != program_id) {
             LOG_WARNING(Core, "Save state file isn't for the current game {}", path);
@@ -96,41 +110,337 @@ std::vector<SaveStateInfo> ListSaveStates(u64 program_id) {
     return result;
 }
 
-void System::SaveState(u32 slot) const {
-    std::ostringstream sstream{std::ios_base::binary};
-    // Serialize
-    oarchive oa{sstream};
-    oa&* this;
+SaveStateProfiler::SaveStateProfiler()
+    : section_start(Clock::now()), start_process_cpu_time(Common::GetProcessCpuTime()),
+      start_thread_cpu_time(Common::GetCurrentThreadCpuTime()) {
+    // The archive writes or reads its own header before any section begins
+    section.name = "Archive";
+}
+
+SaveStateProfiler::~SaveStateProfiler() = default;
+
+void SaveStateProfiler::SetTarget(std::streambuf& target_) {
+    target = &target_;
+}
+
+void SaveStateProfiler::BeginSection(std::string name) {
+    EndSection();
+    section.name = std::move(name);
+}
+
+void SaveStateProfiler::AddIo(std::size_t compressed_size, Clock::duration time) {
+    stats.compressed_size += compressed_size;
+    io_time += time;
+}
+
+SaveStateStats SaveStateProfiler::Finish() {
+    EndSection();
+    const auto process_cpu_time = Common::GetProcessCpuTime() - start_process_cpu_time;
+    const auto thread_cpu_time = Common::GetCurrentThreadCpuTime() - start_thread_cpu_time;
+    stats.worker_time = std::max(process_cpu_time - thread_cpu_time, std::chrono::nanoseconds{});
+    return std::move(stats);
+}
+
+void SaveStateProfiler::EndSection() {
+    using std::chrono::duration_cast;
+    using std::chrono::nanoseconds;
+
+    // I/O happens from within the target, and both happen from within serialization
+    const auto now = Clock::now();
+    section.io_time = duration_cast<nanoseconds>(io_time);
+    section.compress_time = duration_cast<nanoseconds>(target_time - io_time);
+    section.serialize_time = duration_cast<nanoseconds>(now - section_start - target_time);
+    stats.sections.push_back(std::move(section));
+
+    section = {};
+    section_start = now;
+    target_time = {};
+    io_time = {};
+}
+
+SaveStateProfiler::int_type SaveStateProfiler::overflow(int_type ch) {
+    if (traits_type::eq_int_type(ch, traits_type::eof())) {
+        return traits_type::not_eof(ch);
+    }
+    const int_type result =
+        TimeTarget([&] { return target->sputc(traits_type::to_char_type(ch)); });
+    if (!traits_type::eq_int_type(result, traits_type::eof())) {
+        ++section.size;
+    }
+    return result;
+}
+
+std::streamsize SaveStateProfiler::xsputn(const char_type* s, std::streamsize count) {
+    const std::streamsize written = TimeTarget([&] { return target->sputn(s, count); });
+    section.size += written;
+    return written;
+}
+
+int SaveStateProfiler::sync() {
+    return TimeTarget([&] { return target->pubsync(); });
+}
+
+SaveStateProfiler::int_type SaveStateProfiler::underflow() {
+    return TimeTarget([&] { return target->sgetc(); });
+}
+
+SaveStateProfiler::int_type SaveStateProfiler::uflow() {
+    const int_type result = TimeTarget([&] { return target->sbumpc(); });
+    if (!traits_type::eq_int_type(result, traits_type::eof())) {
+        ++section.size;
+    }
+    return result;
+}
+
+std::streamsize SaveStateProfiler::xsgetn(char_type* s, std::streamsize count) {
+    const std::streamsize read = TimeTarget([&] { return target->sgetn(s, count); });
+    section.size += read;
+    return read;
+}
+
+void LogSaveStateStats(const SaveStateStats& stats, const char* operation) {
+    using Milliseconds = std::chrono::duration<double, std::milli>;
+
+    SaveStateStats::Section total;
+    for (const auto& section : stats.sections) {
+        LOG_DEBUG(Core,
+                  "{} {}: {} bytes, {:.2f} ms serialization, {:.2f} ms compression, {:.2f} ms I/O",
+                  operation, section.name, section.size,
+                  Milliseconds(section.serialize_time).count(),
+                  Milliseconds(section.compress_time).count(),
+                  Milliseconds(section.io_time).count());
+        total.size += section.size;
+        total.serialize_time += section.serialize_time;
+        total.compress_time += section.compress_time;
+        total.io_time += section.io_time;
+    }
+    LOG_INFO(Core,
+             "{}: {} bytes ({} compressed), {:.2f} ms serialization, {:.2f} ms compression, "
+             "{:.2f} ms I/O, {:.2f} ms CPU time on other threads",
+             operation, total.size, stats.compressed_size,
+             Milliseconds(total.serialize_time).count(), Milliseconds(total.compress_time).count(),
+             Milliseconds(total.io_time).count(), Milliseconds(stats.worker_time).count());
+}
+
+namespace {
+
+/// Stream buffer appending everything written to it to a vector
+class VectorStreamBuf final : public std::streambuf {
+public:
+    explicit VectorStreamBuf(std::vector<u8>& data) : data(data) {}
+
+protected:
+    int_type overflow(int_type ch) override {
+        if (!traits_type::eq_int_type(ch, traits_type::eof())) {
+            data.push_back(static_cast<u8>(ch));
+        }
+        return traits_type::not_eof(ch);
+    }
+
+    std::streamsize xsputn(const char_type* s, std::streamsize count) override {
+        data.insert(data.end(), s, s + count);
+        return count;
+    }
+
+private:
+    std::vector<u8>& data;
+};
+
+/// Stream buffer reading from a memory region
+class MemoryStreamBuf final : public std::streambuf {
+public:
+    MemoryStreamBuf(const u8* data, std::size_t size) {
+        char_type* begin = reinterpret_cast<char_type*>(const_cast<u8*>(data));
+        setg(begin, begin, begin + size);
+    }
+};
+
+} // Anonymous namespace
+
+static CSTHeader ReadHeader(const std::string& path) {
+    FileUtil::IOFile file(path, "rb");
+    CSTHeader header;
+    if (!file || file.ReadBytes(&header, sizeof(header)) != sizeof(header)) {
+        throw std::runtime_error("Could not read from file at " + path);
+    }
+    if (header.filetype != header_magic_bytes) {
+        throw std::runtime_error("Invalid save state file " + path);
+    }
+    return header;
+}
+
+static std::optional<CSTHeader> TryReadHeader(const std::string& path) {
+    FileUtil::IOFile file(path, "rb");
+    CSTHeader header;
+    if (!file || file.ReadBytes(&header, sizeof(header)) != sizeof(header) ||
+        header.filetype != header_magic_bytes) {
+        return std::nullopt;
+    }
+    return header;
+}
+
+/// Returns whether a slot is the given slot, or holds a delta state based on it through any number
+/// of other delta states
+static bool DeltaChainContains(u64 program_id, u32 start_slot, u32 slot) {
+    u32 current = start_slot;
+    for (u32 depth = 0; current != 0 && depth <= SaveStateSlotCount; ++depth) {
+        if (current == slot) {
+            return true;
+        }
+        const auto header = TryReadHeader(GetSaveStatePath(program_id, current));
+        if (!header) {
+            return false;
+        }
+        current = header->base_slot;
+    }
+    return false;
+}
+
+void System::SaveState(u32 slot) {
+    // Replacing a state that the base state depends on, or that other delta states are based on,
+    // with a delta state would leave chains of delta states that never end in a full state
+    bool delta = Settings::values.delta_savestates && delta_base_slot != 0 &&
+                 memory->HasDeltaReference() &&
+                 !DeltaChainContains(title_id, delta_base_slot, slot);
+    for (u32 other = 1; delta && other <= SaveStateSlotCount; ++other) {
+        if (other != slot && DeltaChainContains(title_id, other, slot)) {
+            delta = false;
+        }
+    }
 
-    const std::string& str{sstream.str()};
-    auto buffer = Common::Compression::CompressDataZSTDDefault(
-        reinterpret_cast<const u8*>(str.data()), str.size());
+    const auto now = std::chrono::system_clock::now().time_since_epoch();
+    SaveState(slot, std::chrono::duration_cast<std::chrono::seconds>(now).count(),
+              std::chrono::duration_cast<std::chrono::nanoseconds>(now).count(), delta);
+}
 
-    const auto path = GetSaveStatePath(title_id, slot);
+SaveStateStats WriteSaveState(u64 program_id, u32 slot, u64 time, u64 id, u32 base_slot,
+                              u64 base_id, const SaveStateWriter& write) {
+    const auto path = GetSaveStatePath(program_id, slot);
     if (!FileUtil::CreateFullPath(path)) {
         throw std::runtime_error("Could not create path " + path);
     }
 
-    FileUtil::IOFile file(path, "wb");
-    if (!file) {
-        throw std::runtime_error("Could not open file " + path);
+    // Write to a temporary file first, so that a failure doesn't destroy the previous savestate
+    const auto temp_path = path + ".tmp";
+    SaveStateStats stats;
+    {
+        FileUtil::IOFile file(temp_path, "wb");
+        if (!file) {
+            throw std::runtime_error("Could not open file " + temp_path);
+        }
+
+        CSTHeader header{};
+        header.filetype = header_magic_bytes;
+        header.program_id = program_id;
+        std::string rev_bytes;
+        CryptoPP::StringSource(Common::g_scm_rev, true,
+                               new CryptoPP::HexDecoder(new CryptoPP::StringSink(rev_bytes)));
+        std::memcpy(header.revision.data(), rev_bytes.data(), sizeof(header.revision));
+        header.time = time;
+        header.id = id;
+        header.base_slot = base_slot;
+        header.base_id = base_id;
+
+        if (file.WriteBytes(&header, sizeof(header)) != sizeof(header)) {
+            throw std::runtime_error("Could not write to file " + temp_path);
+        }
+
+        // Serialize, compressing on background threads and writing the compressed data to the
+        // file as it is produced
+        SaveStateProfiler profiler;
+        Common::Compression::ZSTDCompressStreamBuf buffer(
+            [&file, &profiler](const u8* data, std::size_t size) {
+                const auto start = SaveStateProfiler::Clock::now();
+                const bool written = file.WriteBytes(data, size) == size;
+                profiler.AddIo(size, SaveStateProfiler::Clock::now() - start);
+                return written;
+            },
+            std::thread::hardware_concurrency());
+        profiler.SetTarget(buffer);
+        std::ostream stream(&profiler);
+        write(stream, profiler);
+        profiler.BeginSection("End");
+        if (!profiler.TimeTarget([&buffer] { return buffer.Finish(); }) || !stream) {
+            throw std::runtime_error("Could not write to file " + temp_path);
+        }
+        stats = profiler.Finish();
+    }
+
+    FileUtil::Delete(path);
+    if (!FileUtil::Rename(temp_path, path)) {
+        throw std::runtime_error("Could not rename file " + temp_path + " to " + path);
+    }
+    LogSaveStateStats(stats, "Save");
+    return stats;
+}
+
+static SaveStateResult LoadSaveState(u64 program_id, u32 slot, const SaveStateReader& read,
+                                     u32 depth) {
+    const auto path = GetSaveStatePath(program_id, slot);
+    const CSTHeader header = ReadHeader(path);
+
+    if (header.base_slot != 0) {
+        // A delta state only contains the memory pages that differ from its base state, so the
+        // base state has to be loaded first
+        if (depth >= SaveStateSlotCount) {
+            throw std::runtime_error("Circular dependency between delta savestates");
+        }
+        const auto base_path = GetSaveStatePath(program_id, header.base_slot);
+        if (!FileUtil::Exists(base_path) || ReadHeader(base_path).id != header.base_id) {
+            throw std::runtime_error(fmt::format(
+                "The savestate in slot {} was overwritten, which the state in slot {} depends on",
+                header.base_slot, slot));
+        }
+        LoadSaveState(program_id, header.base_slot, read, depth + 1);
     }
 
-    CSTHeader header{};
-    header.filetype = header_magic_bytes;
-    header.program_id = title_id;
-    std::string rev_bytes;
-    CryptoPP::StringSource(Common::g_scm_rev, true,
-                           new CryptoPP::HexDecoder(new CryptoPP::StringSink(rev_bytes)));
-    std::memcpy(header.revision.data(), rev_bytes.data(), sizeof(header.revision));
-    header.time = std::chrono::duration_cast<std::chrono::seconds>(
-                      std::chrono::system_clock::now().time_since_epoch())
-                      .count();
+    FileUtil::IOFile file(path, "rb");
+    if (!file || !file.Seek(sizeof(CSTHeader), SEEK_SET)) { // Skip header
+        throw std::runtime_error("Could not read from file at " + path);
+    }
 
-    if (file.WriteBytes(&header, sizeof(header)) != sizeof(header) ||
-        file.WriteBytes(buffer.data(), buffer.size()) != buffer.size()) {
-        throw std::runtime_error("Could not write to file " + path);
+    // Deserialize, decompressing the file as it is read
+    SaveStateProfiler profiler;
+    Common::Compression::ZSTDDecompressStreamBuf buffer([&file, &profiler](u8* data,
+                                                                           std::size_t size) {
+        const auto start = SaveStateProfiler::Clock::now();
+        const std::size_t read = file.ReadBytes(data, size);
+        profiler.AddIo(read, SaveStateProfiler::Clock::now() - start);
+        return read;
+    });
+    profiler.SetTarget(buffer);
+    std::istream stream(&profiler);
+    read(stream, profiler);
+    if (buffer.HasFailed()) {
+        throw std::runtime_error("The savestate in file " + path + " is corrupted");
     }
+    const SaveStateStats stats = profiler.Finish();
+    LogSaveStateStats(stats, "Load");
+    return {header.time, header.id, stats};
+}
+
+SaveStateResult LoadSaveState(u64 program_id, u32 slot, const SaveStateReader& read) {
+    return LoadSaveState(program_id, slot, read, 0);
+}
+
+SaveStateResult CompactSaveState(u64 program_id, u32 slot, const SaveStateReader& read,
+                                 const SaveStateWriter& write) {
+    // Keep the time and identifier, so that the delta states based on this one stay valid
+    const SaveStateResult loaded = LoadSaveState(program_id, slot, read);
+    return {loaded.time, loaded.id,
+            WriteSaveState(program_id, slot, loaded.time, loaded.id, 0, 0, write)};
+}
+
+void System::SaveState(u32 slot, u64 time, u64 id, bool delta) {
+    savestate_stats =
+        WriteSaveState(title_id, slot, time, id, delta ? delta_base_slot : 0,
+                       delta ? delta_base_id : 0,
+                       [this, delta](std::ostream& stream, SaveStateProfiler& profiler) {
+                           SerializeState(stream, profiler, delta);
+                       });
+
+    delta_base_slot = Settings::values.delta_savestates ? slot : 0;
+    delta_base_id = id;
 }
 
 void System::LoadState(u32 slot) {
@@ -138,27 +448,102 @@ void System::LoadState(u32 slot) {
         throw std::runtime_error("Unable to load while connected to multiplayer");
     }
 
-    const auto path = GetSaveStatePath(title_id, slot);
+    const SaveStateResult result =
+        LoadSaveState(title_id, slot, [this](std::istream& stream, SaveStateProfiler& profiler) {
+            DeserializeState(stream, profiler);
+        });
+    savestate_stats = result.stats;
 
-    std::vector<u8> decompressed;
+    delta_base_slot = Settings::values.delta_savestates ? slot : 0;
+    delta_base_id = result.id;
+}
+
+void System::CompactState(u32 slot) {
+    if (Network::GetRoomMember().lock()->IsConnected()) {
+        throw std::runtime_error("Unable to load while connected to multiplayer");
+    }
+
+    const SaveStateResult result = CompactSaveState(
+        title_id, slot,
+        [this](std::istream& stream, SaveStateProfiler& profiler) {
+            DeserializeState(stream, profiler);
+        },
+        [this](std::ostream& stream, SaveStateProfiler& profiler) {
+            SerializeState(stream, profiler, false);
+        });
+    savestate_stats = result.stats;
+
+    delta_base_slot = Settings::values.delta_savestates ? slot : 0;
+    delta_base_id = result.id;
+}
+
+void System::SerializeState(std::ostream& stream, SaveStateProfiler& profiler, bool delta) {
+    memory->SetSerializationMode(Settings::values.delta_savestates, delta);
+    savestate_profiler = &profiler;
+    SCOPE_EXIT({ savestate_profiler = nullptr; });
+    oarchive oa{stream};
+    oa&* this;
+}
+
+void System::DeserializeState(std::istream& stream, SaveStateProfiler& profiler) {
+    memory->SetSerializationMode(Settings::values.delta_savestates, false);
+    savestate_profiler = &profiler;
+    SCOPE_EXIT({ savestate_profiler = nullptr; });
+    iarchive ia{stream};
+    ia&* this;
+}
+
+void System::CaptureRewindSnapshot() {
+    next_rewind_ticks =
+        timing->GetGlobalTicks() + GPU::frame_ticks * Settings::values.rewind_interval;
+
+    // Skip the snapshot instead of stalling emulation when compression can't keep up
+    if (rewind_buffer->IsBusy()) {
+        return;
+    }
+
+    // Growing the vector while serializing would copy the state several times. Consecutive
+    // snapshots have about the same size, with some headroom for the state growing.
+    std::vector<u8> state;
+    const std::size_t last_size = rewind_buffer->GetLastStateSize();
+    state.reserve(last_size + last_size / 16);
     {
-        std::vector<u8> buffer(FileUtil::GetSize(path) - sizeof(CSTHeader));
+        VectorStreamBuf buffer(state);
+        std::ostream stream(&buffer);
+        // Don't disturb the reference of delta savestates
+        memory->SetSerializationMode(false, false);
+        oarchive oa{stream};
+        oa&* this;
+    }
+    rewind_buffer->Push(std::move(state));
+}
 
-        FileUtil::IOFile file(path, "rb");
-        file.Seek(sizeof(CSTHeader), SEEK_SET); // Skip header
-        if (file.ReadBytes(buffer.data(), buffer.size()) != buffer.size()) {
-            throw std::runtime_error("Could not read from file at " + path);
-        }
-        decompressed = Common::Compression::DecompressDataZSTD(buffer);
+bool System::Rewind() {
+    if (!rewind_buffer) {
+        return false;
+    }
+    if (Network::GetRoomMember().lock()->IsConnected()) {
+        throw std::runtime_error("Unable to rewind while connected to multiplayer");
+    }
+
+    const auto state = rewind_buffer->Pop();
+    if (!state) {
+        return false;
     }
-    std::istringstream sstream{
-        std::string{reinterpret_cast<char*>(decompressed.data()), decompressed.size()},
-        std::ios_base::binary};
-    decompressed.clear();
 
-    // Deserialize
-    iarchive ia{sstream};
+    MemoryStreamBuf buffer(state->data(), state->size());
+    std::istream stream(&buffer);
+    memory->SetSerializationMode(false, false);
+    iarchive ia{stream};
     ia&* this;
+
+    next_rewind_ticks =
+        timing->GetGlobalTicks() + GPU::frame_ticks * Settings::values.rewind_interval;
+    return true;
+}
+
+std::size_t System::GetRewindSnapshotCount() const {
+    return rewind_buffer ? rewind_buffer->GetSnapshotCount() : 0;
 }
 
 } // namespace Core
@@ -4,6 +4,11 @@
 
 #pragma once
 
+#include <chrono>
+#include <functional>
+#include <iosfwd>
+#include <streambuf>
+#include <string>
 #include <vector>
 #include "common/common_types.h"
 
@@ -14,6 +19,7 @@ struct CSTHeader;
 struct SaveStateInfo {
     u32 slot;
     u64 time;
+    bool delta; ///< Whether the state depends on the state in another slot
     enum class ValidationStatus {
         OK,
         RevisionDismatch,
@@ -24,4 +30,124 @@ constexpr u32 SaveStateSlotCount = 10; // Maximum count of savestate slots
 
 std::vector<SaveStateInfo> ListSaveStates(u64 program_id);
 
+/// Returns the path of the file holding the state in a slot
+std::string GetSaveStatePath(u64 program_id, u32 slot);
+
+/// Size of and time spent on each section of the emulation state while saving or loading a state
+struct SaveStateStats {
+    struct Section {
+        std::string name;
+        u64 size = 0;                              ///< Uncompressed size in bytes
+        std::chrono::nanoseconds serialize_time{}; ///< Time spent serializing or deserializing
+        std::chrono::nanoseconds compress_time{};  ///< Time spent compressing or decompressing
+        std::chrono::nanoseconds io_time{};        ///< Time spent writing or reading the file
+    };
+
+    /// Times of each section, as spent by the thread saving or loading the state. Compression
+    /// time includes waiting for the compression workers.
+    std::vector<Section> sections;
+    u64 compressed_size = 0;
+    /**
+     * CPU time spent by the other threads of the process, i.e. mostly by the compression workers.
+     * Their work overlaps with the sections, so it is not attributed to any of them.
+     */
+    std::chrono::nanoseconds worker_time{};
+};
+
+/**
+ * Stream buffer placed between a serialization archive and the stream buffer compressing or
+ * decompressing the state. It passes all data through unbuffered, attributing its size and the
+ * time spent in each stage to the section of the state being serialized at the time.
+ */
+class SaveStateProfiler final : public std::streambuf {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    SaveStateProfiler();
+    ~SaveStateProfiler() override;
+
+    /// Sets the stream buffer the data is passed to or read from
+    void SetTarget(std::streambuf& target);
+
+    /// Attributes the following data and time to a new section
+    void BeginSection(std::string name);
+
+    /**
+     * Records writing or reading a piece of compressed data. Called from the sink or source of the
+     * target stream buffer.
+     */
+    void AddIo(std::size_t compressed_size, Clock::duration time);
+
+    /// Ends the current section and returns the statistics of all sections
+    SaveStateStats Finish();
+
+    /// Calls a function operating on the target, attributing its time to the current section
+    template <typename Func>
+    auto TimeTarget(Func&& func) {
+        const auto start = Clock::now();
+        auto result = func();
+        target_time += Clock::now() - start;
+        return result;
+    }
+
+protected:
+    int_type overflow(int_type ch) override;
+    std::streamsize xsputn(const char_type* s, std::streamsize count) override;
+    int sync() override;
+    int_type underflow() override;
+    int_type uflow() override;
+    std::streamsize xsgetn(char_type* s, std::streamsize count) override;
+
+private:
+    void EndSection();
+
+    std::streambuf* target = nullptr;
+    SaveStateStats stats;
+
+    SaveStateStats::Section section;
+    Clock::time_point section_start;
+    Clock::duration target_time{}; ///< Time spent in the target within the current section
+    Clock::duration io_time{};     ///< Time spent in I/O within the current section
+
+    std::chrono::nanoseconds start_process_cpu_time;
+    std::chrono::nanoseconds start_thread_cpu_time;
+};
+
+/// Logs the statistics of a save or load
+void LogSaveStateStats(const SaveStateStats& stats, const char* operation);
+
+/// Serializes a state to a savestate stream
+using SaveStateWriter = std::function<void(std::ostream& stream, SaveStateProfiler& profiler)>;
+/// Deserializes a state from a savestate stream
+using SaveStateReader = std::function<void(std::istream& stream, SaveStateProfiler& profiler)>;
+
+/// Time and identifier of a savestate, with the statistics of saving or loading its file
+struct SaveStateResult {
+    u64 time;
+    u64 id;
+    SaveStateStats stats;
+};
+
+/**
+ * Writes a state to the file of a slot, replacing the previous file only once the new one was
+ * written completely.
+ * @param base_slot Slot of the state a delta state was created against, 0 for a full state
+ * @param base_id Identifier of the state a delta state was created against
+ */
+SaveStateStats WriteSaveState(u64 program_id, u32 slot, u64 time, u64 id, u32 base_slot,
+                              u64 base_id, const SaveStateWriter& write);
+
+/**
+ * Loads the state in a slot. A delta state is read after the states it depends on, so `read` is
+ * called for each state of the chain, starting with the full state.
+ */
+SaveStateResult LoadSaveState(u64 program_id, u32 slot, const SaveStateReader& read);
+
+/**
+ * Loads the state in a slot through `read` and writes it back through `write` as a full state,
+ * which keeps its time and identifier so that the delta states based on it stay valid.
+ */
+SaveStateResult CompactSaveState(u64 program_id, u32 slot, const SaveStateReader& read,
+                                 const SaveStateWriter& write);
+
 } // namespace Core
@@ -28,6 +28,9 @@ void Apply() {
 
     VideoCore::g_hw_renderer_enabled = values.use_hw_renderer;
     VideoCore::g_shader_jit_enabled = values.use_shader_jit;
+    VideoCore::g_shader_jit_batch_enabled = values.use_batch_shader_jit;
+    VideoCore::g_shader_jit_disk_cache_enabled = values.use_shader_jit_disk_cache;
+    VideoCore::g_shader_jit_async_enabled = values.use_async_shader_jit;
     VideoCore::g_hw_shader_enabled = values.use_hw_shader;
     VideoCore::g_separable_shader_enabled = values.separable_shader;
     VideoCore::g_hw_shader_accurate_mul = values.shaders_accurate_mul;
@@ -45,6 +48,7 @@ void Apply() {
     auto& system = Core::System::GetInstance();
     if (system.IsPoweredOn()) {
         system.CoreTiming().UpdateClockSpeed(values.cpu_clock_percentage);
+        system.CoreTiming().SetAdaptiveSlicing(values.adaptive_slicing);
         Core::DSP().SetSink(values.sink_id, values.audio_device_id);
         Core::DSP().EnableStretching(values.enable_audio_stretching);
 
@@ -77,12 +81,18 @@ void LogSettings() {
 
     LOG_INFO(Config, "Citra Configuration:");
     log_setting("Core_UseCpuJit", values.use_cpu_jit);
+    log_setting("Core_AdaptiveSlicing", values.adaptive_slicing);
     log_setting("Renderer_UseGLES", values.use_gles);
     log_setting("Renderer_UseHwRenderer", values.use_hw_renderer);
     log_setting("Renderer_UseHwShader", values.use_hw_shader);
     log_setting("Renderer_SeparableShader", values.separable_shader);
     log_setting("Renderer_ShadersAccurateMul", values.shaders_accurate_mul);
     log_setting("Renderer_UseShaderJit", values.use_shader_jit);
+    log_setting("Renderer_UseBatchShaderJit", values.use_batch_shader_jit);
+    log_setting("Renderer_UseShaderJitDiskCache", values.use_shader_jit_disk_cache);
+    log_setting("Renderer_UseAsyncShaderJit", values.use_async_shader_jit);
+    log_setting("Renderer_SwRasterizerThreads", values.sw_rasterizer_threads);
+    log_setting("Renderer_VertexShaderThreads", values.vertex_shader_threads);
     log_setting("Renderer_UseResolutionFactor", values.resolution_factor);
     log_setting("Renderer_FrameLimit", values.frame_limit);
     log_setting("Renderer_UseFrameLimitAlternate", values.use_frame_limit_alternate);
@@ -97,6 +107,9 @@ void LogSettings() {
     log_setting("Layout_UprightScreen", values.upright_screen);
     log_setting("Utility_DumpTextures", values.dump_textures);
     log_setting("Utility_CustomTextures", values.custom_textures);
+    log_setting("Utility_DeltaSavestates", values.delta_savestates);
+    log_setting("Utility_RewindInterval", values.rewind_interval);
+    log_setting("Utility_RewindBufferSize", values.rewind_buffer_size);
     log_setting("Utility_UseDiskShaderCache", values.use_disk_shader_cache);
     log_setting("Audio_EnableDspLle", values.enable_dsp_lle);
     log_setting("Audio_EnableDspLleMultithread", values.enable_dsp_lle_multithread);
@@ -116,6 +129,7 @@ void LogSettings() {
     log_setting("Camera_OuterLeftConfig", values.camera_config[OuterLeftCamera]);
     log_setting("Camera_OuterLeftFlip", values.camera_flip[OuterLeftCamera]);
     log_setting("DataStorage_UseVirtualSd", values.use_virtual_sd);
+    log_setting("DataStorage_RomfsCacheSize", values.romfs_cache_size);
     log_setting("System_IsNew3ds", values.is_new_3ds);
     log_setting("System_RegionValue", values.region_value);
     log_setting("Debugging_UseGdbstub", values.use_gdbstub);
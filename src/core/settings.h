@@ -137,9 +137,11 @@ struct Values {
     // Core
     bool use_cpu_jit;
     int cpu_clock_percentage;
+    bool adaptive_slicing;
 
     // Data Storage
     bool use_virtual_sd;
+    u32 romfs_cache_size;
 
     // System
     int region_value;
@@ -154,6 +156,11 @@ struct Values {
     bool use_disk_shader_cache;
     bool shaders_accurate_mul;
     bool use_shader_jit;
+    bool use_batch_shader_jit;
+    bool use_shader_jit_disk_cache;
+    bool use_async_shader_jit;
+    u16 sw_rasterizer_threads;
+    u16 vertex_shader_threads;
     u16 resolution_factor;
     bool use_frame_limit_alternate;
     u16 frame_limit;
@@ -186,6 +193,9 @@ struct Values {
     bool dump_textures;
     bool custom_textures;
     bool preload_textures;
+    bool delta_savestates;
+    u32 rewind_interval;
+    u32 rewind_buffer_size;
 
     bool use_vsync_new;
 
@@ -0,0 +1,114 @@
+// Copyright 2020 Citra Emulator Project
+// Licensed under GPLv2 or any later version
+// Refer to the license.txt file included.
+
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <catch2/catch.hpp>
+#include "common/common_types.h"
+#include "common/threadsafe_queue.h"
+
+namespace Common {
+
+TEST_CASE("MPSCQueue", "[common]") {
+    MPSCQueue<int> queue;
+    REQUIRE(queue.Empty());
+
+    int value = 0;
+    REQUIRE(!queue.Pop(value));
+
+    queue.Push(1);
+    queue.Push(2);
+    queue.Push(3);
+    REQUIRE(queue.Size() == 3);
+    REQUIRE(queue.Front() == 1);
+    queue.Pop();
+    REQUIRE(queue.Pop(value));
+    REQUIRE(value == 2);
+    REQUIRE(queue.PopWait() == 3);
+    REQUIRE(queue.Empty());
+
+    queue.Push(4);
+    queue.Push(5);
+    std::vector<int> values;
+    REQUIRE(queue.PopAll([&values](int&& v) { values.push_back(v); }) == 2);
+    REQUIRE(values == std::vector<int>{4, 5});
+    REQUIRE(queue.Empty());
+
+    queue.Push(6);
+    queue.Clear();
+    REQUIRE(queue.Empty());
+    REQUIRE(!queue.Pop(value));
+}
+
+TEST_CASE("MPSCQueue[MultipleWriters]", "[common]") {
+    constexpr u32 NumWriters = 4;
+    constexpr u32 NumValues = 100000;
+
+    MPSCQueue<u32> queue;
+    std::vector<std::thread> writers;
+    for (u32 writer = 0; writer < NumWriters; ++writer) {
+        writers.emplace_back([&queue, writer] {
+            for (u32 i = 0; i < NumValues; ++i) {
+                queue.Push(writer << 24 | i);
+            }
+        });
+    }
+
+    // The values of each writer must arrive in the order they were pushed
+    std::vector<u32> next_values(NumWriters);
+    u32 received = 0;
+    bool ordered = true;
+    const auto check_value = [&](u32 value) {
+        const u32 writer = value >> 24;
+        ordered &= (value & 0xFFFFFF) == next_values[writer]++;
+        ++received;
+    };
+    while (received < NumWriters * NumValues) {
+        if (received % 2 == 0) {
+            check_value(queue.PopWait());
+        } else {
+            queue.PopAll(check_value);
+        }
+    }
+
+    for (auto& writer : writers) {
+        writer.join();
+    }
+    REQUIRE(ordered);
+    REQUIRE(queue.Empty());
+    for (const u32 next_value : next_values) {
+        REQUIRE(next_value == NumValues);
+    }
+}
+
+TEST_CASE("MPSCQueue[PopWaitWakesUp]", "[common]") {
+    constexpr u32 NumWriters = 2;
+    constexpr u32 NumValues = 200;
+
+    // Writers pushing slower than the reader pops make the reader wait for almost every element
+    MPSCQueue<u32> queue;
+    std::vector<std::thread> writers;
+    for (u32 writer = 0; writer < NumWriters; ++writer) {
+        writers.emplace_back([&queue] {
+            for (u32 i = 0; i < NumValues; ++i) {
+                std::this_thread::sleep_for(std::chrono::microseconds(50));
+                queue.Push(i);
+            }
+        });
+    }
+
+    u32 sum = 0;
+    for (u32 i = 0; i < NumWriters * NumValues; ++i) {
+        sum += queue.PopWait();
+    }
+
+    for (auto& writer : writers) {
+        writer.join();
+    }
+    REQUIRE(sum == NumWriters * NumValues * (NumValues - 1) / 2);
+    REQUIRE(queue.Empty());
+}
+
+} // namespace Common
@@ -0,0 +1,144 @@
+// Copyright 2020 Citra Emulator Project
+// Licensed under GPLv2 or any later version
+// Refer to the license.txt file included.
+
+#include <algorithm>
+#include <cstring>
+#include <istream>
+#include <ostream>
+#include <random>
+#include <vector>
+#include <catch2/catch.hpp>
+#include "common/common_types.h"
+#include "common/zstd_compression.h"
+
+namespace Common::Compression {
+
+/// Generates data that compresses reasonably well, with some incompressible stretches
+static std::vector<u8> GenerateData(std::size_t size) {
+    std::mt19937 rng(0x5A535444);
+    std::vector<u8> data(size);
+    for (std::size_t i = 0; i < size; ++i) {
+        data[i] = (i / 1000) % 7 == 0 ? static_cast<u8>(rng()) : static_cast<u8>(i * 3);
+    }
+    return data;
+}
+
+/// Writes the data to a compressing stream in pieces of varying size, flushing it if requested
+static std::vector<u8> Compress(const std::vector<u8>& data, u32 num_workers, bool flush) {
+    std::vector<u8> compressed;
+    ZSTDCompressStreamBuf buf(
+        [&compressed](const u8* piece, std::size_t size) {
+            compressed.insert(compressed.end(), piece, piece + size);
+            return true;
+        },
+        num_workers);
+    std::ostream stream(&buf);
+
+    std::mt19937 rng(0x50494543);
+    std::size_t pos = 0;
+    bool flushed = false;
+    while (pos < data.size()) {
+        // Mix small writes going through the put area with large ones bypassing it
+        const std::size_t size =
+            std::min<std::size_t>(data.size() - pos, rng() % 4 == 0 ? rng() % 300000 : rng() % 64);
+        stream.write(reinterpret_cast<const char*>(data.data() + pos), size);
+        pos += size;
+
+        if (flush && !flushed && pos >= data.size() / 2) {
+            const std::size_t compressed_size = compressed.size();
+            stream.flush();
+            // Everything written so far must be decodable at this point
+            REQUIRE(compressed.size() > compressed_size);
+            flushed = true;
+        }
+    }
+    REQUIRE(stream.good());
+    REQUIRE(buf.Finish());
+    return compressed;
+}
+
+/**
+ * Reads the compressed data back through a decompressing stream, in pieces of varying size.
+ * @param failed Receives whether the stream buffer detected corrupt or truncated data
+ */
+static std::vector<u8> Decompress(const std::vector<u8>& compressed, bool& failed) {
+    std::size_t read_pos = 0;
+    ZSTDDecompressStreamBuf buf([&](u8* data, std::size_t size) {
+        // Hand out the compressed data in small pieces to exercise refilling the input
+        size = std::min({size, compressed.size() - read_pos, std::size_t{4096}});
+        std::memcpy(data, compressed.data() + read_pos, size);
+        read_pos += size;
+        return size;
+    });
+    std::istream stream(&buf);
+
+    std::mt19937 rng(0x52454144);
+    std::vector<u8> data;
+    std::vector<char> piece;
+    while (stream) {
+        piece.resize(rng() % 4 == 0 ? rng() % 300000 : rng() % 64 + 1);
+        stream.read(piece.data(), piece.size());
+        data.insert(data.end(), piece.begin(), piece.begin() + stream.gcount());
+    }
+    failed = buf.HasFailed();
+    return data;
+}
+
+TEST_CASE("ZSTD stream round trip", "[common][zstd]") {
+    const u32 num_workers = GENERATE(0u, 4u);
+    const bool flush = GENERATE(false, true);
+    const std::vector<u8> data = GenerateData(4 * 1024 * 1024);
+
+    const std::vector<u8> compressed = Compress(data, num_workers, flush);
+    REQUIRE(compressed.size() < data.size());
+    bool failed;
+    REQUIRE(Decompress(compressed, failed) == data);
+    REQUIRE(!failed);
+}
+
+TEST_CASE("ZSTD stream of empty input", "[common][zstd]") {
+    const u32 num_workers = GENERATE(0u, 4u);
+
+    const std::vector<u8> compressed = Compress({}, num_workers, false);
+    // Even an empty frame has a header
+    REQUIRE(!compressed.empty());
+    bool failed;
+    REQUIRE(Decompress(compressed, failed).empty());
+    REQUIRE(!failed);
+    REQUIRE(Decompress({}, failed).empty());
+    REQUIRE(!failed);
+}
+
+TEST_CASE("ZSTD stream of truncated or corrupt data", "[common][zstd]") {
+    const std::vector<u8> data = GenerateData(1024 * 1024);
+    const std::vector<u8> compressed = Compress(data, 0, false);
+    bool failed = false;
+
+    SECTION("truncated") {
+        const std::vector<u8> truncated(compressed.begin(),
+                                        compressed.begin() + compressed.size() / 2);
+        const std::vector<u8> result = Decompress(truncated, failed);
+        REQUIRE(result.size() < data.size());
+        REQUIRE(std::equal(result.begin(), result.end(), data.begin()));
+        REQUIRE(failed);
+    }
+
+    SECTION("corrupt header") {
+        std::vector<u8> corrupt = compressed;
+        corrupt[0] ^= 0xFF;
+        REQUIRE(Decompress(corrupt, failed).empty());
+        REQUIRE(failed);
+    }
+
+    SECTION("corrupt block") {
+        std::vector<u8> corrupt = compressed;
+        for (std::size_t i = compressed.size() / 3; i < compressed.size() / 3 + 64; ++i) {
+            corrupt[i] = static_cast<u8>(~corrupt[i]);
+        }
+        REQUIRE(Decompress(corrupt, failed) != data);
+        REQUIRE(failed);
+    }
+}
+
+} // namespace Common::Compression
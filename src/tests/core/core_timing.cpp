@@ -4,9 +4,13 @@
 
 #include <catch2/catch.hpp>
 
+#include <algorithm>
 #include <array>
 #include <bitset>
+#include <functional>
+#include <random>
 #include <string>
+#include <vector>
 #include "common/file_util.h"
 #include "core/core.h"
 #include "core/core_timing.h"
@@ -196,4 +200,176 @@ TEST_CASE("CoreTiming[ChainScheduling]", "[core]") {
     REQUIRE(MAX_SLICE_LENGTH == timing.GetTimer(0)->GetDowncount());
 }
 
+TEST_CASE("CoreTiming[EventQueue]", "[core]") {
+    using Event = Core::Timing::Event;
+
+    std::array<Core::TimingEventType, 4> types{};
+    std::mt19937 rng(1234);
+    Core::Timing::EventQueue queue;
+    // Unordered copy of the queue contents to check against
+    std::vector<Event> expected;
+    s64 now = 0;
+    u64 fifo_order = 0;
+
+    const auto check_top = [&] {
+        REQUIRE(queue.Size() == expected.size());
+        if (!expected.empty()) {
+            const Event& top = queue.Top();
+            const Event& expected_top = *std::min_element(expected.begin(), expected.end());
+            REQUIRE(top.time == expected_top.time);
+            REQUIRE(top.fifo_order == expected_top.fifo_order);
+        }
+    };
+
+    for (int i = 0; i < 20000; ++i) {
+        const u32 action = rng() % 16;
+        if (action < 8) {
+            // Mostly near events that fit the wheel, some beyond it and some in the past
+            s64 delay = rng() % 3 == 0 ? rng() % 200 : rng() % 2000000;
+            if (rng() % 50 == 0) {
+                delay = static_cast<s64>(rng() % 100000000);
+            } else if (rng() % 50 == 0) {
+                delay = -static_cast<s64>(rng() % 100000);
+            }
+            const Event event{now + delay, fifo_order++, rng() % 4, &types[rng() % types.size()]};
+            queue.Push(event);
+            expected.push_back(event);
+        } else if (action < 13) {
+            if (!expected.empty()) {
+                const auto top = std::min_element(expected.begin(), expected.end());
+                now = std::max(now, top->time);
+                queue.Pop();
+                expected.erase(top);
+            }
+        } else if (action < 15) {
+            const auto* type = &types[rng() % types.size()];
+            const u64 userdata = rng() % 4;
+            queue.Remove(type, userdata);
+            expected.erase(std::remove_if(expected.begin(), expected.end(),
+                                          [&](const Event& e) {
+                                              return e.type == type && e.userdata == userdata;
+                                          }),
+                           expected.end());
+        } else {
+            const auto* type = &types[rng() % types.size()];
+            queue.Remove(type);
+            expected.erase(std::remove_if(expected.begin(), expected.end(),
+                                          [&](const Event& e) { return e.type == type; }),
+                           expected.end());
+        }
+        check_top();
+    }
+
+    std::sort(expected.begin(), expected.end());
+    const std::vector<Event> events = queue.GetEvents();
+    REQUIRE(events.size() == expected.size());
+    for (std::size_t i = 0; i < events.size(); ++i) {
+        REQUIRE(events[i].fifo_order == expected[i].fifo_order);
+    }
+
+    queue.Clear();
+    REQUIRE(queue.Empty());
+}
+
+namespace EventQueueBenchmark {
+
+/// The binary heap Core::Timing used before Timing::EventQueue, for comparison
+class HeapEventQueue {
+public:
+    using Event = Core::Timing::Event;
+
+    bool Empty() const {
+        return events.empty();
+    }
+
+    void Push(const Event& event) {
+        events.push_back(event);
+        std::push_heap(events.begin(), events.end(), std::greater<>());
+    }
+
+    const Event& Top() const {
+        return events.front();
+    }
+
+    void Pop() {
+        std::pop_heap(events.begin(), events.end(), std::greater<>());
+        events.pop_back();
+    }
+
+    void Remove(const Core::TimingEventType* type, u64 userdata) {
+        auto itr = std::remove_if(events.begin(), events.end(), [&](const Event& e) {
+            return e.type == type && e.userdata == userdata;
+        });
+        if (itr != events.end()) {
+            events.erase(itr, events.end());
+            std::make_heap(events.begin(), events.end(), std::greater<>());
+        }
+    }
+
+private:
+    std::vector<Event> events;
+};
+
+/**
+ * Emulates the event pattern of services: a few periodic events, and many events that are
+ * scheduled and mostly cancelled before they fire, such as thread wakeups and timers.
+ */
+template <typename Queue>
+u64 RunWorkload(Queue& queue, const std::array<Core::TimingEventType, 16>& types,
+                std::size_t pending_events) {
+    std::mt19937 rng(42);
+    s64 now = 0;
+    u64 fifo_order = 0;
+    u64 fired = 0;
+
+    for (std::size_t i = 0; i < pending_events; ++i) {
+        queue.Push({now + static_cast<s64>(rng() % 4000000), fifo_order++, i, &types[i % 16]});
+    }
+    for (int i = 0; i < 100000; ++i) {
+        const u64 userdata = pending_events + i;
+        queue.Push({now + static_cast<s64>(rng() % 1000000), fifo_order++, userdata,
+                    &types[userdata % 16]});
+        if (rng() % 4 != 0) {
+            queue.Remove(&types[userdata % 16], userdata);
+        }
+        now += 2000;
+        while (!queue.Empty() && queue.Top().time <= now) {
+            const auto event = queue.Top();
+            queue.Pop();
+            // Reschedule periodic events
+            if (event.userdata < pending_events) {
+                queue.Push({now + static_cast<s64>(rng() % 4000000), fifo_order++,
+                            event.userdata, event.type});
+            }
+            ++fired;
+        }
+    }
+    return fired;
+}
+
+} // namespace EventQueueBenchmark
+
+TEST_CASE("CoreTiming[EventQueueBenchmark]", "[.][benchmark][core]") {
+    using namespace EventQueueBenchmark;
+
+    std::array<Core::TimingEventType, 16> types{};
+    for (const std::size_t pending_events : {16, 256}) {
+        {
+            Core::Timing::EventQueue queue;
+            HeapEventQueue heap;
+            REQUIRE(RunWorkload(queue, types, pending_events) ==
+                    RunWorkload(heap, types, pending_events));
+        }
+
+        BENCHMARK("Timer wheel, " + std::to_string(pending_events) + " pending events") {
+            Core::Timing::EventQueue queue;
+            return RunWorkload(queue, types, pending_events);
+        };
+        BENCHMARK("Binary heap, " + std::to_string(pending_events) + " pending events") {
+            HeapEventQueue queue;
+            return RunWorkload(queue, types, pending_events);
+        };
+    }
+}
+
 // TODO: Add tests for multiple timers
@@ -0,0 +1,155 @@
+// Copyright 2020 Citra Emulator Project
+// Licensed under GPLv2 or any later version
+// Refer to the license.txt file included.
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <catch2/catch.hpp>
+#include "common/file_util.h"
+#include "core/file_sys/romfs_reader.h"
+#include "core/settings.h"
+
+namespace FileSys {
+
+constexpr std::size_t BLOCK_SIZE = DirectRomFSReader::BLOCK_SIZE;
+/// Offset of the RomFS data in the file, as if it was preceded by a container header
+constexpr std::size_t DATA_OFFSET = 0x200;
+/// Size of the RomFS data, ending in the middle of a block
+constexpr std::size_t DATA_SIZE = 5 * BLOCK_SIZE + 0x123;
+
+static std::vector<u8> MakeData() {
+    std::vector<u8> data(DATA_SIZE);
+    for (std::size_t i = 0; i < data.size(); ++i) {
+        data[i] = static_cast<u8>(i * 7 + (i >> 12));
+    }
+    return data;
+}
+
+/// Writes the data behind a header, returning the path of the file
+static std::string WriteRomFS(const std::vector<u8>& data) {
+    const std::string path = "romfs_reader_test.tmp";
+    FileUtil::IOFile file(path, "wb");
+    const std::vector<u8> header(DATA_OFFSET, 0xEE);
+    REQUIRE(file.WriteBytes(header.data(), header.size()) == header.size());
+    REQUIRE(file.WriteBytes(data.data(), data.size()) == data.size());
+    return path;
+}
+
+static std::vector<u8> Read(RomFSReader& reader, std::size_t offset, std::size_t length) {
+    std::vector<u8> buffer(length);
+    buffer.resize(reader.ReadFile(offset, length, buffer.data()));
+    return buffer;
+}
+
+static std::vector<u8> Slice(const std::vector<u8>& data, std::size_t offset, std::size_t length) {
+    return std::vector<u8>(data.begin() + offset, data.begin() + offset + length);
+}
+
+TEST_CASE("DirectRomFSReader block cache", "[core][file_sys]") {
+    const u32 cache_size = Settings::values.romfs_cache_size;
+    // Room for four blocks, which makes reads of up to one block go through the cache
+    Settings::values.romfs_cache_size = 4 * BLOCK_SIZE / 1024;
+
+    const std::vector<u8> data = MakeData();
+    const std::string path = WriteRomFS(data);
+    DirectRomFSReader reader(FileUtil::IOFile(path, "rb"), DATA_OFFSET, DATA_SIZE);
+    REQUIRE(reader.GetSize() == DATA_SIZE);
+    const auto& stats = reader.GetCacheStats();
+
+    SECTION("hits") {
+        REQUIRE(Read(reader, 0x10, 0x100) == Slice(data, 0x10, 0x100));
+        REQUIRE(stats.misses == 1);
+        REQUIRE(stats.hits == 0);
+
+        // Any other read within the same block is served from the cache
+        REQUIRE(Read(reader, 0x2000, 0x80) == Slice(data, 0x2000, 0x80));
+        REQUIRE(Read(reader, 0x10, 0x100) == Slice(data, 0x10, 0x100));
+        REQUIRE(stats.misses == 1);
+        REQUIRE(stats.hits == 2);
+    }
+
+    SECTION("reads spanning a block boundary") {
+        const std::size_t offset = 2 * BLOCK_SIZE - 0x40;
+        REQUIRE(Read(reader, offset, 0x80) == Slice(data, offset, 0x80));
+        REQUIRE(stats.misses == 2);
+
+        // Both blocks are cached now
+        REQUIRE(Read(reader, BLOCK_SIZE, 0x10) == Slice(data, BLOCK_SIZE, 0x10));
+        REQUIRE(Read(reader, 2 * BLOCK_SIZE + 0x100, 0x10) ==
+                Slice(data, 2 * BLOCK_SIZE + 0x100, 0x10));
+        REQUIRE(stats.misses == 2);
+        REQUIRE(stats.hits == 2);
+
+        // A read of a whole block that isn't aligned touches two blocks as well
+        REQUIRE(Read(reader, 0x1234, BLOCK_SIZE) == Slice(data, 0x1234, BLOCK_SIZE));
+    }
+
+    SECTION("reads at the end of the file") {
+        // The last block is only partially filled
+        REQUIRE(Read(reader, DATA_SIZE - 0x10, 0x10) == Slice(data, DATA_SIZE - 0x10, 0x10));
+        // Reads past the end are cut short
+        REQUIRE(Read(reader, DATA_SIZE - 0x10, 0x100) == Slice(data, DATA_SIZE - 0x10, 0x10));
+        REQUIRE(Read(reader, DATA_SIZE - 0x200, BLOCK_SIZE) ==
+                Slice(data, DATA_SIZE - 0x200, 0x200));
+        REQUIRE(Read(reader, DATA_SIZE, 0x10).empty());
+        REQUIRE(Read(reader, DATA_SIZE + BLOCK_SIZE, 0x10).empty());
+        REQUIRE(stats.misses == 2);
+    }
+
+    SECTION("eviction") {
+        // Reading five blocks into a cache of four evicts the least recently used one
+        for (std::size_t block = 0; block < 5; ++block) {
+            const std::size_t offset = block * BLOCK_SIZE;
+            REQUIRE(Read(reader, offset, 0x10) == Slice(data, offset, 0x10));
+        }
+        REQUIRE(stats.misses == 5);
+        REQUIRE(Read(reader, 4 * BLOCK_SIZE, 0x10) == Slice(data, 4 * BLOCK_SIZE, 0x10));
+        REQUIRE(stats.hits == 1);
+        REQUIRE(Read(reader, 0, 0x10) == Slice(data, 0, 0x10));
+        REQUIRE(stats.misses == 6);
+    }
+
+    SECTION("large reads bypass the cache") {
+        REQUIRE(Read(reader, 0x100, 2 * BLOCK_SIZE) == Slice(data, 0x100, 2 * BLOCK_SIZE));
+        REQUIRE(stats.misses == 0);
+        REQUIRE(stats.hits == 0);
+    }
+
+    Settings::values.romfs_cache_size = cache_size;
+    FileUtil::Delete(path);
+}
+
+TEST_CASE("DirectRomFSReader block cache with encryption", "[core][file_sys]") {
+    const u32 cache_size = Settings::values.romfs_cache_size;
+    Settings::values.romfs_cache_size = 4 * BLOCK_SIZE / 1024;
+
+    const std::string path = WriteRomFS(MakeData());
+    std::array<u8, 16> key{};
+    std::array<u8, 16> ctr{};
+    for (std::size_t i = 0; i < key.size(); ++i) {
+        key[i] = static_cast<u8>(i * 17);
+        ctr[i] = static_cast<u8>(0xF0 - i);
+    }
+    DirectRomFSReader reader(FileUtil::IOFile(path, "rb"), DATA_OFFSET, DATA_SIZE, key, ctr,
+                             0x1000);
+
+    // Reads bypassing the cache decrypt exactly the requested range, so they serve as reference
+    // for the blocks decrypted by the cache
+    const std::vector<u8> decrypted = Read(reader, 0, DATA_SIZE);
+    REQUIRE(decrypted.size() == DATA_SIZE);
+    REQUIRE(reader.GetCacheStats().misses == 0);
+
+    for (const std::size_t offset : {std::size_t{0x10}, 2 * BLOCK_SIZE - 0x33, DATA_SIZE - 0x21}) {
+        const std::size_t length = std::min<std::size_t>(0x80, DATA_SIZE - offset);
+        REQUIRE(Read(reader, offset, length) == Slice(decrypted, offset, length));
+    }
+    REQUIRE(reader.GetCacheStats().misses == 4);
+
+    Settings::values.romfs_cache_size = cache_size;
+    FileUtil::Delete(path);
+}
+
+} // namespace FileSys
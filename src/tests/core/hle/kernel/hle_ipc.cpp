@@ -184,6 +184,59 @@ TEST_CASE("HLERequestContext::PopulateFromIncomingCommandBuffer", "[core][kernel
         REQUIRE(process->vm_manager.UnmapRange(target_address, buffer.GetSize()) == RESULT_SUCCESS);
     }
 
+    SECTION("exposes the host memory of MappedBuffer descriptors") {
+        auto mem_a = std::make_shared<BufferMem>(Memory::PAGE_SIZE * 2);
+        auto mem_b = std::make_shared<BufferMem>(Memory::PAGE_SIZE);
+        MemoryRef buffer_a{mem_a};
+        MemoryRef buffer_b{mem_b};
+
+        VAddr target_address = 0x10000000;
+        auto result = process->vm_manager.MapBackingMemory(
+            target_address, buffer_a, buffer_a.GetSize(), MemoryState::Private);
+        REQUIRE(result.Code() == RESULT_SUCCESS);
+        result = process->vm_manager.MapBackingMemory(target_address + buffer_a.GetSize(), buffer_b,
+                                                      buffer_b.GetSize(), MemoryState::Private);
+        REQUIRE(result.Code() == RESULT_SUCCESS);
+
+        const u32 size = Memory::PAGE_SIZE * 3;
+        const u32_le input[]{
+            IPC::MakeHeader(0, 0, 2),
+            IPC::MappedBufferDesc(size, IPC::RW),
+            target_address,
+        };
+
+        context.PopulateFromIncomingCommandBuffer(input, process);
+        auto& mapped_buffer = context.GetMappedBuffer(0);
+
+        // Pages that are contiguous in host memory are merged
+        auto spans = mapped_buffer.GetWriteSpans(0x10, size - 0x20);
+        REQUIRE(spans);
+        REQUIRE(spans->size() == 2);
+        CHECK((*spans)[0].data == buffer_a.GetPtr() + 0x10);
+        CHECK((*spans)[0].size == buffer_a.GetSize() - 0x10);
+        CHECK((*spans)[1].data == buffer_b.GetPtr());
+        CHECK((*spans)[1].size == buffer_b.GetSize() - 0x10);
+
+        std::fill((*spans)[1].data, (*spans)[1].data + (*spans)[1].size, 0xEF);
+        std::vector<u8> other_buffer(buffer_b.GetSize() - 0x10);
+        mapped_buffer.Read(other_buffer.data(), buffer_a.GetSize(), other_buffer.size());
+        CHECK(other_buffer == std::vector<u8>(other_buffer.size(), 0xEF));
+
+        spans = mapped_buffer.GetReadSpans(0, Memory::PAGE_SIZE);
+        REQUIRE(spans);
+        REQUIRE(spans->size() == 1);
+        CHECK((*spans)[0].data == buffer_a.GetPtr());
+        CHECK((*spans)[0].size == Memory::PAGE_SIZE);
+
+        // Unmapped pages can only be accessed through Read and Write
+        REQUIRE(process->vm_manager.UnmapRange(target_address + buffer_a.GetSize(),
+                                               buffer_b.GetSize()) == RESULT_SUCCESS);
+        CHECK(!mapped_buffer.GetReadSpans(0, size));
+
+        REQUIRE(process->vm_manager.UnmapRange(target_address, buffer_a.GetSize()) ==
+                RESULT_SUCCESS);
+    }
+
     SECTION("translates mixed params") {
         auto mem_static = std::make_shared<BufferMem>(Memory::PAGE_SIZE);
         MemoryRef buffer_static{mem_static};
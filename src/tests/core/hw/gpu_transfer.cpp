@@ -0,0 +1,230 @@
+// Copyright 2020 Citra Emulator Project
+// Licensed under GPLv2 or any later version
+// Refer to the license.txt file included.
+
+#include <random>
+#include <string>
+#include <vector>
+#include <catch2/catch.hpp>
+#include <fmt/format.h>
+#include "common/color.h"
+#include "common/thread_pool.h"
+#include "common/vector_math.h"
+#include "core/hw/gpu.h"
+#include "core/hw/gpu_transfer.h"
+#include "video_core/utils.h"
+
+namespace GPU {
+
+using PixelFormat = Regs::PixelFormat;
+using DisplayTransferConfig = Regs::DisplayTransferConfig;
+
+static constexpr PixelFormat pixel_formats[] = {
+    PixelFormat::RGBA8, PixelFormat::RGB8, PixelFormat::RGB565, PixelFormat::RGB5A1,
+    PixelFormat::RGBA4,
+};
+
+static Common::Vec4<u8> DecodePixel(PixelFormat format, const u8* pixel) {
+    switch (format) {
+    case PixelFormat::RGBA8:
+        return Color::DecodeRGBA8(pixel);
+    case PixelFormat::RGB8:
+        return Color::DecodeRGB8(pixel);
+    case PixelFormat::RGB565:
+        return Color::DecodeRGB565(pixel);
+    case PixelFormat::RGB5A1:
+        return Color::DecodeRGB5A1(pixel);
+    default:
+        return Color::DecodeRGBA4(pixel);
+    }
+}
+
+static void EncodePixel(PixelFormat format, const Common::Vec4<u8>& color, u8* pixel) {
+    switch (format) {
+    case PixelFormat::RGBA8:
+        return Color::EncodeRGBA8(color, pixel);
+    case PixelFormat::RGB8:
+        return Color::EncodeRGB8(color, pixel);
+    case PixelFormat::RGB565:
+        return Color::EncodeRGB565(color, pixel);
+    case PixelFormat::RGB5A1:
+        return Color::EncodeRGB5A1(color, pixel);
+    default:
+        return Color::EncodeRGBA4(color, pixel);
+    }
+}
+
+/// Display transfer as originally implemented in DisplayTransfer, one pixel at a time
+static void ReferenceTransfer(const DisplayTransferConfig& config, const u8* src_pointer,
+                              u8* dst_pointer) {
+    const int horizontal_scale = config.scaling != config.NoScale ? 1 : 0;
+    const int vertical_scale = config.scaling == config.ScaleXY ? 1 : 0;
+    const u32 output_width = config.output_width >> horizontal_scale;
+    const u32 output_height = config.output_height >> vertical_scale;
+    const u32 src_bytes_per_pixel = Regs::BytesPerPixel(config.input_format);
+    const u32 dst_bytes_per_pixel = Regs::BytesPerPixel(config.output_format);
+
+    for (u32 y = 0; y < output_height; ++y) {
+        for (u32 x = 0; x < output_width; ++x) {
+            const u32 input_x = x << horizontal_scale;
+            const u32 input_y = y << vertical_scale;
+            const u32 output_y = config.flip_vertically ? output_height - y - 1 : y;
+
+            u32 src_offset;
+            u32 dst_offset;
+            if (config.input_linear) {
+                src_offset = (input_x + input_y * config.input_width) * src_bytes_per_pixel;
+            } else {
+                src_offset = VideoCore::GetMortonOffset(input_x, input_y, src_bytes_per_pixel) +
+                             (input_y & ~7) * config.input_width * src_bytes_per_pixel;
+            }
+            if (config.input_linear == config.dont_swizzle) {
+                dst_offset = (x + output_y * output_width) * dst_bytes_per_pixel;
+            } else {
+                dst_offset = VideoCore::GetMortonOffset(x, output_y, dst_bytes_per_pixel) +
+                             (output_y & ~7) * output_width * dst_bytes_per_pixel;
+            }
+
+            const u8* src_pixel = src_pointer + src_offset;
+            Common::Vec4<u8> src_color = DecodePixel(config.input_format, src_pixel);
+            if (config.scaling == config.ScaleX) {
+                const Common::Vec4<u8> pixel =
+                    DecodePixel(config.input_format, src_pixel + src_bytes_per_pixel);
+                src_color = ((src_color + pixel) / 2).Cast<u8>();
+            } else if (config.scaling == config.ScaleXY) {
+                const Common::Vec4<u8> pixel1 =
+                    DecodePixel(config.input_format, src_pixel + 1 * src_bytes_per_pixel);
+                const Common::Vec4<u8> pixel2 =
+                    DecodePixel(config.input_format, src_pixel + 2 * src_bytes_per_pixel);
+                const Common::Vec4<u8> pixel3 =
+                    DecodePixel(config.input_format, src_pixel + 3 * src_bytes_per_pixel);
+                src_color = (((src_color + pixel1) + (pixel2 + pixel3)) / 4).Cast<u8>();
+            }
+            EncodePixel(config.output_format, src_color, dst_pointer + dst_offset);
+        }
+    }
+}
+
+static DisplayTransferConfig MakeConfig(PixelFormat input_format, PixelFormat output_format,
+                                        u32 input_width, u32 output_width, u32 output_height) {
+    DisplayTransferConfig config{};
+    config.input_width.Assign(input_width);
+    config.input_height.Assign(output_height * 2);
+    config.output_width.Assign(output_width);
+    config.output_height.Assign(output_height);
+    config.input_format.Assign(input_format);
+    config.output_format.Assign(output_format);
+    return config;
+}
+
+static std::string Describe(const DisplayTransferConfig& config) {
+    return fmt::format("{}x{} from {} wide, format {} to {}, linear {}, dont_swizzle {}, flip {}, "
+                       "scaling {}",
+                       config.output_width.Value(), config.output_height.Value(),
+                       config.input_width.Value(), static_cast<u32>(config.input_format.Value()),
+                       static_cast<u32>(config.output_format.Value()), config.input_linear.Value(),
+                       config.dont_swizzle.Value(), config.flip_vertically.Value(),
+                       static_cast<u32>(config.scaling.Value()));
+}
+
+static void CheckTransfer(const DisplayTransferConfig& config, Common::ThreadPool* pool) {
+    INFO(Describe(config));
+
+    std::mt19937 rng(config.output_size ^ config.flags);
+    std::vector<u8> src(config.input_width * config.input_height * 4);
+    for (u8& byte : src) {
+        byte = static_cast<u8>(rng());
+    }
+
+    // Both outputs start with the same contents, so that bytes neither writes compare equal
+    std::vector<u8> expected(config.output_width * config.output_height * 4);
+    for (u8& byte : expected) {
+        byte = static_cast<u8>(rng());
+    }
+    std::vector<u8> result = expected;
+
+    ReferenceTransfer(config, src.data(), expected.data());
+    PerformDisplayTransfer(config, src.data(), result.data(), pool);
+    REQUIRE(result == expected);
+}
+
+TEST_CASE("PerformDisplayTransfer", "[core][gpu]") {
+    Common::ThreadPool pool(4, "DisplayTransferTest");
+
+    for (const PixelFormat input_format : pixel_formats) {
+        for (const PixelFormat output_format : pixel_formats) {
+            for (u32 mode = 0; mode < 8; ++mode) {
+                DisplayTransferConfig config =
+                    MakeConfig(input_format, output_format, 48, 40, 24);
+                config.input_linear.Assign(mode & 1);
+                config.dont_swizzle.Assign((mode >> 1) & 1);
+                config.flip_vertically.Assign((mode >> 2) & 1);
+                CheckTransfer(config, nullptr);
+
+                // Linear input can't be scaled
+                if (!config.input_linear) {
+                    config.scaling.Assign(DisplayTransferConfig::ScaleX);
+                    CheckTransfer(config, nullptr);
+                    config.output_width.Assign(48);
+                    config.output_height.Assign(32);
+                    config.scaling.Assign(DisplayTransferConfig::ScaleXY);
+                    CheckTransfer(config, nullptr);
+                }
+            }
+        }
+    }
+
+    // Images large enough to be split across threads, and sizes of partial tiles
+    for (u32 mode = 0; mode < 8; ++mode) {
+        for (const auto& [input_width, output_width, output_height] :
+             {std::tuple{256u, 240u, 400u}, std::tuple{24u, 20u, 12u}}) {
+            DisplayTransferConfig config = MakeConfig(PixelFormat::RGBA8, PixelFormat::RGB8,
+                                                      input_width, output_width, output_height);
+            config.input_linear.Assign(mode & 1);
+            config.dont_swizzle.Assign((mode >> 1) & 1);
+            config.flip_vertically.Assign((mode >> 2) & 1);
+            CheckTransfer(config, &pool);
+        }
+    }
+}
+
+TEST_CASE("Display transfer benchmark", "[.][benchmark][gpu]") {
+    Common::ThreadPool pool(4, "DisplayTransferBenchmark");
+
+    // The top screen framebuffer copied out of a tiled color buffer, as games do every frame
+    DisplayTransferConfig config = MakeConfig(PixelFormat::RGBA8, PixelFormat::RGB8, 240, 240, 400);
+    // Large enough for the downscaling transfer at the end
+    std::vector<u8> src(480 * 800 * 4);
+    std::vector<u8> dst(config.output_width * config.output_height * 4);
+
+    BENCHMARK("Reference RGBA8 to RGB8") {
+        ReferenceTransfer(config, src.data(), dst.data());
+    };
+    BENCHMARK("RGBA8 to RGB8") {
+        PerformDisplayTransfer(config, src.data(), dst.data());
+    };
+    BENCHMARK("RGBA8 to RGB8 on 4 threads") {
+        PerformDisplayTransfer(config, src.data(), dst.data(), &pool);
+    };
+
+    config.output_format.Assign(PixelFormat::RGBA8);
+    BENCHMARK("Reference RGBA8 copy") {
+        ReferenceTransfer(config, src.data(), dst.data());
+    };
+    BENCHMARK("RGBA8 copy") {
+        PerformDisplayTransfer(config, src.data(), dst.data());
+    };
+
+    config.scaling.Assign(DisplayTransferConfig::ScaleXY);
+    config.input_width.Assign(480);
+    config.output_width.Assign(480);
+    config.output_height.Assign(800);
+    BENCHMARK("Reference RGBA8 downscale") {
+        ReferenceTransfer(config, src.data(), dst.data());
+    };
+    BENCHMARK("RGBA8 downscale") {
+        PerformDisplayTransfer(config, src.data(), dst.data());
+    };
+}
+
+} // namespace GPU
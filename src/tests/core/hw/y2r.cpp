@@ -0,0 +1,247 @@
+// Copyright 2020 Citra Emulator Project
+// Licensed under GPLv2 or any later version
+// Refer to the license.txt file included.
+
+#include <algorithm>
+#include <array>
+#include <memory>
+#include <random>
+#include <utility>
+#include <vector>
+#include <catch2/catch.hpp>
+#include "common/alignment.h"
+#include "common/hash.h"
+#include "common/memory_ref.h"
+#include "core/core_timing.h"
+#include "core/hle/kernel/kernel.h"
+#include "core/hle/kernel/memory.h"
+#include "core/hle/kernel/process.h"
+#include "core/hle/service/y2r_u.h"
+#include "core/hw/y2r.h"
+#include "core/memory.h"
+
+namespace HW::Y2R {
+
+using namespace Service::Y2R;
+
+constexpr VAddr BUFFER_VADDR = 0x10000000;
+constexpr u16 LINE_WIDTH = 32;
+constexpr u16 MAX_LINES = 24;
+/// Bytes skipped between two lines of every buffer, to check that the gaps are respected
+constexpr u16 LINE_GAP = 16;
+
+constexpr u32 PLANE_SIZE = MAX_LINES * (LINE_WIDTH * 2 + LINE_GAP);
+constexpr u32 SRC_Y_OFFSET = 0;
+constexpr u32 SRC_U_OFFSET = SRC_Y_OFFSET + PLANE_SIZE;
+constexpr u32 SRC_V_OFFSET = SRC_U_OFFSET + PLANE_SIZE;
+constexpr u32 SRC_YUYV_OFFSET = SRC_V_OFFSET + PLANE_SIZE;
+constexpr u32 DST_OFFSET = SRC_YUYV_OFFSET + PLANE_SIZE;
+constexpr u32 DST_SIZE = MAX_LINES * (LINE_WIDTH * 4 + LINE_GAP);
+constexpr u32 BUFFER_SIZE = DST_OFFSET + DST_SIZE;
+
+constexpr std::array<InputFormat, 5> input_formats{
+    InputFormat::YUV422_Indiv8,  InputFormat::YUV420_Indiv8,       InputFormat::YUV422_Indiv16,
+    InputFormat::YUV420_Indiv16, InputFormat::YUYV422_Interleaved,
+};
+constexpr std::array<OutputFormat, 4> output_formats{
+    OutputFormat::RGBA8,
+    OutputFormat::RGB8,
+    OutputFormat::RGB5A1,
+    OutputFormat::RGB565,
+};
+
+/**
+ * Hashes of the output of every rotation, block alignment and coefficient set, for each pair of
+ * input and output formats. These were produced by the original per-pixel implementation.
+ */
+constexpr std::array<std::array<u64, 4>, 5> golden_hashes{{
+    {{0xA6502BC8EF8E7A4B, 0x6B27BC9B2FE031A6, 0x9EA817ADD2A86965, 0x6DADF335721CE435}},
+    {{0xEA5442FA37FCCE2E, 0xDCD951EA52A41451, 0xA022B82ABFEDF260, 0x99FE0F3158F8B252}},
+    {{0x10CB896290023A00, 0xD8A0ACDC0C98A480, 0xB15E20A083BFE6A3, 0x05466A6911F4103A}},
+    {{0x9F33CD481BF0EA5D, 0xFDBBB41BA3CBBAFF, 0x1B421FA5B2277039, 0x9AC449C93BFE7FF9}},
+    {{0x57CFA6B32A18BC09, 0x515549E7706B0741, 0x0ED7CC67E296B772, 0xDEBA8E76A02BD6C2}},
+}};
+
+/// Layout of an image large enough for its strips to be converted on several threads
+constexpr u16 LARGE_LINE_WIDTH = 256;
+constexpr u16 LARGE_LINES = 240;
+constexpr u32 LARGE_PLANE_SIZE = LARGE_LINES * (LARGE_LINE_WIDTH * 2 + LINE_GAP);
+constexpr u32 LARGE_DST_OFFSET = 4 * LARGE_PLANE_SIZE;
+constexpr u32 LARGE_BUFFER_SIZE =
+    LARGE_DST_OFFSET + LARGE_LINES * (LARGE_LINE_WIDTH * 4 + LINE_GAP);
+
+static ConversionBuffer MakeBuffer(u32 offset, u16 line_size, u16 max_lines) {
+    ConversionBuffer buffer{};
+    buffer.address = BUFFER_VADDR + offset;
+    buffer.image_size = max_lines * line_size;
+    buffer.transfer_unit = line_size;
+    buffer.gap = LINE_GAP;
+    return buffer;
+}
+
+/**
+ * Sets up a conversion transferring one line per unit. The input planes are `plane_size` bytes
+ * apart and followed by the output.
+ */
+static ConversionConfiguration MakeConfiguration(InputFormat input_format,
+                                                 OutputFormat output_format, u16 line_width,
+                                                 u16 max_lines, u32 plane_size) {
+    const bool is_16bit =
+        input_format == InputFormat::YUV422_Indiv16 || input_format == InputFormat::YUV420_Indiv16;
+    const u16 input_unit = is_16bit ? 2 : 1;
+    const u16 chroma_unit = (input_format == InputFormat::YUV420_Indiv8 ||
+                             input_format == InputFormat::YUV420_Indiv16)
+                                ? input_unit * line_width / 4
+                                : input_unit * line_width / 2;
+    constexpr std::array<u16, 4> output_bytes_per_pixel{4, 3, 2, 2};
+
+    ConversionConfiguration cvt{};
+    cvt.input_format = input_format;
+    cvt.output_format = output_format;
+    cvt.input_line_width = line_width;
+    cvt.alpha = 0xC3;
+    cvt.src_Y = MakeBuffer(0, input_unit * line_width, max_lines);
+    cvt.src_U = MakeBuffer(plane_size, chroma_unit, max_lines);
+    cvt.src_V = MakeBuffer(2 * plane_size, chroma_unit, max_lines);
+    cvt.src_YUYV = MakeBuffer(3 * plane_size, 2 * line_width, max_lines);
+    cvt.dst = MakeBuffer(4 * plane_size,
+                         output_bytes_per_pixel[static_cast<std::size_t>(output_format)] *
+                             line_width,
+                         max_lines);
+    return cvt;
+}
+
+/// Converts the image in the buffer and returns the output area, including the gaps
+static std::vector<u8> Convert(Memory::MemorySystem& memory, u8* buffer, InputFormat input_format,
+                               OutputFormat output_format, Rotation rotation,
+                               BlockAlignment block_alignment, StandardCoefficient coefficient,
+                               u16 lines) {
+    ConversionConfiguration cvt =
+        MakeConfiguration(input_format, output_format, LINE_WIDTH, MAX_LINES, PLANE_SIZE);
+    cvt.rotation = rotation;
+    cvt.block_alignment = block_alignment;
+    cvt.input_lines = lines;
+    REQUIRE(cvt.SetStandardCoefficient(coefficient) == RESULT_SUCCESS);
+
+    std::fill(buffer + DST_OFFSET, buffer + BUFFER_SIZE, 0xEE);
+    PerformConversion(memory, cvt);
+    return std::vector<u8>(buffer + DST_OFFSET, buffer + BUFFER_SIZE);
+}
+
+static bool IsAtSamePosition(const ConversionBuffer& a, const ConversionBuffer& b) {
+    return a.address == b.address && a.image_size == b.image_size;
+}
+
+TEST_CASE("Y2R::PerformConversion", "[core][y2r]") {
+    Core::Timing timing(1, 100);
+    Memory::MemorySystem memory;
+    Kernel::KernelSystem kernel(
+        memory, timing, [] {}, 0, 1, 0);
+    auto process = kernel.CreateProcess(kernel.CreateCodeSet("", 0));
+    auto mem = std::make_shared<BufferMem>(Common::AlignUp(BUFFER_SIZE, Memory::PAGE_SIZE));
+    MemoryRef buffer{mem};
+    REQUIRE(process->vm_manager
+                .MapBackingMemory(BUFFER_VADDR, buffer, buffer.GetSize(),
+                                  Kernel::MemoryState::Private)
+                .Code() == RESULT_SUCCESS);
+    kernel.SetCurrentProcess(process);
+
+    std::mt19937 rng(0x59325232);
+    std::generate(buffer.GetPtr(), buffer.GetPtr() + DST_OFFSET,
+                  [&rng] { return static_cast<u8>(rng()); });
+
+    for (std::size_t i = 0; i < input_formats.size(); ++i) {
+        for (std::size_t o = 0; o < output_formats.size(); ++o) {
+            INFO("Input format " << i << ", output format " << o);
+
+            std::vector<u8> outputs;
+            for (u8 rotation = 0; rotation < 4; ++rotation) {
+                for (const auto& [block_alignment, lines] :
+                     {std::pair{BlockAlignment::Linear, MAX_LINES},
+                      std::pair{BlockAlignment::Linear, static_cast<u16>(12)},
+                      std::pair{BlockAlignment::Block8x8, MAX_LINES}}) {
+                    for (const StandardCoefficient coefficient :
+                         {StandardCoefficient::ITU_Rec601,
+                          StandardCoefficient::ITU_Rec709_Scaling}) {
+                        const std::vector<u8> output =
+                            Convert(memory, buffer.GetPtr(), input_formats[i], output_formats[o],
+                                    static_cast<Rotation>(rotation), block_alignment, coefficient,
+                                    lines);
+                        outputs.insert(outputs.end(), output.begin(), output.end());
+                    }
+                }
+            }
+
+            CHECK(Common::ComputeHash64(outputs.data(), outputs.size()) == golden_hashes[i][o]);
+        }
+    }
+}
+
+TEST_CASE("Y2R::PerformConversion of large images", "[core][y2r]") {
+    Core::Timing timing(1, 100);
+    Memory::MemorySystem memory;
+    Kernel::KernelSystem kernel(
+        memory, timing, [] {}, 0, 1, 0);
+    auto process = kernel.CreateProcess(kernel.CreateCodeSet("", 0));
+    auto mem = std::make_shared<BufferMem>(Common::AlignUp(LARGE_BUFFER_SIZE, Memory::PAGE_SIZE));
+    MemoryRef buffer{mem};
+    REQUIRE(process->vm_manager
+                .MapBackingMemory(BUFFER_VADDR, buffer, buffer.GetSize(),
+                                  Kernel::MemoryState::Private)
+                .Code() == RESULT_SUCCESS);
+    kernel.SetCurrentProcess(process);
+
+    std::mt19937 rng(0x4C524745);
+    std::generate(buffer.GetPtr(), buffer.GetPtr() + LARGE_DST_OFFSET,
+                  [&rng] { return static_cast<u8>(rng()); });
+
+    u8* const output_begin = buffer.GetPtr() + LARGE_DST_OFFSET;
+    u8* const output_end = buffer.GetPtr() + LARGE_BUFFER_SIZE;
+
+    // Converting the image one strip at a time never splits it, which gives the reference output
+    // and the positions the buffers have to end up at
+    for (const InputFormat input_format : input_formats) {
+        for (const OutputFormat output_format : output_formats) {
+            for (u8 rotation = 0; rotation < 4; ++rotation) {
+                for (const auto& [block_alignment, lines] :
+                     {std::pair{BlockAlignment::Linear, LARGE_LINES},
+                      std::pair{BlockAlignment::Linear, static_cast<u16>(LARGE_LINES - 4)},
+                      std::pair{BlockAlignment::Block8x8, LARGE_LINES}}) {
+                    INFO("Input format " << static_cast<int>(input_format) << ", output format "
+                                         << static_cast<int>(output_format) << ", rotation "
+                                         << static_cast<int>(rotation) << ", "
+                                         << lines << " lines");
+
+                    ConversionConfiguration cvt =
+                        MakeConfiguration(input_format, output_format, LARGE_LINE_WIDTH,
+                                          LARGE_LINES, LARGE_PLANE_SIZE);
+                    cvt.rotation = static_cast<Rotation>(rotation);
+                    cvt.block_alignment = block_alignment;
+                    REQUIRE(cvt.SetStandardCoefficient(StandardCoefficient::ITU_Rec601) ==
+                            RESULT_SUCCESS);
+
+                    ConversionConfiguration sequential = cvt;
+                    std::fill(output_begin, output_end, 0xEE);
+                    for (u16 y = 0; y < lines; y += 8) {
+                        sequential.input_lines = std::min<u16>(lines - y, 8);
+                        PerformConversion(memory, sequential);
+                    }
+                    const std::vector<u8> expected(output_begin, output_end);
+
+                    cvt.input_lines = lines;
+                    std::fill(output_begin, output_end, 0xEE);
+                    PerformConversion(memory, cvt);
+
+                    CHECK(std::equal(output_begin, output_end, expected.begin()));
+                    CHECK(IsAtSamePosition(cvt.src_Y, sequential.src_Y));
+                    CHECK(IsAtSamePosition(cvt.src_U, sequential.src_U));
+                    CHECK(IsAtSamePosition(cvt.src_V, sequential.src_V));
+                    CHECK(IsAtSamePosition(cvt.src_YUYV, sequential.src_YUYV));
+                    CHECK(IsAtSamePosition(cvt.dst, sequential.dst));
+                }
+            }
+        }
+    }
+}
+
+} // namespace HW::Y2R
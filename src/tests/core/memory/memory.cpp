@@ -55,3 +55,56 @@ TEST_CASE("Memory::IsValidVirtualAddress", "[core][memory]") {
         CHECK(Memory::IsValidVirtualAddress(*process, Memory::CONFIG_MEMORY_VADDR) == false);
     }
 }
+
+TEST_CASE("Memory::RasterizerMarkRegionCached", "[core][memory]") {
+    Core::Timing timing(1, 100);
+    Memory::MemorySystem memory;
+    Kernel::KernelSystem kernel(
+        memory, timing, [] {}, 0, 1, 0);
+
+    auto process = kernel.CreateProcess(kernel.CreateCodeSet("", 0));
+    kernel.HandleSpecialMapping(process->vm_manager,
+                                {Memory::VRAM_VADDR, Memory::VRAM_SIZE, false, false});
+    auto& page_table = *process->vm_manager.page_table;
+    const u32 first_page = Memory::VRAM_VADDR >> Memory::PAGE_BITS;
+
+    // Marks the second and third page of VRAM
+    memory.RasterizerMarkRegionCached(Memory::VRAM_PADDR + Memory::PAGE_SIZE + 0x10,
+                                      Memory::PAGE_SIZE, true);
+    CHECK(page_table.attributes[first_page] == Memory::PageType::Memory);
+    CHECK(page_table.attributes[first_page + 1] == Memory::PageType::RasterizerCachedMemory);
+    CHECK(page_table.attributes[first_page + 2] == Memory::PageType::RasterizerCachedMemory);
+    CHECK(page_table.attributes[first_page + 3] == Memory::PageType::Memory);
+    const u8* pointer = page_table.pointers[first_page + 1];
+    CHECK(pointer == nullptr);
+    CHECK(Memory::IsValidVirtualAddress(*process, Memory::VRAM_VADDR + Memory::PAGE_SIZE));
+
+    SECTION("pages mapped later are marked as well") {
+        auto other_process = kernel.CreateProcess(kernel.CreateCodeSet("", 0));
+        kernel.HandleSpecialMapping(other_process->vm_manager,
+                                    {Memory::VRAM_VADDR, Memory::VRAM_SIZE, false, false});
+        auto& other_page_table = *other_process->vm_manager.page_table;
+        CHECK(other_page_table.attributes[first_page + 1] ==
+              Memory::PageType::RasterizerCachedMemory);
+
+        memory.RasterizerMarkRegionCached(Memory::VRAM_PADDR, Memory::VRAM_SIZE, false);
+        CHECK(other_page_table.attributes[first_page + 1] == Memory::PageType::Memory);
+        pointer = other_page_table.pointers[first_page + 1];
+        CHECK(pointer != nullptr);
+    }
+
+    SECTION("unmarking restores the pages") {
+        memory.RasterizerMarkRegionCached(Memory::VRAM_PADDR + Memory::PAGE_SIZE,
+                                          Memory::PAGE_SIZE * 2, false);
+        CHECK(page_table.attributes[first_page + 1] == Memory::PageType::Memory);
+        CHECK(page_table.attributes[first_page + 2] == Memory::PageType::Memory);
+        pointer = page_table.pointers[first_page + 1];
+        CHECK(pointer == memory.GetPhysicalPointer(Memory::VRAM_PADDR + Memory::PAGE_SIZE));
+    }
+
+    SECTION("unmapped pages are left alone") {
+        process->vm_manager.UnmapRange(Memory::VRAM_VADDR, Memory::VRAM_SIZE);
+        memory.RasterizerMarkRegionCached(Memory::VRAM_PADDR, Memory::VRAM_SIZE, false);
+        CHECK(page_table.attributes[first_page + 1] == Memory::PageType::Unmapped);
+    }
+}
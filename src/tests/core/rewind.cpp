@@ -0,0 +1,132 @@
+// Copyright 2020 Citra Emulator Project
+// Licensed under GPLv2 or any later version
+// Refer to the license.txt file included.
+
+#include <chrono>
+#include <random>
+#include <thread>
+#include <vector>
+#include <catch2/catch.hpp>
+#include "common/common_types.h"
+#include "core/rewind.h"
+
+namespace Core {
+
+constexpr std::size_t STATE_SIZE = 64 * 1024;
+
+/// Generates a sequence of states, each differing from the previous one in a few places
+static std::vector<std::vector<u8>> GenerateStates(std::size_t count) {
+    std::mt19937 rng(0x52455749);
+    std::vector<u8> state(STATE_SIZE);
+    for (u8& byte : state) {
+        byte = static_cast<u8>(rng());
+    }
+
+    std::vector<std::vector<u8>> states;
+    for (std::size_t i = 0; i < count; ++i) {
+        for (int change = 0; change < 16; ++change) {
+            state[rng() % STATE_SIZE] = static_cast<u8>(rng());
+        }
+        states.push_back(state);
+    }
+    return states;
+}
+
+static void WaitUntilIdle(const RewindBuffer& buffer) {
+    while (buffer.IsBusy()) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+}
+
+TEST_CASE("RewindBuffer restores snapshots across keyframes", "[core][rewind]") {
+    const auto states = GenerateStates(RewindBuffer::KeyframeInterval * 2 + 5);
+    RewindBuffer buffer(states.size() * STATE_SIZE * 2);
+
+    for (const auto& state : states) {
+        buffer.Push(state);
+    }
+    WaitUntilIdle(buffer);
+    REQUIRE(buffer.GetSnapshotCount() == states.size());
+    REQUIRE(buffer.GetLastStateSize() == STATE_SIZE);
+
+    // The deltas only store the differences to the previous snapshot
+    REQUIRE(buffer.GetSize() < STATE_SIZE * 4);
+
+    // Each Pop has to decode the previous state from its keyframe through all deltas following it
+    for (auto it = states.rbegin(); it != states.rend(); ++it) {
+        const auto state = buffer.Pop();
+        REQUIRE(state != nullptr);
+        REQUIRE(*state == *it);
+    }
+    REQUIRE(buffer.GetSnapshotCount() == 0);
+    REQUIRE(buffer.Pop() == nullptr);
+}
+
+TEST_CASE("RewindBuffer continues the chain after rewinding", "[core][rewind]") {
+    const auto states = GenerateStates(RewindBuffer::KeyframeInterval + 8);
+    RewindBuffer buffer(states.size() * STATE_SIZE * 2);
+
+    // Rewind into the middle of the deltas of the second keyframe, then take new snapshots
+    const std::size_t first_count = RewindBuffer::KeyframeInterval + 4;
+    for (std::size_t i = 0; i < first_count; ++i) {
+        buffer.Push(states[i]);
+    }
+    for (std::size_t i = 0; i < 2; ++i) {
+        REQUIRE(*buffer.Pop() == states[first_count - 1 - i]);
+    }
+    std::vector<std::vector<u8>> expected(states.begin(), states.begin() + first_count - 2);
+    for (std::size_t i = first_count; i < states.size(); ++i) {
+        buffer.Push(states[i]);
+        expected.push_back(states[i]);
+    }
+
+    WaitUntilIdle(buffer);
+    REQUIRE(buffer.GetSnapshotCount() == expected.size());
+    for (auto it = expected.rbegin(); it != expected.rend(); ++it) {
+        const auto state = buffer.Pop();
+        REQUIRE(state != nullptr);
+        REQUIRE(*state == *it);
+    }
+    REQUIRE(buffer.Pop() == nullptr);
+}
+
+TEST_CASE("RewindBuffer evicts keyframes along with their deltas", "[core][rewind]") {
+    const std::size_t count = RewindBuffer::KeyframeInterval * 2 + 5;
+    const auto states = GenerateStates(count);
+    // Room for one keyframe of incompressible data and some deltas, but not for two keyframes
+    RewindBuffer buffer(STATE_SIZE * 3 / 2);
+
+    for (const auto& state : states) {
+        buffer.Push(state);
+    }
+    WaitUntilIdle(buffer);
+
+    // Only the most recent keyframe and the deltas following it are left
+    const std::size_t kept = count % RewindBuffer::KeyframeInterval;
+    REQUIRE(buffer.GetSnapshotCount() == kept);
+    REQUIRE(buffer.GetSize() <= STATE_SIZE * 3 / 2);
+    for (std::size_t i = 0; i < kept; ++i) {
+        const auto state = buffer.Pop();
+        REQUIRE(state != nullptr);
+        REQUIRE(*state == states[count - 1 - i]);
+    }
+    REQUIRE(buffer.Pop() == nullptr);
+}
+
+TEST_CASE("RewindBuffer keeps the most recent keyframe over capacity", "[core][rewind]") {
+    const auto states = GenerateStates(3);
+    RewindBuffer buffer(STATE_SIZE / 2);
+
+    for (const auto& state : states) {
+        buffer.Push(state);
+    }
+    WaitUntilIdle(buffer);
+
+    REQUIRE(buffer.GetSnapshotCount() == states.size());
+    REQUIRE(buffer.GetSize() > STATE_SIZE / 2);
+    for (auto it = states.rbegin(); it != states.rend(); ++it) {
+        REQUIRE(*buffer.Pop() == *it);
+    }
+}
+
+} // namespace Core
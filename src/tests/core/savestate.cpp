@@ -0,0 +1,353 @@
+// Copyright 2020 Citra Emulator Project
+// Licensed under GPLv2 or any later version
+// Refer to the license.txt file included.
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <functional>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <catch2/catch.hpp>
+#include <fmt/format.h>
+#include "common/archives.h"
+#include "common/file_util.h"
+#include "common/zstd_compression.h"
+#include "core/core_timing.h"
+#include "core/hle/kernel/kernel.h"
+#include "core/hle/kernel/process.h"
+#include "core/hw/gpu.h"
+#include "core/hw/lcd.h"
+#include "core/memory.h"
+#include "core/savestate.h"
+
+namespace Core {
+
+TEST_CASE("SaveStateProfiler::Sections", "[core][savestate]") {
+    std::stringbuf target;
+
+    SaveStateProfiler writer;
+    writer.SetTarget(target);
+    std::ostream out(&writer);
+    out.write("abc", 3);
+    writer.BeginSection("First");
+    out.write("defgh", 5);
+    out.put('i');
+    writer.BeginSection("Second");
+    writer.TimeTarget([&writer] {
+        writer.AddIo(4, {});
+        return true;
+    });
+    const SaveStateStats write_stats = writer.Finish();
+
+    REQUIRE(out);
+    REQUIRE(target.str() == "abcdefghi");
+    REQUIRE(write_stats.sections.size() == 3);
+    REQUIRE(write_stats.sections[0].name == "Archive");
+    REQUIRE(write_stats.sections[0].size == 3);
+    REQUIRE(write_stats.sections[1].name == "First");
+    REQUIRE(write_stats.sections[1].size == 6);
+    REQUIRE(write_stats.sections[2].name == "Second");
+    REQUIRE(write_stats.sections[2].size == 0);
+    REQUIRE(write_stats.compressed_size == 4);
+
+    SaveStateProfiler reader;
+    reader.SetTarget(target);
+    std::istream in(&reader);
+    char data[5]{};
+    in.read(data, 4);
+    REQUIRE(std::string(data, 4) == "abcd");
+    reader.BeginSection("Rest");
+    REQUIRE(in.peek() == 'e');
+    REQUIRE(in.get() == 'e');
+    in.read(data, 5);
+    REQUIRE(in.gcount() == 4);
+    REQUIRE(std::string(data, 4) == "fghi");
+    const SaveStateStats read_stats = reader.Finish();
+
+    REQUIRE(read_stats.sections.size() == 2);
+    REQUIRE(read_stats.sections[0].size == 4);
+    REQUIRE(read_stats.sections[1].name == "Rest");
+    REQUIRE(read_stats.sections[1].size == 5);
+}
+
+TEST_CASE("SaveStateProfiler::WorkerTime", "[core][savestate]") {
+    using namespace std::chrono_literals;
+
+    SaveStateProfiler profiler;
+    // Stands in for a compression worker, spinning so that it consumes CPU time
+    std::thread worker([] {
+        const auto end = SaveStateProfiler::Clock::now() + 50ms;
+        while (SaveStateProfiler::Clock::now() < end) {
+        }
+    });
+    worker.join();
+    const SaveStateStats stats = profiler.Finish();
+
+    REQUIRE(stats.worker_time >= 25ms);
+}
+
+/// Stands in for the emulation state, of which delta states only store the changed pages
+class DeltaTestState {
+public:
+    static constexpr std::size_t PageSize = 256;
+    static constexpr std::size_t NumPages = 64;
+
+    std::vector<u8> data = std::vector<u8>(PageSize * NumPages);
+
+    /// Saves the state, or only the pages changed since the last save or load if `delta` is set
+    void Save(std::ostream& stream, bool delta) {
+        stream.put(delta ? 1 : 0);
+        for (u8 page = 0; page < NumPages; ++page) {
+            const u8* contents = data.data() + page * PageSize;
+            const u8* previous = reference.data() + page * PageSize;
+            if (!delta || !std::equal(contents, contents + PageSize, previous)) {
+                stream.put(static_cast<char>(page));
+                stream.write(reinterpret_cast<const char*>(contents), PageSize);
+            }
+        }
+        reference = data;
+    }
+
+    void Load(std::istream& stream) {
+        const bool delta = stream.get() != 0;
+        std::vector<u8> loaded = delta ? data : std::vector<u8>(data.size());
+        for (int page = stream.get(); page != std::istream::traits_type::eof();
+             page = stream.get()) {
+            REQUIRE(static_cast<std::size_t>(page) < NumPages);
+            stream.read(reinterpret_cast<char*>(loaded.data() + page * PageSize), PageSize);
+            REQUIRE(stream);
+        }
+        data = loaded;
+        reference = data;
+    }
+
+    /// Forgets the loaded state, as if the emulation was restarted
+    void Reset() {
+        std::fill(data.begin(), data.end(), 0);
+        reference.clear();
+    }
+
+    SaveStateWriter Writer(bool delta) {
+        return [this, delta](std::ostream& stream, SaveStateProfiler&) { Save(stream, delta); };
+    }
+
+    SaveStateReader Reader() {
+        return [this](std::istream& stream, SaveStateProfiler&) { Load(stream); };
+    }
+
+private:
+    std::vector<u8> reference;
+};
+
+TEST_CASE("CompactSaveState folds a delta chain into a full state", "[core][savestate]") {
+    // Not a real title, so that no actual savestates are touched
+    constexpr u64 program_id = 0x00040000FFFFFF00;
+    const auto delete_states = [] {
+        for (u32 slot = 1; slot <= SaveStateSlotCount; ++slot) {
+            FileUtil::Delete(GetSaveStatePath(program_id, slot));
+        }
+    };
+    delete_states();
+
+    std::mt19937 rng(0x434F4D50);
+    DeltaTestState state;
+    std::generate(state.data.begin(), state.data.end(), [&rng] { return static_cast<u8>(rng()); });
+    const auto change_pages = [&state, &rng] {
+        for (int i = 0; i < 4; ++i) {
+            state.data[rng() % state.data.size()] = static_cast<u8>(rng());
+        }
+    };
+
+    // Slot 1 holds the full state, slot 2 a delta against it and slot 3 a delta against slot 2
+    WriteSaveState(program_id, 1, 100, 1001, 0, 0, state.Writer(false));
+    change_pages();
+    WriteSaveState(program_id, 2, 200, 1002, 1, 1001, state.Writer(true));
+    change_pages();
+    WriteSaveState(program_id, 3, 300, 1003, 2, 1002, state.Writer(true));
+    const std::vector<u8> expected = state.data;
+    const u64 delta_size = FileUtil::GetSize(GetSaveStatePath(program_id, 3));
+
+    state.Reset();
+    const SaveStateResult compacted =
+        CompactSaveState(program_id, 3, state.Reader(), state.Writer(false));
+    REQUIRE(state.data == expected);
+    REQUIRE(compacted.time == 300);
+    REQUIRE(compacted.id == 1003);
+    REQUIRE(FileUtil::GetSize(GetSaveStatePath(program_id, 3)) > delta_size);
+
+    const auto states = ListSaveStates(program_id);
+    REQUIRE(states.size() == 3);
+    REQUIRE(!states[2].delta);
+    REQUIRE(states[2].time == 300);
+
+    // The compacted state no longer needs the states it was based on
+    FileUtil::Delete(GetSaveStatePath(program_id, 1));
+    FileUtil::Delete(GetSaveStatePath(program_id, 2));
+    state.Reset();
+    const SaveStateResult loaded = LoadSaveState(program_id, 3, state.Reader());
+    REQUIRE(state.data == expected);
+    REQUIRE(loaded.id == 1003);
+
+    // Delta states based on the compacted state are still valid, as it kept its identifier
+    change_pages();
+    WriteSaveState(program_id, 4, 400, 1004, 3, 1003, state.Writer(true));
+    const std::vector<u8> expected_delta = state.data;
+    state.Reset();
+    LoadSaveState(program_id, 4, state.Reader());
+    REQUIRE(state.data == expected_delta);
+
+    delete_states();
+}
+
+TEST_CASE("LoadSaveState rejects corrupted states", "[core][savestate]") {
+    constexpr u64 program_id = 0x00040000FFFFFF01;
+    const std::string path = GetSaveStatePath(program_id, 1);
+
+    std::mt19937 rng(0x434F5252);
+    DeltaTestState state;
+    std::generate(state.data.begin(), state.data.end(), [&rng] { return static_cast<u8>(rng()); });
+    WriteSaveState(program_id, 1, 100, 1001, 0, 0, state.Writer(false));
+
+    // Flip some bytes in the middle of the compressed state, well past the header
+    std::vector<u8> contents(FileUtil::GetSize(path));
+    {
+        FileUtil::IOFile file(path, "rb");
+        REQUIRE(file.ReadBytes(contents.data(), contents.size()) == contents.size());
+    }
+    for (std::size_t i = contents.size() / 2; i < contents.size() / 2 + 16; ++i) {
+        contents[i] = static_cast<u8>(~contents[i]);
+    }
+    {
+        FileUtil::IOFile file(path, "wb");
+        REQUIRE(file.WriteBytes(contents.data(), contents.size()) == contents.size());
+    }
+
+    state.Reset();
+    REQUIRE_THROWS_AS(LoadSaveState(program_id, 1, state.Reader()), std::runtime_error);
+
+    FileUtil::Delete(path);
+}
+
+static std::string Serialize(const std::function<void(oarchive&)>& save) {
+    std::ostringstream stream;
+    {
+        oarchive oa{stream};
+        save(oa);
+    }
+    return stream.str();
+}
+
+static std::vector<u8> Compress(const std::string& state) {
+    std::vector<u8> compressed;
+    Common::Compression::ZSTDCompressStreamBuf buffer(
+        [&compressed](const u8* data, std::size_t size) {
+            compressed.insert(compressed.end(), data, data + size);
+            return true;
+        },
+        std::thread::hardware_concurrency());
+    buffer.sputn(state.data(), static_cast<std::streamsize>(state.size()));
+    buffer.Finish();
+    return compressed;
+}
+
+static std::string Decompress(const std::vector<u8>& compressed, std::size_t size) {
+    std::size_t position = 0;
+    Common::Compression::ZSTDDecompressStreamBuf buffer([&](u8* data, std::size_t max_size) {
+        const std::size_t read = std::min(max_size, compressed.size() - position);
+        std::memcpy(data, compressed.data() + position, read);
+        position += read;
+        return read;
+    });
+    std::string state(size, '\0');
+    state.resize(static_cast<std::size_t>(
+        buffer.sgetn(state.data(), static_cast<std::streamsize>(state.size()))));
+    return state;
+}
+
+/**
+ * Measures each stage of saving and loading the state of a subsystem the way
+ * System::SaveState and System::LoadState do. The sizes are part of the benchmark names.
+ */
+static void BenchmarkSubsystem(const std::string& name,
+                               const std::function<void(oarchive&)>& save,
+                               const std::function<void(iarchive&)>& load = nullptr) {
+    const std::string state = Serialize(save);
+    const std::vector<u8> compressed = Compress(state);
+    REQUIRE(Decompress(compressed, state.size()) == state);
+
+    const std::string path = "savestate_benchmark.tmp";
+    {
+        FileUtil::IOFile file(path, "wb");
+        REQUIRE(file.WriteBytes(compressed.data(), compressed.size()) == compressed.size());
+    }
+
+    const std::string label =
+        fmt::format("{} ({} bytes, {} compressed)", name, state.size(), compressed.size());
+
+    BENCHMARK("Serialize " + label) {
+        return Serialize(save);
+    };
+    BENCHMARK("Compress " + label) {
+        return Compress(state);
+    };
+    BENCHMARK("Write " + label) {
+        FileUtil::IOFile file(path, "wb");
+        return file.WriteBytes(compressed.data(), compressed.size());
+    };
+    BENCHMARK("Read " + label) {
+        std::vector<u8> data(compressed.size());
+        FileUtil::IOFile file(path, "rb");
+        file.ReadBytes(data.data(), data.size());
+        return data;
+    };
+    BENCHMARK("Decompress " + label) {
+        return Decompress(compressed, state.size());
+    };
+    if (load) {
+        BENCHMARK("Deserialize " + label) {
+            std::istringstream stream(state);
+            iarchive ia{stream};
+            load(ia);
+        };
+    }
+
+    FileUtil::Delete(path);
+}
+
+TEST_CASE("Savestate benchmark", "[.][benchmark][savestate]") {
+    Timing timing(1, 100);
+    Memory::MemorySystem memory;
+    Kernel::KernelSystem kernel(
+        memory, timing, [] {}, 0, 1, 0);
+    kernel.SetCurrentProcess(kernel.CreateProcess(kernel.CreateCodeSet("", 0)));
+
+    // Fill half of FCRAM with a mix of poorly and well compressible data, leaving the rest empty
+    u8* fcram = memory.GetFCRAMPointer(0);
+    for (std::size_t offset = 0; offset < Memory::FCRAM_SIZE / 2; offset += sizeof(u32)) {
+        const u32 value = offset % 0x1000 < 0x400 ? static_cast<u32>(offset * 0x9E3779B1)
+                                                  : static_cast<u32>(offset / 0x1000);
+        std::memcpy(fcram + offset, &value, sizeof(value));
+    }
+
+    // Loading the timing, memory and kernel state resolves the objects it references through
+    // Core::System, which isn't running here, so only saving them is measured
+    BenchmarkSubsystem("Timing", [&timing](oarchive& ar) { ar& timing; });
+    BenchmarkSubsystem("Memory", [&memory](oarchive& ar) { ar& memory; });
+    BenchmarkSubsystem("Kernel", [&kernel](oarchive& ar) { ar& kernel; });
+    BenchmarkSubsystem(
+        "GPU",
+        [](oarchive& ar) {
+            ar& GPU::g_regs;
+            ar& LCD::g_regs;
+        },
+        [](iarchive& ar) {
+            ar& GPU::g_regs;
+            ar& LCD::g_regs;
+        });
+}
+
+} // namespace Core
@@ -0,0 +1,344 @@
+// Copyright 2020 Citra Emulator Project
+// Licensed under GPLv2 or any later version
+// Refer to the license.txt file included.
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <memory>
+#include <random>
+#include <vector>
+#include <catch2/catch.hpp>
+#include <nihstro/inline_assembly.h>
+#include "video_core/shader/shader_jit_batch_x64_compiler.h"
+#include "video_core/shader/shader_jit_x64_compiler.h"
+
+using float24 = Pica::float24;
+using BatchUnitState = Pica::Shader::BatchUnitState;
+using JitBatchShader = Pica::Shader::JitBatchShader;
+using JitShader = Pica::Shader::JitShader;
+
+using DestRegister = nihstro::DestRegister;
+using OpCode = nihstro::OpCode;
+using SourceRegister = nihstro::SourceRegister;
+
+using LaneValues = std::array<float, BatchUnitState::NUM_LANES>;
+
+static std::unique_ptr<JitBatchShader> CompileShader(
+    std::initializer_list<nihstro::InlineAsm> code) {
+    const auto shbin = nihstro::InlineAsm::CompileToRawBinary(code);
+
+    std::array<u32, Pica::Shader::MAX_PROGRAM_CODE_LENGTH> program_code{};
+    std::array<u32, Pica::Shader::MAX_SWIZZLE_DATA_LENGTH> swizzle_data{};
+
+    std::transform(shbin.program.begin(), shbin.program.end(), program_code.begin(),
+                   [](const auto& x) { return x.hex; });
+    std::transform(shbin.swizzle_table.begin(), shbin.swizzle_table.end(), swizzle_data.begin(),
+                   [](const auto& x) { return x.hex; });
+
+    auto shader = std::make_unique<JitBatchShader>();
+    if (!shader->Compile(&program_code, &swizzle_data, 0)) {
+        return nullptr;
+    }
+
+    return shader;
+}
+
+class ShaderTest {
+public:
+    explicit ShaderTest(std::initializer_list<nihstro::InlineAsm> code)
+        : shader(CompileShader(code)) {}
+
+    LaneValues Run(const LaneValues& inputs) {
+        Pica::Shader::ShaderSetup shader_setup;
+        std::array<Pica::Shader::UnitState, BatchUnitState::NUM_LANES> shader_units;
+
+        for (std::size_t lane = 0; lane < inputs.size(); ++lane) {
+            shader_units[lane].registers.input[0].x = float24::FromFloat32(inputs[lane]);
+        }
+
+        REQUIRE(shader->Run(shader_setup, shader_units.data()));
+
+        LaneValues outputs;
+        for (std::size_t lane = 0; lane < outputs.size(); ++lane) {
+            outputs[lane] = shader_units[lane].registers.output[0].x.ToFloat32();
+        }
+        return outputs;
+    }
+
+public:
+    std::unique_ptr<JitBatchShader> shader;
+};
+
+TEST_CASE("Batch LG2", "[video_core][shader][shader_jit]") {
+    const auto sh_input = SourceRegister::MakeInput(0);
+    const auto sh_output = DestRegister::MakeOutput(0);
+
+    auto shader = ShaderTest({
+        // clang-format off
+        {OpCode::Id::LG2, sh_output, sh_input},
+        {OpCode::Id::END},
+        // clang-format on
+    });
+    REQUIRE(shader.shader != nullptr);
+
+    const LaneValues results = shader.Run({NAN, 0.f, 4.f, 1.e24f});
+    REQUIRE(std::isnan(results[0]));
+    REQUIRE(std::isinf(results[1]));
+    REQUIRE(results[2] == Approx(2.f));
+    REQUIRE(results[3] == Approx(79.7262742773f));
+}
+
+TEST_CASE("Batch EX2", "[video_core][shader][shader_jit]") {
+    const auto sh_input = SourceRegister::MakeInput(0);
+    const auto sh_output = DestRegister::MakeOutput(0);
+
+    auto shader = ShaderTest({
+        // clang-format off
+        {OpCode::Id::EX2, sh_output, sh_input},
+        {OpCode::Id::END},
+        // clang-format on
+    });
+    REQUIRE(shader.shader != nullptr);
+
+    const LaneValues results = shader.Run({-800.f, 0.f, 6.f, 800.f});
+    REQUIRE(results[0] == Approx(0.f));
+    REQUIRE(results[1] == Approx(1.f));
+    REQUIRE(results[2] == Approx(64.f));
+    REQUIRE(std::isinf(results[3]));
+}
+
+TEST_CASE("Batch RCP", "[video_core][shader][shader_jit]") {
+    const auto sh_input = SourceRegister::MakeInput(0);
+    const auto sh_output = DestRegister::MakeOutput(0);
+
+    auto shader = ShaderTest({
+        // clang-format off
+        {OpCode::Id::RCP, sh_output, sh_input},
+        {OpCode::Id::END},
+        // clang-format on
+    });
+    REQUIRE(shader.shader != nullptr);
+
+    const LaneValues results = shader.Run({1.f, 2.f, -4.f, 0.5f});
+    REQUIRE(results[0] == Approx(1.f).epsilon(0.001));
+    REQUIRE(results[1] == Approx(0.5f).epsilon(0.001));
+    REQUIRE(results[2] == Approx(-0.25f).epsilon(0.001));
+    REQUIRE(results[3] == Approx(2.f).epsilon(0.001));
+}
+
+// The tests below encode their programs by hand, all instructions using operand descriptor 0,
+// which enables all destination components and leaves the sources unswizzled. Only the first
+// source of the common instruction format can address uniforms.
+constexpr u32 IDENTITY_SWIZZLE = 0xF | (0x1B << 5) | (0x1B << 14) | (0x1B << 23);
+
+constexpr u32 INPUT(u32 index) {
+    return index;
+}
+constexpr u32 TEMPORARY(u32 index) {
+    return 0x10 + index;
+}
+constexpr u32 UNIFORM(u32 index) {
+    return 0x20 + index;
+}
+constexpr u32 OUTPUT(u32 index) {
+    return index;
+}
+
+static u32 Arithmetic(OpCode::Id opcode, u32 dest, u32 src1, u32 src2 = 0) {
+    return static_cast<u32>(opcode) << 26 | dest << 21 | src1 << 12 | src2 << 7;
+}
+
+static u32 Mad(u32 dest, u32 src1, u32 src2, u32 src3) {
+    return 0x7u << 29 | dest << 24 | src1 << 17 | src2 << 10 | src3 << 5;
+}
+
+/// Sets the components of the conditional code to `src1 > src2`
+static u32 CompareGreaterThan(u32 src1, u32 src2) {
+    constexpr u32 GREATER_THAN = 4;
+    return 0x17u << 27 | GREATER_THAN << 24 | GREATER_THAN << 21 | src1 << 12 | src2 << 7;
+}
+
+/// Encodes a flow control instruction whose condition is the x component of the conditional code
+static u32 FlowControlIfX(OpCode::Id opcode, u32 dest_offset, u32 num_instructions = 0) {
+    const u32 just_x = static_cast<u32>(nihstro::Instruction::FlowControlType::JustX);
+    return static_cast<u32>(opcode) << 26 | 1u << 25 | just_x << 22 | dest_offset << 10 |
+           num_instructions;
+}
+
+static u32 Loop(u32 int_uniform, u32 last_instruction) {
+    return static_cast<u32>(OpCode::Id::LOOP) << 26 | int_uniform << 22 | last_instruction << 10;
+}
+
+static u32 End() {
+    return static_cast<u32>(OpCode::Id::END) << 26;
+}
+
+struct RawProgram {
+    explicit RawProgram(std::initializer_list<u32> code) {
+        program_code.fill(0);
+        std::copy(code.begin(), code.end(), program_code.begin());
+        swizzle_data.fill(0);
+        swizzle_data[0] = IDENTITY_SWIZZLE;
+    }
+
+    std::array<u32, Pica::Shader::MAX_PROGRAM_CODE_LENGTH> program_code;
+    std::array<u32, Pica::Shader::MAX_SWIZZLE_DATA_LENGTH> swizzle_data;
+};
+
+/// Runs the batch with the given values in v0.x, and returns the values of o0.x
+static bool RunBatch(const JitBatchShader& shader, const Pica::Shader::ShaderSetup& setup,
+                     const LaneValues& inputs, LaneValues& outputs) {
+    std::array<Pica::Shader::UnitState, BatchUnitState::NUM_LANES> shader_units;
+    for (std::size_t lane = 0; lane < inputs.size(); ++lane) {
+        shader_units[lane].registers.input[0].x = float24::FromFloat32(inputs[lane]);
+        shader_units[lane].registers.output[0].x = float24::FromFloat32(-1.f);
+    }
+
+    const bool result = shader.Run(setup, shader_units.data());
+    for (std::size_t lane = 0; lane < outputs.size(); ++lane) {
+        outputs[lane] = shader_units[lane].registers.output[0].x.ToFloat32();
+    }
+    return result;
+}
+
+TEST_CASE("Batch IFC with diverging lanes", "[video_core][shader][shader_jit]") {
+    const RawProgram program({
+        CompareGreaterThan(UNIFORM(0), INPUT(0)),
+        FlowControlIfX(OpCode::Id::IFC, 3, 1),
+        Arithmetic(OpCode::Id::MOV, OUTPUT(0), INPUT(0)),
+        Arithmetic(OpCode::Id::ADD, OUTPUT(0), INPUT(0), INPUT(0)),
+        End(),
+    });
+    JitBatchShader shader;
+    REQUIRE(shader.Compile(&program.program_code, &program.swizzle_data, 0));
+
+    // Lanes with a negative input take the IFC branch, the other ones the ELSE branch
+    Pica::Shader::ShaderSetup setup;
+    setup.uniforms.f[0].x = float24::FromFloat32(0.f);
+    LaneValues outputs;
+    REQUIRE(RunBatch(shader, setup, {-1.f, 2.f, -3.f, 4.f}, outputs));
+    REQUIRE(outputs == LaneValues{-1.f, 4.f, -3.f, 8.f});
+
+    REQUIRE(RunBatch(shader, setup, {1.f, 2.f, 3.f, 4.f}, outputs));
+    REQUIRE(outputs == LaneValues{2.f, 4.f, 6.f, 8.f});
+}
+
+TEST_CASE("Batch JMPC falls back on diverging lanes", "[video_core][shader][shader_jit]") {
+    const RawProgram program({
+        CompareGreaterThan(UNIFORM(0), INPUT(0)),
+        FlowControlIfX(OpCode::Id::JMPC, 3),
+        Arithmetic(OpCode::Id::MOV, OUTPUT(0), INPUT(0)),
+        End(),
+    });
+    JitBatchShader shader;
+    REQUIRE(shader.Compile(&program.program_code, &program.swizzle_data, 0));
+
+    Pica::Shader::ShaderSetup setup;
+    setup.uniforms.f[0].x = float24::FromFloat32(0.f);
+    LaneValues outputs;
+    REQUIRE(RunBatch(shader, setup, {1.f, 2.f, 3.f, 4.f}, outputs));
+    REQUIRE(outputs == LaneValues{1.f, 2.f, 3.f, 4.f});
+    REQUIRE(RunBatch(shader, setup, {-1.f, -2.f, -3.f, -4.f}, outputs));
+    REQUIRE(outputs == LaneValues{-1.f, -1.f, -1.f, -1.f});
+
+    // The lanes are left untouched when they disagree on the jump
+    REQUIRE_FALSE(RunBatch(shader, setup, {1.f, -2.f, 3.f, 4.f}, outputs));
+    REQUIRE(outputs == LaneValues{-1.f, -1.f, -1.f, -1.f});
+}
+
+TEST_CASE("Batch BREAKC falls back on diverging lanes", "[video_core][shader][shader_jit]") {
+    const RawProgram program({
+        CompareGreaterThan(UNIFORM(0), INPUT(0)),
+        Arithmetic(OpCode::Id::MOV, TEMPORARY(0), UNIFORM(0)),
+        Loop(0, 4),
+        FlowControlIfX(OpCode::Id::BREAKC, 0),
+        Arithmetic(OpCode::Id::ADD, TEMPORARY(0), TEMPORARY(0), INPUT(0)),
+        Arithmetic(OpCode::Id::MOV, OUTPUT(0), TEMPORARY(0)),
+        End(),
+    });
+    JitBatchShader shader;
+    REQUIRE(shader.Compile(&program.program_code, &program.swizzle_data, 0));
+
+    // Four iterations
+    Pica::Shader::ShaderSetup setup;
+    setup.uniforms.f[0].x = float24::FromFloat32(0.f);
+    setup.uniforms.i[0] = Common::Vec4<u8>(3, 0, 0, 0);
+    LaneValues outputs;
+    REQUIRE(RunBatch(shader, setup, {1.f, 2.f, 3.f, 4.f}, outputs));
+    REQUIRE(outputs == LaneValues{4.f, 8.f, 12.f, 16.f});
+    REQUIRE(RunBatch(shader, setup, {-1.f, -2.f, -3.f, -4.f}, outputs));
+    REQUIRE(outputs == LaneValues{0.f, 0.f, 0.f, 0.f});
+
+    REQUIRE_FALSE(RunBatch(shader, setup, {1.f, 2.f, -3.f, 4.f}, outputs));
+    REQUIRE(outputs == LaneValues{-1.f, -1.f, -1.f, -1.f});
+}
+
+TEST_CASE("Batch JIT matches JitShader", "[video_core][shader][shader_jit]") {
+    const RawProgram program({
+        Arithmetic(OpCode::Id::MUL, TEMPORARY(0), INPUT(0), INPUT(1)),
+        Arithmetic(OpCode::Id::DP4, TEMPORARY(1), UNIFORM(0), TEMPORARY(0)),
+        Arithmetic(OpCode::Id::EX2, TEMPORARY(2), INPUT(0)),
+        Arithmetic(OpCode::Id::LG2, TEMPORARY(3), INPUT(1)),
+        Arithmetic(OpCode::Id::RCP, TEMPORARY(4), TEMPORARY(1)),
+        Arithmetic(OpCode::Id::RSQ, TEMPORARY(5), INPUT(0)),
+        Mad(OUTPUT(0), TEMPORARY(2), TEMPORARY(3), TEMPORARY(4)),
+        Arithmetic(OpCode::Id::MAX, OUTPUT(1), TEMPORARY(5), TEMPORARY(1)),
+        Arithmetic(OpCode::Id::MIN, OUTPUT(2), TEMPORARY(3), TEMPORARY(0)),
+        Arithmetic(OpCode::Id::FLR, OUTPUT(3), TEMPORARY(0)),
+        Arithmetic(OpCode::Id::DP3, OUTPUT(4), UNIFORM(1), INPUT(1)),
+        End(),
+    });
+    JitBatchShader batch_shader;
+    REQUIRE(batch_shader.Compile(&program.program_code, &program.swizzle_data, 0));
+    JitShader shader;
+    shader.Compile(&program.program_code, &program.swizzle_data);
+
+    Pica::Shader::ShaderSetup setup;
+    setup.uniforms.f[0] = {float24::FromFloat32(0.5f), float24::FromFloat32(-2.f),
+                           float24::FromFloat32(3.f), float24::FromFloat32(0.25f)};
+    setup.uniforms.f[1] = {float24::FromFloat32(1.f), float24::FromFloat32(-1.f),
+                           float24::FromFloat32(4.f), float24::FromFloat32(0.f)};
+
+    std::mt19937 rng(0x4C414E45);
+    std::uniform_real_distribution<float> distribution(-20.f, 20.f);
+    std::vector<float> special_values{NAN, INFINITY, -INFINITY, 0.f, -0.f, 1.f, 200.f, -200.f};
+
+    for (int batch = 0; batch < 64; ++batch) {
+        std::array<Pica::Shader::UnitState, BatchUnitState::NUM_LANES> batch_units;
+        for (auto& unit : batch_units) {
+            for (std::size_t reg = 0; reg < 2; ++reg) {
+                for (std::size_t component = 0; component < 4; ++component) {
+                    const float value = rng() % 8 == 0 ? special_values[rng() % 8]
+                                                       : distribution(rng);
+                    unit.registers.input[reg][component] = float24::FromFloat32(value);
+                }
+            }
+        }
+        auto scalar_units = batch_units;
+
+        REQUIRE(batch_shader.Run(setup, batch_units.data()));
+        for (auto& unit : scalar_units) {
+            shader.Run(setup, unit, 0);
+        }
+
+        for (std::size_t lane = 0; lane < BatchUnitState::NUM_LANES; ++lane) {
+            INFO("Batch " << batch << ", lane " << lane);
+            for (std::size_t reg = 0; reg < 5; ++reg) {
+                for (std::size_t component = 0; component < 4; ++component) {
+                    const float expected =
+                        scalar_units[lane].registers.output[reg][component].ToFloat32();
+                    const float result =
+                        batch_units[lane].registers.output[reg][component].ToFloat32();
+                    INFO("o" << reg << "." << component << ": " << expected << " vs " << result);
+                    if (std::isnan(expected)) {
+                        CHECK(std::isnan(result));
+                    } else {
+                        CHECK(std::memcmp(&expected, &result, sizeof(float)) == 0);
+                    }
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,127 @@
+// Copyright 2020 Citra Emulator Project
+// Licensed under GPLv2 or any later version
+// Refer to the license.txt file included.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <catch2/catch.hpp>
+#include <nihstro/inline_assembly.h>
+#include "video_core/shader/shader_jit_x64.h"
+#include "video_core/video_core.h"
+
+using float24 = Pica::float24;
+using JitX64Engine = Pica::Shader::JitX64Engine;
+using ShaderSetup = Pica::Shader::ShaderSetup;
+
+using DestRegister = nihstro::DestRegister;
+using OpCode = nihstro::OpCode;
+using SourceRegister = nihstro::SourceRegister;
+
+static std::unique_ptr<ShaderSetup> MakeShaderSetup(OpCode::Id opcode) {
+    const auto shbin = nihstro::InlineAsm::CompileToRawBinary({
+        // clang-format off
+        {opcode, DestRegister::MakeOutput(0), SourceRegister::MakeInput(0)},
+        {OpCode::Id::END},
+        // clang-format on
+    });
+
+    auto setup = std::make_unique<ShaderSetup>();
+    setup->program_code.fill(0);
+    setup->swizzle_data.fill(0);
+    std::transform(shbin.program.begin(), shbin.program.end(), setup->program_code.begin(),
+                   [](const auto& x) { return x.hex; });
+    std::transform(shbin.swizzle_table.begin(), shbin.swizzle_table.end(),
+                   setup->swizzle_data.begin(), [](const auto& x) { return x.hex; });
+    return setup;
+}
+
+static float RunShader(const JitX64Engine& engine, const ShaderSetup& setup, float input) {
+    Pica::Shader::UnitState shader_unit;
+    shader_unit.registers.input[0].x = float24::FromFloat32(input);
+    engine.Run(setup, shader_unit);
+    return shader_unit.registers.output[0].x.ToFloat32();
+}
+
+/// Sets up batches until the engine hands out the compiled shader, returns false on timeout
+static bool WaitForCompiledShader(JitX64Engine& engine, ShaderSetup& setup) {
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    while (std::chrono::steady_clock::now() < deadline) {
+        engine.SetupBatch(setup, 0);
+        if (setup.engine_data.cached_shader != nullptr) {
+            return true;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return false;
+}
+
+/// Creates an engine with the given compilation mode and without a disk cache
+static std::unique_ptr<JitX64Engine> MakeEngine(bool async) {
+    VideoCore::g_shader_jit_disk_cache_enabled = false;
+    VideoCore::g_shader_jit_async_enabled = async;
+    auto engine = std::make_unique<JitX64Engine>();
+    VideoCore::g_shader_jit_async_enabled = false;
+    return engine;
+}
+
+TEST_CASE("JitX64Engine compiles synchronously", "[video_core][shader][shader_jit]") {
+    const auto engine = MakeEngine(false);
+    const auto setup = MakeShaderSetup(OpCode::Id::MOV);
+
+    engine->SetupBatch(*setup, 0);
+    REQUIRE(setup->engine_data.cached_shader != nullptr);
+    REQUIRE(RunShader(*engine, *setup, 3.f) == 3.f);
+}
+
+TEST_CASE("JitX64Engine interprets shaders while compiling them",
+          "[video_core][shader][shader_jit]") {
+    const auto engine = MakeEngine(true);
+    const auto setup = MakeShaderSetup(OpCode::Id::MOV);
+
+    // The first batch of a new shader always runs on the interpreter
+    engine->SetupBatch(*setup, 0);
+    REQUIRE(setup->engine_data.cached_shader == nullptr);
+    REQUIRE(RunShader(*engine, *setup, 3.f) == 3.f);
+
+    // Toggling the setting doesn't change the mode of an existing engine
+    VideoCore::g_shader_jit_async_enabled = false;
+    const auto other_setup = MakeShaderSetup(OpCode::Id::RCP);
+    engine->SetupBatch(*other_setup, 0);
+    REQUIRE(other_setup->engine_data.cached_shader == nullptr);
+
+    REQUIRE(WaitForCompiledShader(*engine, *setup));
+    REQUIRE(RunShader(*engine, *setup, 3.f) == 3.f);
+    REQUIRE(WaitForCompiledShader(*engine, *other_setup));
+    REQUIRE(RunShader(*engine, *other_setup, 4.f) == Approx(0.25f).epsilon(0.001f));
+}
+
+TEST_CASE("JitX64Engine publishes all queued shaders", "[video_core][shader][shader_jit]") {
+    const auto engine = MakeEngine(true);
+
+    const OpCode::Id opcodes[] = {OpCode::Id::MOV, OpCode::Id::RCP, OpCode::Id::RSQ,
+                                  OpCode::Id::EX2, OpCode::Id::LG2, OpCode::Id::FLR};
+    std::vector<std::unique_ptr<ShaderSetup>> setups;
+    for (const OpCode::Id opcode : opcodes) {
+        setups.push_back(MakeShaderSetup(opcode));
+        engine->SetupBatch(*setups.back(), 0);
+    }
+
+    // These batches run on the interpreter, as none of the shaders was published yet
+    const std::vector<float> expected{4.f, 0.25f, 0.5f, 16.f, 2.f, 4.f};
+    for (std::size_t i = 0; i < setups.size(); ++i) {
+        REQUIRE(RunShader(*engine, *setups[i], 4.f) == Approx(expected[i]).epsilon(0.001f));
+    }
+
+    // A shader set up again after being published is compiled exactly once
+    for (std::size_t i = 0; i < setups.size(); ++i) {
+        REQUIRE(WaitForCompiledShader(*engine, *setups[i]));
+        const void* const compiled = setups[i]->engine_data.cached_shader;
+        engine->SetupBatch(*setups[i], 0);
+        REQUIRE(setups[i]->engine_data.cached_shader == compiled);
+        REQUIRE(RunShader(*engine, *setups[i], 4.f) == Approx(expected[i]).epsilon(0.001f));
+    }
+}
@@ -89,3 +89,27 @@ TEST_CASE("EX2", "[video_core][shader][shader_jit]") {
     REQUIRE(shader.Run(79.7262742773f) == Approx(1.e24f));
     REQUIRE(std::isinf(shader.Run(800.f)));
 }
+
+TEST_CASE("LoadProgram", "[video_core][shader][shader_jit]") {
+    const auto sh_input = SourceRegister::MakeInput(0);
+    const auto sh_output = DestRegister::MakeOutput(0);
+
+    auto shader = ShaderTest({
+        // clang-format off
+        {OpCode::Id::LG2, sh_output, sh_input},
+        {OpCode::Id::END},
+        // clang-format on
+    });
+
+    // Load the program into the code buffer of another shader, at a different host address
+    auto loaded = std::make_unique<JitShader>();
+    REQUIRE(loaded->GetPreludeSize() == shader.shader->GetPreludeSize());
+    REQUIRE(loaded->LoadProgram(shader.shader->GetProgramCode(),
+                                shader.shader->GetInstructionOffsets()));
+    REQUIRE(loaded->GetProgramCode() == shader.shader->GetProgramCode());
+    shader.shader = std::move(loaded);
+
+    REQUIRE(std::isnan(shader.Run(-1.f)));
+    REQUIRE(shader.Run(4.f) == Approx(2.f));
+    REQUIRE(shader.Run(64.f) == Approx(6.f));
+}
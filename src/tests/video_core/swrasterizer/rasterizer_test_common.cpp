@@ -0,0 +1,62 @@
+// Copyright 2020 Citra Emulator Project
+// Licensed under GPLv2 or any later version
+// Refer to the license.txt file included.
+
+#include "core/memory.h"
+#include "tests/video_core/swrasterizer/rasterizer_test_common.h"
+#include "video_core/pica_state.h"
+
+namespace Pica::Rasterizer::Tests {
+
+void SetupFramebuffer() {
+    g_state.Reset();
+    auto& regs = g_state.regs;
+
+    auto& framebuffer = regs.framebuffer.framebuffer;
+    framebuffer.color_buffer_address.Assign(Memory::VRAM_PADDR / 8);
+    framebuffer.color_format.Assign(FramebufferRegs::ColorFormat::RGBA8);
+    framebuffer.width.Assign(FRAMEBUFFER_WIDTH);
+    framebuffer.height.Assign(FRAMEBUFFER_HEIGHT - 1);
+    framebuffer.allow_color_write.Assign(0xF);
+
+    // Blending makes the output depend on the order in which overlapping triangles are drawn
+    auto& output_merger = regs.framebuffer.output_merger;
+    output_merger.alphablend_enable.Assign(1);
+    output_merger.alpha_blending.blend_equation_rgb.Assign(FramebufferRegs::BlendEquation::Add);
+    output_merger.alpha_blending.blend_equation_a.Assign(FramebufferRegs::BlendEquation::Add);
+    output_merger.alpha_blending.factor_source_rgb.Assign(
+        FramebufferRegs::BlendFactor::SourceAlpha);
+    output_merger.alpha_blending.factor_dest_rgb.Assign(
+        FramebufferRegs::BlendFactor::OneMinusSourceAlpha);
+    output_merger.alpha_blending.factor_source_a.Assign(FramebufferRegs::BlendFactor::One);
+    output_merger.alpha_blending.factor_dest_a.Assign(FramebufferRegs::BlendFactor::Zero);
+    output_merger.red_enable.Assign(1);
+    output_merger.green_enable.Assign(1);
+    output_merger.blue_enable.Assign(1);
+    output_merger.alpha_enable.Assign(1);
+
+    // The texture environment passes the interpolated vertex color through
+    regs.lighting.disable.Assign(1);
+}
+
+std::vector<Vertex> GenerateTriangles(std::mt19937& rng, std::size_t count, float margin) {
+    std::uniform_real_distribution<float> x_dist(0.0f, FRAMEBUFFER_WIDTH + margin);
+    std::uniform_real_distribution<float> y_dist(0.0f, FRAMEBUFFER_HEIGHT);
+    std::uniform_real_distribution<float> unit_dist(0.0f, 1.0f);
+
+    std::vector<Vertex> vertices;
+    for (std::size_t i = 0; i < count * 3; ++i) {
+        Shader::OutputVertex output{};
+        output.pos.w = float24::FromFloat32(1.0f);
+        for (std::size_t c = 0; c < 4; ++c) {
+            output.color[c] = float24::FromFloat32(unit_dist(rng));
+        }
+        Vertex vertex(output);
+        vertex.screenpos = {float24::FromFloat32(x_dist(rng)), float24::FromFloat32(y_dist(rng)),
+                            float24::FromFloat32(unit_dist(rng))};
+        vertices.push_back(vertex);
+    }
+    return vertices;
+}
+
+} // namespace Pica::Rasterizer::Tests
@@ -0,0 +1,37 @@
+// Copyright 2020 Citra Emulator Project
+// Licensed under GPLv2 or any later version
+// Refer to the license.txt file included.
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <random>
+#include <vector>
+#include "common/common_types.h"
+#include "video_core/swrasterizer/rasterizer.h"
+
+namespace Pica::Rasterizer::Tests {
+
+constexpr u32 FRAMEBUFFER_WIDTH = 256;
+constexpr u32 FRAMEBUFFER_HEIGHT = 128;
+constexpr u32 FRAMEBUFFER_SIZE = FRAMEBUFFER_WIDTH * FRAMEBUFFER_HEIGHT * 4;
+
+/// Configures an RGBA8 color buffer at the start of VRAM, with alpha blending enabled
+void SetupFramebuffer();
+
+/**
+ * Generates triangles in screen coordinates, which may reach the given distance past the right
+ * edge of the framebuffer. Those pixels still lie within the color buffer's memory.
+ */
+std::vector<Vertex> GenerateTriangles(std::mt19937& rng, std::size_t count, float margin);
+
+/// Draws the triangles with the given function and returns the contents of the color buffer
+template <typename DrawFunc>
+std::vector<u8> Render(u8* framebuffer, DrawFunc&& draw) {
+    std::fill(framebuffer, framebuffer + FRAMEBUFFER_SIZE, 0x40);
+    draw();
+    return std::vector<u8>(framebuffer, framebuffer + FRAMEBUFFER_SIZE);
+}
+
+} // namespace Pica::Rasterizer::Tests
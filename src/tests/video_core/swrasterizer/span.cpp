@@ -0,0 +1,94 @@
+// Copyright 2020 Citra Emulator Project
+// Licensed under GPLv2 or any later version
+// Refer to the license.txt file included.
+
+#include <algorithm>
+#include <cstddef>
+#include <random>
+#include <vector>
+#include <catch2/catch.hpp>
+#include "core/memory.h"
+#include "tests/video_core/swrasterizer/rasterizer_test_common.h"
+#include "video_core/pica_state.h"
+#include "video_core/swrasterizer/rasterizer.h"
+#include "video_core/swrasterizer/span.h"
+#include "video_core/video_core.h"
+
+namespace Pica::Rasterizer {
+
+using namespace Tests;
+
+/// Mixes the vertex color with a constant over a few texture environment stages
+static void SetupCombiners() {
+    using TevStageConfig = TexturingRegs::TevStageConfig;
+    auto& texturing = g_state.regs.texturing;
+
+    auto& stage0 = texturing.tev_stage0;
+    stage0.color_source1.Assign(TevStageConfig::Source::PrimaryColor);
+    stage0.color_source2.Assign(TevStageConfig::Source::Constant);
+    stage0.color_op.Assign(TevStageConfig::Operation::Modulate);
+    stage0.alpha_source1.Assign(TevStageConfig::Source::PrimaryColor);
+    stage0.alpha_op.Assign(TevStageConfig::Operation::Replace);
+    stage0.const_color = 0xC080A0FF;
+
+    auto& stage1 = texturing.tev_stage1;
+    stage1.color_source1.Assign(TevStageConfig::Source::Previous);
+    stage1.color_source2.Assign(TevStageConfig::Source::PrimaryColor);
+    stage1.color_modifier2.Assign(TevStageConfig::ColorModifier::OneMinusSourceAlpha);
+    stage1.color_op.Assign(TevStageConfig::Operation::AddSigned);
+    stage1.color_scale.Assign(1);
+    stage1.alpha_source1.Assign(TevStageConfig::Source::Previous);
+    stage1.alpha_op.Assign(TevStageConfig::Operation::Replace);
+
+    auto& stage2 = texturing.tev_stage2;
+    stage2.color_source1.Assign(TevStageConfig::Source::Previous);
+    stage2.color_source2.Assign(TevStageConfig::Source::PreviousBuffer);
+    stage2.color_source3.Assign(TevStageConfig::Source::PrimaryColor);
+    stage2.color_op.Assign(TevStageConfig::Operation::Lerp);
+    stage2.alpha_source1.Assign(TevStageConfig::Source::Previous);
+    stage2.alpha_op.Assign(TevStageConfig::Operation::Replace);
+
+    for (auto* stage : {&texturing.tev_stage3, &texturing.tev_stage4, &texturing.tev_stage5}) {
+        stage->color_source1.Assign(TevStageConfig::Source::Previous);
+        stage->alpha_source1.Assign(TevStageConfig::Source::Previous);
+    }
+
+    texturing.tev_combiner_buffer_input.update_mask_rgb.Assign(0x1);
+    texturing.tev_combiner_buffer_color.raw = 0x20406080;
+}
+
+TEST_CASE("SIMD spans match scalar rasterization", "[video_core][swrasterizer]") {
+    Memory::MemorySystem memory;
+    VideoCore::g_memory = &memory;
+    SetupFramebuffer();
+    u8* framebuffer = memory.GetPhysicalPointer(Memory::VRAM_PADDR);
+
+    SECTION("pass-through texture environment") {}
+    SECTION("combined texture environment") {
+        SetupCombiners();
+    }
+
+    // Covers the right edge of the bounding box falling in the middle of a span
+    std::mt19937 rng(0x5350414E);
+    const std::vector<Vertex> vertices = GenerateTriangles(rng, 200, 64.0f);
+
+    auto draw = [&] {
+        for (std::size_t i = 0; i < vertices.size(); i += 3) {
+            ProcessTriangle(vertices[i], vertices[i + 1], vertices[i + 2]);
+        }
+    };
+
+    SetSpanSimdEnabled(false);
+    const auto scalar = Render(framebuffer, draw);
+    SetSpanSimdEnabled(true);
+    const auto simd = Render(framebuffer, draw);
+
+    // Make sure the draw actually covered a good part of the framebuffer
+    const auto untouched = std::count(scalar.begin(), scalar.end(), u8{0x40});
+    REQUIRE(static_cast<std::size_t>(untouched) < scalar.size() / 2);
+    REQUIRE(scalar == simd);
+
+    VideoCore::g_memory = nullptr;
+}
+
+} // namespace Pica::Rasterizer
@@ -0,0 +1,159 @@
+// Copyright 2020 Citra Emulator Project
+// Licensed under GPLv2 or any later version
+// Refer to the license.txt file included.
+
+#include <array>
+#include <cstddef>
+#include <random>
+#include <catch2/catch.hpp>
+#include "common/x64/cpu_detect.h"
+#include "video_core/regs_texturing.h"
+#include "video_core/swrasterizer/span.h"
+#include "video_core/swrasterizer/tev_jit_x64.h"
+
+namespace Pica::Rasterizer {
+
+using TevStageConfig = TexturingRegs::TevStageConfig;
+using Source = TevStageConfig::Source;
+using ColorModifier = TevStageConfig::ColorModifier;
+using AlphaModifier = TevStageConfig::AlphaModifier;
+using Operation = TevStageConfig::Operation;
+
+constexpr std::array<Source, 10> sources{{
+    Source::PrimaryColor,
+    Source::PrimaryFragmentColor,
+    Source::SecondaryFragmentColor,
+    Source::Texture0,
+    Source::Texture1,
+    Source::Texture2,
+    Source::Texture3,
+    Source::PreviousBuffer,
+    Source::Constant,
+    Source::Previous,
+}};
+
+constexpr std::array<ColorModifier, 10> color_modifiers{{
+    ColorModifier::SourceColor,
+    ColorModifier::OneMinusSourceColor,
+    ColorModifier::SourceAlpha,
+    ColorModifier::OneMinusSourceAlpha,
+    ColorModifier::SourceRed,
+    ColorModifier::OneMinusSourceRed,
+    ColorModifier::SourceGreen,
+    ColorModifier::OneMinusSourceGreen,
+    ColorModifier::SourceBlue,
+    ColorModifier::OneMinusSourceBlue,
+}};
+
+/// Operations compiled by TevJit; the dot products are left to the scalar code
+constexpr std::array<Operation, 8> jit_operations{{
+    Operation::Replace,
+    Operation::Modulate,
+    Operation::Add,
+    Operation::AddSigned,
+    Operation::Lerp,
+    Operation::Subtract,
+    Operation::MultiplyThenAdd,
+    Operation::AddThenMultiply,
+}};
+
+template <typename T, std::size_t N>
+static T Pick(std::mt19937& rng, const std::array<T, N>& values) {
+    return values[std::uniform_int_distribution<std::size_t>(0, N - 1)(rng)];
+}
+
+/// Randomizes all texture environment stages, the combiner buffer color and its update masks
+static void RandomizeTev(std::mt19937& rng, TexturingRegs& regs) {
+    std::uniform_int_distribution<u32> alpha_modifier_dist(0, 7);
+    std::uniform_int_distribution<u32> scale_dist(0, 3);
+    std::uniform_int_distribution<u32> mask_dist(0, 15);
+
+    for (auto* stage : {&regs.tev_stage0, &regs.tev_stage1, &regs.tev_stage2, &regs.tev_stage3,
+                        &regs.tev_stage4, &regs.tev_stage5}) {
+        stage->color_source1.Assign(Pick(rng, sources));
+        stage->color_source2.Assign(Pick(rng, sources));
+        stage->color_source3.Assign(Pick(rng, sources));
+        stage->alpha_source1.Assign(Pick(rng, sources));
+        stage->alpha_source2.Assign(Pick(rng, sources));
+        stage->alpha_source3.Assign(Pick(rng, sources));
+        stage->color_modifier1.Assign(Pick(rng, color_modifiers));
+        stage->color_modifier2.Assign(Pick(rng, color_modifiers));
+        stage->color_modifier3.Assign(Pick(rng, color_modifiers));
+        stage->alpha_modifier1.Assign(static_cast<AlphaModifier>(alpha_modifier_dist(rng)));
+        stage->alpha_modifier2.Assign(static_cast<AlphaModifier>(alpha_modifier_dist(rng)));
+        stage->alpha_modifier3.Assign(static_cast<AlphaModifier>(alpha_modifier_dist(rng)));
+        stage->color_op.Assign(Pick(rng, jit_operations));
+        stage->alpha_op.Assign(Pick(rng, jit_operations));
+        stage->const_color = static_cast<u32>(rng());
+        // A scale of 3 is reserved and behaves like 0
+        stage->color_scale.Assign(scale_dist(rng));
+        stage->alpha_scale.Assign(scale_dist(rng));
+    }
+
+    regs.tev_combiner_buffer_color.raw = static_cast<u32>(rng());
+    regs.tev_combiner_buffer_input.update_mask_rgb.Assign(mask_dist(rng));
+    regs.tev_combiner_buffer_input.update_mask_a.Assign(mask_dist(rng));
+}
+
+/// Fills the inputs with random colors, favouring the extreme values which saturate the operations
+static void RandomizeInputs(std::mt19937& rng, TevSpanInputs& inputs) {
+    std::uniform_int_distribution<u32> byte_dist(0, 255);
+    std::uniform_int_distribution<u32> kind_dist(0, 3);
+    auto randomize = [&](SpanArray<Common::Vec4<u8>>& colors) {
+        for (auto& color : colors) {
+            for (std::size_t c = 0; c < 4; ++c) {
+                const u32 kind = kind_dist(rng);
+                color[c] = static_cast<u8>(kind == 0 ? 0 : kind == 1 ? 255 : byte_dist(rng));
+            }
+        }
+    };
+    randomize(inputs.primary_color);
+    randomize(inputs.primary_fragment_color);
+    randomize(inputs.secondary_fragment_color);
+    for (auto& texture_color : inputs.texture_color) {
+        randomize(texture_color);
+    }
+}
+
+TEST_CASE("TevJit matches the scalar texture environment", "[video_core][swrasterizer]") {
+    if (!Common::GetCPUCaps().sse4_1) {
+        WARN("TevJit requires SSE4.1, which the host does not support");
+        return;
+    }
+
+    std::mt19937 rng(0x54455631);
+    TexturingRegs regs{};
+    TevSpanInputs inputs{};
+
+    SetSpanSimdEnabled(false);
+    for (int i = 0; i < 20000; ++i) {
+        RandomizeTev(rng, regs);
+        RandomizeInputs(rng, inputs);
+
+        const auto config = TevJitConfig::BuildFromRegs(regs);
+        REQUIRE(config.IsSupported());
+        const TevJit jit(config);
+
+        SpanArray<Common::Vec4<u8>> expected;
+        SpanCombiner(regs).Combine(inputs, expected);
+        SpanArray<Common::Vec4<u8>> output;
+        jit.Run(regs, inputs, output);
+
+        for (std::size_t lane = 0; lane < SPAN_WIDTH; ++lane) {
+            for (std::size_t c = 0; c < 4; ++c) {
+                INFO("iteration " << i << ", lane " << lane << ", channel " << c);
+                REQUIRE(static_cast<int>(output[lane][c]) == static_cast<int>(expected[lane][c]));
+            }
+        }
+    }
+    SetSpanSimdEnabled(true);
+}
+
+TEST_CASE("TevJit leaves dot products to the scalar code", "[video_core][swrasterizer]") {
+    TexturingRegs regs{};
+    const auto op = GENERATE(Operation::Dot3_RGB, Operation::Dot3_RGBA);
+    regs.tev_stage3.color_op.Assign(op);
+    REQUIRE_FALSE(TevJitConfig::BuildFromRegs(regs).IsSupported());
+}
+
+} // namespace Pica::Rasterizer
@@ -0,0 +1,68 @@
+// Copyright 2020 Citra Emulator Project
+// Licensed under GPLv2 or any later version
+// Refer to the license.txt file included.
+
+#include <cstring>
+#include <catch2/catch.hpp>
+#include "core/memory.h"
+#include "video_core/swrasterizer/texture_cache.h"
+#include "video_core/video_core.h"
+
+namespace Pica::Rasterizer {
+
+/// Returns the texel as bytes in R, G, B, A order
+static u32 Sample(TextureCache& cache, const Texture::TextureInfo& info, unsigned int s,
+                  unsigned int t) {
+    Common::Vec4<u8> color = cache.Get(info).Lookup(s, t);
+    u32 result;
+    std::memcpy(&result, color.AsArray(), sizeof(result));
+    return result;
+}
+
+TEST_CASE("TextureCache", "[video_core][swrasterizer]") {
+    Memory::MemorySystem memory;
+    VideoCore::g_memory = &memory;
+
+    Texture::TextureInfo info{};
+    info.physical_address = Memory::VRAM_PADDR;
+    info.width = 16;
+    info.height = 8;
+    info.format = TexturingRegs::TextureFormat::RGBA8;
+    info.SetDefaultStride();
+    const std::size_t size = info.stride * (info.height / 8);
+
+    u8* data = memory.GetPhysicalPointer(info.physical_address);
+    const auto fill = [data, size](u8 value) { std::memset(data, value, size); };
+    const auto texel = [](u8 value) { return value * 0x01010101u; };
+
+    TextureCache cache;
+    fill(0x11);
+    REQUIRE(Sample(cache, info, 15, 7) == texel(0x11));
+
+    // Changes are only noticed once the texture was invalidated
+    fill(0x22);
+    REQUIRE(Sample(cache, info, 15, 7) == texel(0x11));
+    cache.InvalidateRegion(info.physical_address + size, 0x100);
+    REQUIRE(Sample(cache, info, 15, 7) == texel(0x11));
+    cache.InvalidateRegion(info.physical_address + size - 4, 0x100);
+    REQUIRE(Sample(cache, info, 15, 7) == texel(0x22));
+
+    fill(0x33);
+    cache.InvalidateAll();
+    REQUIRE(Sample(cache, info, 0, 0) == texel(0x33));
+
+    // The same memory is decoded separately for each format
+    Texture::TextureInfo a8_info = info;
+    a8_info.format = TexturingRegs::TextureFormat::A8;
+    a8_info.SetDefaultStride();
+    REQUIRE(Sample(cache, a8_info, 0, 0) == 0x33000000u);
+    REQUIRE(Sample(cache, info, 0, 0) == texel(0x33));
+
+    cache.Clear();
+    fill(0x44);
+    REQUIRE(Sample(cache, info, 0, 0) == texel(0x44));
+
+    VideoCore::g_memory = nullptr;
+}
+
+} // namespace Pica::Rasterizer
@@ -0,0 +1,53 @@
+// Copyright 2020 Citra Emulator Project
+// Licensed under GPLv2 or any later version
+// Refer to the license.txt file included.
+
+#include <algorithm>
+#include <cstddef>
+#include <random>
+#include <vector>
+#include <catch2/catch.hpp>
+#include "core/memory.h"
+#include "tests/video_core/swrasterizer/rasterizer_test_common.h"
+#include "video_core/swrasterizer/rasterizer.h"
+#include "video_core/swrasterizer/tile_binner.h"
+#include "video_core/video_core.h"
+
+namespace Pica::Rasterizer {
+
+using namespace Tests;
+
+TEST_CASE("TileBinner matches serial rasterization", "[video_core][swrasterizer]") {
+    Memory::MemorySystem memory;
+    VideoCore::g_memory = &memory;
+    SetupFramebuffer();
+    u8* framebuffer = memory.GetPhysicalPointer(Memory::VRAM_PADDR);
+
+    std::mt19937 rng(0x54494C45);
+    TileBinner binner(4);
+
+    // Triangles reaching outside the framebuffer make the binner fall back to a single thread
+    const float margin = GENERATE(0.0f, 64.0f);
+    const std::vector<Vertex> vertices = GenerateTriangles(rng, 200, margin);
+
+    const auto serial = Render(framebuffer, [&] {
+        for (std::size_t i = 0; i < vertices.size(); i += 3) {
+            ProcessTriangle(vertices[i], vertices[i + 1], vertices[i + 2]);
+        }
+    });
+    const auto binned = Render(framebuffer, [&] {
+        for (std::size_t i = 0; i < vertices.size(); i += 3) {
+            binner.AddTriangle(vertices[i], vertices[i + 1], vertices[i + 2]);
+        }
+        binner.Flush();
+    });
+
+    // Make sure the draw actually covered a good part of the framebuffer
+    const auto untouched = std::count(serial.begin(), serial.end(), u8{0x40});
+    REQUIRE(static_cast<std::size_t>(untouched) < serial.size() / 2);
+    REQUIRE(serial == binned);
+
+    VideoCore::g_memory = nullptr;
+}
+
+} // namespace Pica::Rasterizer
@@ -0,0 +1,112 @@
+// Copyright 2020 Citra Emulator Project
+// Licensed under GPLv2 or any later version
+// Refer to the license.txt file included.
+
+#include <array>
+#include <cstring>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+#include <catch2/catch.hpp>
+#include "video_core/texture/texture_decode.h"
+
+using Pica::TexturingRegs;
+using TextureFormat = Pica::TexturingRegs::TextureFormat;
+
+namespace Pica::Texture {
+
+static constexpr std::array<std::pair<TextureFormat, const char*>, 14> texture_formats{{
+    {TextureFormat::RGBA8, "RGBA8"},
+    {TextureFormat::RGB8, "RGB8"},
+    {TextureFormat::RGB5A1, "RGB5A1"},
+    {TextureFormat::RGB565, "RGB565"},
+    {TextureFormat::RGBA4, "RGBA4"},
+    {TextureFormat::IA8, "IA8"},
+    {TextureFormat::RG8, "RG8"},
+    {TextureFormat::I8, "I8"},
+    {TextureFormat::A8, "A8"},
+    {TextureFormat::IA4, "IA4"},
+    {TextureFormat::I4, "I4"},
+    {TextureFormat::A4, "A4"},
+    {TextureFormat::ETC1, "ETC1"},
+    {TextureFormat::ETC1A4, "ETC1A4"},
+}};
+
+static TextureInfo MakeTextureInfo(TextureFormat format, unsigned int width, unsigned int height) {
+    TextureInfo info{};
+    info.width = width;
+    info.height = height;
+    info.format = format;
+    info.SetDefaultStride();
+    return info;
+}
+
+static std::vector<u8> MakeRandomTexture(const TextureInfo& info) {
+    std::mt19937 random(static_cast<u32>(info.format));
+    std::vector<u8> texture(info.stride * (info.height / 8));
+    for (u8& byte : texture) {
+        byte = static_cast<u8>(random());
+    }
+    return texture;
+}
+
+TEST_CASE("DecodeTextureRect", "[video_core][texture]") {
+    for (const auto& [format, name] : texture_formats) {
+        INFO("Format " << name);
+        const TextureInfo info = MakeTextureInfo(format, 32, 16);
+        const std::vector<u8> texture = MakeRandomTexture(info);
+
+        const auto check_texel = [&](const u8* decoded, unsigned int x, unsigned int y) {
+            INFO("Texel " << x << ", " << y);
+            Common::Vec4<u8> expected = LookupTexture(texture.data(), x, y, info);
+            REQUIRE(std::memcmp(decoded, expected.AsArray(), 4) == 0);
+        };
+
+        std::vector<u8> decoded(info.width * info.height * 4);
+        DecodeTextureRect(texture.data(), info, 0, 0, info.width, info.height, decoded.data(),
+                          info.width * 4);
+        for (unsigned int y = 0; y < info.height; ++y) {
+            for (unsigned int x = 0; x < info.width; ++x) {
+                check_texel(&decoded[(y * info.width + x) * 4], x, y);
+            }
+        }
+
+        // Flipped vertically, with edges that aren't aligned to tiles
+        constexpr unsigned int x0 = 3, y0 = 5, x1 = 21, y1 = 14;
+        constexpr std::ptrdiff_t row_size = (x1 - x0) * 4;
+        decoded.assign((y1 - y0) * row_size, 0);
+        DecodeTextureRect(texture.data(), info, x0, y0, x1, y1,
+                          &decoded[(y1 - y0 - 1) * row_size], -row_size);
+        for (unsigned int y = y0; y < y1; ++y) {
+            for (unsigned int x = x0; x < x1; ++x) {
+                check_texel(&decoded[(y1 - 1 - y) * row_size + (x - x0) * 4], x, y);
+            }
+        }
+    }
+}
+
+TEST_CASE("Texture decoding benchmark", "[.][benchmark][video_core]") {
+    for (const auto& [format, name] : texture_formats) {
+        const TextureInfo info = MakeTextureInfo(format, 256, 256);
+        const std::vector<u8> texture = MakeRandomTexture(info);
+        std::vector<u8> decoded(info.width * info.height * 4);
+
+        BENCHMARK(std::string("LookupTexture ") + name) {
+            for (unsigned int y = 0; y < info.height; ++y) {
+                for (unsigned int x = 0; x < info.width; ++x) {
+                    Common::Vec4<u8> color = LookupTexture(texture.data(), x, y, info);
+                    std::memcpy(&decoded[(y * info.width + x) * 4], color.AsArray(), 4);
+                }
+            }
+            return decoded[0];
+        };
+        BENCHMARK(std::string("DecodeTextureRect ") + name) {
+            DecodeTextureRect(texture.data(), info, 0, 0, info.width, info.height, decoded.data(),
+                              info.width * 4);
+            return decoded[0];
+        };
+    }
+}
+
+} // namespace Pica::Texture
@@ -0,0 +1,57 @@
+// Copyright 2020 Citra Emulator Project
+// Licensed under GPLv2 or any later version
+// Refer to the license.txt file included.
+
+#include <cstddef>
+#include <cstring>
+#include <vector>
+#include <catch2/catch.hpp>
+#include "video_core/utils.h"
+
+namespace VideoCore {
+
+static std::vector<u8> MakePattern(std::size_t size) {
+    std::vector<u8> data(size);
+    for (std::size_t i = 0; i < size; ++i) {
+        data[i] = static_cast<u8>(i * 7 + (i >> 8) * 13);
+    }
+    return data;
+}
+
+template <std::size_t bytes_per_pixel>
+static void TestImage(u32 width, u32 height, bool flip) {
+    const std::size_t size = width * height * bytes_per_pixel;
+    const std::ptrdiff_t row_size = width * bytes_per_pixel;
+    const std::ptrdiff_t stride = flip ? -row_size : row_size;
+    const std::vector<u8> tiled = MakePattern(size);
+
+    std::vector<u8> expected(size);
+    for (u32 y = 0; y < height; ++y) {
+        for (u32 x = 0; x < width; ++x) {
+            const u32 linear_y = flip ? height - 1 - y : y;
+            std::memcpy(&expected[(linear_y * width + x) * bytes_per_pixel],
+                        &tiled[GetMortonOffset(x, y, bytes_per_pixel) + (y & ~7) * row_size],
+                        bytes_per_pixel);
+        }
+    }
+
+    std::vector<u8> linear(size);
+    u8* const first_row = linear.data() + (flip ? size - row_size : 0);
+    UnswizzleImage<bytes_per_pixel>(tiled.data(), width, first_row, stride, width, height);
+    REQUIRE(linear == expected);
+
+    std::vector<u8> swizzled(size);
+    SwizzleImage<bytes_per_pixel>(first_row, stride, swizzled.data(), width, width, height);
+    REQUIRE(swizzled == tiled);
+}
+
+TEST_CASE("Morton tiling", "[video_core]") {
+    for (const bool flip : {false, true}) {
+        TestImage<1>(8, 8, flip);
+        TestImage<2>(24, 16, flip);
+        TestImage<3>(16, 24, flip);
+        TestImage<4>(40, 32, flip);
+    }
+}
+
+} // namespace VideoCore
@@ -0,0 +1,189 @@
+// Copyright 2020 Citra Emulator Project
+// Licensed under GPLv2 or any later version
+// Refer to the license.txt file included.
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <random>
+#include <vector>
+#include <catch2/catch.hpp>
+#include "common/alignment.h"
+#include "core/memory.h"
+#include "video_core/debug_utils/debug_utils.h"
+#include "video_core/pica_state.h"
+#include "video_core/regs_pipeline.h"
+#include "video_core/shader/shader.h"
+#include "video_core/vertex_loader.h"
+#include "video_core/video_core.h"
+
+namespace Pica {
+
+using VertexAttributeFormat = PipelineRegs::VertexAttributeFormat;
+
+/// Converts an attribute element by element, the way VertexLoader did before it selected
+/// specialized loaders
+static void LoadAttributeGeneric(VertexAttributeFormat format, u32 elements, const u8* source,
+                                 Common::Vec4<float24>& attribute) {
+    for (u32 comp = 0; comp < elements; ++comp) {
+        switch (format) {
+        case VertexAttributeFormat::BYTE: {
+            s8 value;
+            std::memcpy(&value, source + comp, sizeof(value));
+            attribute[comp] = float24::FromFloat32(value);
+            break;
+        }
+        case VertexAttributeFormat::UBYTE:
+            attribute[comp] = float24::FromFloat32(source[comp]);
+            break;
+        case VertexAttributeFormat::SHORT: {
+            s16 value;
+            std::memcpy(&value, source + comp * sizeof(value), sizeof(value));
+            attribute[comp] = float24::FromFloat32(value);
+            break;
+        }
+        case VertexAttributeFormat::FLOAT: {
+            float value;
+            std::memcpy(&value, source + comp * sizeof(value), sizeof(value));
+            attribute[comp] = float24::FromFloat32(value);
+            break;
+        }
+        }
+    }
+    for (u32 comp = elements; comp < 4; ++comp) {
+        attribute[comp] = float24::FromFloat32(comp == 3 ? 1.0f : 0.0f);
+    }
+}
+
+static u32 ElementSize(VertexAttributeFormat format) {
+    return format == VertexAttributeFormat::FLOAT   ? 4
+           : format == VertexAttributeFormat::SHORT ? 2
+                                                    : 1;
+}
+
+/// Compares the bit patterns, so that NaNs converted from random data compare equal as well
+static bool SameBits(float24 a, float24 b) {
+    const float x = a.ToFloat32();
+    const float y = b.ToFloat32();
+    return std::memcmp(&x, &y, sizeof(float)) == 0;
+}
+
+TEST_CASE("VertexLoader matches the generic attribute conversion", "[video_core]") {
+    Memory::MemorySystem memory;
+    VideoCore::g_memory = &memory;
+    g_state.Reset();
+
+    constexpr u32 LoaderSpacing = 0x1000;
+    constexpr u32 NumVertices = 16;
+    u8* const vertex_data = memory.GetPhysicalPointer(Memory::VRAM_PADDR);
+
+    std::mt19937 rng(0x56544C44);
+    for (int iteration = 0; iteration < 2000; ++iteration) {
+        PipelineRegs regs{};
+        auto& attributes = regs.vertex_attributes;
+        // The attribute formats and loader components are packed into BitFields without a raw
+        // member, so their words are assembled here
+        u32* const words = reinterpret_cast<u32*>(&attributes);
+
+        const u32 num_attributes = rng() % 12 + 1;
+        std::array<VertexAttributeFormat, 12> formats{};
+        std::array<u32, 12> elements{};
+        std::vector<u32> array_attributes;
+        u32 default_mask = 0;
+        for (u32 i = 0; i < num_attributes; ++i) {
+            formats[i] = static_cast<VertexAttributeFormat>(rng() % 4);
+            elements[i] = rng() % 4 + 1;
+            const u32 descriptor = static_cast<u32>(formats[i]) | (elements[i] - 1) << 2;
+            words[1 + i / 8] |= descriptor << (4 * (i % 8));
+            if (rng() % 4 == 0) {
+                default_mask |= 1 << i;
+            } else {
+                array_attributes.push_back(i);
+            }
+        }
+        attributes.attribute_mask.Assign(default_mask);
+        attributes.max_attribute_index.Assign(num_attributes - 1);
+        std::shuffle(array_attributes.begin(), array_attributes.end(), rng);
+
+        // Spread the array attributes over up to three loaders, some of them with padding
+        std::array<u32, 12> sources{};
+        std::array<u32, 12> strides{};
+        const u32 num_loaders = rng() % 3 + 1;
+        std::size_t next_attribute = 0;
+        for (u32 loader = 0; loader < num_loaders; ++loader) {
+            const std::size_t end = loader + 1 == num_loaders
+                                        ? array_attributes.size()
+                                        : std::min(array_attributes.size(),
+                                                   next_attribute + rng() % 5);
+            std::vector<u32> components;
+            u32 offset = 0;
+            std::vector<u32> loader_attributes;
+            for (; next_attribute < end; ++next_attribute) {
+                // A loader has at most 12 components
+                if (components.size() + (end - next_attribute) < 12 && rng() % 4 == 0) {
+                    const u32 padding = 12 + rng() % 4;
+                    components.push_back(padding);
+                    offset = Common::AlignUp(offset, 4u) + (padding - 11) * 4;
+                }
+                const u32 i = array_attributes[next_attribute];
+                components.push_back(i);
+                loader_attributes.push_back(i);
+                offset = Common::AlignUp(offset, ElementSize(formats[i]));
+                sources[i] = loader * LoaderSpacing + offset;
+                offset += elements[i] * ElementSize(formats[i]);
+            }
+
+            // Vertices may be spaced further apart than the attributes they are made of
+            const u32 stride = offset + rng() % 16;
+            for (const u32 i : loader_attributes) {
+                strides[i] = stride;
+            }
+
+            auto& loader_config = attributes.attribute_loaders[loader];
+            loader_config.data_offset.Assign(loader * LoaderSpacing);
+            u32* const loader_words = words + 3 + loader * 3;
+            for (std::size_t c = 0; c < components.size(); ++c) {
+                loader_words[1 + c / 8] |= components[c] << (4 * (c % 8));
+            }
+            loader_config.byte_count.Assign(stride);
+            loader_config.component_count.Assign(static_cast<u32>(components.size()));
+        }
+
+        for (u32 i = 0; i < num_loaders * LoaderSpacing; ++i) {
+            vertex_data[i] = static_cast<u8>(rng());
+        }
+        for (u32 i = 0; i < num_attributes; ++i) {
+            for (u32 comp = 0; comp < 4; ++comp) {
+                g_state.input_default_attributes.attr[i][comp] =
+                    float24::FromFloat32(static_cast<float>(rng() % 1000));
+            }
+        }
+
+        const VertexLoader loader(regs);
+        DebugUtils::MemoryAccessTracker memory_accesses;
+        for (u32 vertex = 0; vertex < NumVertices; ++vertex) {
+            Shader::AttributeBuffer input{};
+            loader.LoadVertex(Memory::VRAM_PADDR, vertex, vertex, input, memory_accesses);
+
+            for (u32 i = 0; i < num_attributes; ++i) {
+                Common::Vec4<float24> expected;
+                if (default_mask & (1 << i)) {
+                    expected = g_state.input_default_attributes.attr[i];
+                } else {
+                    LoadAttributeGeneric(formats[i], elements[i],
+                                         vertex_data + sources[i] + strides[i] * vertex,
+                                         expected);
+                }
+                for (u32 comp = 0; comp < 4; ++comp) {
+                    INFO("iteration " << iteration << ", vertex " << vertex << ", attribute " << i
+                                      << ", component " << comp);
+                    REQUIRE(SameBits(input.attr[i][comp], expected[comp]));
+                }
+            }
+        }
+    }
+
+    VideoCore::g_memory = nullptr;
+}
+
+} // namespace Pica
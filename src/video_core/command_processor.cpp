@@ -2,18 +2,22 @@
 // Licensed under GPLv2 or any later version
 // Refer to the license.txt file included.
 
+#include <algorithm>
 #include <array>
 #include <cstddef>
 #include <cstring>
 #include <memory>
 #include <utility>
+#include <vector>
 #include "common/assert.h"
 #include "common/logging/log.h"
 #include "common/microprofile.h"
+#include "common/thread_pool.h"
 #include "common/vector_math.h"
 #include "core/hle/service/gsp/gsp.h"
 #include "core/hw/gpu.h"
 #include "core/memory.h"
+#include "core/settings.h"
 #include "core/tracer/recorder.h"
 #include "video_core/command_processor.h"
 #include "video_core/debug_utils/debug_utils.h"
@@ -39,6 +43,173 @@ constexpr std::array<u32, 16> expand_bits_to_bytes{
 
 MICROPROFILE_DEFINE(GPU_Drawing, "GPU", "Drawing", MP_RGB(50, 50, 240));
 
+/// Indexed draws with at least this many vertices have their vertices shaded in parallel
+constexpr u32 PARALLEL_SHADING_MIN_VERTICES = 256;
+/// Number of unique vertices shaded by each task of a parallel draw
+constexpr std::size_t PARALLEL_SHADING_CHUNK_SIZE = 64;
+/// Number of vertices handed to the shader engine at once
+constexpr std::size_t VERTEX_BATCH_SIZE = 8;
+
+/// Thread pool shading the vertices of large indexed draws, if enabled
+static std::unique_ptr<Common::ThreadPool> vertex_shader_pool;
+/// Value of the vertex_shader_threads setting the thread pool was created with
+static u16 vertex_shader_pool_threads = 1;
+/// Shader outputs of the vertices of a non-indexed draw, kept across draws to reuse the allocation
+static std::vector<Shader::AttributeBuffer> draw_vs_outputs;
+
+static Common::ThreadPool* GetVertexShaderPool() {
+    const u16 num_threads = Settings::values.vertex_shader_threads;
+    if (num_threads == 1) {
+        vertex_shader_pool = nullptr;
+        return nullptr;
+    }
+
+    if (vertex_shader_pool == nullptr || vertex_shader_pool_threads != num_threads) {
+        vertex_shader_pool = std::make_unique<Common::ThreadPool>(num_threads, "VertexShader");
+        vertex_shader_pool_threads = num_threads;
+    }
+    return vertex_shader_pool.get();
+}
+
+/**
+ * Post-transform vertex cache covering a whole indexed draw. Each vertex referenced by the draw is
+ * assigned a slot, which is identified by the first index referencing the vertex, so that the
+ * vertex shader only needs to run once for each unique vertex. The cache is kept across draws to
+ * reuse the allocations of its tables.
+ */
+class PostTransformCache {
+public:
+    /// Assigns the slots for the indices of a new draw
+    void Reset(const u8* index_address_8_, bool index_u16_, u32 num_indices) {
+        index_address_8 = index_address_8_;
+        index_address_16 = reinterpret_cast<const u16*>(index_address_8_);
+        index_u16 = index_u16_;
+
+        u32 min_vertex = 0xFFFF;
+        u32 max_vertex = 0;
+        for (u32 index = 0; index < num_indices; ++index) {
+            min_vertex = std::min(min_vertex, GetVertex(index));
+            max_vertex = std::max(max_vertex, GetVertex(index));
+        }
+
+        // Direct-mapped lookup table covering the range of vertices referenced by the draw
+        vertex_slots.assign(num_indices == 0 ? 0 : max_vertex - min_vertex + 1, INVALID_SLOT);
+        index_slots.resize(num_indices);
+        first_indices.clear();
+        for (u32 index = 0; index < num_indices; ++index) {
+            u32& slot = vertex_slots[GetVertex(index) - min_vertex];
+            if (slot == INVALID_SLOT) {
+                slot = static_cast<u32>(first_indices.size());
+                first_indices.push_back(index);
+            }
+            index_slots[index] = slot;
+        }
+
+        // Slots are always written before they are read, so the outputs of previous draws can
+        // stay in place
+        if (outputs.size() < first_indices.size()) {
+            outputs.resize(first_indices.size());
+        }
+    }
+
+    u32 GetVertex(u32 index) const {
+        return index_u16 ? index_address_16[index] : index_address_8[index];
+    }
+
+    /// Returns the slot of the vertex referenced by the given index
+    u32 GetSlot(u32 index) const {
+        return index_slots[index];
+    }
+
+    /// Returns the first index referencing the vertex of the given slot
+    u32 GetFirstIndex(u32 slot) const {
+        return first_indices[slot];
+    }
+
+    /// Returns the number of unique vertices, i.e. the number of cache misses
+    std::size_t NumSlots() const {
+        return first_indices.size();
+    }
+
+    /// Returns the number of indices referencing an already shaded vertex
+    std::size_t NumHits() const {
+        return index_slots.size() - first_indices.size();
+    }
+
+    Shader::AttributeBuffer& Output(u32 slot) {
+        return outputs[slot];
+    }
+
+private:
+    static constexpr u32 INVALID_SLOT = 0xFFFFFFFF;
+
+    const u8* index_address_8 = nullptr;
+    const u16* index_address_16 = nullptr;
+    bool index_u16 = false;
+
+    std::vector<u32> vertex_slots;
+    std::vector<u32> index_slots;
+    std::vector<u32> first_indices;
+    std::vector<Shader::AttributeBuffer> outputs;
+};
+
+/// Post-transform cache of indexed draws
+static PostTransformCache post_transform_cache;
+
+/**
+ * Loads and shades a range of the vertices of a draw. The vertices are handed to the shader engine
+ * in batches, which allows it to process several vertices at once.
+ * @param get_vertex Returns the index and the vertex number of the n-th vertex of the draw
+ * @param get_output Returns the buffer receiving the shader output of the n-th vertex of the draw
+ */
+template <typename GetVertex, typename GetOutput>
+static void ShadeVertices(const VertexLoader& loader, const Shader::ShaderEngine& shader_engine,
+                          u32 base_address, u32 begin, u32 end, GetVertex&& get_vertex,
+                          GetOutput&& get_output) {
+    const auto& regs = g_state.regs;
+
+    std::array<Shader::UnitState, VERTEX_BATCH_SIZE> shader_units;
+    // Memory accesses are only tracked while recording, which never uses this path
+    DebugUtils::MemoryAccessTracker memory_accesses;
+
+    for (u32 batch_begin = begin; batch_begin < end; batch_begin += VERTEX_BATCH_SIZE) {
+        const u32 batch_size = std::min<u32>(VERTEX_BATCH_SIZE, end - batch_begin);
+
+        for (u32 i = 0; i < batch_size; ++i) {
+            const auto [index, vertex] = get_vertex(batch_begin + i);
+            Shader::AttributeBuffer input;
+            loader.LoadVertex(base_address, index, vertex, input, memory_accesses);
+            shader_units[i].LoadInput(regs.vs, input);
+        }
+
+        shader_engine.RunBatch(g_state.vs, shader_units.data(), batch_size);
+
+        for (u32 i = 0; i < batch_size; ++i) {
+            shader_units[i].WriteOutput(regs.vs, get_output(batch_begin + i));
+        }
+    }
+}
+
+/**
+ * Calls `shade(begin, end)` to shade the vertices [0, count), spread over the threads of the given
+ * pool if there is one.
+ */
+template <typename Func>
+static void ShadeVerticesInChunks(Common::ThreadPool* pool, std::size_t count, Func&& shade) {
+    if (pool == nullptr) {
+        shade(0, static_cast<u32>(count));
+        return;
+    }
+
+    const std::size_t num_chunks =
+        (count + PARALLEL_SHADING_CHUNK_SIZE - 1) / PARALLEL_SHADING_CHUNK_SIZE;
+    pool->ParallelFor(num_chunks, [&](std::size_t chunk) {
+        const std::size_t begin = chunk * PARALLEL_SHADING_CHUNK_SIZE;
+        const std::size_t end = std::min(begin + PARALLEL_SHADING_CHUNK_SIZE, count);
+        shade(static_cast<u32>(begin), static_cast<u32>(end));
+    });
+}
+
 static const char* GetShaderSetupTypeName(Shader::ShaderSetup& setup) {
     if (&setup == &g_state.vs) {
         return "vertex shader";
@@ -343,16 +514,8 @@ static void WritePicaReg(u32 id, u32 value, u32 mask) {
 
         DebugUtils::MemoryAccessTracker memory_accesses;
 
-        // Simple circular-replacement vertex cache
-        // The size has been tuned for optimal balance between hit-rate and the cost of lookup
-        const std::size_t VERTEX_CACHE_SIZE = 32;
-        std::array<bool, VERTEX_CACHE_SIZE> vertex_cache_valid{};
-        std::array<u16, VERTEX_CACHE_SIZE> vertex_cache_ids;
-        std::array<Shader::AttributeBuffer, VERTEX_CACHE_SIZE> vertex_cache;
         Shader::AttributeBuffer vs_output;
 
-        unsigned int vertex_cache_pos = 0;
-
         auto* shader_engine = Shader::GetEngine();
         Shader::UnitState shader_unit;
 
@@ -363,58 +526,118 @@ static void WritePicaReg(u32 id, u32 value, u32 mask) {
         if (g_state.geometry_pipeline.NeedIndexInput())
             ASSERT(is_indexed);
 
-        for (unsigned int index = 0; index < regs.pipeline.num_vertices; ++index) {
-            // Indexed rendering doesn't use the start offset
-            unsigned int vertex =
-                is_indexed ? (index_u16 ? index_address_16[index] : index_address_8[index])
-                           : (index + regs.pipeline.vertex_offset);
+        // Indexed draws shade each unique vertex once, unless the indices are passed to the
+        // geometry shader instead
+        PostTransformCache* vertex_cache = nullptr;
+        if (is_indexed && !g_state.geometry_pipeline.NeedIndexInput()) {
+            vertex_cache = &post_transform_cache;
+            vertex_cache->Reset(index_address_8, index_u16, regs.pipeline.num_vertices);
+            MICROPROFILE_META_CPU("Vertex cache hits", static_cast<int>(vertex_cache->NumHits()));
+            MICROPROFILE_META_CPU("Vertex cache misses",
+                                  static_cast<int>(vertex_cache->NumSlots()));
+        }
 
-            bool vertex_cache_hit = false;
+        // Unless the indices are passed to the geometry shader, the vertices are shaded in batches
+        // before being submitted to the geometry pipeline, and large draws may shade them on
+        // multiple threads. Per-vertex debugging events and memory access tracking require the
+        // vertices to be processed one by one instead.
+        Common::ThreadPool* const shader_pool =
+            regs.pipeline.num_vertices >= PARALLEL_SHADING_MIN_VERTICES ? GetVertexShaderPool()
+                                                                        : nullptr;
+        const bool batched_shading =
+            !g_state.geometry_pipeline.NeedIndexInput() &&
+            !(g_debug_context &&
+              (g_debug_context->recorder ||
+               g_debug_context->breakpoints[(int)DebugContext::Event::VertexShaderInvocation]
+                   .enabled));
+
+        if (batched_shading && vertex_cache) {
+            ShadeVerticesInChunks(shader_pool, vertex_cache->NumSlots(), [&](u32 begin, u32 end) {
+                ShadeVertices(
+                    loader, *shader_engine, base_address, begin, end,
+                    [&](u32 slot) {
+                        const u32 index = vertex_cache->GetFirstIndex(slot);
+                        return std::make_pair(index, vertex_cache->GetVertex(index));
+                    },
+                    [&](u32 slot) -> Shader::AttributeBuffer& {
+                        return vertex_cache->Output(slot);
+                    });
+            });
+
+            for (u32 index = 0; index < regs.pipeline.num_vertices; ++index) {
+                g_state.geometry_pipeline.SubmitVertex(
+                    vertex_cache->Output(vertex_cache->GetSlot(index)));
+            }
+        } else if (batched_shading) {
+            // Non-indexed draw
+            const u32 num_vertices = regs.pipeline.num_vertices;
+            const u32 vertex_offset = regs.pipeline.vertex_offset;
+            if (draw_vs_outputs.size() < num_vertices) {
+                draw_vs_outputs.resize(num_vertices);
+            }
 
-            if (is_indexed) {
-                if (g_state.geometry_pipeline.NeedIndexInput()) {
-                    g_state.geometry_pipeline.SubmitIndex(vertex);
-                    continue;
-                }
+            ShadeVerticesInChunks(shader_pool, num_vertices, [&](u32 begin, u32 end) {
+                ShadeVertices(
+                    loader, *shader_engine, base_address, begin, end,
+                    [vertex_offset](u32 index) {
+                        return std::make_pair(index, index + vertex_offset);
+                    },
+                    [&](u32 index) -> Shader::AttributeBuffer& { return draw_vs_outputs[index]; });
+            });
+
+            for (u32 index = 0; index < num_vertices; ++index) {
+                g_state.geometry_pipeline.SubmitVertex(draw_vs_outputs[index]);
+            }
+        } else {
+            for (unsigned int index = 0; index < regs.pipeline.num_vertices; ++index) {
+                // Indexed rendering doesn't use the start offset
+                unsigned int vertex =
+                    is_indexed ? (index_u16 ? index_address_16[index] : index_address_8[index])
+                               : (index + regs.pipeline.vertex_offset);
 
-                if (g_debug_context && Pica::g_debug_context->recorder) {
-                    int size = index_u16 ? 2 : 1;
-                    memory_accesses.AddAccess(base_address + index_info.offset + size * index,
-                                              size);
-                }
+                bool vertex_cache_hit = false;
+
+                if (is_indexed) {
+                    if (g_state.geometry_pipeline.NeedIndexInput()) {
+                        g_state.geometry_pipeline.SubmitIndex(vertex);
+                        continue;
+                    }
 
-                for (unsigned int i = 0; i < VERTEX_CACHE_SIZE; ++i) {
-                    if (vertex_cache_valid[i] && vertex == vertex_cache_ids[i]) {
-                        vs_output = vertex_cache[i];
+                    if (g_debug_context && Pica::g_debug_context->recorder) {
+                        int size = index_u16 ? 2 : 1;
+                        memory_accesses.AddAccess(base_address + index_info.offset + size * index,
+                                                  size);
+                    }
+
+                    // The vertex has already been shaded unless this is its first reference
+                    const u32 slot = vertex_cache->GetSlot(index);
+                    if (vertex_cache->GetFirstIndex(slot) != index) {
+                        vs_output = vertex_cache->Output(slot);
                         vertex_cache_hit = true;
-                        break;
                     }
                 }
-            }
 
-            if (!vertex_cache_hit) {
-                // Initialize data for the current vertex
-                Shader::AttributeBuffer input;
-                loader.LoadVertex(base_address, index, vertex, input, memory_accesses);
+                if (!vertex_cache_hit) {
+                    // Initialize data for the current vertex
+                    Shader::AttributeBuffer input;
+                    loader.LoadVertex(base_address, index, vertex, input, memory_accesses);
 
-                // Send to vertex shader
-                if (g_debug_context)
-                    g_debug_context->OnEvent(DebugContext::Event::VertexShaderInvocation,
-                                             (void*)&input);
-                shader_unit.LoadInput(regs.vs, input);
-                shader_engine->Run(g_state.vs, shader_unit);
-                shader_unit.WriteOutput(regs.vs, vs_output);
+                    // Send to vertex shader
+                    if (g_debug_context)
+                        g_debug_context->OnEvent(DebugContext::Event::VertexShaderInvocation,
+                                                 (void*)&input);
+                    shader_unit.LoadInput(regs.vs, input);
+                    shader_engine->Run(g_state.vs, shader_unit);
+                    shader_unit.WriteOutput(regs.vs, vs_output);
 
-                if (is_indexed) {
-                    vertex_cache[vertex_cache_pos] = vs_output;
-                    vertex_cache_valid[vertex_cache_pos] = true;
-                    vertex_cache_ids[vertex_cache_pos] = vertex;
-                    vertex_cache_pos = (vertex_cache_pos + 1) % VERTEX_CACHE_SIZE;
+                    if (is_indexed) {
+                        vertex_cache->Output(vertex_cache->GetSlot(index)) = vs_output;
+                    }
                 }
-            }
 
-            // Send to geometry pipeline
-            g_state.geometry_pipeline.SubmitVertex(vs_output);
+                // Send to geometry pipeline
+                g_state.geometry_pipeline.SubmitVertex(vs_output);
+            }
         }
 
         for (auto& range : memory_accesses.ranges) {
@@ -647,6 +870,8 @@ static void WritePicaReg(u32 id, u32 value, u32 mask) {
 
 void ProcessCommandList(PAddr list, u32 size) {
 
+    VideoCore::g_renderer->Rasterizer()->NotifyCommandListStarted();
+
     u32* buffer = (u32*)VideoCore::g_memory->GetPhysicalPointer(list);
 
     if (Pica::g_debug_context && Pica::g_debug_context->recorder) {
@@ -42,6 +42,10 @@ public:
     /// Notify rasterizer that the specified PICA register has been changed
     virtual void NotifyPicaRegisterChanged(u32 id) = 0;
 
+    /// Notify rasterizer that a command list is about to be processed. The emulated CPU may have
+    /// modified any memory since the previous one.
+    virtual void NotifyCommandListStarted() {}
+
     /// Notify rasterizer that all caches should be flushed to 3DS memory
     virtual void FlushAll() = 0;
 
@@ -169,37 +169,72 @@ template <bool morton_to_gl, PixelFormat format>
 static void MortonCopyTile(u32 stride, u8* tile_buffer, u8* gl_buffer) {
     constexpr u32 bytes_per_pixel = SurfaceParams::GetFormatBpp(format) / 8;
     constexpr u32 gl_bytes_per_pixel = CachedSurface::GetGLBytesPerPixel(format);
-    for (u32 y = 0; y < 8; ++y) {
-        for (u32 x = 0; x < 8; ++x) {
-            u8* tile_ptr = tile_buffer + VideoCore::MortonInterleave(x, y) * bytes_per_pixel;
-            u8* gl_ptr = gl_buffer + ((7 - y) * stride + x) * gl_bytes_per_pixel;
-            if constexpr (morton_to_gl) {
-                if constexpr (format == PixelFormat::D24S8) {
-                    gl_ptr[0] = tile_ptr[3];
-                    std::memcpy(gl_ptr + 1, tile_ptr, 3);
-                } else if (format == PixelFormat::RGBA8 && GLES) {
-                    // because GLES does not have ABGR format
-                    // so we will do byteswapping here
-                    gl_ptr[0] = tile_ptr[3];
-                    gl_ptr[1] = tile_ptr[2];
-                    gl_ptr[2] = tile_ptr[1];
-                    gl_ptr[3] = tile_ptr[0];
-                } else if (format == PixelFormat::RGB8 && GLES) {
-                    gl_ptr[0] = tile_ptr[2];
-                    gl_ptr[1] = tile_ptr[1];
-                    gl_ptr[2] = tile_ptr[0];
-                } else {
+
+    if constexpr (bytes_per_pixel != gl_bytes_per_pixel) {
+        // D24 is padded to 4 bytes per pixel in the GL buffer, which the tile copies can't do
+        for (u32 y = 0; y < 8; ++y) {
+            for (u32 x = 0; x < 8; ++x) {
+                u8* tile_ptr = tile_buffer + VideoCore::MortonInterleave(x, y) * bytes_per_pixel;
+                u8* gl_ptr = gl_buffer + ((7 - y) * stride + x) * gl_bytes_per_pixel;
+                if constexpr (morton_to_gl) {
                     std::memcpy(gl_ptr, tile_ptr, bytes_per_pixel);
-                }
-            } else {
-                if constexpr (format == PixelFormat::D24S8) {
-                    std::memcpy(tile_ptr, gl_ptr + 1, 3);
-                    tile_ptr[3] = gl_ptr[0];
                 } else {
                     std::memcpy(tile_ptr, gl_ptr, bytes_per_pixel);
                 }
             }
         }
+        return;
+    }
+
+    // GL rows are stored bottom to top
+    const std::ptrdiff_t gl_stride = -static_cast<std::ptrdiff_t>(stride * gl_bytes_per_pixel);
+    u8* const gl_first_row = gl_buffer - 7 * gl_stride;
+
+    if constexpr (morton_to_gl) {
+        VideoCore::UnswizzleTile<bytes_per_pixel>(tile_buffer, gl_first_row, gl_stride);
+
+        if constexpr (format == PixelFormat::D24S8) {
+            // Move the stencil byte from the top to the bottom of each pixel
+            for (u32 y = 0; y < 8; ++y) {
+                u8* gl_ptr = gl_buffer + y * stride * gl_bytes_per_pixel;
+                for (u32 x = 0; x < 8; ++x, gl_ptr += 4) {
+                    u32 value;
+                    std::memcpy(&value, gl_ptr, sizeof(u32));
+                    value = (value << 8) | (value >> 24);
+                    std::memcpy(gl_ptr, &value, sizeof(u32));
+                }
+            }
+        } else if (format == PixelFormat::RGBA8 && GLES) {
+            // because GLES does not have ABGR format
+            // so we will do byteswapping here
+            for (u32 y = 0; y < 8; ++y) {
+                u8* gl_ptr = gl_buffer + y * stride * gl_bytes_per_pixel;
+                for (u32 x = 0; x < 8; ++x, gl_ptr += 4) {
+                    std::swap(gl_ptr[0], gl_ptr[3]);
+                    std::swap(gl_ptr[1], gl_ptr[2]);
+                }
+            }
+        } else if (format == PixelFormat::RGB8 && GLES) {
+            for (u32 y = 0; y < 8; ++y) {
+                u8* gl_ptr = gl_buffer + y * stride * gl_bytes_per_pixel;
+                for (u32 x = 0; x < 8; ++x, gl_ptr += 3) {
+                    std::swap(gl_ptr[0], gl_ptr[2]);
+                }
+            }
+        }
+    } else {
+        VideoCore::SwizzleTile<bytes_per_pixel>(gl_first_row, gl_stride, tile_buffer);
+
+        if constexpr (format == PixelFormat::D24S8) {
+            // Move the stencil byte from the bottom to the top of each pixel
+            for (u32 i = 0; i < 64; ++i) {
+                u8* tile_ptr = tile_buffer + i * 4;
+                u32 value;
+                std::memcpy(&value, tile_ptr, sizeof(u32));
+                value = (value >> 8) | (value << 24);
+                std::memcpy(tile_ptr, &value, sizeof(u32));
+            }
+        }
     }
 }
 
@@ -631,14 +666,13 @@ void CachedSurface::LoadGLBuffer(PAddr load_start, PAddr load_end) {
             const auto rect = GetSubRect(FromInterval(load_interval));
             ASSERT(FromInterval(load_interval).GetInterval() == load_interval);
 
-            for (unsigned y = rect.bottom; y < rect.top; ++y) {
-                for (unsigned x = rect.left; x < rect.right; ++x) {
-                    auto vec4 =
-                        Pica::Texture::LookupTexture(texture_src_data, x, height - 1 - y, tex_info);
-                    const std::size_t offset = (x + (width * y)) * 4;
-                    std::memcpy(&gl_buffer[offset], vec4.AsArray(), 4);
-                }
-            }
+            // The texture is stored upside down compared to the GL buffer, so start at the top
+            // row of the rectangle and walk it downwards
+            const std::size_t row_size = width * 4;
+            Pica::Texture::DecodeTextureRect(
+                texture_src_data, tex_info, rect.left, height - rect.top, rect.right,
+                height - rect.bottom, &gl_buffer[(rect.top - 1) * row_size + rect.left * 4],
+                -static_cast<std::ptrdiff_t>(row_size));
         } else {
             morton_to_gl_fns[static_cast<std::size_t>(pixel_format)](stride, height, &gl_buffer[0],
                                                                      addr, load_start, load_end);
@@ -13,6 +13,8 @@
 #include "video_core/shader/shader.h"
 #include "video_core/shader/shader_interpreter.h"
 #ifdef ARCHITECTURE_x86_64
+#include "common/x64/cpu_detect.h"
+#include "video_core/shader/shader_jit_batch_x64.h"
 #include "video_core/shader/shader_jit_x64.h"
 #endif // ARCHITECTURE_x86_64
 #include "video_core/video_core.h"
@@ -136,6 +138,7 @@ MICROPROFILE_DEFINE(GPU_Shader, "GPU", "Shader", MP_RGB(50, 50, 240));
 
 #ifdef ARCHITECTURE_x86_64
 static std::unique_ptr<JitX64Engine> jit_engine;
+static std::unique_ptr<JitX64BatchEngine> jit_batch_engine;
 #endif // ARCHITECTURE_x86_64
 static InterpreterEngine interpreter_engine;
 
@@ -143,6 +146,14 @@ ShaderEngine* GetEngine() {
 #ifdef ARCHITECTURE_x86_64
     // TODO(yuriks): Re-initialize on each change rather than being persistent
     if (VideoCore::g_shader_jit_enabled) {
+        // The batched JIT relies on SSE4.1 for masked stores
+        if (VideoCore::g_shader_jit_batch_enabled && Common::GetCPUCaps().sse4_1) {
+            if (jit_batch_engine == nullptr) {
+                jit_batch_engine = std::make_unique<JitX64BatchEngine>();
+            }
+            return jit_batch_engine.get();
+        }
+
         if (jit_engine == nullptr) {
             jit_engine = std::make_unique<JitX64Engine>();
         }
@@ -156,6 +167,7 @@ ShaderEngine* GetEngine() {
 void Shutdown() {
 #ifdef ARCHITECTURE_x86_64
     jit_engine = nullptr;
+    jit_batch_engine = nullptr;
 #endif // ARCHITECTURE_x86_64
 }
 
@@ -278,6 +278,8 @@ struct ShaderSetup {
         unsigned int entry_point;
         /// Used by the JIT, points to a compiled shader object.
         const void* cached_shader = nullptr;
+        /// Used by the batched JIT, points to a compiled batch shader object if there is one.
+        const void* cached_batch_shader = nullptr;
     } engine_data;
 
     void MarkProgramCodeDirty() {
@@ -340,6 +342,19 @@ public:
      * @param state Shader unit state, must be setup with input data before each shader invocation.
      */
     virtual void Run(const ShaderSetup& setup, UnitState& state) const = 0;
+
+    /**
+     * Runs the currently setup shader for several vertices. Engines which can process multiple
+     * vertices at once override this, the default implementation runs them one after another.
+     *
+     * @param setup Shader engine state, must be setup with SetupBatch on each shader change.
+     * @param states Array of `count` shader unit states, each setup with input data.
+     */
+    virtual void RunBatch(const ShaderSetup& setup, UnitState* states, std::size_t count) const {
+        for (std::size_t i = 0; i < count; ++i) {
+            Run(setup, states[i]);
+        }
+    }
 };
 
 // TODO(yuriks): Remove and make it non-global state somewhere
@@ -0,0 +1,69 @@
+// Copyright 2020 Citra Emulator Project
+// Licensed under GPLv2 or any later version
+// Refer to the license.txt file included.
+
+#include <array>
+#include "common/hash.h"
+#include "common/microprofile.h"
+#include "video_core/shader/shader.h"
+#include "video_core/shader/shader_jit_batch_x64.h"
+#include "video_core/shader/shader_jit_batch_x64_compiler.h"
+
+namespace Pica::Shader {
+
+JitX64BatchEngine::JitX64BatchEngine() = default;
+JitX64BatchEngine::~JitX64BatchEngine() = default;
+
+void JitX64BatchEngine::SetupBatch(ShaderSetup& setup, unsigned int entry_point) {
+    scalar_engine.SetupBatch(setup, entry_point);
+
+    // Only the code reachable from the entry point is compiled, so it's part of the key
+    const std::array<u64, 3> key_data{setup.GetProgramCodeHash(), setup.GetSwizzleDataHash(),
+                                      entry_point};
+    const u64 cache_key = Common::ComputeStructHash64(key_data);
+
+    auto iter = cache.find(cache_key);
+    if (iter != cache.end()) {
+        setup.engine_data.cached_batch_shader = iter->second.get();
+    } else {
+        auto shader = std::make_unique<JitBatchShader>();
+        if (!shader->Compile(&setup.program_code, &setup.swizzle_data, entry_point)) {
+            shader = nullptr;
+        }
+        setup.engine_data.cached_batch_shader = shader.get();
+        cache.emplace_hint(iter, cache_key, std::move(shader));
+    }
+}
+
+void JitX64BatchEngine::Run(const ShaderSetup& setup, UnitState& state) const {
+    scalar_engine.Run(setup, state);
+}
+
+MICROPROFILE_DECLARE(GPU_Shader);
+
+void JitX64BatchEngine::RunBatch(const ShaderSetup& setup, UnitState* states,
+                                 std::size_t count) const {
+    const JitBatchShader* shader =
+        static_cast<const JitBatchShader*>(setup.engine_data.cached_batch_shader);
+
+    std::size_t i = 0;
+    if (shader != nullptr) {
+        for (; i + BatchUnitState::NUM_LANES <= count; i += BatchUnitState::NUM_LANES) {
+            bool completed;
+            {
+                MICROPROFILE_SCOPE(GPU_Shader);
+                completed = shader->Run(setup, states + i);
+            }
+
+            if (!completed) {
+                // The lanes diverged, so run the vertices of this batch one by one instead
+                scalar_engine.RunBatch(setup, states + i, BatchUnitState::NUM_LANES);
+            }
+        }
+    }
+
+    // Vertices that don't fill a whole batch
+    scalar_engine.RunBatch(setup, states + i, count - i);
+}
+
+} // namespace Pica::Shader
@@ -0,0 +1,38 @@
+// Copyright 2020 Citra Emulator Project
+// Licensed under GPLv2 or any later version
+// Refer to the license.txt file included.
+
+#pragma once
+
+#include <memory>
+#include <unordered_map>
+#include "common/common_types.h"
+#include "video_core/shader/shader.h"
+#include "video_core/shader/shader_jit_x64.h"
+
+namespace Pica::Shader {
+
+class JitBatchShader;
+
+/**
+ * Shader engine running batches of vertices through the batched shader JIT, which processes
+ * several vertices at once in the lanes of SSE registers. Single vertices, as well as shaders and
+ * batches that can't be run in lockstep, are handled by the scalar shader JIT.
+ */
+class JitX64BatchEngine final : public ShaderEngine {
+public:
+    JitX64BatchEngine();
+    ~JitX64BatchEngine() override;
+
+    void SetupBatch(ShaderSetup& setup, unsigned int entry_point) override;
+    void Run(const ShaderSetup& setup, UnitState& state) const override;
+    void RunBatch(const ShaderSetup& setup, UnitState* states, std::size_t count) const override;
+
+private:
+    JitX64Engine scalar_engine;
+
+    /// Compiled batch shaders, holding nullptr for the shaders that can't be run in lockstep
+    std::unordered_map<u64, std::unique_ptr<JitBatchShader>> cache;
+};
+
+} // namespace Pica::Shader
@@ -0,0 +1,1190 @@
+// Copyright 2020 Citra Emulator Project
+// Licensed under GPLv2 or any later version
+// Refer to the license.txt file included.
+
+#include <algorithm>
+#include <cstdint>
+#include <nihstro/shader_bytecode.h>
+#include <smmintrin.h>
+#include <xmmintrin.h>
+#include "common/assert.h"
+#include "common/logging/log.h"
+#include "common/x64/xbyak_abi.h"
+#include "common/x64/xbyak_util.h"
+#include "video_core/pica_types.h"
+#include "video_core/shader/shader.h"
+#include "video_core/shader/shader_jit_batch_x64_compiler.h"
+
+using namespace Common::X64;
+using namespace Xbyak::util;
+using Xbyak::Label;
+using Xbyak::Reg32;
+using Xbyak::Reg64;
+using Xbyak::Xmm;
+
+namespace Pica::Shader {
+
+typedef void (JitBatchShader::*JitFunction)(Instruction instr);
+
+const JitFunction instr_table[64] = {
+    &JitBatchShader::Compile_ADD,    // add
+    &JitBatchShader::Compile_DP3,    // dp3
+    &JitBatchShader::Compile_DP4,    // dp4
+    &JitBatchShader::Compile_DPH,    // dph
+    nullptr,                         // unknown
+    &JitBatchShader::Compile_EX2,    // ex2
+    &JitBatchShader::Compile_LG2,    // lg2
+    nullptr,                         // unknown
+    &JitBatchShader::Compile_MUL,    // mul
+    &JitBatchShader::Compile_SGE,    // sge
+    &JitBatchShader::Compile_SLT,    // slt
+    &JitBatchShader::Compile_FLR,    // flr
+    &JitBatchShader::Compile_MAX,    // max
+    &JitBatchShader::Compile_MIN,    // min
+    &JitBatchShader::Compile_RCP,    // rcp
+    &JitBatchShader::Compile_RSQ,    // rsq
+    nullptr,                         // unknown
+    nullptr,                         // unknown
+    nullptr,                         // mova
+    &JitBatchShader::Compile_MOV,    // mov
+    nullptr,                         // unknown
+    nullptr,                         // unknown
+    nullptr,                         // unknown
+    nullptr,                         // unknown
+    &JitBatchShader::Compile_DPH,    // dphi
+    nullptr,                         // unknown
+    &JitBatchShader::Compile_SGE,    // sgei
+    &JitBatchShader::Compile_SLT,    // slti
+    nullptr,                         // unknown
+    nullptr,                         // unknown
+    nullptr,                         // unknown
+    nullptr,                         // unknown
+    nullptr,                         // unknown
+    &JitBatchShader::Compile_NOP,    // nop
+    &JitBatchShader::Compile_END,    // end
+    &JitBatchShader::Compile_BREAKC, // breakc
+    &JitBatchShader::Compile_CALL,   // call
+    &JitBatchShader::Compile_CALLC,  // callc
+    &JitBatchShader::Compile_CALLU,  // callu
+    &JitBatchShader::Compile_IF,     // ifu
+    &JitBatchShader::Compile_IF,     // ifc
+    &JitBatchShader::Compile_LOOP,   // loop
+    nullptr,                         // emit
+    nullptr,                         // sete
+    &JitBatchShader::Compile_JMP,    // jmpc
+    &JitBatchShader::Compile_JMP,    // jmpu
+    &JitBatchShader::Compile_CMP,    // cmp
+    &JitBatchShader::Compile_CMP,    // cmp
+    &JitBatchShader::Compile_MAD,    // madi
+    &JitBatchShader::Compile_MAD,    // madi
+    &JitBatchShader::Compile_MAD,    // madi
+    &JitBatchShader::Compile_MAD,    // madi
+    &JitBatchShader::Compile_MAD,    // madi
+    &JitBatchShader::Compile_MAD,    // madi
+    &JitBatchShader::Compile_MAD,    // madi
+    &JitBatchShader::Compile_MAD,    // madi
+    &JitBatchShader::Compile_MAD,    // mad
+    &JitBatchShader::Compile_MAD,    // mad
+    &JitBatchShader::Compile_MAD,    // mad
+    &JitBatchShader::Compile_MAD,    // mad
+    &JitBatchShader::Compile_MAD,    // mad
+    &JitBatchShader::Compile_MAD,    // mad
+    &JitBatchShader::Compile_MAD,    // mad
+    &JitBatchShader::Compile_MAD,    // mad
+};
+
+// The following is used to alias some commonly used registers. RAX-RDX can be used as scratch
+// registers within a compiler function. Every Pica register component occupies one XMM register,
+// holding the values of all lanes. The registers have designated purposes, as documented below:
+
+/// Pointer to the uniform memory
+static const Reg64 UNIFORMS = r9;
+/// Pointer to the unit state of the first lane, the unit states of the other lanes follow it
+static const Reg64 LANES = r13;
+/// Stack pointer after the prologue, used to leave the program from within subroutines
+static const Reg64 FRAME = r14;
+/// Pointer to the BatchUnitState instance of the batch
+static const Reg64 STATE = r15;
+/// Current VS loop iteration number
+static const Reg32 LOOPCOUNT = esi;
+/// Mask of the lanes executing the current IFC block. This must be XMM0, which is the implicit
+/// mask operand of BLENDVPS
+static const Xmm EXEC = xmm0;
+/// Loaded with the components of the first swizzled source register
+static const std::array<Xmm, 4> SRC1 = {xmm1, xmm2, xmm3, xmm4};
+/// Loaded with the components of the second swizzled source register
+static const std::array<Xmm, 4> SRC2 = {xmm5, xmm6, xmm7, xmm8};
+/// Loaded with the components of the third swizzled source register
+static const std::array<Xmm, 4> SRC3 = {xmm9, xmm10, xmm11, xmm12};
+/// SIMD scratch registers
+static const Xmm SCRATCH = xmm13;
+static const Xmm SCRATCH2 = xmm14;
+/// Scratch register only used to store to a destination register
+static const Xmm STORE_SCRATCH = xmm15;
+
+/// Space reserved for the code of a single instruction, and for the prologue and epilogue
+constexpr std::size_t MAX_INSTRUCTION_CODE_SIZE = 16 * 1024;
+
+bool JitBatchShader::SubroutineContainsLoop(unsigned offset, unsigned num_instructions,
+                                            unsigned depth) const {
+    if (depth > 8) {
+        return true;
+    }
+    const unsigned end = std::min<unsigned>(offset + num_instructions, MAX_PROGRAM_CODE_LENGTH);
+    for (unsigned i = offset; i < end; ++i) {
+        Instruction instr = {(*program_code)[i]};
+        switch (instr.opcode.Value()) {
+        case OpCode::Id::LOOP:
+            return true;
+        case OpCode::Id::CALL:
+        case OpCode::Id::CALLC:
+        case OpCode::Id::CALLU:
+            if (SubroutineContainsLoop(instr.flow_control.dest_offset,
+                                       instr.flow_control.num_instructions, depth + 1)) {
+                return true;
+            }
+            break;
+        default:
+            break;
+        }
+    }
+    return false;
+}
+
+static std::size_t ConditionalCodeOffset(unsigned index) {
+    return offsetof(BatchUnitState, conditional_code) + index * sizeof(BatchUnitState::LaneMask);
+}
+
+void JitBatchShader::Reject(const char* reason) {
+    if (supported) {
+        LOG_DEBUG(HW_GPU, "Shader can't be run in lockstep: {}", reason);
+    }
+    supported = false;
+}
+
+void JitBatchShader::Compile_SwizzleSrc(Instruction instr, unsigned src_num,
+                                        SourceRegister src_reg, const Vec4Regs& dest,
+                                        unsigned components) {
+    unsigned operand_desc_id;
+
+    const bool is_inverted =
+        (0 != (instr.opcode.Value().GetInfo().subtype & OpCode::Info::SrcInversed));
+
+    unsigned address_register_index;
+    unsigned offset_src;
+
+    if (instr.opcode.Value().EffectiveOpCode() == OpCode::Id::MAD ||
+        instr.opcode.Value().EffectiveOpCode() == OpCode::Id::MADI) {
+        operand_desc_id = instr.mad.operand_desc_id;
+        offset_src = is_inverted ? 3 : 2;
+        address_register_index = instr.mad.address_register_index;
+    } else {
+        operand_desc_id = instr.common.operand_desc_id;
+        offset_src = is_inverted ? 2 : 1;
+        address_register_index = instr.common.address_register_index;
+    }
+
+    // The address registers may hold a different value in each lane
+    if (src_num == offset_src && address_register_index != 0) {
+        Reject("Relative addressing");
+        return;
+    }
+
+    SwizzlePattern swiz = {(*swizzle_data)[operand_desc_id]};
+    const u8 sel = swiz.GetRawSelector(src_num);
+    const bool negate[] = {swiz.negate_src1, swiz.negate_src2, swiz.negate_src3};
+
+    if (src_reg.GetRegisterType() == RegisterType::Input) {
+        used_inputs[src_reg.GetIndex()] = true;
+    } else if (src_reg.GetRegisterType() == RegisterType::Temporary) {
+        used_temporaries[src_reg.GetIndex()] = true;
+    }
+
+    for (int i : BitSet32(components)) {
+        // The selector of the first component is stored in the most significant bits
+        const unsigned component = (sel >> (6 - 2 * i)) & 3;
+
+        if (src_reg.GetRegisterType() == RegisterType::FloatUniform) {
+            // Uniforms are the same for all lanes
+            const std::size_t offset = Uniforms::GetFloatUniformOffset(src_reg.GetIndex()) +
+                                       component * sizeof(float24);
+            movss(dest[i], dword[UNIFORMS + offset]);
+            shufps(dest[i], dest[i], _MM_SHUFFLE(0, 0, 0, 0));
+        } else {
+            movaps(dest[i], xword[STATE + BatchUnitState::InputOffset(src_reg, component)]);
+        }
+
+        if (negate[src_num - 1]) {
+            xorps(dest[i], xword[rip + negbit]);
+        }
+    }
+}
+
+unsigned JitBatchShader::DestComponents(Instruction instr) const {
+    unsigned operand_desc_id;
+    if (instr.opcode.Value().EffectiveOpCode() == OpCode::Id::MAD ||
+        instr.opcode.Value().EffectiveOpCode() == OpCode::Id::MADI) {
+        operand_desc_id = instr.mad.operand_desc_id;
+    } else {
+        operand_desc_id = instr.common.operand_desc_id;
+    }
+
+    SwizzlePattern swiz = {(*swizzle_data)[operand_desc_id]};
+
+    unsigned components = 0;
+    for (unsigned i = 0; i < 4; ++i) {
+        if (swiz.DestComponentEnabled(i)) {
+            components |= 1 << i;
+        }
+    }
+    return components;
+}
+
+void JitBatchShader::Compile_StoreComponent(std::size_t offset, Xmm value) {
+    if (if_depth == 0) {
+        movaps(xword[STATE + offset], value);
+    } else {
+        // Only update the lanes executing the current IFC block
+        movaps(STORE_SCRATCH, xword[STATE + offset]);
+        blendvps(STORE_SCRATCH, value);
+        movaps(xword[STATE + offset], STORE_SCRATCH);
+    }
+}
+
+void JitBatchShader::Compile_DestEnable(Instruction instr, const Vec4Regs& src) {
+    DestRegister dest;
+    if (instr.opcode.Value().EffectiveOpCode() == OpCode::Id::MAD ||
+        instr.opcode.Value().EffectiveOpCode() == OpCode::Id::MADI) {
+        dest = instr.mad.dest.Value();
+    } else {
+        dest = instr.common.dest.Value();
+    }
+
+    if (dest.GetRegisterType() == RegisterType::Output) {
+        used_outputs[dest.GetIndex()] = true;
+    } else if (dest.GetRegisterType() == RegisterType::Temporary) {
+        used_temporaries[dest.GetIndex()] = true;
+    } else {
+        Reject("Invalid destination register");
+        return;
+    }
+
+    for (int i : BitSet32(DestComponents(instr))) {
+        Compile_StoreComponent(BatchUnitState::OutputOffset(dest, i), src[i]);
+    }
+}
+
+void JitBatchShader::Compile_DestEnableBroadcast(Instruction instr, Xmm value) {
+    Compile_DestEnable(instr, {value, value, value, value});
+}
+
+void JitBatchShader::Compile_SanitizedMul(Xmm src1, Xmm src2, Xmm scratch) {
+    // Set scratch to mask of (src1 != NaN and src2 != NaN)
+    movaps(scratch, src1);
+    cmpordps(scratch, src2);
+
+    mulps(src1, src2);
+
+    // Set src2 to mask of (result == NaN)
+    movaps(src2, src1);
+    cmpunordps(src2, src2);
+
+    // Clear components where scratch != src2 (i.e. if result is NaN where neither source was NaN)
+    xorps(scratch, src2);
+    andps(src1, scratch);
+}
+
+void JitBatchShader::Compile_EvaluateCondition(Instruction instr, Xmm dest) {
+    // Loads the mask of the lanes whose conditional code matches the reference value
+    const auto compare = [this](Xmm reg, unsigned index, bool reference) {
+        movaps(reg, xword[STATE + ConditionalCodeOffset(index)]);
+        if (!reference) {
+            xorps(reg, xword[rip + all_ones]);
+        }
+    };
+
+    switch (instr.flow_control.op) {
+    case Instruction::FlowControlType::Or:
+        compare(dest, 0, instr.flow_control.refx.Value());
+        compare(SCRATCH, 1, instr.flow_control.refy.Value());
+        orps(dest, SCRATCH);
+        break;
+
+    case Instruction::FlowControlType::And:
+        compare(dest, 0, instr.flow_control.refx.Value());
+        compare(SCRATCH, 1, instr.flow_control.refy.Value());
+        andps(dest, SCRATCH);
+        break;
+
+    case Instruction::FlowControlType::JustX:
+        compare(dest, 0, instr.flow_control.refx.Value());
+        break;
+
+    case Instruction::FlowControlType::JustY:
+        compare(dest, 1, instr.flow_control.refy.Value());
+        break;
+    }
+}
+
+void JitBatchShader::Compile_UniformCondition(Instruction instr) {
+    std::size_t offset = Uniforms::GetBoolUniformOffset(instr.flow_control.bool_uniform_id);
+    cmp(byte[UNIFORMS + offset], 0);
+}
+
+void JitBatchShader::Compile_JumpIfAllLanes(Instruction instr, Label& target) {
+    Compile_EvaluateCondition(instr, SCRATCH2);
+    movmskps(eax, SCRATCH2);
+    cmp(eax, 0xF);
+    je(target, T_NEAR);
+    test(eax, eax);
+    jnz(diverged_label, T_NEAR);
+}
+
+void JitBatchShader::Compile_ADD(Instruction instr) {
+    const unsigned components = DestComponents(instr);
+    Compile_SwizzleSrc(instr, 1, instr.common.src1, SRC1, components);
+    Compile_SwizzleSrc(instr, 2, instr.common.src2, SRC2, components);
+    for (int i : BitSet32(components)) {
+        addps(SRC1[i], SRC2[i]);
+    }
+    Compile_DestEnable(instr, SRC1);
+}
+
+void JitBatchShader::Compile_DP3(Instruction instr) {
+    Compile_SwizzleSrc(instr, 1, instr.common.src1, SRC1, 0x7);
+    Compile_SwizzleSrc(instr, 2, instr.common.src2, SRC2, 0x7);
+
+    for (std::size_t i = 0; i < 3; ++i) {
+        Compile_SanitizedMul(SRC1[i], SRC2[i], SCRATCH);
+    }
+
+    // Summed in the same order as in JitShader
+    addps(SRC1[0], SRC1[1]);
+    addps(SRC1[0], SRC1[2]);
+
+    Compile_DestEnableBroadcast(instr, SRC1[0]);
+}
+
+void JitBatchShader::Compile_DP4(Instruction instr) {
+    Compile_SwizzleSrc(instr, 1, instr.common.src1, SRC1, 0xF);
+    Compile_SwizzleSrc(instr, 2, instr.common.src2, SRC2, 0xF);
+
+    for (std::size_t i = 0; i < 4; ++i) {
+        Compile_SanitizedMul(SRC1[i], SRC2[i], SCRATCH);
+    }
+
+    // Summed in the same order as the two HADDPS of JitShader
+    addps(SRC1[0], SRC1[1]);
+    addps(SRC1[2], SRC1[3]);
+    addps(SRC1[0], SRC1[2]);
+
+    Compile_DestEnableBroadcast(instr, SRC1[0]);
+}
+
+void JitBatchShader::Compile_DPH(Instruction instr) {
+    if (instr.opcode.Value().EffectiveOpCode() == OpCode::Id::DPHI) {
+        Compile_SwizzleSrc(instr, 1, instr.common.src1i, SRC1, 0x7);
+        Compile_SwizzleSrc(instr, 2, instr.common.src2i, SRC2, 0xF);
+    } else {
+        Compile_SwizzleSrc(instr, 1, instr.common.src1, SRC1, 0x7);
+        Compile_SwizzleSrc(instr, 2, instr.common.src2, SRC2, 0xF);
+    }
+
+    // Set 4th component to 1.0
+    movaps(SRC1[3], xword[rip + one]);
+
+    for (std::size_t i = 0; i < 4; ++i) {
+        Compile_SanitizedMul(SRC1[i], SRC2[i], SCRATCH);
+    }
+
+    addps(SRC1[0], SRC1[1]);
+    addps(SRC1[2], SRC1[3]);
+    addps(SRC1[0], SRC1[2]);
+
+    Compile_DestEnableBroadcast(instr, SRC1[0]);
+}
+
+void JitBatchShader::Compile_EX2(Instruction instr) {
+    Compile_SwizzleSrc(instr, 1, instr.common.src1, SRC1, 0x1);
+    call(exp2_subroutine);
+    Compile_DestEnableBroadcast(instr, SRC1[0]);
+}
+
+void JitBatchShader::Compile_LG2(Instruction instr) {
+    Compile_SwizzleSrc(instr, 1, instr.common.src1, SRC1, 0x1);
+    call(log2_subroutine);
+    Compile_DestEnableBroadcast(instr, SRC1[0]);
+}
+
+void JitBatchShader::Compile_MUL(Instruction instr) {
+    const unsigned components = DestComponents(instr);
+    Compile_SwizzleSrc(instr, 1, instr.common.src1, SRC1, components);
+    Compile_SwizzleSrc(instr, 2, instr.common.src2, SRC2, components);
+    for (int i : BitSet32(components)) {
+        Compile_SanitizedMul(SRC1[i], SRC2[i], SCRATCH);
+    }
+    Compile_DestEnable(instr, SRC1);
+}
+
+void JitBatchShader::Compile_SGE(Instruction instr) {
+    const unsigned components = DestComponents(instr);
+    if (instr.opcode.Value().EffectiveOpCode() == OpCode::Id::SGEI) {
+        Compile_SwizzleSrc(instr, 1, instr.common.src1i, SRC1, components);
+        Compile_SwizzleSrc(instr, 2, instr.common.src2i, SRC2, components);
+    } else {
+        Compile_SwizzleSrc(instr, 1, instr.common.src1, SRC1, components);
+        Compile_SwizzleSrc(instr, 2, instr.common.src2, SRC2, components);
+    }
+
+    for (int i : BitSet32(components)) {
+        cmpleps(SRC2[i], SRC1[i]);
+        andps(SRC2[i], xword[rip + one]);
+    }
+
+    Compile_DestEnable(instr, SRC2);
+}
+
+void JitBatchShader::Compile_SLT(Instruction instr) {
+    const unsigned components = DestComponents(instr);
+    if (instr.opcode.Value().EffectiveOpCode() == OpCode::Id::SLTI) {
+        Compile_SwizzleSrc(instr, 1, instr.common.src1i, SRC1, components);
+        Compile_SwizzleSrc(instr, 2, instr.common.src2i, SRC2, components);
+    } else {
+        Compile_SwizzleSrc(instr, 1, instr.common.src1, SRC1, components);
+        Compile_SwizzleSrc(instr, 2, instr.common.src2, SRC2, components);
+    }
+
+    for (int i : BitSet32(components)) {
+        cmpltps(SRC1[i], SRC2[i]);
+        andps(SRC1[i], xword[rip + one]);
+    }
+
+    Compile_DestEnable(instr, SRC1);
+}
+
+void JitBatchShader::Compile_FLR(Instruction instr) {
+    const unsigned components = DestComponents(instr);
+    Compile_SwizzleSrc(instr, 1, instr.common.src1, SRC1, components);
+    for (int i : BitSet32(components)) {
+        roundps(SRC1[i], SRC1[i], _MM_FROUND_FLOOR);
+    }
+    Compile_DestEnable(instr, SRC1);
+}
+
+void JitBatchShader::Compile_MAX(Instruction instr) {
+    const unsigned components = DestComponents(instr);
+    Compile_SwizzleSrc(instr, 1, instr.common.src1, SRC1, components);
+    Compile_SwizzleSrc(instr, 2, instr.common.src2, SRC2, components);
+    // SSE semantics match PICA200 ones: In case of NaN, SRC2 is returned.
+    for (int i : BitSet32(components)) {
+        maxps(SRC1[i], SRC2[i]);
+    }
+    Compile_DestEnable(instr, SRC1);
+}
+
+void JitBatchShader::Compile_MIN(Instruction instr) {
+    const unsigned components = DestComponents(instr);
+    Compile_SwizzleSrc(instr, 1, instr.common.src1, SRC1, components);
+    Compile_SwizzleSrc(instr, 2, instr.common.src2, SRC2, components);
+    // SSE semantics match PICA200 ones: In case of NaN, SRC2 is returned.
+    for (int i : BitSet32(components)) {
+        minps(SRC1[i], SRC2[i]);
+    }
+    Compile_DestEnable(instr, SRC1);
+}
+
+void JitBatchShader::Compile_MOV(Instruction instr) {
+    Compile_SwizzleSrc(instr, 1, instr.common.src1, SRC1, DestComponents(instr));
+    Compile_DestEnable(instr, SRC1);
+}
+
+void JitBatchShader::Compile_RCP(Instruction instr) {
+    Compile_SwizzleSrc(instr, 1, instr.common.src1, SRC1, 0x1);
+
+    // Same approximation as the RCPSS used by JitShader
+    rcpps(SRC1[0], SRC1[0]);
+
+    Compile_DestEnableBroadcast(instr, SRC1[0]);
+}
+
+void JitBatchShader::Compile_RSQ(Instruction instr) {
+    Compile_SwizzleSrc(instr, 1, instr.common.src1, SRC1, 0x1);
+
+    // Same approximation as the RSQRTSS used by JitShader
+    rsqrtps(SRC1[0], SRC1[0]);
+
+    Compile_DestEnableBroadcast(instr, SRC1[0]);
+}
+
+void JitBatchShader::Compile_NOP(Instruction instr) {}
+
+void JitBatchShader::Compile_END(Instruction instr) {
+    jmp(end_label, T_NEAR);
+}
+
+void JitBatchShader::Compile_BREAKC(Instruction instr) {
+    if (!looping) {
+        Reject("BREAKC outside of a LOOP");
+        return;
+    }
+    ASSERT(loop_break_label);
+    Compile_JumpIfAllLanes(instr, *loop_break_label);
+}
+
+void JitBatchShader::Compile_CALL(Instruction instr) {
+    // LOOPCOUNT isn't saved across calls, so a loop within the subroutine would clobber it
+    if (looping && SubroutineContainsLoop(instr.flow_control.dest_offset,
+                                          instr.flow_control.num_instructions)) {
+        Reject("Nested loop within a subroutine");
+        return;
+    }
+
+    // Push offset of the return
+    push(qword, (instr.flow_control.dest_offset + instr.flow_control.num_instructions));
+
+    // Call the subroutine
+    call(instruction_labels[instr.flow_control.dest_offset]);
+
+    // Skip over the return offset that's on the stack
+    add(rsp, 8);
+}
+
+void JitBatchShader::Compile_CALLC(Instruction instr) {
+    Compile_EvaluateCondition(instr, SCRATCH2);
+    movmskps(eax, SCRATCH2);
+    Label b;
+    test(eax, eax);
+    jz(b, T_NEAR);
+    cmp(eax, 0xF);
+    jne(diverged_label, T_NEAR);
+    Compile_CALL(instr);
+    L(b);
+}
+
+void JitBatchShader::Compile_CALLU(Instruction instr) {
+    Compile_UniformCondition(instr);
+    Label b;
+    jz(b);
+    Compile_CALL(instr);
+    L(b);
+}
+
+void JitBatchShader::Compile_CMP(Instruction instr) {
+    using Op = Instruction::Common::CompareOpType::Op;
+    const Op ops[] = {instr.common.compare_op.x, instr.common.compare_op.y};
+
+    Compile_SwizzleSrc(instr, 1, instr.common.src1, SRC1, 0x3);
+    Compile_SwizzleSrc(instr, 2, instr.common.src2, SRC2, 0x3);
+
+    // SSE doesn't have greater-than (GT) or greater-equal (GE) comparison operators. You need to
+    // emulate them by swapping the lhs and rhs and using LT and LE. NLT and NLE can't be used here
+    // because they don't match when used with NaNs.
+    static const u8 cmp[] = {CMP_EQ, CMP_NEQ, CMP_LT, CMP_LE, CMP_LT, CMP_LE};
+
+    for (unsigned i = 0; i < 2; ++i) {
+        if (ops[i] > Op::GreaterEqual) {
+            Reject("Unknown compare mode");
+            return;
+        }
+
+        const bool invert_op = (ops[i] == Op::GreaterThan || ops[i] == Op::GreaterEqual);
+        const Xmm lhs = invert_op ? SRC2[i] : SRC1[i];
+        const Xmm rhs = invert_op ? SRC1[i] : SRC2[i];
+
+        cmpps(lhs, rhs, cmp[ops[i]]);
+        Compile_StoreComponent(ConditionalCodeOffset(i), lhs);
+    }
+}
+
+void JitBatchShader::Compile_MAD(Instruction instr) {
+    const unsigned components = DestComponents(instr);
+    Compile_SwizzleSrc(instr, 1, instr.mad.src1, SRC1, components);
+
+    if (instr.opcode.Value().EffectiveOpCode() == OpCode::Id::MADI) {
+        Compile_SwizzleSrc(instr, 2, instr.mad.src2i, SRC2, components);
+        Compile_SwizzleSrc(instr, 3, instr.mad.src3i, SRC3, components);
+    } else {
+        Compile_SwizzleSrc(instr, 2, instr.mad.src2, SRC2, components);
+        Compile_SwizzleSrc(instr, 3, instr.mad.src3, SRC3, components);
+    }
+
+    for (int i : BitSet32(components)) {
+        Compile_SanitizedMul(SRC1[i], SRC2[i], SCRATCH);
+        addps(SRC1[i], SRC3[i]);
+    }
+
+    Compile_DestEnable(instr, SRC1);
+}
+
+void JitBatchShader::Compile_IF(Instruction instr) {
+    if (instr.flow_control.dest_offset < program_counter) {
+        Reject("Backwards if-statement");
+        return;
+    }
+    Label l_else, l_endif;
+
+    if (instr.opcode.Value() == OpCode::Id::IFU) {
+        // The condition is the same for all lanes, so this is compiled like in JitShader
+        Compile_UniformCondition(instr);
+        jz(l_else, T_NEAR);
+
+        Compile_Block(instr.flow_control.dest_offset);
+
+        if (instr.flow_control.num_instructions == 0) {
+            L(l_else);
+            return;
+        }
+
+        jmp(l_endif, T_NEAR);
+
+        L(l_else);
+        Compile_Block(instr.flow_control.dest_offset + instr.flow_control.num_instructions);
+
+        L(l_endif);
+        return;
+    }
+
+    if (if_depth == MAX_BATCH_IF_NESTING) {
+        Reject("IFC blocks nested too deeply");
+        return;
+    }
+
+    // Both sides of the branch are executed by the lanes taking them, skipping the sides that no
+    // lane takes
+    const std::size_t saved_exec =
+        offsetof(BatchUnitState, if_stack) + if_depth * 2 * sizeof(BatchUnitState::LaneMask);
+    const std::size_t condition = saved_exec + sizeof(BatchUnitState::LaneMask);
+
+    Compile_EvaluateCondition(instr, SCRATCH2);
+    movaps(xword[STATE + saved_exec], EXEC);
+    movaps(xword[STATE + condition], SCRATCH2);
+
+    andps(EXEC, SCRATCH2);
+    movmskps(eax, EXEC);
+    test(eax, eax);
+    jz(l_else, T_NEAR);
+
+    ++if_depth;
+    Compile_Block(instr.flow_control.dest_offset);
+    --if_depth;
+
+    L(l_else);
+
+    if (instr.flow_control.num_instructions != 0) {
+        movaps(EXEC, xword[STATE + condition]);
+        andnps(EXEC, xword[STATE + saved_exec]);
+        movmskps(eax, EXEC);
+        test(eax, eax);
+        jz(l_endif, T_NEAR);
+
+        ++if_depth;
+        Compile_Block(instr.flow_control.dest_offset + instr.flow_control.num_instructions);
+        --if_depth;
+
+        L(l_endif);
+    }
+
+    movaps(EXEC, xword[STATE + saved_exec]);
+}
+
+void JitBatchShader::Compile_LOOP(Instruction instr) {
+    if (instr.flow_control.dest_offset < program_counter) {
+        Reject("Backwards loop");
+        return;
+    }
+    if (looping) {
+        Reject("Nested loop");
+        return;
+    }
+
+    looping = true;
+
+    // The loop counter register is only used for relative addressing, which is not supported, so
+    // only the iteration count (X-component + 1) of the integer uniform is used here
+    std::size_t offset = Uniforms::GetIntUniformOffset(instr.flow_control.int_uniform_id);
+    movzx(LOOPCOUNT, byte[UNIFORMS + offset]);
+    add(LOOPCOUNT, 1);
+
+    Label l_loop_start;
+    L(l_loop_start);
+
+    loop_break_label = Xbyak::Label();
+    Compile_Block(instr.flow_control.dest_offset + 1);
+
+    sub(LOOPCOUNT, 1); // Increment loop count by 1
+    jnz(l_loop_start, T_NEAR);
+    L(*loop_break_label);
+    loop_break_label.reset();
+
+    looping = false;
+}
+
+void JitBatchShader::Compile_JMP(Instruction instr) {
+    Label& b = instruction_labels[instr.flow_control.dest_offset];
+
+    if (instr.opcode.Value() == OpCode::Id::JMPC) {
+        Compile_JumpIfAllLanes(instr, b);
+        return;
+    }
+
+    Compile_UniformCondition(instr);
+
+    bool inverted_condition = (instr.flow_control.num_instructions & 1);
+    if (inverted_condition) {
+        jz(b, T_NEAR);
+    } else {
+        jnz(b, T_NEAR);
+    }
+}
+
+void JitBatchShader::Compile_Block(unsigned end) {
+    while (program_counter < end) {
+        Compile_NextInstr();
+    }
+}
+
+void JitBatchShader::Compile_Return() {
+    // Peek return offset on the stack and check if we're at that offset
+    mov(rax, qword[rsp + 8]);
+    cmp(eax, (program_counter));
+
+    // If so, jump back to before CALL
+    Label b;
+    jnz(b);
+    ret();
+    L(b);
+}
+
+void JitBatchShader::Compile_NextInstr() {
+    if (!supported) {
+        // Nothing emitted after rejecting the program will be used
+        ++program_counter;
+        return;
+    }
+
+    if (getSize() + MAX_INSTRUCTION_CODE_SIZE > MAX_BATCH_SHADER_SIZE) {
+        Reject("Program too large");
+        return;
+    }
+
+    if (std::binary_search(return_offsets.begin(), return_offsets.end(), program_counter)) {
+        if (if_depth > 0) {
+            Reject("Subroutine ending within an IFC block");
+            return;
+        }
+        Compile_Return();
+    }
+
+    L(instruction_labels[program_counter]);
+
+    if (!reachable[program_counter]) {
+        // Only compile the code reachable from the entry point, which avoids rejecting programs
+        // because of stale data following them
+        ++program_counter;
+        jmp(diverged_label, T_NEAR);
+        return;
+    }
+
+    Instruction instr = {(*program_code)[program_counter++]};
+
+    OpCode::Id opcode = instr.opcode.Value();
+
+    // Lanes that skipped the current IFC block must not take part in control flow leaving it
+    if (if_depth > 0) {
+        switch (opcode) {
+        case OpCode::Id::END:
+        case OpCode::Id::BREAKC:
+        case OpCode::Id::CALL:
+        case OpCode::Id::CALLC:
+        case OpCode::Id::CALLU:
+        case OpCode::Id::JMPC:
+        case OpCode::Id::JMPU:
+            Reject("Flow control within an IFC block");
+            return;
+        default:
+            break;
+        }
+    }
+
+    auto instr_func = instr_table[static_cast<unsigned>(opcode)];
+    if (instr_func) {
+        // JIT the instruction!
+        ((*this).*instr_func)(instr);
+    } else {
+        Reject("Unsupported instruction");
+    }
+}
+
+void JitBatchShader::AnalyzeProgram(unsigned entry_point) {
+    return_offsets.clear();
+    reachable.assign(program_code->size(), false);
+
+    // Offsets to walk from, along with the end of the subroutine containing them
+    std::vector<std::pair<unsigned, unsigned>> pending{
+        {entry_point, static_cast<unsigned>(program_code->size())}};
+
+    while (!pending.empty()) {
+        auto [offset, subroutine_end] = pending.back();
+        pending.pop_back();
+
+        while (offset < subroutine_end && !reachable[offset]) {
+            reachable[offset] = true;
+
+            Instruction instr = {(*program_code)[offset]};
+            const unsigned dest_offset = instr.flow_control.dest_offset;
+            const unsigned return_offset = dest_offset + instr.flow_control.num_instructions;
+
+            switch (instr.opcode.Value()) {
+            case OpCode::Id::JMPC:
+            case OpCode::Id::JMPU:
+                pending.emplace_back(dest_offset, subroutine_end);
+                break;
+            case OpCode::Id::CALL:
+            case OpCode::Id::CALLC:
+            case OpCode::Id::CALLU:
+                pending.emplace_back(dest_offset, std::min(return_offset, subroutine_end));
+                return_offsets.push_back(return_offset);
+                break;
+            case OpCode::Id::IFU:
+            case OpCode::Id::IFC:
+                // The first side of the branch directly follows the instruction
+                pending.emplace_back(dest_offset, subroutine_end);
+                pending.emplace_back(return_offset, subroutine_end);
+                break;
+            case OpCode::Id::LOOP:
+                pending.emplace_back(dest_offset + 1, subroutine_end);
+                break;
+            default:
+                break;
+            }
+
+            if (instr.opcode.Value() == OpCode::Id::END) {
+                break;
+            }
+            ++offset;
+        }
+    }
+
+    // Sort for efficient binary search later
+    std::sort(return_offsets.begin(), return_offsets.end());
+    return_offsets.erase(std::unique(return_offsets.begin(), return_offsets.end()),
+                         return_offsets.end());
+}
+
+void JitBatchShader::Compile_TransposeRegisters(std::size_t lane_offset, std::size_t batch_offset,
+                                                BitSet32 registers, bool to_lanes) {
+    const auto lane_address = [&](int reg, std::size_t lane) {
+        return xword[LANES + lane * sizeof(UnitState) + lane_offset +
+                     reg * sizeof(Common::Vec4<float24>)];
+    };
+    const auto batch_address = [&](int reg, std::size_t component) {
+        return xword[STATE + batch_offset +
+                     (reg * 4 + component) * sizeof(BatchUnitState::LaneValues)];
+    };
+
+    for (int reg : registers) {
+        for (std::size_t i = 0; i < 4; ++i) {
+            movaps(SRC1[i], to_lanes ? batch_address(reg, i) : lane_address(reg, i));
+        }
+
+        // 4x4 transpose, which turns the components of each lane into the lanes of each component
+        // and vice versa
+        movaps(SRC3[0], SRC1[0]);
+        unpcklps(SRC3[0], SRC1[1]);
+        movaps(SRC3[1], SRC1[2]);
+        unpcklps(SRC3[1], SRC1[3]);
+        movaps(SRC3[2], SRC1[0]);
+        unpckhps(SRC3[2], SRC1[1]);
+        movaps(SRC3[3], SRC1[2]);
+        unpckhps(SRC3[3], SRC1[3]);
+
+        movaps(SRC2[0], SRC3[0]);
+        movlhps(SRC2[0], SRC3[1]);
+        movaps(SRC2[1], SRC3[1]);
+        movhlps(SRC2[1], SRC3[0]);
+        movaps(SRC2[2], SRC3[2]);
+        movlhps(SRC2[2], SRC3[3]);
+        movaps(SRC2[3], SRC3[3]);
+        movhlps(SRC2[3], SRC3[2]);
+
+        for (std::size_t i = 0; i < 4; ++i) {
+            movaps(to_lanes ? lane_address(reg, i) : batch_address(reg, i), SRC2[i]);
+        }
+    }
+}
+
+bool JitBatchShader::Compile(const std::array<u32, MAX_PROGRAM_CODE_LENGTH>* program_code_,
+                             const std::array<u32, MAX_SWIZZLE_DATA_LENGTH>* swizzle_data_,
+                             unsigned entry_point) {
+    program_code = program_code_;
+    swizzle_data = swizzle_data_;
+
+    // Reset flow control state
+    program_counter = 0;
+    looping = false;
+    if_depth = 0;
+    supported = true;
+    used_inputs = used_temporaries = used_outputs = BitSet32();
+    instruction_labels.fill(Xbyak::Label());
+
+    AnalyzeProgram(entry_point);
+
+    // Compile entire program. The prologue is emitted last, once the registers accessed by the
+    // program are known.
+    Compile_Block(static_cast<unsigned>(program_code->size()));
+
+    // Free memory that's no longer needed
+    program_code = nullptr;
+    swizzle_data = nullptr;
+    return_offsets.clear();
+    return_offsets.shrink_to_fit();
+    reachable.clear();
+    reachable.shrink_to_fit();
+
+    if (!supported) {
+        return false;
+    }
+
+    // Epilogue of the END instruction: scatter the registers and conditional codes to the lanes
+    L(end_label);
+    Compile_TransposeRegisters(offsetof(UnitState, registers.temporary),
+                               offsetof(BatchUnitState, registers.temporary), used_temporaries,
+                               true);
+    Compile_TransposeRegisters(offsetof(UnitState, registers.output),
+                               offsetof(BatchUnitState, registers.output), used_outputs, true);
+    for (unsigned i = 0; i < 2; ++i) {
+        for (std::size_t lane = 0; lane < BatchUnitState::NUM_LANES; ++lane) {
+            mov(eax, dword[STATE + ConditionalCodeOffset(i) + lane * sizeof(u32)]);
+            shr(eax, 31);
+            mov(byte[LANES + lane * sizeof(UnitState) + offsetof(UnitState, conditional_code) + i],
+                al);
+        }
+    }
+    mov(rsp, FRAME);
+    mov(eax, 1);
+    ABI_PopRegistersAndAdjustStack(*this, ABI_ALL_CALLEE_SAVED, 8, 16);
+    ret();
+
+    // Epilogue of diverged lanes: leave the lanes untouched
+    L(diverged_label);
+    mov(rsp, FRAME);
+    xor_(eax, eax);
+    ABI_PopRegistersAndAdjustStack(*this, ABI_ALL_CALLEE_SAVED, 8, 16);
+    ret();
+
+    program = (CompiledShader*)getCurr();
+
+    // The stack pointer is 8 modulo 16 at the entry of a procedure
+    // We reserve 16 bytes and assign a dummy value to the first 8 bytes, to catch any potential
+    // return checks (see Compile_Return) that happen in shader main routine.
+    ABI_PushRegistersAndAdjustStack(*this, ABI_ALL_CALLEE_SAVED, 8, 16);
+    mov(qword[rsp + 8], 0xFFFFFFFFFFFFFFFFULL);
+
+    mov(UNIFORMS, ABI_PARAM1);
+    mov(STATE, ABI_PARAM2);
+    mov(FRAME, rsp);
+    mov(LANES, qword[STATE + offsetof(BatchUnitState, lanes)]);
+
+    // Gather the registers accessed by the program from the lanes. The temporaries and outputs are
+    // gathered as well because the components which the program doesn't write keep the values
+    // left by the previous invocation, as they do with the other engines.
+    Compile_TransposeRegisters(offsetof(UnitState, registers.input),
+                               offsetof(BatchUnitState, registers.input), used_inputs, false);
+    Compile_TransposeRegisters(offsetof(UnitState, registers.temporary),
+                               offsetof(BatchUnitState, registers.temporary), used_temporaries,
+                               false);
+    Compile_TransposeRegisters(offsetof(UnitState, registers.output),
+                               offsetof(BatchUnitState, registers.output), used_outputs, false);
+
+    // The conditional code is reset at the start of the program, like in the interpreter
+    xorps(SCRATCH, SCRATCH);
+    movaps(xword[STATE + ConditionalCodeOffset(0)], SCRATCH);
+    movaps(xword[STATE + ConditionalCodeOffset(1)], SCRATCH);
+
+    // All lanes are active outside of IFC blocks
+    pcmpeqd(EXEC, EXEC);
+
+    jmp(instruction_labels[entry_point], T_NEAR);
+
+    ready();
+
+    ASSERT_MSG(getSize() <= MAX_BATCH_SHADER_SIZE,
+               "Compiled a shader that exceeds the allocated size!");
+    LOG_DEBUG(HW_GPU, "Compiled batch shader size={}", getSize());
+    return true;
+}
+
+JitBatchShader::JitBatchShader() : Xbyak::CodeGenerator(MAX_BATCH_SHADER_SIZE) {
+    CompilePrelude();
+}
+
+void JitBatchShader::CompilePrelude() {
+    align(16);
+    one = getCurr();
+    for (std::size_t i = 0; i < 4; ++i) {
+        dd(0x3f800000);
+    }
+    negbit = getCurr();
+    for (std::size_t i = 0; i < 4; ++i) {
+        dd(0x80000000);
+    }
+    all_ones = getCurr();
+    for (std::size_t i = 0; i < 4; ++i) {
+        dd(0xFFFFFFFF);
+    }
+
+    log2_subroutine = CompilePrelude_Log2();
+    exp2_subroutine = CompilePrelude_Exp2();
+}
+
+const void* JitBatchShader::CompilePrelude_Vector(u32 value) {
+    align(16);
+    const void* vector = getCurr();
+    for (std::size_t i = 0; i < 4; ++i) {
+        dd(value);
+    }
+    return vector;
+}
+
+Xbyak::Label JitBatchShader::CompilePrelude_Log2() {
+    Xbyak::Label subroutine;
+
+    // Evaluates the approximation of JitShader::CompilePrelude_Log2 on every lane with the same
+    // sequence of floating point operations, so that both JITs produce identical results. The edge
+    // cases handled by branches in JitShader are computed for all lanes and blended in at the end.
+    const void* c0 = CompilePrelude_Vector(0x3d74552f);
+    const void* c1 = CompilePrelude_Vector(0xbeee7397);
+    const void* c2 = CompilePrelude_Vector(0x3fbd96dd);
+    const void* c3 = CompilePrelude_Vector(0xc02153f6);
+    const void* c4 = CompilePrelude_Vector(0x4038d96c);
+    const void* exponent_mask = CompilePrelude_Vector(0x7f800000);
+    const void* mantissa_mask = CompilePrelude_Vector(0x007fffff);
+    const void* exponent_bias = CompilePrelude_Vector(0x7f);
+    const void* negative_infinity = CompilePrelude_Vector(0xff800000);
+    const void* default_qnan = CompilePrelude_Vector(0x7fc00000);
+
+    const Xmm input = SRC2[0];
+    const Xmm mask = SRC2[1];
+    const Xmm zero = SRC2[2];
+
+    align(16);
+    L(subroutine);
+    movaps(input, SRC1[0]);
+
+    // Split input
+    movaps(SCRATCH2, SRC1[0]);
+    andps(SCRATCH2, xword[rip + exponent_mask]);
+    psrld(SCRATCH2, 23);
+    psubd(SCRATCH2, xword[rip + exponent_bias]);
+    cvtdq2ps(SCRATCH2, SCRATCH2);
+    // SCRATCH2 now contains the exponent of the input.
+    andps(SRC1[0], xword[rip + mantissa_mask]);
+    orps(SRC1[0], xword[rip + one]);
+    // SRC1 now contains the mantissa of the input.
+
+    // Compute polynomial
+    movaps(SCRATCH, xword[rip + c0]);
+    mulps(SCRATCH, SRC1[0]);
+    addps(SCRATCH, xword[rip + c1]);
+    mulps(SCRATCH, SRC1[0]);
+    addps(SCRATCH, xword[rip + c2]);
+    mulps(SCRATCH, SRC1[0]);
+    addps(SCRATCH, xword[rip + c3]);
+    mulps(SCRATCH, SRC1[0]);
+    subps(SRC1[0], xword[rip + one]);
+    addps(SCRATCH, xword[rip + c4]);
+    mulps(SCRATCH, SRC1[0]);
+    addps(SCRATCH2, SCRATCH);
+
+    // Zero and negative inputs, including -Inf, produce NaN
+    xorps(zero, zero);
+    movaps(mask, input);
+    cmpleps(mask, zero);
+    movaps(SCRATCH, xword[rip + default_qnan]);
+    andps(SCRATCH, mask);
+    andnps(mask, SCRATCH2);
+    orps(mask, SCRATCH);
+
+    // Zero produces -Inf
+    movaps(SCRATCH2, input);
+    cmpeqps(SCRATCH2, zero);
+    movaps(SCRATCH, xword[rip + negative_infinity]);
+    andps(SCRATCH, SCRATCH2);
+    andnps(SCRATCH2, mask);
+    orps(SCRATCH2, SCRATCH);
+
+    // NaN is passed through
+    movaps(SRC1[0], input);
+    cmpunordps(SRC1[0], SRC1[0]);
+    andps(input, SRC1[0]);
+    andnps(SRC1[0], SCRATCH2);
+    orps(SRC1[0], input);
+
+    ret();
+
+    return subroutine;
+}
+
+Xbyak::Label JitBatchShader::CompilePrelude_Exp2() {
+    Xbyak::Label subroutine;
+
+    // Evaluates the approximation of JitShader::CompilePrelude_Exp2 on every lane, see
+    // CompilePrelude_Log2
+    const void* input_max = CompilePrelude_Vector(0x43010000);
+    const void* input_min = CompilePrelude_Vector(0xc2fdffff);
+    const void* c0 = CompilePrelude_Vector(0x3c5dbe69);
+    const void* half = CompilePrelude_Vector(0x3f000000);
+    const void* c1 = CompilePrelude_Vector(0x3d5509f9);
+    const void* c2 = CompilePrelude_Vector(0x3e773cc5);
+    const void* c3 = CompilePrelude_Vector(0x3f3168b3);
+    const void* c4 = CompilePrelude_Vector(0x3f800016);
+    const void* exponent_bias = CompilePrelude_Vector(0x7f);
+
+    const Xmm input = SRC2[0];
+
+    align(16);
+    L(subroutine);
+    movaps(input, SRC1[0]);
+
+    // Clamp to maximum range since we shift the value directly into the exponent.
+    minps(SRC1[0], xword[rip + input_max]);
+    maxps(SRC1[0], xword[rip + input_min]);
+
+    // Decompose input
+    movaps(SCRATCH, SRC1[0]);
+    subps(SCRATCH, xword[rip + half]);
+    cvtps2dq(SCRATCH, SCRATCH);
+    cvtdq2ps(SCRATCH2, SCRATCH);
+    // SCRATCH2 now contains input rounded to the nearest integer.
+    paddd(SCRATCH, xword[rip + exponent_bias]);
+    subps(SRC1[0], SCRATCH2);
+    // SRC1 contains input - round(input), which is in [-0.5, 0.5).
+    pslld(SCRATCH, 23);
+    // SCRATCH contains 2^(round(input)).
+
+    // Compute polynomial
+    movaps(SCRATCH2, xword[rip + c0]);
+    mulps(SCRATCH2, SRC1[0]);
+    addps(SCRATCH2, xword[rip + c1]);
+    mulps(SCRATCH2, SRC1[0]);
+    addps(SCRATCH2, xword[rip + c2]);
+    mulps(SCRATCH2, SRC1[0]);
+    addps(SCRATCH2, xword[rip + c3]);
+    mulps(SRC1[0], SCRATCH2);
+    addps(SRC1[0], xword[rip + c4]);
+    mulps(SRC1[0], SCRATCH);
+
+    // NaN is passed through
+    movaps(SCRATCH, input);
+    cmpunordps(SCRATCH, SCRATCH);
+    andps(input, SCRATCH);
+    andnps(SCRATCH, SRC1[0]);
+    orps(SCRATCH, input);
+    movaps(SRC1[0], SCRATCH);
+
+    ret();
+
+    return subroutine;
+}
+
+} // namespace Pica::Shader
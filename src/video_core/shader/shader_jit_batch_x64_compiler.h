@@ -0,0 +1,254 @@
+// Copyright 2020 Citra Emulator Project
+// Licensed under GPLv2 or any later version
+// Refer to the license.txt file included.
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <optional>
+#include <vector>
+#include <nihstro/shader_bytecode.h>
+#include <xbyak.h>
+#include "common/bit_set.h"
+#include "common/common_types.h"
+#include "video_core/shader/shader.h"
+
+using nihstro::Instruction;
+using nihstro::OpCode;
+using nihstro::SwizzlePattern;
+
+namespace Pica::Shader {
+
+/// Memory allocated for each compiled batch shader
+constexpr std::size_t MAX_BATCH_SHADER_SIZE = MAX_PROGRAM_CODE_LENGTH * 128;
+
+/// Maximum nesting depth of IFC blocks that JitBatchShader can compile
+constexpr std::size_t MAX_BATCH_IF_NESTING = 8;
+
+/**
+ * Shader unit state of a batch of vertices that are processed in lockstep, laid out as a structure
+ * of arrays: each component of each register holds the values of all lanes in one SSE vector.
+ */
+struct BatchUnitState {
+    static constexpr std::size_t NUM_LANES = 4;
+
+    /// One register component of every lane
+    using LaneValues = std::array<float24, NUM_LANES>;
+    /// One boolean mask of every lane, with all bits of a lane either set or cleared
+    using LaneMask = std::array<u32, NUM_LANES>;
+
+    struct Registers {
+        alignas(16) LaneValues input[16][4];
+        alignas(16) LaneValues temporary[16][4];
+        alignas(16) LaneValues output[16][4];
+    } registers;
+
+    alignas(16) LaneMask conditional_code[2];
+
+    /// Execution mask and condition of each enclosing IFC block, saved while compiling its body
+    alignas(16) LaneMask if_stack[MAX_BATCH_IF_NESTING][2];
+
+    /// Unit states of the vertices processed by the batch, one per lane
+    UnitState* lanes;
+
+    static std::size_t InputOffset(const SourceRegister& reg, unsigned component) {
+        switch (reg.GetRegisterType()) {
+        case RegisterType::Input:
+            return offsetof(BatchUnitState, registers.input) +
+                   (reg.GetIndex() * 4 + component) * sizeof(LaneValues);
+
+        case RegisterType::Temporary:
+            return offsetof(BatchUnitState, registers.temporary) +
+                   (reg.GetIndex() * 4 + component) * sizeof(LaneValues);
+
+        default:
+            UNREACHABLE();
+            return 0;
+        }
+    }
+
+    static std::size_t OutputOffset(const DestRegister& reg, unsigned component) {
+        switch (reg.GetRegisterType()) {
+        case RegisterType::Output:
+            return offsetof(BatchUnitState, registers.output) +
+                   (reg.GetIndex() * 4 + component) * sizeof(LaneValues);
+
+        case RegisterType::Temporary:
+            return offsetof(BatchUnitState, registers.temporary) +
+                   (reg.GetIndex() * 4 + component) * sizeof(LaneValues);
+
+        default:
+            UNREACHABLE();
+            return 0;
+        }
+    }
+};
+
+/**
+ * This class implements the batched shader JIT compiler. It recompiles a Pica shader program into
+ * x86_64 code that runs the shader for BatchUnitState::NUM_LANES vertices at once, with each SSE
+ * lane processing a different vertex. Requires SSE4.1.
+ *
+ * Branches on the conditional code of IFC blocks may diverge between the lanes, and are handled by
+ * running both sides of the branch under an execution mask. Programs using features that cannot
+ * be executed in lockstep (relative addressing, MOVA, geometry shader instructions or flow control
+ * leaving a diverged IFC block) are rejected at compile time. The remaining conditional jumps,
+ * calls and breaks abort the batch at runtime if the lanes disagree on the condition, in which
+ * case the vertices have to be run through the scalar engine instead.
+ */
+class JitBatchShader : public Xbyak::CodeGenerator {
+public:
+    JitBatchShader();
+
+    /**
+     * Runs the shader for the given unit states.
+     * @param lanes Array of BatchUnitState::NUM_LANES unit states, with their inputs loaded
+     * @returns false if the lanes diverged, in which case none of the unit states were modified
+     */
+    bool Run(const ShaderSetup& setup, UnitState* lanes) const {
+        BatchUnitState batch_state;
+        batch_state.lanes = lanes;
+        return program(&setup.uniforms, &batch_state);
+    }
+
+    /**
+     * Compiles the part of the program reachable from the given entry point.
+     * @returns false if the program cannot be run in lockstep, in which case the shader must not
+     *          be used
+     */
+    bool Compile(const std::array<u32, MAX_PROGRAM_CODE_LENGTH>* program_code,
+                 const std::array<u32, MAX_SWIZZLE_DATA_LENGTH>* swizzle_data,
+                 unsigned entry_point);
+
+    void Compile_ADD(Instruction instr);
+    void Compile_DP3(Instruction instr);
+    void Compile_DP4(Instruction instr);
+    void Compile_DPH(Instruction instr);
+    void Compile_EX2(Instruction instr);
+    void Compile_LG2(Instruction instr);
+    void Compile_MUL(Instruction instr);
+    void Compile_SGE(Instruction instr);
+    void Compile_SLT(Instruction instr);
+    void Compile_FLR(Instruction instr);
+    void Compile_MAX(Instruction instr);
+    void Compile_MIN(Instruction instr);
+    void Compile_RCP(Instruction instr);
+    void Compile_RSQ(Instruction instr);
+    void Compile_MOV(Instruction instr);
+    void Compile_NOP(Instruction instr);
+    void Compile_END(Instruction instr);
+    void Compile_BREAKC(Instruction instr);
+    void Compile_CALL(Instruction instr);
+    void Compile_CALLC(Instruction instr);
+    void Compile_CALLU(Instruction instr);
+    void Compile_IF(Instruction instr);
+    void Compile_LOOP(Instruction instr);
+    void Compile_JMP(Instruction instr);
+    void Compile_CMP(Instruction instr);
+    void Compile_MAD(Instruction instr);
+
+private:
+    using Vec4Regs = std::array<Xbyak::Xmm, 4>;
+
+    void Compile_Block(unsigned end);
+    void Compile_NextInstr();
+
+    /**
+     * Loads the swizzled components of a source register, one SSE register per component.
+     * @param components Mask of the swizzled components to load, bit N being component N
+     */
+    void Compile_SwizzleSrc(Instruction instr, unsigned src_num, SourceRegister src_reg,
+                            const Vec4Regs& dest, unsigned components);
+    /// Stores each enabled component of the destination register from the given SSE registers
+    void Compile_DestEnable(Instruction instr, const Vec4Regs& src);
+    /// Stores `value` into all enabled components of the destination register
+    void Compile_DestEnableBroadcast(Instruction instr, Xbyak::Xmm value);
+    void Compile_StoreComponent(std::size_t offset, Xbyak::Xmm value);
+
+    /// Returns the mask of the destination components enabled by the instruction
+    unsigned DestComponents(Instruction instr) const;
+
+    /// See JitShader::Compile_SanitizedMul. Clobbers `src2` and `scratch`.
+    void Compile_SanitizedMul(Xbyak::Xmm src1, Xbyak::Xmm src2, Xbyak::Xmm scratch);
+
+    /// Computes the per-lane mask of the condition of a flow control instruction into `dest`
+    void Compile_EvaluateCondition(Instruction instr, Xbyak::Xmm dest);
+    void Compile_UniformCondition(Instruction instr);
+
+    /**
+     * Evaluates the per-lane condition of a flow control instruction, and jumps to `target` if it
+     * holds for all lanes. Aborts the batch if it only holds for some of them.
+     */
+    void Compile_JumpIfAllLanes(Instruction instr, Xbyak::Label& target);
+
+    void Compile_Return();
+
+    /// Copies the given registers of the lanes' unit states into the batch state, or back
+    void Compile_TransposeRegisters(std::size_t lane_offset, std::size_t batch_offset,
+                                    BitSet32 registers, bool to_lanes);
+
+    /// Marks the program as not executable in lockstep
+    void Reject(const char* reason);
+
+    /**
+     * Analyzes the program for `CALL` instructions and for the instructions reachable from the
+     * entry point before emitting any code.
+     */
+    void AnalyzeProgram(unsigned entry_point);
+
+    /// Returns whether a subroutine or any subroutine it calls contains a LOOP instruction
+    bool SubroutineContainsLoop(unsigned offset, unsigned num_instructions,
+                                unsigned depth = 0) const;
+
+    void CompilePrelude();
+    /// Emits a 16-byte aligned vector holding `value` in each lane and returns its address
+    const void* CompilePrelude_Vector(u32 value);
+    /// Emits the subroutines computing EX2 and LG2 of SRC1[0]. They clobber SRC2 and the scratch
+    /// registers, but preserve EXEC.
+    Xbyak::Label CompilePrelude_Log2();
+    Xbyak::Label CompilePrelude_Exp2();
+
+    const std::array<u32, MAX_PROGRAM_CODE_LENGTH>* program_code = nullptr;
+    const std::array<u32, MAX_SWIZZLE_DATA_LENGTH>* swizzle_data = nullptr;
+
+    /// Mapping of Pica VS instructions to pointers in the emitted code
+    std::array<Xbyak::Label, MAX_PROGRAM_CODE_LENGTH> instruction_labels;
+
+    /// Label pointing to the end of the current LOOP block
+    std::optional<Xbyak::Label> loop_break_label;
+
+    /// Label of the epilogue writing the results back to the lanes
+    Xbyak::Label end_label;
+    /// Label of the epilogue aborting the batch when the lanes diverge
+    Xbyak::Label diverged_label;
+
+    /// Offsets in code where a return needs to be inserted
+    std::vector<unsigned> return_offsets;
+
+    /// Whether each instruction may be executed when starting from the entry point
+    std::vector<bool> reachable;
+
+    /// Registers accessed by the compiled code
+    BitSet32 used_inputs;
+    BitSet32 used_temporaries;
+    BitSet32 used_outputs;
+
+    unsigned program_counter = 0; ///< Offset of the next instruction to decode
+    bool looping = false;         ///< True if compiling a loop, used to check for nested loops
+    unsigned if_depth = 0;        ///< Number of enclosing IFC blocks executed under a mask
+    bool supported = true;        ///< False once the program has been rejected
+
+    /// Constant vectors
+    const void* one = nullptr;
+    const void* negbit = nullptr;
+    const void* all_ones = nullptr;
+
+    Xbyak::Label log2_subroutine;
+    Xbyak::Label exp2_subroutine;
+
+    using CompiledShader = bool(const void* uniforms, BatchUnitState* state);
+    CompiledShader* program = nullptr;
+};
+
+} // namespace Pica::Shader
@@ -3,14 +3,27 @@
 // Refer to the license.txt file included.
 
 #include "common/microprofile.h"
+#include "common/thread.h"
 #include "video_core/shader/shader.h"
 #include "video_core/shader/shader_jit_x64.h"
 #include "video_core/shader/shader_jit_x64_compiler.h"
+#include "video_core/shader/shader_jit_x64_disk_cache.h"
+#include "video_core/video_core.h"
 
 namespace Pica::Shader {
 
-JitX64Engine::JitX64Engine() = default;
-JitX64Engine::~JitX64Engine() = default;
+JitX64Engine::JitX64Engine() : async_compile(VideoCore::g_shader_jit_async_enabled) {
+    if (VideoCore::g_shader_jit_disk_cache_enabled) {
+        disk_cache = std::make_unique<JitDiskCache>();
+    }
+}
+
+JitX64Engine::~JitX64Engine() {
+    if (compiler_thread.joinable()) {
+        compile_queue.Push(nullptr);
+        compiler_thread.join();
+    }
+}
 
 void JitX64Engine::SetupBatch(ShaderSetup& setup, unsigned int entry_point) {
     ASSERT(entry_point < MAX_PROGRAM_CODE_LENGTH);
@@ -22,23 +35,72 @@ void JitX64Engine::SetupBatch(ShaderSetup& setup, unsigned int entry_point) {
     u64 cache_key = code_hash ^ swizzle_hash;
     auto iter = cache.find(cache_key);
     if (iter != cache.end()) {
-        setup.engine_data.cached_shader = iter->second.get();
+        // Still nullptr if the shader is being compiled in the background
+        setup.engine_data.cached_shader = iter->second->compiled.load(std::memory_order_acquire);
+        return;
+    }
+
+    auto cached = std::make_unique<CachedShader>();
+    if (disk_cache) {
+        cached->shader = disk_cache->Load(cache_key);
+    }
+
+    if (cached->shader == nullptr && async_compile) {
+        // Let the interpreter run the shader until the compiler thread has published it
+        if (!compiler_thread.joinable()) {
+            compiler_thread = std::thread([this] { CompilerLoop(); });
+        }
+        auto job = std::make_unique<CompileJob>();
+        job->cache_key = cache_key;
+        job->target = cached.get();
+        job->program_code = setup.program_code;
+        job->swizzle_data = setup.swizzle_data;
+        compile_queue.Push(std::move(job));
+        setup.engine_data.cached_shader = nullptr;
     } else {
-        auto shader = std::make_unique<JitShader>();
-        shader->Compile(&setup.program_code, &setup.swizzle_data);
-        setup.engine_data.cached_shader = shader.get();
-        cache.emplace_hint(iter, cache_key, std::move(shader));
+        if (cached->shader == nullptr) {
+            cached->shader = CompileShader(cache_key, setup.program_code, setup.swizzle_data);
+        }
+        cached->compiled.store(cached->shader.get(), std::memory_order_relaxed);
+        setup.engine_data.cached_shader = cached->shader.get();
+    }
+
+    cache.emplace_hint(iter, cache_key, std::move(cached));
+}
+
+std::unique_ptr<JitShader> JitX64Engine::CompileShader(
+    u64 cache_key, const std::array<u32, MAX_PROGRAM_CODE_LENGTH>& code,
+    const std::array<u32, MAX_SWIZZLE_DATA_LENGTH>& swizzle) {
+    auto shader = std::make_unique<JitShader>();
+    shader->Compile(&code, &swizzle);
+    if (disk_cache) {
+        disk_cache->Store(cache_key, *shader);
+    }
+    return shader;
+}
+
+void JitX64Engine::CompilerLoop() {
+    Common::SetCurrentThreadName("ShaderJitCompiler");
+
+    std::unique_ptr<CompileJob> job;
+    while ((job = compile_queue.PopWait())) {
+        CachedShader& target = *job->target;
+        target.shader = CompileShader(job->cache_key, job->program_code, job->swizzle_data);
+        target.compiled.store(target.shader.get(), std::memory_order_release);
     }
 }
 
 MICROPROFILE_DECLARE(GPU_Shader);
 
 void JitX64Engine::Run(const ShaderSetup& setup, UnitState& state) const {
-    ASSERT(setup.engine_data.cached_shader != nullptr);
+    const JitShader* shader = static_cast<const JitShader*>(setup.engine_data.cached_shader);
+    if (shader == nullptr) {
+        interpreter.Run(setup, state);
+        return;
+    }
 
     MICROPROFILE_SCOPE(GPU_Shader);
 
-    const JitShader* shader = static_cast<const JitShader*>(setup.engine_data.cached_shader);
     shader->Run(setup, state, setup.engine_data.entry_point);
 }
 
@@ -4,13 +4,19 @@
 
 #pragma once
 
+#include <array>
+#include <atomic>
 #include <memory>
+#include <thread>
 #include <unordered_map>
 #include "common/common_types.h"
+#include "common/threadsafe_queue.h"
 #include "video_core/shader/shader.h"
+#include "video_core/shader/shader_interpreter.h"
 
 namespace Pica::Shader {
 
+class JitDiskCache;
 class JitShader;
 
 class JitX64Engine final : public ShaderEngine {
@@ -22,7 +28,41 @@ public:
     void Run(const ShaderSetup& setup, UnitState& state) const override;
 
 private:
-    std::unordered_map<u64, std::unique_ptr<JitShader>> cache;
+    struct CachedShader {
+        std::unique_ptr<JitShader> shader;
+        /// Points to `shader` once it has been compiled, which may happen on the compiler thread
+        std::atomic<const JitShader*> compiled{nullptr};
+    };
+
+    struct CompileJob {
+        u64 cache_key;
+        CachedShader* target;
+        std::array<u32, MAX_PROGRAM_CODE_LENGTH> program_code;
+        std::array<u32, MAX_SWIZZLE_DATA_LENGTH> swizzle_data;
+    };
+
+    /// Compiles a program and stores it in the disk cache
+    std::unique_ptr<JitShader> CompileShader(
+        u64 cache_key, const std::array<u32, MAX_PROGRAM_CODE_LENGTH>& code,
+        const std::array<u32, MAX_SWIZZLE_DATA_LENGTH>& swizzle);
+
+    void CompilerLoop();
+
+    /**
+     * Whether new shaders are compiled on the compiler thread. This is fixed when the engine is
+     * created, so that only one thread ever compiles shaders and writes them to the disk cache.
+     */
+    const bool async_compile;
+
+    std::unordered_map<u64, std::unique_ptr<CachedShader>> cache;
+    std::unique_ptr<JitDiskCache> disk_cache;
+
+    /// Runs shaders whose compilation hasn't finished yet
+    InterpreterEngine interpreter;
+
+    /// Programs queued for compilation on the compiler thread, nullptr stops the thread
+    Common::SPSCQueue<std::unique_ptr<CompileJob>> compile_queue;
+    std::thread compiler_thread;
 };
 
 } // namespace Pica::Shader
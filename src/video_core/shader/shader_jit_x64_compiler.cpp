@@ -5,6 +5,7 @@
 #include <algorithm>
 #include <cmath>
 #include <cstdint>
+#include <cstring>
 #include <nihstro/shader_bytecode.h>
 #include <smmintrin.h>
 #include <xmmintrin.h>
@@ -164,11 +165,24 @@ static void LogCritical(const char* msg) {
 
 void JitShader::Compile_Assert(bool condition, const char* msg) {
     if (!condition) {
-        mov(ABI_PARAM1, reinterpret_cast<std::size_t>(msg));
-        CallFarFunction(*this, LogCritical);
+        Compile_LogCritical(msg);
     }
 }
 
+void JitShader::Compile_LogCritical(const char* msg) {
+    // The message is embedded into the code, so that the program doesn't refer to any host address
+    Xbyak::Label message_end;
+    jmp(message_end, T_NEAR);
+    const void* message = getCurr();
+    for (std::size_t i = 0; i <= std::strlen(msg); ++i) {
+        db(msg[i]);
+    }
+    L(message_end);
+
+    lea(ABI_PARAM1, ptr[rip + message]);
+    call(qword[rip + log_critical_function]);
+}
+
 /**
  * Loads and swizzles a source register into the specified XMM register.
  * @param instr VS instruction, used for determining how to load the source register
@@ -788,8 +802,7 @@ void JitShader::Compile_EMIT(Instruction instr) {
     jnz(have_emitter);
 
     ABI_PushRegistersAndAdjustStack(*this, PersistentCallerSavedRegs(), 0);
-    mov(ABI_PARAM1, reinterpret_cast<std::size_t>("Execute EMIT on VS"));
-    CallFarFunction(*this, LogCritical);
+    Compile_LogCritical("Execute EMIT on VS");
     ABI_PopRegistersAndAdjustStack(*this, PersistentCallerSavedRegs(), 0);
     jmp(end);
 
@@ -798,7 +811,7 @@ void JitShader::Compile_EMIT(Instruction instr) {
     mov(ABI_PARAM1, rax);
     mov(ABI_PARAM2, STATE);
     add(ABI_PARAM2, static_cast<Xbyak::uint32>(offsetof(UnitState, registers.output)));
-    CallFarFunction(*this, Emit);
+    call(qword[rip + emit_function]);
     ABI_PopRegistersAndAdjustStack(*this, PersistentCallerSavedRegs(), 0);
     L(end);
 }
@@ -810,8 +823,7 @@ void JitShader::Compile_SETE(Instruction instr) {
     jnz(have_emitter);
 
     ABI_PushRegistersAndAdjustStack(*this, PersistentCallerSavedRegs(), 0);
-    mov(ABI_PARAM1, reinterpret_cast<std::size_t>("Execute SETEMIT on VS"));
-    CallFarFunction(*this, LogCritical);
+    Compile_LogCritical("Execute SETEMIT on VS");
     ABI_PopRegistersAndAdjustStack(*this, PersistentCallerSavedRegs(), 0);
     jmp(end);
 
@@ -920,14 +932,10 @@ void JitShader::Compile(const std::array<u32, MAX_PROGRAM_CODE_LENGTH>* program_
     mov(COND1, byte[STATE + offsetof(UnitState, conditional_code[1])]);
 
     // Used to set a register to one
-    static const __m128 one = {1.f, 1.f, 1.f, 1.f};
-    mov(rax, reinterpret_cast<std::size_t>(&one));
-    movaps(ONE, xword[rax]);
+    movaps(ONE, xword[rip + one_vector]);
 
     // Used to negate registers
-    static const __m128 neg = {-0.f, -0.f, -0.f, -0.f};
-    mov(rax, reinterpret_cast<std::size_t>(&neg));
-    movaps(NEGBIT, xword[rax]);
+    movaps(NEGBIT, xword[rip + negbit_vector]);
 
     // Jump to start of the shader program
     jmp(ABI_PARAM3);
@@ -945,13 +953,62 @@ void JitShader::Compile(const std::array<u32, MAX_PROGRAM_CODE_LENGTH>* program_
 
     ASSERT_MSG(getSize() <= MAX_SHADER_SIZE, "Compiled a shader that exceeds the allocated size!");
     LOG_DEBUG(HW_GPU, "Compiled shader size={}", getSize());
+
+    for (std::size_t i = 0; i < instruction_offsets.size(); ++i) {
+        instruction_offsets[i] = static_cast<u32>(instruction_labels[i].getAddress() - getCode());
+    }
+}
+
+std::vector<u8> JitShader::GetProgramCode() const {
+    return std::vector<u8>(getCode() + prelude_size, getCode() + getSize());
+}
+
+bool JitShader::LoadProgram(const std::vector<u8>& code,
+                            const std::array<u32, MAX_PROGRAM_CODE_LENGTH>& offsets) {
+    const std::size_t size = prelude_size + code.size();
+    if (size > MAX_SHADER_SIZE) {
+        return false;
+    }
+    for (u32 offset : offsets) {
+        if (offset < prelude_size || offset >= size) {
+            return false;
+        }
+    }
+
+    // The program only refers to the prelude and to itself relative to the instruction pointer, so
+    // it can be copied verbatim behind the prelude of this instance
+    program = (CompiledShader*)getCurr();
+    for (u8 byte : code) {
+        db(byte);
+    }
+    instruction_offsets = offsets;
+
+    ready();
+    return true;
 }
 
 JitShader::JitShader() : Xbyak::CodeGenerator(MAX_SHADER_SIZE) {
     CompilePrelude();
+    prelude_size = getSize();
 }
 
 void JitShader::CompilePrelude() {
+    align(8);
+    log_critical_function = getCurr();
+    dq(reinterpret_cast<std::size_t>(&LogCritical));
+    emit_function = getCurr();
+    dq(reinterpret_cast<std::size_t>(&Emit));
+
+    align(16);
+    one_vector = getCurr();
+    for (std::size_t i = 0; i < 4; ++i) {
+        dd(0x3f800000);
+    }
+    negbit_vector = getCurr();
+    for (std::size_t i = 0; i < 4; ++i) {
+        dd(0x80000000);
+    }
+
     log2_subroutine = CompilePrelude_Log2();
     exp2_subroutine = CompilePrelude_Exp2();
 }
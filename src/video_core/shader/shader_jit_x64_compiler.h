@@ -33,12 +33,36 @@ public:
     JitShader();
 
     void Run(const ShaderSetup& setup, UnitState& state, unsigned offset) const {
-        program(&setup.uniforms, &state, instruction_labels[offset].getAddress());
+        program(&setup.uniforms, &state, getCode() + instruction_offsets[offset]);
     }
 
     void Compile(const std::array<u32, MAX_PROGRAM_CODE_LENGTH>* program_code,
                  const std::array<u32, MAX_SWIZZLE_DATA_LENGTH>* swizzle_data);
 
+    /**
+     * Returns the code of the compiled program, excluding the prelude. The code refers to host
+     * memory only relative to the instruction pointer and within the code buffer, so it can be
+     * loaded by any other JitShader of the same build.
+     */
+    std::vector<u8> GetProgramCode() const;
+
+    /// Returns the offset of the code of each Pica VS instruction from the start of the code buffer
+    const std::array<u32, MAX_PROGRAM_CODE_LENGTH>& GetInstructionOffsets() const {
+        return instruction_offsets;
+    }
+
+    /// Returns the size of the prelude emitted in front of every program
+    std::size_t GetPreludeSize() const {
+        return prelude_size;
+    }
+
+    /**
+     * Loads a program previously compiled by another JitShader, in place of calling Compile.
+     * @returns false if the program doesn't fit this shader's code buffer
+     */
+    bool LoadProgram(const std::vector<u8>& code,
+                     const std::array<u32, MAX_PROGRAM_CODE_LENGTH>& offsets);
+
     void Compile_ADD(Instruction instr);
     void Compile_DP3(Instruction instr);
     void Compile_DP4(Instruction instr);
@@ -100,6 +124,9 @@ private:
      */
     void Compile_Assert(bool condition, const char* msg);
 
+    /// Emits a call logging the given message as critical error
+    void Compile_LogCritical(const char* msg);
+
     /**
      * Analyzes the entire shader program for `CALL` instructions before emitting any code,
      * identifying the locations where a return needs to be inserted.
@@ -119,6 +146,9 @@ private:
     /// Mapping of Pica VS instructions to pointers in the emitted code
     std::array<Xbyak::Label, MAX_PROGRAM_CODE_LENGTH> instruction_labels;
 
+    /// Offsets of the emitted code of each Pica VS instruction from the start of the code buffer
+    std::array<u32, MAX_PROGRAM_CODE_LENGTH> instruction_offsets{};
+
     /// Label pointing to the end of the current LOOP block. Used by the BREAKC instruction to break
     /// out of the loop.
     std::optional<Xbyak::Label> loop_break_label;
@@ -134,6 +164,14 @@ private:
 
     Xbyak::Label log2_subroutine;
     Xbyak::Label exp2_subroutine;
+
+    /// Host function pointers and constant vectors, accessed relative to the instruction pointer
+    const void* log_critical_function = nullptr;
+    const void* emit_function = nullptr;
+    const void* one_vector = nullptr;
+    const void* negbit_vector = nullptr;
+
+    std::size_t prelude_size = 0;
 };
 
 } // namespace Pica::Shader
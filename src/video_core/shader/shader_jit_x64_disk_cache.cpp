@@ -0,0 +1,209 @@
+// Copyright 2020 Citra Emulator Project
+// Licensed under GPLv2 or any later version
+// Refer to the license.txt file included.
+
+#include <cstring>
+#include <fmt/format.h>
+#include "common/common_paths.h"
+#include "common/hash.h"
+#include "common/logging/log.h"
+#include "common/scm_rev.h"
+#include "common/x64/cpu_detect.h"
+#include "core/core.h"
+#include "core/loader/loader.h"
+#include "video_core/shader/shader_jit_x64_compiler.h"
+#include "video_core/shader/shader_jit_x64_disk_cache.h"
+
+namespace Pica::Shader {
+
+constexpr u32 CACHE_MAGIC = 0x54494A43; // "CJIT"
+constexpr u32 CACHE_VERSION = 2;
+
+/// Host CPU features JitShader selects its instructions by
+constexpr u32 HOST_FEATURE_SSE4_1 = 1 << 0;
+
+struct CacheHeader {
+    u32 magic;
+    u32 version;
+    /// Hash identifying the build that compiled the programs
+    u64 build_hash;
+    /// Size of the JitShader prelude the programs were compiled behind
+    u64 prelude_size;
+    /// HOST_FEATURE_* flags of the CPU the programs were compiled for
+    u32 host_features;
+    u32 reserved;
+};
+
+struct EntryHeader {
+    u64 key;
+    u64 code_size;
+    /// Hash of the instruction offsets and code following the header
+    u64 checksum;
+};
+
+constexpr std::size_t OFFSETS_SIZE = sizeof(u32) * MAX_PROGRAM_CODE_LENGTH;
+
+static u32 GetHostFeatures() {
+    u32 features = 0;
+    if (Common::GetCPUCaps().sse4_1) {
+        features |= HOST_FEATURE_SSE4_1;
+    }
+    return features;
+}
+
+/// Builds the header of cache files whose programs can run on this build and host
+static CacheHeader BuildExpectedHeader() {
+    const std::string build = fmt::format("{} {}", Common::g_scm_rev, Common::g_build_date);
+    // Measuring the prelude requires emitting it
+    return CacheHeader{CACHE_MAGIC,
+                       CACHE_VERSION,
+                       Common::ComputeHash64(build.data(), build.size()),
+                       JitShader().GetPreludeSize(),
+                       GetHostFeatures(),
+                       0};
+}
+
+/// Returns whether the cache file starts with the expected header
+static bool CheckHeader(const std::vector<u8>& data, const CacheHeader& expected) {
+    CacheHeader header;
+    if (data.size() < sizeof(header)) {
+        return false;
+    }
+    std::memcpy(&header, data.data(), sizeof(header));
+    if (header.magic == expected.magic && header.version == expected.version &&
+        header.build_hash == expected.build_hash && header.prelude_size == expected.prelude_size &&
+        header.host_features != expected.host_features) {
+        LOG_INFO(HW_GPU, "JIT shader cache was created on a CPU with other features - discarding");
+        return false;
+    }
+    if (std::memcmp(&header, &expected, sizeof(header)) != 0) {
+        LOG_INFO(HW_GPU, "JIT shader cache was created by another build - discarding");
+        return false;
+    }
+    return true;
+}
+
+JitDiskCache::JitDiskCache() {
+    u64 program_id = 0;
+    if (Core::System::GetInstance().GetAppLoader().ReadProgramId(program_id) !=
+            Loader::ResultStatus::Success ||
+        program_id == 0) {
+        LOG_INFO(HW_GPU, "Not caching JIT shaders of a title without title id");
+        return;
+    }
+
+    const std::string dir = FileUtil::GetUserPath(FileUtil::UserPath::ShaderDir) + "jit_x64";
+    if (!FileUtil::CreateFullPath(dir + DIR_SEP)) {
+        LOG_ERROR(HW_GPU, "Failed to create directory={}", dir);
+        return;
+    }
+    path = fmt::format("{}" DIR_SEP "{:016X}.bin", dir, program_id);
+
+    std::vector<u8> data;
+    {
+        FileUtil::IOFile in(path, "rb");
+        if (in.IsOpen()) {
+            data.resize(in.GetSize());
+            if (in.ReadBytes(data.data(), data.size()) != data.size()) {
+                data.clear();
+            }
+        }
+    }
+
+    const CacheHeader expected_header = BuildExpectedHeader();
+    const std::size_t valid_size = CheckHeader(data, expected_header) ? ReadEntries(data) : 0;
+    if (valid_size != 0 && valid_size == data.size()) {
+        file = FileUtil::IOFile(path, "ab");
+    } else {
+        // Drop the invalid part of the file, which would hide all entries appended behind it
+        if (valid_size == 0) {
+            data.resize(sizeof(expected_header));
+            std::memcpy(data.data(), &expected_header, sizeof(expected_header));
+        } else {
+            data.resize(valid_size);
+        }
+        file = FileUtil::IOFile(path, "wb");
+        if (file.WriteBytes(data.data(), data.size()) != data.size()) {
+            LOG_ERROR(HW_GPU, "Failed to write JIT shader cache file={}", path);
+            file.Close();
+        }
+    }
+
+    LOG_INFO(HW_GPU, "Loaded {} JIT shaders from the disk cache", entries.size());
+}
+
+JitDiskCache::~JitDiskCache() = default;
+
+std::size_t JitDiskCache::ReadEntries(const std::vector<u8>& data) {
+    std::size_t pos = sizeof(CacheHeader);
+    while (pos < data.size()) {
+        EntryHeader entry_header;
+        if (data.size() - pos < sizeof(entry_header)) {
+            break;
+        }
+        std::memcpy(&entry_header, data.data() + pos, sizeof(entry_header));
+
+        const u8* payload = data.data() + pos + sizeof(entry_header);
+        const std::size_t available = data.size() - pos - sizeof(entry_header);
+        if (entry_header.code_size > MAX_SHADER_SIZE ||
+            available < OFFSETS_SIZE + entry_header.code_size ||
+            Common::ComputeHash64(payload, OFFSETS_SIZE + entry_header.code_size) !=
+                entry_header.checksum) {
+            break;
+        }
+
+        Entry entry;
+        std::memcpy(entry.instruction_offsets.data(), payload, OFFSETS_SIZE);
+        entry.code.assign(payload + OFFSETS_SIZE, payload + OFFSETS_SIZE + entry_header.code_size);
+        entries.emplace(entry_header.key, std::move(entry));
+
+        pos += sizeof(entry_header) + OFFSETS_SIZE + entry_header.code_size;
+    }
+
+    if (pos != data.size()) {
+        LOG_WARNING(HW_GPU, "JIT shader cache file={} is corrupted at offset {} - truncating",
+                    path, pos);
+    }
+    return pos;
+}
+
+std::unique_ptr<JitShader> JitDiskCache::Load(u64 key) {
+    auto iter = entries.find(key);
+    if (iter == entries.end()) {
+        return nullptr;
+    }
+
+    auto shader = std::make_unique<JitShader>();
+    const bool loaded = shader->LoadProgram(iter->second.code, iter->second.instruction_offsets);
+    // The program is owned by the shader engine from now on
+    entries.erase(iter);
+    if (!loaded) {
+        LOG_ERROR(HW_GPU, "Failed to load JIT shader {:016X} from the disk cache", key);
+        return nullptr;
+    }
+    return shader;
+}
+
+void JitDiskCache::Store(u64 key, const JitShader& shader) {
+    if (!file.IsOpen()) {
+        return;
+    }
+
+    const std::vector<u8> code = shader.GetProgramCode();
+    std::vector<u8> record(sizeof(EntryHeader) + OFFSETS_SIZE + code.size());
+    u8* payload = record.data() + sizeof(EntryHeader);
+    std::memcpy(payload, shader.GetInstructionOffsets().data(), OFFSETS_SIZE);
+    std::memcpy(payload + OFFSETS_SIZE, code.data(), code.size());
+
+    const EntryHeader entry_header{key, code.size(),
+                                   Common::ComputeHash64(payload, OFFSETS_SIZE + code.size())};
+    std::memcpy(record.data(), &entry_header, sizeof(entry_header));
+
+    // Write each entry at once, so that an interrupted session leaves at most one broken entry
+    if (file.WriteBytes(record.data(), record.size()) != record.size() || !file.Flush()) {
+        LOG_ERROR(HW_GPU, "Failed to write JIT shader cache file={}", path);
+        file.Close();
+    }
+}
+
+} // namespace Pica::Shader
@@ -0,0 +1,60 @@
+// Copyright 2020 Citra Emulator Project
+// Licensed under GPLv2 or any later version
+// Refer to the license.txt file included.
+
+#pragma once
+
+#include <array>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "common/common_types.h"
+#include "common/file_util.h"
+#include "video_core/shader/shader.h"
+
+namespace Pica::Shader {
+
+class JitShader;
+
+/**
+ * Stores the programs compiled by the shader JIT on disk, so that later sessions of the same title
+ * can load them instead of compiling them again. There is one cache file per title, which is only
+ * used by the build that created it.
+ */
+class JitDiskCache {
+public:
+    /// Opens the cache file of the running title and reads all valid programs stored in it
+    JitDiskCache();
+    ~JitDiskCache();
+
+    /**
+     * Loads the program stored under the given key into a new shader.
+     * @returns nullptr if no program is stored under the key
+     */
+    std::unique_ptr<JitShader> Load(u64 key);
+
+    /**
+     * Appends the program of a freshly compiled shader to the cache file. May be called on another
+     * thread than Load, as the two don't share any state.
+     */
+    void Store(u64 key, const JitShader& shader);
+
+private:
+    struct Entry {
+        std::array<u32, MAX_PROGRAM_CODE_LENGTH> instruction_offsets;
+        std::vector<u8> code;
+    };
+
+    /**
+     * Parses the entries following the header of the cache file, which has already been checked.
+     * @returns the size of the valid part of the file
+     */
+    std::size_t ReadEntries(const std::vector<u8>& data);
+
+    std::string path;
+    FileUtil::IOFile file;
+    std::unordered_map<u64, Entry> entries;
+};
+
+} // namespace Pica::Shader
@@ -4,16 +4,33 @@
 
 #pragma once
 
+#include <functional>
+
 namespace Pica {
 namespace Shader {
 struct OutputVertex;
 }
 
+namespace Rasterizer {
+struct Vertex;
+}
+
 namespace Clipper {
 
 using Shader::OutputVertex;
 
+using TriangleHandler = std::function<void(
+    const Rasterizer::Vertex& v0, const Rasterizer::Vertex& v1, const Rasterizer::Vertex& v2)>;
+
+/// Clips the triangle and rasterizes the resulting triangles right away
 void ProcessTriangle(const OutputVertex& v0, const OutputVertex& v1, const OutputVertex& v2);
 
+/**
+ * Clips the triangle and calls triangle_handler for each of the resulting triangles, whose
+ * vertices already have their screen coordinates set up.
+ */
+void ProcessTriangle(const OutputVertex& v0, const OutputVertex& v1, const OutputVertex& v2,
+                     const TriangleHandler& triangle_handler);
+
 } // namespace Clipper
 } // namespace Pica
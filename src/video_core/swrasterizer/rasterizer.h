@@ -4,6 +4,8 @@
 
 #pragma once
 
+#include "common/common_types.h"
+#include "common/math_util.h"
 #include "video_core/shader/shader.h"
 
 namespace Pica::Rasterizer {
@@ -41,4 +43,31 @@ struct Vertex : Shader::OutputVertex {
 
 void ProcessTriangle(const Vertex& v0, const Vertex& v1, const Vertex& v2);
 
+/**
+ * Rasterizes only the pixels of the triangle which lie inside the given region. Rasterizing a
+ * triangle once for each region of a partition of the screen produces the same output as
+ * rasterizing it in one go, which allows disjoint regions to be processed concurrently.
+ * @param region Region in pixel coordinates; right and bottom are exclusive
+ */
+void ProcessTriangle(const Vertex& v0, const Vertex& v1, const Vertex& v2,
+                     const Common::Rectangle<u32>& region);
+
+/**
+ * Returns the bounding box of the pixels the triangle can possibly cover, taking the scissor
+ * test into account. Right and bottom are exclusive.
+ */
+Common::Rectangle<u32> GetTriangleBounds(const Vertex& v0, const Vertex& v1, const Vertex& v2);
+
+/// Makes the rasterizer check the textures in the given region for changes before sampling them
+void InvalidateTextures(PAddr addr, u32 size);
+
+/**
+ * Makes the rasterizer check all textures for changes before sampling them, for when the emulated
+ * CPU may have modified them.
+ */
+void InvalidateAllTextures();
+
+/// Removes all decoded textures kept by the rasterizer
+void ClearTextures();
+
 } // namespace Pica::Rasterizer
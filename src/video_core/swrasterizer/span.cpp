@@ -0,0 +1,223 @@
+// Copyright 2020 Citra Emulator Project
+// Licensed under GPLv2 or any later version
+// Refer to the license.txt file included.
+
+#include <algorithm>
+#include "common/assert.h"
+#include "common/logging/log.h"
+#include "video_core/swrasterizer/span.h"
+#include "video_core/swrasterizer/texturing.h"
+
+#ifdef ARCHITECTURE_x86_64
+#include <smmintrin.h>
+#include "common/x64/cpu_detect.h"
+#include "video_core/swrasterizer/tev_jit_x64.h"
+#endif
+
+namespace Pica::Rasterizer {
+
+using TevStageConfig = TexturingRegs::TevStageConfig;
+
+static u32 EvaluateSpanCoverageScalar(const std::array<EdgeFunction, 3>& edges, int x, int y,
+                                      int max_x, std::array<SpanArray<int>, 3>& w) {
+    u32 coverage = 0;
+    for (std::size_t lane = 0; lane < SPAN_WIDTH; ++lane) {
+        const int px = x + static_cast<int>(lane) * 0x10;
+        bool covered = px < max_x;
+        for (std::size_t i = 0; i < 3; ++i) {
+            const auto& edge = edges[i];
+            w[i][lane] = edge.bias + edge.dx * (y - edge.y0) - edge.dy * (px - edge.x0);
+            covered = covered && w[i][lane] >= 0;
+        }
+        coverage |= covered ? 1u << lane : 0;
+    }
+    return coverage;
+}
+
+static Common::Vec4<u8> CombineFragment(const TexturingRegs& regs,
+                                        const std::array<TevStageConfig, 6>& tev_stages,
+                                        const TevSpanInputs& inputs, std::size_t lane) {
+    // Texture environment - consists of 6 stages of color and alpha combining.
+    //
+    // Color combiners take three input color values from some source (e.g. interpolated
+    // vertex color, texture color, previous stage, etc), perform some very simple
+    // operations on each of them (e.g. inversion) and then calculate the output color
+    // with some basic arithmetic. Alpha combiners can be configured separately but work
+    // analogously.
+    Common::Vec4<u8> combiner_output = {0, 0, 0, 0};
+    Common::Vec4<u8> combiner_buffer = {0, 0, 0, 0};
+    Common::Vec4<u8> next_combiner_buffer =
+        Common::MakeVec(regs.tev_combiner_buffer_color.r.Value(),
+                        regs.tev_combiner_buffer_color.g.Value(),
+                        regs.tev_combiner_buffer_color.b.Value(),
+                        regs.tev_combiner_buffer_color.a.Value())
+            .Cast<u8>();
+
+    for (unsigned tev_stage_index = 0; tev_stage_index < tev_stages.size(); ++tev_stage_index) {
+        const auto& tev_stage = tev_stages[tev_stage_index];
+        using Source = TevStageConfig::Source;
+
+        auto GetSource = [&](Source source) -> Common::Vec4<u8> {
+            switch (source) {
+            case Source::PrimaryColor:
+                return inputs.primary_color[lane];
+
+            case Source::PrimaryFragmentColor:
+                return inputs.primary_fragment_color[lane];
+
+            case Source::SecondaryFragmentColor:
+                return inputs.secondary_fragment_color[lane];
+
+            case Source::Texture0:
+                return inputs.texture_color[0][lane];
+
+            case Source::Texture1:
+                return inputs.texture_color[1][lane];
+
+            case Source::Texture2:
+                return inputs.texture_color[2][lane];
+
+            case Source::Texture3:
+                return inputs.texture_color[3][lane];
+
+            case Source::PreviousBuffer:
+                return combiner_buffer;
+
+            case Source::Constant:
+                return Common::MakeVec(tev_stage.const_r.Value(), tev_stage.const_g.Value(),
+                                       tev_stage.const_b.Value(), tev_stage.const_a.Value())
+                    .Cast<u8>();
+
+            case Source::Previous:
+                return combiner_output;
+
+            default:
+                LOG_ERROR(HW_GPU, "Unknown color combiner source {}", (int)source);
+                UNIMPLEMENTED();
+                return {0, 0, 0, 0};
+            }
+        };
+
+        // color combiner
+        // NOTE: Not sure if the alpha combiner might use the color output of the previous
+        //       stage as input. Hence, we currently don't directly write the result to
+        //       combiner_output.rgb(), but instead store it in a temporary variable until
+        //       alpha combining has been done.
+        Common::Vec3<u8> color_result[3] = {
+            GetColorModifier(tev_stage.color_modifier1, GetSource(tev_stage.color_source1)),
+            GetColorModifier(tev_stage.color_modifier2, GetSource(tev_stage.color_source2)),
+            GetColorModifier(tev_stage.color_modifier3, GetSource(tev_stage.color_source3)),
+        };
+        auto color_output = ColorCombine(tev_stage.color_op, color_result);
+
+        u8 alpha_output;
+        if (tev_stage.color_op == TevStageConfig::Operation::Dot3_RGBA) {
+            // result of Dot3_RGBA operation is also placed to the alpha component
+            alpha_output = color_output.x;
+        } else {
+            // alpha combiner
+            std::array<u8, 3> alpha_result = {{
+                GetAlphaModifier(tev_stage.alpha_modifier1, GetSource(tev_stage.alpha_source1)),
+                GetAlphaModifier(tev_stage.alpha_modifier2, GetSource(tev_stage.alpha_source2)),
+                GetAlphaModifier(tev_stage.alpha_modifier3, GetSource(tev_stage.alpha_source3)),
+            }};
+            alpha_output = AlphaCombine(tev_stage.alpha_op, alpha_result);
+        }
+
+        combiner_output[0] =
+            std::min((unsigned)255, color_output.r() * tev_stage.GetColorMultiplier());
+        combiner_output[1] =
+            std::min((unsigned)255, color_output.g() * tev_stage.GetColorMultiplier());
+        combiner_output[2] =
+            std::min((unsigned)255, color_output.b() * tev_stage.GetColorMultiplier());
+        combiner_output[3] = std::min((unsigned)255, alpha_output * tev_stage.GetAlphaMultiplier());
+
+        combiner_buffer = next_combiner_buffer;
+
+        if (regs.tev_combiner_buffer_input.TevStageUpdatesCombinerBufferColor(tev_stage_index)) {
+            next_combiner_buffer.r() = combiner_output.r();
+            next_combiner_buffer.g() = combiner_output.g();
+            next_combiner_buffer.b() = combiner_output.b();
+        }
+
+        if (regs.tev_combiner_buffer_input.TevStageUpdatesCombinerBufferAlpha(tev_stage_index)) {
+            next_combiner_buffer.a() = combiner_output.a();
+        }
+    }
+
+    return combiner_output;
+}
+
+#ifdef ARCHITECTURE_x86_64
+
+CPU_TARGET("sse4.1") static u32
+EvaluateSpanCoverageSSE41(const std::array<EdgeFunction, 3>& edges, int x, int y, int max_x,
+                          std::array<SpanArray<int>, 3>& w) {
+    const __m128i px = _mm_add_epi32(_mm_set1_epi32(x), _mm_setr_epi32(0, 0x10, 0x20, 0x30));
+    const __m128i py = _mm_set1_epi32(y);
+
+    // Pixels past the right edge of the bounding box are not covered
+    __m128i covered = _mm_cmpgt_epi32(_mm_set1_epi32(max_x), px);
+    for (std::size_t i = 0; i < 3; ++i) {
+        const auto& edge = edges[i];
+        const __m128i dy_term =
+            _mm_mullo_epi32(_mm_set1_epi32(edge.dx), _mm_sub_epi32(py, _mm_set1_epi32(edge.y0)));
+        const __m128i dx_term =
+            _mm_mullo_epi32(_mm_set1_epi32(edge.dy), _mm_sub_epi32(px, _mm_set1_epi32(edge.x0)));
+        const __m128i value =
+            _mm_add_epi32(_mm_set1_epi32(edge.bias), _mm_sub_epi32(dy_term, dx_term));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(w[i].data()), value);
+        covered = _mm_andnot_si128(_mm_cmpgt_epi32(_mm_setzero_si128(), value), covered);
+    }
+    return static_cast<u32>(_mm_movemask_ps(_mm_castsi128_ps(covered)));
+}
+
+/// Whether the SSE4.1 implementations of the span functions are used
+static bool use_sse41 = Common::GetCPUCaps().sse4_1;
+
+#endif // ARCHITECTURE_x86_64
+
+void SetSpanSimdEnabled(bool enabled) {
+#ifdef ARCHITECTURE_x86_64
+    use_sse41 = enabled && Common::GetCPUCaps().sse4_1;
+#endif
+}
+
+u32 EvaluateSpanCoverage(const std::array<EdgeFunction, 3>& edges, int x, int y, int max_x,
+                         std::array<SpanArray<int>, 3>& w) {
+#ifdef ARCHITECTURE_x86_64
+    if (use_sse41) {
+        return EvaluateSpanCoverageSSE41(edges, x, y, max_x, w);
+    }
+#endif
+    return EvaluateSpanCoverageScalar(edges, x, y, max_x, w);
+}
+
+#ifdef ARCHITECTURE_x86_64
+static TevJitCache tev_jit_cache;
+#endif // ARCHITECTURE_x86_64
+
+SpanCombiner::SpanCombiner(const TexturingRegs& regs_)
+    : regs(regs_), tev_stages(regs.GetTevStages()) {
+#ifdef ARCHITECTURE_x86_64
+    if (use_sse41) {
+        jit = tev_jit_cache.Get(regs);
+    }
+#endif
+}
+
+void SpanCombiner::Combine(const TevSpanInputs& inputs,
+                           SpanArray<Common::Vec4<u8>>& output) const {
+#ifdef ARCHITECTURE_x86_64
+    if (jit != nullptr) {
+        jit->Run(regs, inputs, output);
+        return;
+    }
+#endif
+
+    for (std::size_t lane = 0; lane < SPAN_WIDTH; ++lane) {
+        output[lane] = CombineFragment(regs, tev_stages, inputs, lane);
+    }
+}
+
+} // namespace Pica::Rasterizer
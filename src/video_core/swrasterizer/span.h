@@ -0,0 +1,81 @@
+// Copyright 2020 Citra Emulator Project
+// Licensed under GPLv2 or any later version
+// Refer to the license.txt file included.
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include "common/common_types.h"
+#include "common/vector_math.h"
+#include "video_core/regs_texturing.h"
+
+namespace Pica::Rasterizer {
+
+/// Number of horizontally adjacent pixels the rasterizer processes at once
+constexpr std::size_t SPAN_WIDTH = 4;
+
+template <typename T>
+using SpanArray = std::array<T, SPAN_WIDTH>;
+
+/**
+ * Enables or disables the SIMD implementations of the span functions, which are used by default
+ * when the host supports them. With SIMD disabled, coverage and the texture environment are
+ * computed by the scalar code, whose output the SIMD implementations have to match exactly.
+ * Must not be called while triangles are being rasterized.
+ */
+void SetSpanSimdEnabled(bool enabled);
+
+/**
+ * Edge function of a triangle in rasterizer coordinates, which evaluates to
+ * bias + dx * (y - y0) - dy * (x - x0) for the pixel (x, y). This is non-negative for pixels on
+ * the inner side of the edge.
+ */
+struct EdgeFunction {
+    int x0;
+    int y0;
+    int dx;
+    int dy;
+    int bias;
+};
+
+/**
+ * Evaluates the three edge functions of a triangle for the pixels of the span starting at (x, y)
+ * in rasterizer coordinates.
+ * @param max_x Pixels at or right of this coordinate are not part of the span
+ * @param w Receives the value of each edge function for each pixel
+ * @return Bitmask of the pixels covered by the triangle, bit N corresponding to pixel N
+ */
+u32 EvaluateSpanCoverage(const std::array<EdgeFunction, 3>& edges, int x, int y, int max_x,
+                         std::array<SpanArray<int>, 3>& w);
+
+/// Colors feeding the texture environment, for each fragment of a span
+struct TevSpanInputs {
+    SpanArray<Common::Vec4<u8>> primary_color;
+    SpanArray<Common::Vec4<u8>> primary_fragment_color;
+    SpanArray<Common::Vec4<u8>> secondary_fragment_color;
+    std::array<SpanArray<Common::Vec4<u8>>, 4> texture_color;
+};
+
+class TevJit;
+
+/// Texture environment of a triangle, set up once for all of its spans
+class SpanCombiner {
+public:
+    explicit SpanCombiner(const TexturingRegs& regs);
+
+    /**
+     * Runs the texture environment for all fragments of a span. The results of fragments which
+     * are not covered by the triangle are unspecified, but computing them is harmless.
+     */
+    void Combine(const TevSpanInputs& inputs, SpanArray<Common::Vec4<u8>>& output) const;
+
+private:
+    const TexturingRegs& regs;
+    const std::array<TexturingRegs::TevStageConfig, 6> tev_stages;
+
+    /// Compiled texture environment, if the JIT supports the configuration
+    const TevJit* jit = nullptr;
+};
+
+} // namespace Pica::Rasterizer
@@ -2,15 +2,71 @@
 // Licensed under GPLv2 or any later version
 // Refer to the license.txt file included.
 
+#include "core/settings.h"
+#include "video_core/pica_state.h"
 #include "video_core/swrasterizer/clipper.h"
+#include "video_core/swrasterizer/rasterizer.h"
 #include "video_core/swrasterizer/swrasterizer.h"
+#include "video_core/swrasterizer/tile_binner.h"
 
 namespace VideoCore {
 
+SWRasterizer::SWRasterizer() {
+    const std::size_t num_threads = Settings::values.sw_rasterizer_threads;
+    if (num_threads != 1) {
+        tile_binner = std::make_unique<Pica::Rasterizer::TileBinner>(num_threads);
+    }
+}
+
+SWRasterizer::~SWRasterizer() = default;
+
 void SWRasterizer::AddTriangle(const Pica::Shader::OutputVertex& v0,
                                const Pica::Shader::OutputVertex& v1,
                                const Pica::Shader::OutputVertex& v2) {
-    Pica::Clipper::ProcessTriangle(v0, v1, v2);
+    if (!tile_binner) {
+        Pica::Clipper::ProcessTriangle(v0, v1, v2);
+        return;
+    }
+
+    Pica::Clipper::ProcessTriangle(v0, v1, v2,
+                                   [this](const Pica::Rasterizer::Vertex& vtx0,
+                                          const Pica::Rasterizer::Vertex& vtx1,
+                                          const Pica::Rasterizer::Vertex& vtx2) {
+                                       tile_binner->AddTriangle(vtx0, vtx1, vtx2);
+                                   });
+}
+
+void SWRasterizer::DrawTriangles() {
+    if (tile_binner) {
+        tile_binner->Flush();
+    }
+
+    // The draw may have rendered to memory that is sampled as a texture later on. Both buffers
+    // are assumed to use the largest pixel size, as their formats may not be valid.
+    const auto& framebuffer = Pica::g_state.regs.framebuffer.framebuffer;
+    const u32 buffer_size = framebuffer.GetWidth() * framebuffer.GetHeight() * 4;
+    Pica::Rasterizer::InvalidateTextures(framebuffer.GetColorBufferPhysicalAddress(), buffer_size);
+    Pica::Rasterizer::InvalidateTextures(framebuffer.GetDepthBufferPhysicalAddress(), buffer_size);
+}
+
+void SWRasterizer::NotifyCommandListStarted() {
+    Pica::Rasterizer::InvalidateAllTextures();
+}
+
+void SWRasterizer::FlushAll() {
+    DrawTriangles();
+}
+
+void SWRasterizer::InvalidateRegion(PAddr addr, u32 size) {
+    Pica::Rasterizer::InvalidateTextures(addr, size);
+}
+
+void SWRasterizer::FlushAndInvalidateRegion(PAddr addr, u32 size) {
+    Pica::Rasterizer::InvalidateTextures(addr, size);
+}
+
+void SWRasterizer::ClearAll(bool flush) {
+    Pica::Rasterizer::ClearTextures();
 }
 
 } // namespace VideoCore
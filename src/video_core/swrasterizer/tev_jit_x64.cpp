@@ -0,0 +1,500 @@
+// Copyright 2020 Citra Emulator Project
+// Licensed under GPLv2 or any later version
+// Refer to the license.txt file included.
+
+#include <algorithm>
+#include <utility>
+#include "common/assert.h"
+#include "common/logging/log.h"
+#include "common/microprofile.h"
+#include "common/x64/xbyak_abi.h"
+#include "video_core/swrasterizer/tev_jit_x64.h"
+
+using namespace Common::X64;
+using namespace Xbyak::util;
+using Xbyak::Reg64;
+using Xbyak::Xmm;
+
+namespace Pica::Rasterizer {
+
+using TevStageConfig = TexturingRegs::TevStageConfig;
+using Source = TevStageConfig::Source;
+using ColorModifier = TevStageConfig::ColorModifier;
+using AlphaModifier = TevStageConfig::AlphaModifier;
+using Operation = TevStageConfig::Operation;
+
+// Each SSE register holds one RGBA8 color for each of the four fragments of a span, i.e. byte
+// 4 * N + C contains channel C of fragment N.
+static_assert(SPAN_WIDTH * sizeof(Common::Vec4<u8>) == 16,
+              "A span of colors must fit into an SSE register");
+
+// The following is used to alias the registers used by the generated code. All general purpose
+// registers used are caller-saved in both ABIs.
+
+/// Pointer to the TevSpanInputs of the span
+static const Reg64 INPUTS = r9;
+/// Pointer to the texturing registers, used to read the constant colors
+static const Reg64 REGS = r10;
+/// Pointer to the output colors of the span
+static const Reg64 OUTPUT = r11;
+/// Mask selecting the alpha channel of each fragment. pblendvb implicitly uses xmm0 as its mask.
+static const Xmm ALPHA_MASK = xmm0;
+/// Output of the previous texture environment stage
+static const Xmm COMBINER_OUTPUT = xmm1;
+/// Contents of the combiner buffer as seen by the current stage
+static const Xmm COMBINER_BUFFER = xmm2;
+/// Contents of the combiner buffer as seen by the next stage
+static const Xmm NEXT_COMBINER_BUFFER = xmm3;
+/// The three (modified) inputs of the current stage
+static const Xmm INPUT[3] = {xmm4, xmm5, xmm6};
+/// Result of the alpha operation, if it has to be computed separately from the color operation
+static const Xmm ALPHA_RESULT = xmm7;
+/// Scratch registers
+static const Xmm SCRATCH1 = xmm8;
+static const Xmm SCRATCH2 = xmm9;
+static const Xmm SCRATCH3 = xmm10;
+static const Xmm SCRATCH4 = xmm11;
+/// Constant vector of zeroes, used to zero-extend bytes to words
+static const Xmm ZERO = xmm12;
+/// Constant vector with all bits set, used to invert values with XOR
+static const Xmm ONES = xmm13;
+
+// XMM registers used by the generated code which may have to be preserved, depending on the ABI
+static const BitSet32 used_xmm_regs =
+    BuildRegSet({ALPHA_MASK, COMBINER_OUTPUT, COMBINER_BUFFER, NEXT_COMBINER_BUFFER, INPUT[0],
+                 INPUT[1], INPUT[2], ALPHA_RESULT, SCRATCH1, SCRATCH2, SCRATCH3, SCRATCH4, ZERO,
+                 ONES});
+
+/// Offsets of the configuration of each texture environment stage in the texturing registers
+static constexpr std::array<std::size_t, 6> tev_stage_offsets{{
+    offsetof(TexturingRegs, tev_stage0),
+    offsetof(TexturingRegs, tev_stage1),
+    offsetof(TexturingRegs, tev_stage2),
+    offsetof(TexturingRegs, tev_stage3),
+    offsetof(TexturingRegs, tev_stage4),
+    offsetof(TexturingRegs, tev_stage5),
+}};
+
+/// Number of inputs read by an operation
+static unsigned NumOperationInputs(Operation op) {
+    switch (op) {
+    case Operation::Replace:
+        return 1;
+    case Operation::Modulate:
+    case Operation::Add:
+    case Operation::AddSigned:
+    case Operation::Subtract:
+        return 2;
+    default:
+        return 3;
+    }
+}
+
+/// Returns whether the stage passes on the output of the previous stage unchanged
+static bool IsPassthroughStage(const TevStageConfig& stage) {
+    return stage.color_op == Operation::Replace && stage.alpha_op == Operation::Replace &&
+           stage.color_source1 == Source::Previous && stage.alpha_source1 == Source::Previous &&
+           stage.color_modifier1 == ColorModifier::SourceColor &&
+           stage.alpha_modifier1 == AlphaModifier::SourceAlpha &&
+           stage.GetColorMultiplier() == 1 && stage.GetAlphaMultiplier() == 1;
+}
+
+TevJitConfig TevJitConfig::BuildFromRegs(const TexturingRegs& regs) {
+    TevJitConfig res;
+
+    const auto tev_stages = regs.GetTevStages();
+    for (std::size_t i = 0; i < tev_stages.size(); i++) {
+        const auto& tev_stage = tev_stages[i];
+        res.state.tev_stages[i].sources_raw = tev_stage.sources_raw;
+        res.state.tev_stages[i].modifiers_raw = tev_stage.modifiers_raw;
+        res.state.tev_stages[i].ops_raw = tev_stage.ops_raw;
+        res.state.tev_stages[i].scales_raw = tev_stage.scales_raw;
+    }
+
+    res.state.combiner_buffer_input =
+        static_cast<u8>(regs.tev_combiner_buffer_input.update_mask_rgb.Value() |
+                        regs.tev_combiner_buffer_input.update_mask_a.Value() << 4);
+
+    return res;
+}
+
+bool TevJitConfig::IsSupported() const {
+    const auto is_supported_op = [](Operation op) {
+        return op <= Operation::Subtract || op == Operation::MultiplyThenAdd ||
+               op == Operation::AddThenMultiply;
+    };
+    const auto is_supported_source = [](Source source) {
+        return source <= Source::Texture3 || source >= Source::PreviousBuffer;
+    };
+    const auto is_supported_modifier = [](ColorModifier modifier) {
+        // Apart from SourceAlpha and OneMinusSourceAlpha, values with bit 1 set are undefined
+        return modifier <= ColorModifier::SourceRed || (static_cast<u32>(modifier) & 2) == 0;
+    };
+
+    for (unsigned i = 0; i < 6; ++i) {
+        const auto stage = GetTevStage(i);
+        if (!is_supported_op(stage.color_op) || !is_supported_op(stage.alpha_op) ||
+            !is_supported_source(stage.color_source1) ||
+            !is_supported_source(stage.color_source2) ||
+            !is_supported_source(stage.color_source3) ||
+            !is_supported_source(stage.alpha_source1) ||
+            !is_supported_source(stage.alpha_source2) ||
+            !is_supported_source(stage.alpha_source3) ||
+            !is_supported_modifier(stage.color_modifier1) ||
+            !is_supported_modifier(stage.color_modifier2) ||
+            !is_supported_modifier(stage.color_modifier3)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+TevJit::TevJit(const TevJitConfig& config) : Xbyak::CodeGenerator(MAX_TEV_JIT_SIZE) {
+    CompilePrelude();
+    Compile(config);
+}
+
+void TevJit::CompilePrelude() {
+    align(16);
+    for (u32 channel = 0; channel < 4; ++channel) {
+        channel_shuffle[channel] = getCurr();
+        for (u32 fragment = 0; fragment < 4; ++fragment) {
+            dd((fragment * 4 + channel) * 0x01010101);
+        }
+    }
+
+    words_1 = getCurr();
+    for (int i = 0; i < 4; ++i) {
+        dd(0x00010001);
+    }
+
+    words_128 = getCurr();
+    for (int i = 0; i < 4; ++i) {
+        dd(0x00800080);
+    }
+
+    alpha_mask = getCurr();
+    for (int i = 0; i < 4; ++i) {
+        dd(0xFF000000);
+    }
+}
+
+void TevJit::Compile_LoadSource(Source source, unsigned stage_index, Xmm dest) {
+    switch (source) {
+    case Source::PrimaryColor:
+        movdqu(dest, xword[INPUTS + offsetof(TevSpanInputs, primary_color)]);
+        break;
+    case Source::PrimaryFragmentColor:
+        movdqu(dest, xword[INPUTS + offsetof(TevSpanInputs, primary_fragment_color)]);
+        break;
+    case Source::SecondaryFragmentColor:
+        movdqu(dest, xword[INPUTS + offsetof(TevSpanInputs, secondary_fragment_color)]);
+        break;
+    case Source::Texture0:
+    case Source::Texture1:
+    case Source::Texture2:
+    case Source::Texture3: {
+        const std::size_t index = static_cast<u32>(source) - static_cast<u32>(Source::Texture0);
+        movdqu(dest, xword[INPUTS + offsetof(TevSpanInputs, texture_color) +
+                           index * sizeof(SpanArray<Common::Vec4<u8>>)]);
+        break;
+    }
+    case Source::PreviousBuffer:
+        movdqa(dest, COMBINER_BUFFER);
+        break;
+    case Source::Constant:
+        movd(dest, dword[REGS + tev_stage_offsets[stage_index] +
+                         offsetof(TevStageConfig, const_color)]);
+        pshufd(dest, dest, 0);
+        break;
+    case Source::Previous:
+        movdqa(dest, COMBINER_OUTPUT);
+        break;
+    default:
+        // Filtered out by TevJitConfig::IsSupported
+        UNREACHABLE();
+        break;
+    }
+}
+
+void TevJit::Compile_ColorModifier(ColorModifier modifier, Xmm value) {
+    const u32 raw = static_cast<u32>(modifier);
+    // SourceColor keeps the color as it is, the other modifiers broadcast a single channel
+    // (encoded in bits 2-3, with the value 0 for SourceAlpha).
+    if (modifier != ColorModifier::SourceColor && modifier != ColorModifier::OneMinusSourceColor) {
+        const u32 channel = (raw >> 2 == 0) ? 3 : (raw >> 2) - 1;
+        pshufb(value, xword[rip + channel_shuffle[channel]]);
+    }
+    // Odd values invert the channel
+    if (raw & 1) {
+        pxor(value, ONES);
+    }
+}
+
+void TevJit::Compile_AlphaModifier(AlphaModifier modifier, Xmm value) {
+    const u32 raw = static_cast<u32>(modifier);
+    // Bits 1-2 select the channel, starting with alpha
+    const u32 channel = (raw >> 1) == 0 ? 3 : (raw >> 1) - 1;
+    pshufb(value, xword[rip + channel_shuffle[channel]]);
+    // Odd values invert the channel
+    if (raw & 1) {
+        pxor(value, ONES);
+    }
+}
+
+void TevJit::Compile_Div255(Xmm value, Xmm scratch) {
+    // (x + 1 + (x >> 8)) >> 8, which is exact for values up to 255 * 255
+    movdqa(scratch, value);
+    psrlw(scratch, 8);
+    paddw(value, xword[rip + words_1]);
+    paddw(value, scratch);
+    psrlw(value, 8);
+}
+
+void TevJit::Compile_MulDiv255(Xmm dest, Xmm a, Xmm b) {
+    movdqa(SCRATCH1, a);
+    punpcklbw(SCRATCH1, ZERO);
+    movdqa(SCRATCH2, b);
+    punpcklbw(SCRATCH2, ZERO);
+    pmullw(SCRATCH1, SCRATCH2);
+    Compile_Div255(SCRATCH1, SCRATCH2);
+
+    movdqa(SCRATCH3, a);
+    punpckhbw(SCRATCH3, ZERO);
+    movdqa(SCRATCH2, b);
+    punpckhbw(SCRATCH2, ZERO);
+    pmullw(SCRATCH3, SCRATCH2);
+    Compile_Div255(SCRATCH3, SCRATCH2);
+
+    packuswb(SCRATCH1, SCRATCH3);
+    movdqa(dest, SCRATCH1);
+}
+
+void TevJit::Compile_Operation(Operation op, Xmm dest) {
+    switch (op) {
+    case Operation::Replace:
+        movdqa(dest, INPUT[0]);
+        break;
+
+    case Operation::Modulate:
+        Compile_MulDiv255(dest, INPUT[0], INPUT[1]);
+        break;
+
+    case Operation::Add:
+        movdqa(dest, INPUT[0]);
+        paddusb(dest, INPUT[1]);
+        break;
+
+    case Operation::AddSigned:
+        movdqa(SCRATCH1, INPUT[0]);
+        punpcklbw(SCRATCH1, ZERO);
+        movdqa(SCRATCH2, INPUT[1]);
+        punpcklbw(SCRATCH2, ZERO);
+        paddw(SCRATCH1, SCRATCH2);
+        psubw(SCRATCH1, xword[rip + words_128]);
+
+        movdqa(dest, INPUT[0]);
+        punpckhbw(dest, ZERO);
+        movdqa(SCRATCH2, INPUT[1]);
+        punpckhbw(SCRATCH2, ZERO);
+        paddw(dest, SCRATCH2);
+        psubw(dest, xword[rip + words_128]);
+
+        // Saturates the signed results to [0, 255]
+        packuswb(SCRATCH1, dest);
+        movdqa(dest, SCRATCH1);
+        break;
+
+    case Operation::Lerp:
+        // input[0] * input[2] + input[1] * (255 - input[2]). The sum can't exceed 255 * 255, so it
+        // fits into 16 bits.
+        movdqa(SCRATCH4, INPUT[2]);
+        pxor(SCRATCH4, ONES);
+
+        movdqa(SCRATCH1, INPUT[0]);
+        punpcklbw(SCRATCH1, ZERO);
+        movdqa(SCRATCH2, INPUT[2]);
+        punpcklbw(SCRATCH2, ZERO);
+        pmullw(SCRATCH1, SCRATCH2);
+        movdqa(SCRATCH2, INPUT[1]);
+        punpcklbw(SCRATCH2, ZERO);
+        movdqa(SCRATCH3, SCRATCH4);
+        punpcklbw(SCRATCH3, ZERO);
+        pmullw(SCRATCH2, SCRATCH3);
+        paddw(SCRATCH1, SCRATCH2);
+        Compile_Div255(SCRATCH1, SCRATCH2);
+
+        movdqa(dest, INPUT[0]);
+        punpckhbw(dest, ZERO);
+        movdqa(SCRATCH2, INPUT[2]);
+        punpckhbw(SCRATCH2, ZERO);
+        pmullw(dest, SCRATCH2);
+        movdqa(SCRATCH2, INPUT[1]);
+        punpckhbw(SCRATCH2, ZERO);
+        movdqa(SCRATCH3, SCRATCH4);
+        punpckhbw(SCRATCH3, ZERO);
+        pmullw(SCRATCH2, SCRATCH3);
+        paddw(dest, SCRATCH2);
+        Compile_Div255(dest, SCRATCH2);
+
+        packuswb(SCRATCH1, dest);
+        movdqa(dest, SCRATCH1);
+        break;
+
+    case Operation::Subtract:
+        movdqa(dest, INPUT[0]);
+        psubusb(dest, INPUT[1]);
+        break;
+
+    case Operation::MultiplyThenAdd:
+        // (a * b + 255 * c) / 255 == (a * b) / 255 + c
+        Compile_MulDiv255(dest, INPUT[0], INPUT[1]);
+        paddusb(dest, INPUT[2]);
+        break;
+
+    case Operation::AddThenMultiply:
+        movdqa(dest, INPUT[0]);
+        paddusb(dest, INPUT[1]);
+        Compile_MulDiv255(dest, dest, INPUT[2]);
+        break;
+
+    default:
+        // Filtered out by TevJitConfig::IsSupported
+        UNREACHABLE();
+        break;
+    }
+}
+
+void TevJit::Compile_Scale(unsigned multiplier, Xmm value) {
+    // Multiplies each byte by 1, 2 or 4, saturating the result
+    for (; multiplier > 1; multiplier >>= 1) {
+        paddusb(value, value);
+    }
+}
+
+void TevJit::Compile(const TevJitConfig& config) {
+    program = (CompiledTev*)getCurr();
+
+    // Only Windows has callee-saved XMM registers
+    ABI_PushRegistersAndAdjustStack(*this, ABI_ALL_CALLEE_SAVED & used_xmm_regs, 8);
+
+    mov(INPUTS, ABI_PARAM1);
+    mov(REGS, ABI_PARAM2);
+    mov(OUTPUT, ABI_PARAM3);
+
+    movdqa(ALPHA_MASK, xword[rip + alpha_mask]);
+    pxor(ZERO, ZERO);
+    pcmpeqb(ONES, ONES);
+
+    // The combiner buffer is only tracked if any stage reads it
+    bool uses_combiner_buffer = false;
+    for (unsigned i = 0; i < 6; ++i) {
+        const auto stage = config.GetTevStage(i);
+        for (const Source source : {stage.color_source1.Value(), stage.color_source2.Value(),
+                                    stage.color_source3.Value(), stage.alpha_source1.Value(),
+                                    stage.alpha_source2.Value(), stage.alpha_source3.Value()}) {
+            uses_combiner_buffer |= source == Source::PreviousBuffer;
+        }
+    }
+
+    pxor(COMBINER_OUTPUT, COMBINER_OUTPUT);
+    if (uses_combiner_buffer) {
+        pxor(COMBINER_BUFFER, COMBINER_BUFFER);
+        movd(NEXT_COMBINER_BUFFER,
+             dword[REGS + offsetof(TexturingRegs, tev_combiner_buffer_color)]);
+        pshufd(NEXT_COMBINER_BUFFER, NEXT_COMBINER_BUFFER, 0);
+    }
+
+    for (unsigned stage_index = 0; stage_index < 6; ++stage_index) {
+        const auto stage = config.GetTevStage(stage_index);
+
+        if (!IsPassthroughStage(stage)) {
+            const std::array<std::pair<Source, Source>, 3> sources{{
+                {stage.color_source1, stage.alpha_source1},
+                {stage.color_source2, stage.alpha_source2},
+                {stage.color_source3, stage.alpha_source3},
+            }};
+            const std::array<std::pair<ColorModifier, AlphaModifier>, 3> modifiers{{
+                {stage.color_modifier1, stage.alpha_modifier1},
+                {stage.color_modifier2, stage.alpha_modifier2},
+                {stage.color_modifier3, stage.alpha_modifier3},
+            }};
+
+            // The color modifiers produce the RGB channels and the alpha modifiers the alpha
+            // channel of the combiner inputs. Inputs which neither operation reads are skipped.
+            const unsigned num_inputs =
+                std::max(NumOperationInputs(stage.color_op), NumOperationInputs(stage.alpha_op));
+            for (unsigned i = 0; i < num_inputs; ++i) {
+                Compile_LoadSource(sources[i].first, stage_index, INPUT[i]);
+                Compile_ColorModifier(modifiers[i].first, INPUT[i]);
+                Compile_LoadSource(sources[i].second, stage_index, SCRATCH1);
+                Compile_AlphaModifier(modifiers[i].second, SCRATCH1);
+                pblendvb(INPUT[i], SCRATCH1);
+            }
+
+            // The color and alpha operations work identically on each channel, so the alpha
+            // operation only needs to be computed separately if it is configured differently.
+            // COMBINER_OUTPUT can be overwritten, since the inputs have already been loaded.
+            Compile_Operation(stage.color_op, COMBINER_OUTPUT);
+            Compile_Scale(stage.GetColorMultiplier(), COMBINER_OUTPUT);
+            if (stage.alpha_op != stage.color_op ||
+                stage.GetAlphaMultiplier() != stage.GetColorMultiplier()) {
+                Compile_Operation(stage.alpha_op, ALPHA_RESULT);
+                Compile_Scale(stage.GetAlphaMultiplier(), ALPHA_RESULT);
+                pblendvb(COMBINER_OUTPUT, ALPHA_RESULT);
+            }
+        }
+
+        if (uses_combiner_buffer) {
+            movdqa(COMBINER_BUFFER, NEXT_COMBINER_BUFFER);
+
+            if (config.TevStageUpdatesCombinerBufferColor(stage_index)) {
+                // Replace the color channels, keeping the alpha channel
+                movdqa(SCRATCH1, COMBINER_OUTPUT);
+                pblendvb(SCRATCH1, NEXT_COMBINER_BUFFER);
+                movdqa(NEXT_COMBINER_BUFFER, SCRATCH1);
+            }
+
+            if (config.TevStageUpdatesCombinerBufferAlpha(stage_index)) {
+                pblendvb(NEXT_COMBINER_BUFFER, COMBINER_OUTPUT);
+            }
+        }
+    }
+
+    movdqu(xword[OUTPUT], COMBINER_OUTPUT);
+
+    ABI_PopRegistersAndAdjustStack(*this, ABI_ALL_CALLEE_SAVED & used_xmm_regs, 8);
+    ret();
+
+    ready();
+
+    ASSERT_MSG(getSize() <= MAX_TEV_JIT_SIZE, "Compiled a TEV that exceeds the allocated size!");
+    LOG_DEBUG(HW_GPU, "Compiled TEV size={}", getSize());
+}
+
+TevJitCache::TevJitCache() = default;
+TevJitCache::~TevJitCache() = default;
+
+MICROPROFILE_DEFINE(GPU_TevJitCompile, "GPU", "TEV JIT Compilation", MP_RGB(100, 255, 52));
+
+const TevJit* TevJitCache::Get(const TexturingRegs& regs) {
+    const auto config = TevJitConfig::BuildFromRegs(regs);
+
+    std::lock_guard lock{mutex};
+    auto iter = cache.find(config);
+    if (iter != cache.end()) {
+        return iter->second.get();
+    }
+
+    std::unique_ptr<TevJit> tev;
+    if (config.IsSupported()) {
+        MICROPROFILE_SCOPE(GPU_TevJitCompile);
+        tev = std::make_unique<TevJit>(config);
+    }
+    // Unsupported configurations are cached as well, to avoid checking them again
+    const TevJit* result = tev.get();
+    cache.emplace_hint(iter, config, std::move(tev));
+    return result;
+}
+
+} // namespace Pica::Rasterizer
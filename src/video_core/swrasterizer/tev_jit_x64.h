@@ -0,0 +1,141 @@
+// Copyright 2020 Citra Emulator Project
+// Licensed under GPLv2 or any later version
+// Refer to the license.txt file included.
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <xbyak.h>
+#include "common/common_types.h"
+#include "common/hash.h"
+#include "video_core/regs_texturing.h"
+#include "video_core/swrasterizer/span.h"
+
+namespace Pica::Rasterizer {
+
+/// Memory allocated for each compiled texture environment
+constexpr std::size_t MAX_TEV_JIT_SIZE = 16 * 1024;
+
+struct TevJitConfigState {
+    struct {
+        u32 sources_raw;
+        u32 modifiers_raw;
+        u32 ops_raw;
+        u32 scales_raw;
+    } tev_stages[6];
+    u8 combiner_buffer_input;
+};
+
+/**
+ * The part of the texture environment configuration that is compiled into the generated code.
+ * Constant colors and the initial combiner buffer color are read from the registers at runtime, so
+ * changing them does not require a recompilation.
+ */
+struct TevJitConfig : Common::HashableStruct<TevJitConfigState> {
+    /// Construct a TevJitConfig with the given Pica register configuration.
+    static TevJitConfig BuildFromRegs(const TexturingRegs& regs);
+
+    TexturingRegs::TevStageConfig GetTevStage(unsigned stage_index) const {
+        TexturingRegs::TevStageConfig stage;
+        stage.sources_raw = state.tev_stages[stage_index].sources_raw;
+        stage.modifiers_raw = state.tev_stages[stage_index].modifiers_raw;
+        stage.ops_raw = state.tev_stages[stage_index].ops_raw;
+        stage.const_color = 0;
+        stage.scales_raw = state.tev_stages[stage_index].scales_raw;
+        return stage;
+    }
+
+    bool TevStageUpdatesCombinerBufferColor(unsigned stage_index) const {
+        return (stage_index < 4) && (state.combiner_buffer_input & (1 << stage_index));
+    }
+
+    bool TevStageUpdatesCombinerBufferAlpha(unsigned stage_index) const {
+        return (stage_index < 4) && ((state.combiner_buffer_input >> 4) & (1 << stage_index));
+    }
+
+    /// Returns whether the configuration only uses operations that TevJit can compile
+    bool IsSupported() const;
+};
+
+} // namespace Pica::Rasterizer
+
+namespace std {
+template <>
+struct hash<Pica::Rasterizer::TevJitConfig> {
+    std::size_t operator()(const Pica::Rasterizer::TevJitConfig& k) const noexcept {
+        return k.Hash();
+    }
+};
+} // namespace std
+
+namespace Pica::Rasterizer {
+
+/**
+ * This class implements the texture environment JIT compiler. It compiles one texture environment
+ * configuration into straight-line x86_64 code which combines the colors of a whole span, with
+ * all sources, modifiers and operations resolved at compile time. Requires SSE4.1.
+ */
+class TevJit : public Xbyak::CodeGenerator {
+public:
+    explicit TevJit(const TevJitConfig& config);
+
+    void Run(const TexturingRegs& regs, const TevSpanInputs& inputs,
+             SpanArray<Common::Vec4<u8>>& output) const {
+        program(&inputs, &regs, output.data());
+    }
+
+private:
+    void Compile(const TevJitConfig& config);
+    void CompilePrelude();
+
+    void Compile_LoadSource(TexturingRegs::TevStageConfig::Source source, unsigned stage_index,
+                            Xbyak::Xmm dest);
+    void Compile_ColorModifier(TexturingRegs::TevStageConfig::ColorModifier modifier,
+                               Xbyak::Xmm value);
+    void Compile_AlphaModifier(TexturingRegs::TevStageConfig::AlphaModifier modifier,
+                               Xbyak::Xmm value);
+    void Compile_Operation(TexturingRegs::TevStageConfig::Operation op, Xbyak::Xmm dest);
+    void Compile_Scale(unsigned multiplier, Xbyak::Xmm value);
+
+    /// Computes (a * b) / 255 for each byte of `a` and `b` into `dest`, which may alias `a`
+    void Compile_MulDiv255(Xbyak::Xmm dest, Xbyak::Xmm a, Xbyak::Xmm b);
+    /// Divides each 16-bit lane of `value` by 255, clobbering `scratch`
+    void Compile_Div255(Xbyak::Xmm value, Xbyak::Xmm scratch);
+
+    /// Shuffle masks broadcasting each color channel of a fragment to all of its channels
+    std::array<const void*, 4> channel_shuffle{};
+    /// Constant vectors of 16-bit lanes
+    const void* words_1 = nullptr;
+    const void* words_128 = nullptr;
+    /// Selects the alpha channel of each fragment in pblendvb
+    const void* alpha_mask = nullptr;
+
+    using CompiledTev = void(const TevSpanInputs* inputs, const TexturingRegs* regs,
+                             Common::Vec4<u8>* output);
+    CompiledTev* program = nullptr;
+};
+
+/**
+ * Keeps one compiled texture environment per configuration. Lookups may happen concurrently from
+ * the rasterizer threads.
+ */
+class TevJitCache {
+public:
+    TevJitCache();
+    ~TevJitCache();
+
+    /// Returns the compiled texture environment for the given registers, or nullptr if the
+    /// configuration is not supported by the JIT
+    const TevJit* Get(const TexturingRegs& regs);
+
+private:
+    std::mutex mutex;
+    std::unordered_map<TevJitConfig, std::unique_ptr<TevJit>> cache;
+};
+
+} // namespace Pica::Rasterizer
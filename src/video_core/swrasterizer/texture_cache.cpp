@@ -0,0 +1,102 @@
+// Copyright 2020 Citra Emulator Project
+// Licensed under GPLv2 or any later version
+// Refer to the license.txt file included.
+
+#include <algorithm>
+#include "common/hash.h"
+#include "common/microprofile.h"
+#include "core/memory.h"
+#include "video_core/swrasterizer/texture_cache.h"
+#include "video_core/video_core.h"
+
+namespace Pica::Rasterizer {
+
+static_assert(sizeof(Common::Vec4<u8>) == 4, "Decoded texels must be tightly packed");
+
+/// The least recently used textures are removed once the decoded textures exceed this size
+constexpr std::size_t MAX_DECODED_SIZE = 64 * 1024 * 1024;
+
+std::size_t TextureCache::KeyHash::operator()(const Key& key) const noexcept {
+    return static_cast<std::size_t>(Common::ComputeStructHash64(key));
+}
+
+TextureCache::TextureCache() = default;
+TextureCache::~TextureCache() = default;
+
+MICROPROFILE_DEFINE(GPU_TextureDecode, "GPU", "Texture Decoding", MP_RGB(100, 100, 255));
+
+const DecodedTexture& TextureCache::Get(const Texture::TextureInfo& info) {
+    const Key key{info.physical_address, info.width, info.height, info.format};
+
+    std::lock_guard lock{mutex};
+    auto [iter, inserted] = cache.try_emplace(key);
+    Entry& entry = iter->second;
+    entry.last_used = generation;
+    if (entry.checked) {
+        return entry.texture;
+    }
+    entry.checked = true;
+
+    const u8* source = VideoCore::g_memory->GetPhysicalPointer(info.physical_address);
+    const std::size_t source_size = static_cast<std::size_t>(info.stride) * (info.height / 8);
+    const u64 source_hash = source != nullptr ? Common::ComputeHash64(source, source_size) : 0;
+    if (!inserted && source_hash == entry.source_hash) {
+        return entry.texture;
+    }
+
+    MICROPROFILE_SCOPE(GPU_TextureDecode);
+    entry.source_size = source_size;
+    entry.source_hash = source_hash;
+
+    DecodedTexture& texture = entry.texture;
+    if (inserted) {
+        texture.width = info.width;
+        texture.height = info.height;
+        texture.texels.resize(info.width * info.height);
+        decoded_size += texture.texels.size() * sizeof(Common::Vec4<u8>);
+    }
+
+    if (source != nullptr) {
+        Texture::DecodeTextureRect(source, info, 0, 0, info.width, info.height,
+                                   reinterpret_cast<u8*>(texture.texels.data()),
+                                   info.width * sizeof(Common::Vec4<u8>));
+    } else {
+        std::fill(texture.texels.begin(), texture.texels.end(), Common::Vec4<u8>{});
+    }
+    return texture;
+}
+
+void TextureCache::InvalidateRegion(PAddr addr, u32 size) {
+    const PAddr end = addr + size;
+    for (auto& [key, entry] : cache) {
+        if (key.address < end && addr < key.address + entry.source_size) {
+            entry.checked = false;
+        }
+    }
+}
+
+void TextureCache::InvalidateAll() {
+    if (decoded_size > MAX_DECODED_SIZE) {
+        for (auto iter = cache.begin(); iter != cache.end();) {
+            const DecodedTexture& texture = iter->second.texture;
+            if (iter->second.last_used != generation) {
+                decoded_size -= texture.texels.size() * sizeof(Common::Vec4<u8>);
+                iter = cache.erase(iter);
+            } else {
+                ++iter;
+            }
+        }
+    }
+
+    for (auto& [key, entry] : cache) {
+        entry.checked = false;
+    }
+    ++generation;
+}
+
+void TextureCache::Clear() {
+    cache.clear();
+    decoded_size = 0;
+}
+
+} // namespace Pica::Rasterizer
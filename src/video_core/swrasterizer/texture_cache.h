@@ -0,0 +1,98 @@
+// Copyright 2020 Citra Emulator Project
+// Licensed under GPLv2 or any later version
+// Refer to the license.txt file included.
+
+#pragma once
+
+#include <cstddef>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+#include "common/common_types.h"
+#include "common/vector_math.h"
+#include "video_core/regs_texturing.h"
+#include "video_core/texture/texture_decode.h"
+
+namespace Pica::Rasterizer {
+
+/// A texture decoded to RGBA8, stored row by row
+struct DecodedTexture {
+    u32 width = 0;
+    u32 height = 0;
+    std::vector<Common::Vec4<u8>> texels;
+
+    /// Returns the texel at the given coordinates, which must lie inside the texture
+    Common::Vec4<u8> Lookup(unsigned int s, unsigned int t) const {
+        return texels[t * width + s];
+    }
+};
+
+/**
+ * Keeps decoded copies of the textures sampled by the rasterizer, so that sampling a texel is a
+ * plain load. Textures are identified by their address, format and size. Their memory is hashed
+ * to tell whether a texture actually changed when it has to be checked again, as writes by the
+ * emulated CPU are not reported to the rasterizer.
+ *
+ * Lookups may happen concurrently from the rasterizer threads. The other functions must not be
+ * called while triangles are being rasterized.
+ */
+class TextureCache {
+public:
+    TextureCache();
+    ~TextureCache();
+
+    /**
+     * Returns the decoded texture, decoding it again if its memory changed since it was last
+     * checked. The reference stays valid until InvalidateAll or Clear is called.
+     */
+    const DecodedTexture& Get(const Texture::TextureInfo& info);
+
+    /// Makes the textures overlapping the given region check their memory for changes again
+    void InvalidateRegion(PAddr addr, u32 size);
+
+    /**
+     * Makes all textures check their memory for changes again. If the cache grew too large, the
+     * textures that were not used since the previous call are removed.
+     */
+    void InvalidateAll();
+
+    /// Removes all textures
+    void Clear();
+
+private:
+    struct Key {
+        PAddr address;
+        u32 width;
+        u32 height;
+        TexturingRegs::TextureFormat format;
+
+        bool operator==(const Key& other) const {
+            return address == other.address && width == other.width && height == other.height &&
+                   format == other.format;
+        }
+    };
+
+    struct KeyHash {
+        std::size_t operator()(const Key& key) const noexcept;
+    };
+
+    struct Entry {
+        DecodedTexture texture;
+        /// Size of the encoded texture in memory
+        std::size_t source_size = 0;
+        u64 source_hash = 0;
+        /// Whether the memory of the texture was checked since the last invalidation
+        bool checked = false;
+        /// Value of generation when the texture was last used
+        u64 last_used = 0;
+    };
+
+    std::mutex mutex;
+    std::unordered_map<Key, Entry, KeyHash> cache;
+    /// Number of calls to InvalidateAll
+    u64 generation = 0;
+    /// Total size of the decoded textures in bytes
+    std::size_t decoded_size = 0;
+};
+
+} // namespace Pica::Rasterizer
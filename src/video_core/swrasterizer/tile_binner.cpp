@@ -0,0 +1,86 @@
+// Copyright 2020 Citra Emulator Project
+// Licensed under GPLv2 or any later version
+// Refer to the license.txt file included.
+
+#include "common/microprofile.h"
+#include "video_core/pica_state.h"
+#include "video_core/swrasterizer/tile_binner.h"
+
+namespace Pica::Rasterizer {
+
+MICROPROFILE_DEFINE(GPU_RasterizerBinning, "GPU", "Rasterizer Binning", MP_RGB(50, 80, 240));
+
+TileBinner::TileBinner(std::size_t num_threads)
+    : pool(num_threads, "SWRasterizer"), bins(MAX_TILES_X * MAX_TILES_Y) {}
+
+TileBinner::~TileBinner() = default;
+
+void TileBinner::AddTriangle(const Vertex& v0, const Vertex& v1, const Vertex& v2) {
+    MICROPROFILE_SCOPE(GPU_RasterizerBinning);
+
+    const auto bounds = GetTriangleBounds(v0, v1, v2);
+    if (bounds.left >= bounds.right || bounds.top >= bounds.bottom) {
+        // The triangle does not cover any pixels
+        return;
+    }
+
+    const u32 index = static_cast<u32>(vertices.size() / 3);
+    vertices.push_back(v0);
+    vertices.push_back(v1);
+    vertices.push_back(v2);
+
+    if (serial_batch) {
+        return;
+    }
+
+    const auto& framebuffer = g_state.regs.framebuffer.framebuffer;
+    if (bounds.right > framebuffer.GetWidth() || bounds.bottom > framebuffer.GetHeight()) {
+        serial_batch = true;
+        return;
+    }
+
+    for (u32 tile_y = bounds.top / TILE_SIZE; tile_y <= (bounds.bottom - 1) / TILE_SIZE;
+         ++tile_y) {
+        for (u32 tile_x = bounds.left / TILE_SIZE; tile_x <= (bounds.right - 1) / TILE_SIZE;
+             ++tile_x) {
+            const u32 tile = tile_y * MAX_TILES_X + tile_x;
+            if (bins[tile].empty()) {
+                active_tiles.push_back(tile);
+            }
+            bins[tile].push_back(index);
+        }
+    }
+}
+
+void TileBinner::Flush() {
+    if (vertices.empty()) {
+        return;
+    }
+
+    if (serial_batch || pool.NumThreads() == 1) {
+        for (std::size_t i = 0; i < vertices.size(); i += 3) {
+            ProcessTriangle(vertices[i], vertices[i + 1], vertices[i + 2]);
+        }
+    } else {
+        pool.ParallelFor(active_tiles.size(), [this](std::size_t i) {
+            const u32 tile = active_tiles[i];
+            const u32 left = (tile % MAX_TILES_X) * TILE_SIZE;
+            const u32 top = (tile / MAX_TILES_X) * TILE_SIZE;
+            const Common::Rectangle<u32> region{left, top, left + TILE_SIZE, top + TILE_SIZE};
+
+            for (const u32 index : bins[tile]) {
+                const std::size_t base = static_cast<std::size_t>(index) * 3;
+                ProcessTriangle(vertices[base], vertices[base + 1], vertices[base + 2], region);
+            }
+        });
+    }
+
+    for (const u32 tile : active_tiles) {
+        bins[tile].clear();
+    }
+    active_tiles.clear();
+    vertices.clear();
+    serial_batch = false;
+}
+
+} // namespace Pica::Rasterizer
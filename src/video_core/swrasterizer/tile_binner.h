@@ -0,0 +1,56 @@
+// Copyright 2020 Citra Emulator Project
+// Licensed under GPLv2 or any later version
+// Refer to the license.txt file included.
+
+#pragma once
+
+#include <cstddef>
+#include <vector>
+#include "common/common_types.h"
+#include "common/thread_pool.h"
+#include "video_core/swrasterizer/rasterizer.h"
+
+namespace Pica::Rasterizer {
+
+/**
+ * Defers rasterization of the triangles of a draw call and sorts them into screen tiles, so that
+ * the tiles can be rasterized concurrently when the batch is flushed.
+ *
+ * Each tile is owned by exactly one thread during a flush and processes its triangles in
+ * submission order, so the output is identical to rasterizing the batch serially.
+ */
+class TileBinner {
+public:
+    /// @param num_threads Number of threads used for rasterization, 0 for one per host core
+    explicit TileBinner(std::size_t num_threads);
+    ~TileBinner();
+
+    /// Queues a (clipped) triangle of the current batch
+    void AddTriangle(const Vertex& v0, const Vertex& v1, const Vertex& v2);
+
+    /// Rasterizes all queued triangles. Must be called before any rasterizer state changes.
+    void Flush();
+
+private:
+    static constexpr u32 TILE_SIZE = 32;
+    // The framebuffer width and height registers are 11 and 10 bits wide, respectively
+    static constexpr u32 MAX_TILES_X = (1 << 11) / TILE_SIZE;
+    static constexpr u32 MAX_TILES_Y = (1 << 10) / TILE_SIZE;
+
+    Common::ThreadPool pool;
+
+    /// Vertices of the queued triangles, three per triangle
+    std::vector<Vertex> vertices;
+    /// Indices of the triangles overlapping each tile, in submission order
+    std::vector<std::vector<u32>> bins;
+    /// Tiles with a non-empty bin
+    std::vector<u32> active_tiles;
+
+    /**
+     * Set when a triangle of the batch reaches outside the framebuffer. Such pixels can alias
+     * pixels of other tiles in memory, so the batch is then rasterized on a single thread.
+     */
+    bool serial_batch = false;
+};
+
+} // namespace Pica::Rasterizer
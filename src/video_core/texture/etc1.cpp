@@ -69,28 +69,23 @@ union ETC1Tile {
         BitField<60, 4, u64> r1;
     } separate;
 
-    const Common::Vec3<u8> GetRGB(unsigned int x, unsigned int y) const {
-        int texel = 4 * x + y;
-
-        if (flip)
-            std::swap(x, y);
-
-        // Lookup base value
+    /// Returns the base color of one half of the subtile
+    Common::Vec3<int> GetBaseColor(unsigned half) const {
         Common::Vec3<int> ret;
         if (differential_mode) {
             ret.r() = static_cast<int>(differential.r);
             ret.g() = static_cast<int>(differential.g);
             ret.b() = static_cast<int>(differential.b);
-            if (x >= 2) {
+            if (half == 1) {
                 ret.r() += static_cast<int>(differential.dr);
                 ret.g() += static_cast<int>(differential.dg);
                 ret.b() += static_cast<int>(differential.db);
             }
-            ret.r() = Color::Convert5To8(ret.r());
-            ret.g() = Color::Convert5To8(ret.g());
-            ret.b() = Color::Convert5To8(ret.b());
+            ret.r() = Color::Convert5To8(static_cast<u8>(ret.r()));
+            ret.g() = Color::Convert5To8(static_cast<u8>(ret.g()));
+            ret.b() = Color::Convert5To8(static_cast<u8>(ret.b()));
         } else {
-            if (x < 2) {
+            if (half == 0) {
                 ret.r() = Color::Convert4To8(static_cast<u8>(separate.r1));
                 ret.g() = Color::Convert4To8(static_cast<u8>(separate.g1));
                 ret.b() = Color::Convert4To8(static_cast<u8>(separate.b1));
@@ -100,20 +95,36 @@ union ETC1Tile {
                 ret.b() = Color::Convert4To8(static_cast<u8>(separate.b2));
             }
         }
+        return ret;
+    }
 
-        // Add modifier
+    /// Returns the modifier of a texel in one half of the subtile
+    int GetModifier(unsigned half, unsigned texel) const {
         unsigned table_index =
-            static_cast<int>((x < 2) ? table_index_1.Value() : table_index_2.Value());
+            static_cast<int>((half == 0) ? table_index_1.Value() : table_index_2.Value());
 
         int modifier = etc1_modifier_table[table_index][GetTableSubIndex(texel)];
         if (GetNegationFlag(texel))
             modifier *= -1;
+        return modifier;
+    }
 
-        ret.r() = std::clamp(ret.r() + modifier, 0, 255);
-        ret.g() = std::clamp(ret.g() + modifier, 0, 255);
-        ret.b() = std::clamp(ret.b() + modifier, 0, 255);
+    /// Returns which half of the subtile a texel belongs to
+    unsigned GetHalf(unsigned int x, unsigned int y) const {
+        return ((flip ? y : x) < 2) ? 0 : 1;
+    }
 
-        return ret.Cast<u8>();
+    const Common::Vec3<u8> GetRGB(unsigned int x, unsigned int y) const {
+        const unsigned half = GetHalf(x, y);
+        const int modifier = GetModifier(half, 4 * x + y);
+        return ApplyModifier(GetBaseColor(half), modifier);
+    }
+
+    static Common::Vec3<u8> ApplyModifier(const Common::Vec3<int>& base, int modifier) {
+        return Common::MakeVec(std::clamp(base.r() + modifier, 0, 255),
+                               std::clamp(base.g() + modifier, 0, 255),
+                               std::clamp(base.b() + modifier, 0, 255))
+            .Cast<u8>();
     }
 };
 
@@ -124,4 +135,16 @@ Common::Vec3<u8> SampleETC1Subtile(u64 value, unsigned int x, unsigned int y) {
     return tile.GetRGB(x, y);
 }
 
+void DecodeETC1Subtile(u64 value, std::array<Common::Vec3<u8>, 16>& texels) {
+    const ETC1Tile tile{value};
+    const std::array<Common::Vec3<int>, 2> base_colors{tile.GetBaseColor(0), tile.GetBaseColor(1)};
+    for (unsigned int y = 0; y < 4; ++y) {
+        for (unsigned int x = 0; x < 4; ++x) {
+            const unsigned half = tile.GetHalf(x, y);
+            const int modifier = tile.GetModifier(half, 4 * x + y);
+            texels[y * 4 + x] = ETC1Tile::ApplyModifier(base_colors[half], modifier);
+        }
+    }
+}
+
 } // namespace Pica::Texture
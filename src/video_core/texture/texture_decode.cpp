@@ -2,6 +2,9 @@
 // Licensed under GPLv2 or any later version
 // Refer to the license.txt file included.
 
+#include <algorithm>
+#include <array>
+#include <cstring>
 #include "common/assert.h"
 #include "common/color.h"
 #include "common/logging/log.h"
@@ -13,6 +16,11 @@
 #include "video_core/texture/texture_decode.h"
 #include "video_core/utils.h"
 
+#ifdef ARCHITECTURE_x86_64
+#include <smmintrin.h>
+#include "common/x64/cpu_detect.h"
+#endif
+
 using TextureFormat = Pica::TexturingRegs::TextureFormat;
 
 namespace Pica::Texture {
@@ -211,6 +219,385 @@ Common::Vec4<u8> LookupTexelInTile(const u8* source, unsigned int x, unsigned in
     }
 }
 
+namespace {
+
+/// Decodes the texels of a tile in Morton order, the order they are stored in
+template <typename Decode>
+void DecodeMortonTexels(u8* texels, Decode&& decode) {
+    for (u32 i = 0; i < TILE_SIZE; ++i) {
+        Common::Vec4<u8> color = decode(i);
+        std::memcpy(texels + i * 4, color.AsArray(), 4);
+    }
+}
+
+void DecodeMortonTexelsScalar(const u8* source, TextureFormat format, u8* texels) {
+    switch (format) {
+    case TextureFormat::RGBA8:
+        DecodeMortonTexels(texels, [source](u32 i) { return Color::DecodeRGBA8(source + i * 4); });
+        break;
+
+    case TextureFormat::RGB8:
+        DecodeMortonTexels(texels, [source](u32 i) { return Color::DecodeRGB8(source + i * 3); });
+        break;
+
+    case TextureFormat::RGB5A1:
+        DecodeMortonTexels(texels,
+                           [source](u32 i) { return Color::DecodeRGB5A1(source + i * 2); });
+        break;
+
+    case TextureFormat::RGB565:
+        DecodeMortonTexels(texels,
+                           [source](u32 i) { return Color::DecodeRGB565(source + i * 2); });
+        break;
+
+    case TextureFormat::RGBA4:
+        DecodeMortonTexels(texels, [source](u32 i) { return Color::DecodeRGBA4(source + i * 2); });
+        break;
+
+    case TextureFormat::IA8:
+        DecodeMortonTexels(texels, [source](u32 i) -> Common::Vec4<u8> {
+            const u8* source_ptr = source + i * 2;
+            return {source_ptr[1], source_ptr[1], source_ptr[1], source_ptr[0]};
+        });
+        break;
+
+    case TextureFormat::RG8:
+        DecodeMortonTexels(texels, [source](u32 i) { return Color::DecodeRG8(source + i * 2); });
+        break;
+
+    case TextureFormat::I8:
+        DecodeMortonTexels(texels, [source](u32 i) -> Common::Vec4<u8> {
+            return {source[i], source[i], source[i], 255};
+        });
+        break;
+
+    case TextureFormat::A8:
+        DecodeMortonTexels(texels,
+                           [source](u32 i) -> Common::Vec4<u8> { return {0, 0, 0, source[i]}; });
+        break;
+
+    case TextureFormat::IA4:
+        DecodeMortonTexels(texels, [source](u32 i) -> Common::Vec4<u8> {
+            const u8 intensity = Color::Convert4To8(source[i] >> 4);
+            return {intensity, intensity, intensity, Color::Convert4To8(source[i] & 0xF)};
+        });
+        break;
+
+    case TextureFormat::I4:
+        DecodeMortonTexels(texels, [source](u32 i) -> Common::Vec4<u8> {
+            const u8 intensity = Color::Convert4To8((source[i / 2] >> (4 * (i % 2))) & 0xF);
+            return {intensity, intensity, intensity, 255};
+        });
+        break;
+
+    case TextureFormat::A4:
+        DecodeMortonTexels(texels, [source](u32 i) -> Common::Vec4<u8> {
+            return {0, 0, 0, Color::Convert4To8((source[i / 2] >> (4 * (i % 2))) & 0xF)};
+        });
+        break;
+
+    default:
+        LOG_ERROR(HW_GPU, "Unknown texture format: {:x}", (u32)format);
+        DEBUG_ASSERT(false);
+        std::memset(texels, 0, DECODED_TILE_SIZE);
+        break;
+    }
+}
+
+#ifdef ARCHITECTURE_x86_64
+
+/// Stores 8 texels given as one 16-bit lane per texel and component
+CPU_TARGET("sse4.1") void StoreTexelsSSE41(u8* texels, __m128i r, __m128i g, __m128i b, __m128i a) {
+    const __m128i rg = _mm_or_si128(r, _mm_slli_epi16(g, 8));
+    const __m128i ba = _mm_or_si128(b, _mm_slli_epi16(a, 8));
+    _mm_store_si128(reinterpret_cast<__m128i*>(texels), _mm_unpacklo_epi16(rg, ba));
+    _mm_store_si128(reinterpret_cast<__m128i*>(texels + 16), _mm_unpackhi_epi16(rg, ba));
+}
+
+/// Extracts a component from each 16-bit texel and expands it to 8 bits
+template <int bits>
+CPU_TARGET("sse4.1") __m128i ExpandComponentSSE41(__m128i pixels, int shift) {
+    const __m128i value = _mm_and_si128(_mm_srl_epi16(pixels, _mm_cvtsi32_si128(shift)),
+                                        _mm_set1_epi16((1 << bits) - 1));
+    if constexpr (bits == 1) {
+        return _mm_mullo_epi16(value, _mm_set1_epi16(255));
+    } else {
+        // Replicate the high bits into the low bits, like the Color::ConvertNTo8 functions do
+        const __m128i high = _mm_slli_epi16(value, 8 - bits);
+        return _mm_or_si128(high, _mm_srl_epi16(high, _mm_cvtsi32_si128(bits)));
+    }
+}
+
+/// Expands 4-bit values to 8 bits, for 16 values held in the low nibble of each byte
+CPU_TARGET("sse4.1") __m128i ExpandNibblesSSE41(__m128i values) {
+    return _mm_or_si128(values, _mm_slli_epi16(values, 4));
+}
+
+/// Stores 16 texels given as one byte per texel, shuffled into place by the masks of each group
+/// of 4 texels
+CPU_TARGET("sse4.1") void StoreByteTexelsSSE41(u8* texels, __m128i values, __m128i fill,
+                                               const __m128i (&masks)[4]) {
+    for (std::size_t group = 0; group < 4; ++group) {
+        const __m128i result = _mm_or_si128(_mm_shuffle_epi8(values, masks[group]), fill);
+        _mm_store_si128(reinterpret_cast<__m128i*>(texels + group * 16), result);
+    }
+}
+
+CPU_TARGET("sse4.1") void StoreIntensityTexelsSSE41(u8* texels, __m128i values) {
+    const __m128i masks[4]{
+        _mm_setr_epi8(0, 0, 0, -1, 1, 1, 1, -1, 2, 2, 2, -1, 3, 3, 3, -1),
+        _mm_setr_epi8(4, 4, 4, -1, 5, 5, 5, -1, 6, 6, 6, -1, 7, 7, 7, -1),
+        _mm_setr_epi8(8, 8, 8, -1, 9, 9, 9, -1, 10, 10, 10, -1, 11, 11, 11, -1),
+        _mm_setr_epi8(12, 12, 12, -1, 13, 13, 13, -1, 14, 14, 14, -1, 15, 15, 15, -1),
+    };
+    StoreByteTexelsSSE41(texels, values, _mm_set1_epi32(static_cast<int>(0xFF000000)), masks);
+}
+
+CPU_TARGET("sse4.1") void StoreAlphaTexelsSSE41(u8* texels, __m128i values) {
+    const __m128i masks[4]{
+        _mm_setr_epi8(-1, -1, -1, 0, -1, -1, -1, 1, -1, -1, -1, 2, -1, -1, -1, 3),
+        _mm_setr_epi8(-1, -1, -1, 4, -1, -1, -1, 5, -1, -1, -1, 6, -1, -1, -1, 7),
+        _mm_setr_epi8(-1, -1, -1, 8, -1, -1, -1, 9, -1, -1, -1, 10, -1, -1, -1, 11),
+        _mm_setr_epi8(-1, -1, -1, 12, -1, -1, -1, 13, -1, -1, -1, 14, -1, -1, -1, 15),
+    };
+    StoreByteTexelsSSE41(texels, values, _mm_setzero_si128(), masks);
+}
+
+/// Stores 8 texels given as one intensity and alpha byte pair per texel
+CPU_TARGET("sse4.1") void StoreIntensityAlphaTexelsSSE41(u8* texels, __m128i pairs) {
+    const __m128i low_mask = _mm_setr_epi8(0, 0, 0, 1, 2, 2, 2, 3, 4, 4, 4, 5, 6, 6, 6, 7);
+    const __m128i high_mask = _mm_setr_epi8(8, 8, 8, 9, 10, 10, 10, 11, 12, 12, 12, 13, 14, 14,
+                                            14, 15);
+    _mm_store_si128(reinterpret_cast<__m128i*>(texels), _mm_shuffle_epi8(pairs, low_mask));
+    _mm_store_si128(reinterpret_cast<__m128i*>(texels + 16), _mm_shuffle_epi8(pairs, high_mask));
+}
+
+/// Splits the nibbles of 16 bytes into 32 values, low nibble first, and expands them to 8 bits
+CPU_TARGET("sse4.1") void UnpackNibblesSSE41(__m128i bytes, __m128i& first, __m128i& second) {
+    const __m128i nibble_mask = _mm_set1_epi8(0xF);
+    const __m128i low = _mm_and_si128(bytes, nibble_mask);
+    const __m128i high = _mm_and_si128(_mm_srli_epi16(bytes, 4), nibble_mask);
+    first = ExpandNibblesSSE41(_mm_unpacklo_epi8(low, high));
+    second = ExpandNibblesSSE41(_mm_unpackhi_epi8(low, high));
+}
+
+CPU_TARGET("sse4.1") __m128i LoadSSE41(const u8* source) {
+    return _mm_loadu_si128(reinterpret_cast<const __m128i*>(source));
+}
+
+CPU_TARGET("sse4.1") bool DecodeMortonTexelsSSE41(const u8* source, TextureFormat format,
+                                                  u8* texels) {
+    const __m128i opaque = _mm_set1_epi16(255);
+    const __m128i alpha_mask = _mm_set1_epi32(static_cast<int>(0xFF000000));
+
+    switch (format) {
+    case TextureFormat::RGBA8: {
+        const __m128i mask = _mm_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+        for (std::size_t i = 0; i < TILE_SIZE / 4; ++i) {
+            const __m128i result = _mm_shuffle_epi8(LoadSSE41(source + i * 16), mask);
+            _mm_store_si128(reinterpret_cast<__m128i*>(texels + i * 16), result);
+        }
+        return true;
+    }
+
+    case TextureFormat::RGB8: {
+        const __m128i mask = _mm_setr_epi8(2, 1, 0, -1, 5, 4, 3, -1, 8, 7, 6, -1, 11, 10, 9, -1);
+        for (std::size_t i = 0; i < TILE_SIZE / 4; ++i) {
+            // Load exactly the 12 bytes of these 4 texels, to not read past the end of the tile
+            const u8* source_ptr = source + i * 12;
+            u32 last;
+            std::memcpy(&last, source_ptr + 8, sizeof(last));
+            const __m128i pixels = _mm_unpacklo_epi64(
+                _mm_loadl_epi64(reinterpret_cast<const __m128i*>(source_ptr)),
+                _mm_cvtsi32_si128(static_cast<int>(last)));
+            const __m128i result = _mm_or_si128(_mm_shuffle_epi8(pixels, mask), alpha_mask);
+            _mm_store_si128(reinterpret_cast<__m128i*>(texels + i * 16), result);
+        }
+        return true;
+    }
+
+    case TextureFormat::RGB5A1:
+        for (std::size_t i = 0; i < TILE_SIZE / 8; ++i) {
+            const __m128i pixels = LoadSSE41(source + i * 16);
+            StoreTexelsSSE41(texels + i * 32, ExpandComponentSSE41<5>(pixels, 11),
+                             ExpandComponentSSE41<5>(pixels, 6), ExpandComponentSSE41<5>(pixels, 1),
+                             ExpandComponentSSE41<1>(pixels, 0));
+        }
+        return true;
+
+    case TextureFormat::RGB565:
+        for (std::size_t i = 0; i < TILE_SIZE / 8; ++i) {
+            const __m128i pixels = LoadSSE41(source + i * 16);
+            StoreTexelsSSE41(texels + i * 32, ExpandComponentSSE41<5>(pixels, 11),
+                             ExpandComponentSSE41<6>(pixels, 5), ExpandComponentSSE41<5>(pixels, 0),
+                             opaque);
+        }
+        return true;
+
+    case TextureFormat::RGBA4:
+        for (std::size_t i = 0; i < TILE_SIZE / 8; ++i) {
+            const __m128i pixels = LoadSSE41(source + i * 16);
+            StoreTexelsSSE41(texels + i * 32, ExpandComponentSSE41<4>(pixels, 12),
+                             ExpandComponentSSE41<4>(pixels, 8), ExpandComponentSSE41<4>(pixels, 4),
+                             ExpandComponentSSE41<4>(pixels, 0));
+        }
+        return true;
+
+    case TextureFormat::IA8: {
+        // Swap the alpha and intensity bytes of each texel
+        const __m128i mask = _mm_setr_epi8(1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14);
+        for (std::size_t i = 0; i < TILE_SIZE / 8; ++i) {
+            const __m128i pairs = _mm_shuffle_epi8(LoadSSE41(source + i * 16), mask);
+            StoreIntensityAlphaTexelsSSE41(texels + i * 32, pairs);
+        }
+        return true;
+    }
+
+    case TextureFormat::RG8: {
+        const __m128i low_mask =
+            _mm_setr_epi8(1, 0, -1, -1, 3, 2, -1, -1, 5, 4, -1, -1, 7, 6, -1, -1);
+        const __m128i high_mask =
+            _mm_setr_epi8(9, 8, -1, -1, 11, 10, -1, -1, 13, 12, -1, -1, 15, 14, -1, -1);
+        for (std::size_t i = 0; i < TILE_SIZE / 8; ++i) {
+            const __m128i pixels = LoadSSE41(source + i * 16);
+            const __m128i low = _mm_or_si128(_mm_shuffle_epi8(pixels, low_mask), alpha_mask);
+            const __m128i high = _mm_or_si128(_mm_shuffle_epi8(pixels, high_mask), alpha_mask);
+            _mm_store_si128(reinterpret_cast<__m128i*>(texels + i * 32), low);
+            _mm_store_si128(reinterpret_cast<__m128i*>(texels + i * 32 + 16), high);
+        }
+        return true;
+    }
+
+    case TextureFormat::I8:
+        for (std::size_t i = 0; i < TILE_SIZE / 16; ++i) {
+            StoreIntensityTexelsSSE41(texels + i * 64, LoadSSE41(source + i * 16));
+        }
+        return true;
+
+    case TextureFormat::A8:
+        for (std::size_t i = 0; i < TILE_SIZE / 16; ++i) {
+            StoreAlphaTexelsSSE41(texels + i * 64, LoadSSE41(source + i * 16));
+        }
+        return true;
+
+    case TextureFormat::IA4: {
+        const __m128i nibble_mask = _mm_set1_epi8(0xF);
+        for (std::size_t i = 0; i < TILE_SIZE / 16; ++i) {
+            const __m128i bytes = LoadSSE41(source + i * 16);
+            const __m128i intensity = ExpandNibblesSSE41(
+                _mm_and_si128(_mm_srli_epi16(bytes, 4), nibble_mask));
+            const __m128i alpha = ExpandNibblesSSE41(_mm_and_si128(bytes, nibble_mask));
+            StoreIntensityAlphaTexelsSSE41(texels + i * 64, _mm_unpacklo_epi8(intensity, alpha));
+            StoreIntensityAlphaTexelsSSE41(texels + i * 64 + 32,
+                                           _mm_unpackhi_epi8(intensity, alpha));
+        }
+        return true;
+    }
+
+    case TextureFormat::I4:
+        for (std::size_t i = 0; i < TILE_SIZE / 32; ++i) {
+            __m128i first, second;
+            UnpackNibblesSSE41(LoadSSE41(source + i * 16), first, second);
+            StoreIntensityTexelsSSE41(texels + i * 128, first);
+            StoreIntensityTexelsSSE41(texels + i * 128 + 64, second);
+        }
+        return true;
+
+    case TextureFormat::A4:
+        for (std::size_t i = 0; i < TILE_SIZE / 32; ++i) {
+            __m128i first, second;
+            UnpackNibblesSSE41(LoadSSE41(source + i * 16), first, second);
+            StoreAlphaTexelsSSE41(texels + i * 128, first);
+            StoreAlphaTexelsSSE41(texels + i * 128 + 64, second);
+        }
+        return true;
+
+    default:
+        return false;
+    }
+}
+
+#endif // ARCHITECTURE_x86_64
+
+void DecodeETC1Tile(const u8* source, bool has_alpha, u8* dest) {
+    const std::size_t subtile_size = has_alpha ? 16 : 8;
+
+    std::array<Common::Vec3<u8>, 16> colors;
+    for (std::size_t subtile = 0; subtile < ETC1_SUBTILES; ++subtile) {
+        const u8* subtile_ptr = source + subtile * subtile_size;
+
+        u64 packed_alpha = ~u64{0};
+        if (has_alpha) {
+            u64_le alpha_data;
+            std::memcpy(&alpha_data, subtile_ptr, sizeof(u64));
+            packed_alpha = alpha_data;
+            subtile_ptr += sizeof(u64);
+        }
+
+        u64_le subtile_data;
+        std::memcpy(&subtile_data, subtile_ptr, sizeof(u64));
+        DecodeETC1Subtile(subtile_data, colors);
+
+        // ETC1 further subdivides each 8x8 tile into four 4x4 subtiles
+        const unsigned int subtile_x = static_cast<unsigned int>(subtile % 2) * 4;
+        const unsigned int subtile_y = static_cast<unsigned int>(subtile / 2) * 4;
+        for (unsigned int y = 0; y < 4; ++y) {
+            for (unsigned int x = 0; x < 4; ++x) {
+                u8* texel = dest + ((subtile_y + y) * 8 + subtile_x + x) * 4;
+                std::memcpy(texel, colors[y * 4 + x].AsArray(), 3);
+                texel[3] = Color::Convert4To8((packed_alpha >> (4 * (x * 4 + y))) & 0xF);
+            }
+        }
+    }
+}
+
+} // anonymous namespace
+
+void DecodeTextureTile(const u8* source, const TextureInfo& info, u8* dest) {
+    if (info.format == TextureFormat::ETC1 || info.format == TextureFormat::ETC1A4) {
+        DecodeETC1Tile(source, info.format == TextureFormat::ETC1A4, dest);
+        return;
+    }
+
+    alignas(16) std::array<u8, DECODED_TILE_SIZE> texels;
+#ifdef ARCHITECTURE_x86_64
+    static const bool use_sse41 = Common::GetCPUCaps().sse4_1;
+    const bool decoded = use_sse41 && DecodeMortonTexelsSSE41(source, info.format, texels.data());
+#else
+    const bool decoded = false;
+#endif
+    if (!decoded) {
+        DecodeMortonTexelsScalar(source, info.format, texels.data());
+    }
+    VideoCore::UnswizzleTile<4>(texels.data(), dest, 8 * 4);
+}
+
+void DecodeTextureRect(const u8* source, const TextureInfo& info, unsigned int x0,
+                       unsigned int y0, unsigned int x1, unsigned int y1, u8* dest,
+                       std::ptrdiff_t dest_stride) {
+    const std::size_t tile_size = CalculateTileSize(info.format);
+
+    std::array<u8, DECODED_TILE_SIZE> tile;
+    for (unsigned int tile_y = y0 & ~7u; tile_y < y1; tile_y += 8) {
+        const u8* line = source + (tile_y / 8) * info.stride;
+        const unsigned int row_begin = std::max(tile_y, y0);
+        const unsigned int row_end = std::min(tile_y + 8, y1);
+
+        for (unsigned int tile_x = x0 & ~7u; tile_x < x1; tile_x += 8) {
+            DecodeTextureTile(line + (tile_x / 8) * tile_size, info, tile.data());
+
+            const unsigned int column_begin = std::max(tile_x, x0);
+            const unsigned int column_end = std::min(tile_x + 8, x1);
+            for (unsigned int y = row_begin; y < row_end; ++y) {
+                const u8* tile_row = tile.data() + ((y - tile_y) * 8 + column_begin - tile_x) * 4;
+                u8* dest_row = dest + static_cast<std::ptrdiff_t>(y - y0) * dest_stride +
+                               (column_begin - x0) * 4;
+                std::memcpy(dest_row, tile_row, (column_end - column_begin) * 4);
+            }
+        }
+    }
+}
+
 TextureInfo TextureInfo::FromPicaRegister(const TexturingRegs::TextureConfig& config,
                                           const TexturingRegs::TextureFormat& format) {
     TextureInfo info;
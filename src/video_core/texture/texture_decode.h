@@ -4,12 +4,16 @@
 
 #pragma once
 
+#include <cstddef>
 #include "common/common_types.h"
 #include "common/vector_math.h"
 #include "video_core/regs_texturing.h"
 
 namespace Pica::Texture {
 
+/// Byte size of a 8*8 tile decoded to RGBA8.
+constexpr std::size_t DECODED_TILE_SIZE = 8 * 8 * 4;
+
 /// Returns the byte size of a 8*8 tile of the specified texture format.
 size_t CalculateTileSize(TexturingRegs::TextureFormat format);
 
@@ -55,4 +59,29 @@ Common::Vec4<u8> LookupTexture(const u8* source, unsigned int x, unsigned int y,
 Common::Vec4<u8> LookupTexelInTile(const u8* source, unsigned int x, unsigned int y,
                                    const TextureInfo& info, bool disable_alpha);
 
+/**
+ * Decodes a whole 8x8 texture tile to RGBA8.
+ *
+ * @param source Pointer to the beginning of the tile.
+ * @param info TextureInfo describing the texture format.
+ * @param dest Destination for DECODED_TILE_SIZE bytes. The texels are stored row by row, starting
+ *             at in-tile coordinate y = 0, with the components in R, G, B, A byte order.
+ */
+void DecodeTextureTile(const u8* source, const TextureInfo& info, u8* dest);
+
+/**
+ * Decodes the texels of a rectangle of a texture to RGBA8, a whole tile at a time.
+ *
+ * @param source Source pointer to the beginning of the texture
+ * @param info TextureInfo object describing the texture setup
+ * @param x0, y0 Texture coordinates of the first texel of the rectangle
+ * @param x1, y1 Texture coordinates past the last texel of the rectangle
+ * @param dest Destination of texel (x0, y0), with the components in R, G, B, A byte order
+ * @param dest_stride Byte offset between rows of the destination, which is negative to flip the
+ *                    rectangle vertically
+ */
+void DecodeTextureRect(const u8* source, const TextureInfo& info, unsigned int x0,
+                       unsigned int y0, unsigned int x1, unsigned int y1, u8* dest,
+                       std::ptrdiff_t dest_stride);
+
 } // namespace Pica::Texture
@@ -4,8 +4,14 @@
 
 #pragma once
 
+#include <cstddef>
+#include <cstring>
 #include "common/common_types.h"
 
+#ifdef ARCHITECTURE_x86_64
+#include <emmintrin.h>
+#endif
+
 namespace VideoCore {
 
 // 8x8 Z-Order coordinate from 2D coordinates
@@ -49,4 +55,150 @@ static inline u32 GetMortonOffset(u32 x, u32 y, u32 bytes_per_pixel) {
     return (i + offset) * bytes_per_pixel;
 }
 
+namespace Detail {
+
+template <bool tile_to_linear, std::size_t bytes_per_pixel>
+inline void MortonCopyTileScalar(u8* tile, u8* linear, std::ptrdiff_t stride) {
+    // Each group of 4 pixels in Morton order forms a 2x2 block made of two 2-pixel rows
+    constexpr std::size_t run_size = 2 * bytes_per_pixel;
+    for (u32 block = 0; block < 16; ++block) {
+        const u32 x = ((block & 1) << 1) | (block & 4);
+        const u32 y = (block & 2) | ((block & 8) >> 1);
+        u8* const block_ptr = tile + block * 2 * run_size;
+        u8* const row = linear + static_cast<std::ptrdiff_t>(y) * stride + x * bytes_per_pixel;
+        if constexpr (tile_to_linear) {
+            std::memcpy(row, block_ptr, run_size);
+            std::memcpy(row + stride, block_ptr + run_size, run_size);
+        } else {
+            std::memcpy(block_ptr, row, run_size);
+            std::memcpy(block_ptr + run_size, row + stride, run_size);
+        }
+    }
+}
+
+#ifdef ARCHITECTURE_x86_64
+template <bool tile_to_linear>
+inline void MortonCopyTileSSE2_32(u8* tile, u8* linear, std::ptrdiff_t stride) {
+    // A 4x4 subtile is stored as four 2x2 blocks of 16 bytes. The first halves of two
+    // horizontally adjacent blocks form one subtile row and the second halves the next one.
+    for (u32 subtile = 0; subtile < 4; ++subtile) {
+        u8* const subtile_ptr = tile + subtile * 64;
+        u8* const row = linear + static_cast<std::ptrdiff_t>((subtile & 2) * 2) * stride +
+                        (subtile & 1) * 16;
+        for (u32 half = 0; half < 2; ++half) {
+            auto* const blocks = reinterpret_cast<__m128i*>(subtile_ptr + half * 32);
+            auto* const row0 = reinterpret_cast<__m128i*>(row + half * 2 * stride);
+            auto* const row1 = reinterpret_cast<__m128i*>(row + (half * 2 + 1) * stride);
+            const __m128i a = _mm_loadu_si128(tile_to_linear ? blocks : row0);
+            const __m128i b = _mm_loadu_si128(tile_to_linear ? blocks + 1 : row1);
+            _mm_storeu_si128(tile_to_linear ? row0 : blocks, _mm_unpacklo_epi64(a, b));
+            _mm_storeu_si128(tile_to_linear ? row1 : blocks + 1, _mm_unpackhi_epi64(a, b));
+        }
+    }
+}
+
+template <bool tile_to_linear>
+inline void MortonCopyTileSSE2_16(u8* tile, u8* linear, std::ptrdiff_t stride) {
+    // A 4x4 subtile is stored as four 2x2 blocks of 8 bytes. Swapping the middle words of
+    // two adjacent blocks turns them into two half rows, and two subtiles make a full row.
+    for (u32 pair = 0; pair < 4; ++pair) {
+        u8* const blocks = tile + (pair & 2) * 32 + (pair & 1) * 16;
+        u8* const row = linear + static_cast<std::ptrdiff_t>(pair * 2) * stride;
+        auto* const left = reinterpret_cast<__m128i*>(blocks);
+        auto* const right = reinterpret_cast<__m128i*>(blocks + 32);
+        auto* const row0 = reinterpret_cast<__m128i*>(row);
+        auto* const row1 = reinterpret_cast<__m128i*>(row + stride);
+        constexpr int order = _MM_SHUFFLE(3, 1, 2, 0);
+        if constexpr (tile_to_linear) {
+            const __m128i a = _mm_shuffle_epi32(_mm_loadu_si128(left), order);
+            const __m128i b = _mm_shuffle_epi32(_mm_loadu_si128(right), order);
+            _mm_storeu_si128(row0, _mm_unpacklo_epi64(a, b));
+            _mm_storeu_si128(row1, _mm_unpackhi_epi64(a, b));
+        } else {
+            const __m128i a = _mm_loadu_si128(row0);
+            const __m128i b = _mm_loadu_si128(row1);
+            _mm_storeu_si128(left, _mm_shuffle_epi32(_mm_unpacklo_epi64(a, b), order));
+            _mm_storeu_si128(right, _mm_shuffle_epi32(_mm_unpackhi_epi64(a, b), order));
+        }
+    }
+}
+#endif
+
+template <bool tile_to_linear, std::size_t bytes_per_pixel>
+inline void MortonCopyTile(u8* tile, u8* linear, std::ptrdiff_t stride) {
+#ifdef ARCHITECTURE_x86_64
+    if constexpr (bytes_per_pixel == 4) {
+        MortonCopyTileSSE2_32<tile_to_linear>(tile, linear, stride);
+        return;
+    } else if constexpr (bytes_per_pixel == 2) {
+        MortonCopyTileSSE2_16<tile_to_linear>(tile, linear, stride);
+        return;
+    }
+#endif
+    MortonCopyTileScalar<tile_to_linear, bytes_per_pixel>(tile, linear, stride);
+}
+
+} // namespace Detail
+
+/**
+ * Converts an 8x8 tile of pixels in Morton order to 8 rows of a linear image.
+ * @param tile Source tile, 64 * bytes_per_pixel bytes long
+ * @param linear Destination of the first tile row
+ * @param stride Distance in bytes between two rows of the linear image. A negative stride
+ *               writes the rows bottom to top.
+ */
+template <std::size_t bytes_per_pixel>
+inline void UnswizzleTile(const u8* tile, u8* linear, std::ptrdiff_t stride) {
+    Detail::MortonCopyTile<true, bytes_per_pixel>(const_cast<u8*>(tile), linear, stride);
+}
+
+/**
+ * Converts 8 rows of a linear image to an 8x8 tile of pixels in Morton order.
+ * @param linear Source of the first tile row
+ * @param stride Distance in bytes between two rows of the linear image
+ * @param tile Destination tile, 64 * bytes_per_pixel bytes long
+ */
+template <std::size_t bytes_per_pixel>
+inline void SwizzleTile(const u8* linear, std::ptrdiff_t stride, u8* tile) {
+    Detail::MortonCopyTile<false, bytes_per_pixel>(tile, const_cast<u8*>(linear), stride);
+}
+
+/**
+ * Converts a Morton tiled image to a linear one. Both dimensions must be multiples of 8.
+ * @param tiled Source image, whose tile rows are tiled_width pixels wide
+ * @param linear Destination of the first image row
+ * @param stride Distance in bytes between two rows of the linear image
+ */
+template <std::size_t bytes_per_pixel>
+inline void UnswizzleImage(const u8* tiled, u32 tiled_width, u8* linear, std::ptrdiff_t stride,
+                           u32 width, u32 height) {
+    for (u32 y = 0; y < height; y += 8) {
+        const u8* tile = tiled + static_cast<std::size_t>(y) * tiled_width * bytes_per_pixel;
+        u8* row = linear + static_cast<std::ptrdiff_t>(y) * stride;
+        for (u32 x = 0; x < width; x += 8) {
+            UnswizzleTile<bytes_per_pixel>(tile, row + x * bytes_per_pixel, stride);
+            tile += 64 * bytes_per_pixel;
+        }
+    }
+}
+
+/**
+ * Converts a linear image to a Morton tiled one. Both dimensions must be multiples of 8.
+ * @param linear Source of the first image row
+ * @param stride Distance in bytes between two rows of the linear image
+ * @param tiled Destination image, whose tile rows are tiled_width pixels wide
+ */
+template <std::size_t bytes_per_pixel>
+inline void SwizzleImage(const u8* linear, std::ptrdiff_t stride, u8* tiled, u32 tiled_width,
+                         u32 width, u32 height) {
+    for (u32 y = 0; y < height; y += 8) {
+        u8* tile = tiled + static_cast<std::size_t>(y) * tiled_width * bytes_per_pixel;
+        const u8* row = linear + static_cast<std::ptrdiff_t>(y) * stride;
+        for (u32 x = 0; x < width; x += 8) {
+            SwizzleTile<bytes_per_pixel>(row + x * bytes_per_pixel, stride, tile);
+            tile += 64 * bytes_per_pixel;
+        }
+    }
+}
+
 } // namespace VideoCore
@@ -1,3 +1,5 @@
+#include <array>
+#include <cstring>
 #include <memory>
 #include <boost/range/algorithm/fill.hpp>
 #include "common/alignment.h"
@@ -17,6 +19,43 @@
 
 namespace Pica {
 
+/**
+ * Loads an attribute made of `elements` elements of type T. Being specialized for the layout of
+ * the attribute, the conversion doesn't need to branch on it and is unrolled by the compiler.
+ */
+template <typename T, u32 elements>
+static void LoadAttribute(const u8* source, Common::Vec4<float24>& attribute) {
+    std::array<T, elements> data;
+    std::memcpy(data.data(), source, sizeof(data));
+
+    for (u32 comp = 0; comp < elements; ++comp) {
+        attribute[comp] = float24::FromFloat32(static_cast<float>(data[comp]));
+    }
+
+    // Default attribute values set if array elements have < 4 components. This
+    // is *not* carried over from the default attribute settings even if they're
+    // enabled for this attribute.
+    for (u32 comp = elements; comp < 4; ++comp) {
+        attribute[comp] = comp == 3 ? float24::FromFloat32(1.0f) : float24::FromFloat32(0.0f);
+    }
+}
+
+VertexLoader::AttributeLoadFunc VertexLoader::GetAttributeLoader(
+    PipelineRegs::VertexAttributeFormat format, u32 elements) {
+    // Indexed by VertexAttributeFormat and number of elements
+    static constexpr std::array<std::array<AttributeLoadFunc, 4>, 4> attribute_loaders{{
+        {LoadAttribute<s8, 1>, LoadAttribute<s8, 2>, LoadAttribute<s8, 3>, LoadAttribute<s8, 4>},
+        {LoadAttribute<u8, 1>, LoadAttribute<u8, 2>, LoadAttribute<u8, 3>, LoadAttribute<u8, 4>},
+        {LoadAttribute<s16, 1>, LoadAttribute<s16, 2>, LoadAttribute<s16, 3>,
+         LoadAttribute<s16, 4>},
+        {LoadAttribute<float, 1>, LoadAttribute<float, 2>, LoadAttribute<float, 3>,
+         LoadAttribute<float, 4>},
+    }};
+
+    ASSERT(elements >= 1 && elements <= 4);
+    return attribute_loaders[static_cast<u32>(format)][elements - 1];
+}
+
 void VertexLoader::Setup(const PipelineRegs& regs) {
     ASSERT_MSG(!is_setup, "VertexLoader is not intended to be setup more than once.");
 
@@ -68,95 +107,65 @@ void VertexLoader::Setup(const PipelineRegs& regs) {
         }
     }
 
+    // Select the loaders of the attributes once, so that loading a vertex doesn't have to branch on
+    // their configuration
+    for (int i = 0; i < num_total_attributes; ++i) {
+        if (vertex_attribute_elements[i] != 0) {
+            array_attributes[num_array_attributes] = i;
+            array_attribute_loaders[num_array_attributes] =
+                GetAttributeLoader(vertex_attribute_formats[i], vertex_attribute_elements[i]);
+            array_attribute_sizes[num_array_attributes] = attribute_config.GetStride(i);
+            ++num_array_attributes;
+        } else if (vertex_attribute_is_default[i]) {
+            default_attributes[num_default_attributes++] = i;
+        }
+        // TODO(yuriks): In the remaining case, no data gets loaded and the vertex
+        // remains with the last value it had. This isn't currently maintained
+        // as global state, however, and so won't work in Citra yet.
+    }
+
     is_setup = true;
 }
 
 void VertexLoader::LoadVertex(u32 base_address, int index, int vertex,
                               Shader::AttributeBuffer& input,
-                              DebugUtils::MemoryAccessTracker& memory_accesses) {
+                              DebugUtils::MemoryAccessTracker& memory_accesses) const {
     ASSERT_MSG(is_setup, "A VertexLoader needs to be setup before loading vertices.");
 
-    for (int i = 0; i < num_total_attributes; ++i) {
-        if (vertex_attribute_elements[i] != 0) {
-            // Load per-vertex data from the loader arrays
-            u32 source_addr =
-                base_address + vertex_attribute_sources[i] + vertex_attribute_strides[i] * vertex;
-
-            if (g_debug_context && Pica::g_debug_context->recorder) {
-                memory_accesses.AddAccess(
-                    source_addr,
-                    vertex_attribute_elements[i] *
-                        ((vertex_attribute_formats[i] == PipelineRegs::VertexAttributeFormat::FLOAT)
-                             ? 4
-                             : (vertex_attribute_formats[i] ==
-                                PipelineRegs::VertexAttributeFormat::SHORT)
-                                   ? 2
-                                   : 1));
-            }
+    const bool track_memory_accesses = g_debug_context && Pica::g_debug_context->recorder;
 
-            switch (vertex_attribute_formats[i]) {
-            case PipelineRegs::VertexAttributeFormat::BYTE: {
-                const s8* srcdata = reinterpret_cast<const s8*>(
-                    VideoCore::g_memory->GetPhysicalPointer(source_addr));
-                for (unsigned int comp = 0; comp < vertex_attribute_elements[i]; ++comp) {
-                    input.attr[i][comp] = float24::FromFloat32(srcdata[comp]);
-                }
-                break;
-            }
-            case PipelineRegs::VertexAttributeFormat::UBYTE: {
-                const u8* srcdata = reinterpret_cast<const u8*>(
-                    VideoCore::g_memory->GetPhysicalPointer(source_addr));
-                for (unsigned int comp = 0; comp < vertex_attribute_elements[i]; ++comp) {
-                    input.attr[i][comp] = float24::FromFloat32(srcdata[comp]);
-                }
-                break;
-            }
-            case PipelineRegs::VertexAttributeFormat::SHORT: {
-                const s16* srcdata = reinterpret_cast<const s16*>(
-                    VideoCore::g_memory->GetPhysicalPointer(source_addr));
-                for (unsigned int comp = 0; comp < vertex_attribute_elements[i]; ++comp) {
-                    input.attr[i][comp] = float24::FromFloat32(srcdata[comp]);
-                }
-                break;
-            }
-            case PipelineRegs::VertexAttributeFormat::FLOAT: {
-                const float* srcdata = reinterpret_cast<const float*>(
-                    VideoCore::g_memory->GetPhysicalPointer(source_addr));
-                for (unsigned int comp = 0; comp < vertex_attribute_elements[i]; ++comp) {
-                    input.attr[i][comp] = float24::FromFloat32(srcdata[comp]);
-                }
-                break;
-            }
-            }
+    for (std::size_t n = 0; n < num_array_attributes; ++n) {
+        const u32 i = array_attributes[n];
 
-            // Default attribute values set if array elements have < 4 components. This
-            // is *not* carried over from the default attribute settings even if they're
-            // enabled for this attribute.
-            for (unsigned int comp = vertex_attribute_elements[i]; comp < 4; ++comp) {
-                input.attr[i][comp] =
-                    comp == 3 ? float24::FromFloat32(1.0f) : float24::FromFloat32(0.0f);
-            }
+        // Load per-vertex data from the loader arrays
+        const u32 source_addr =
+            base_address + vertex_attribute_sources[i] + vertex_attribute_strides[i] * vertex;
 
-            LOG_TRACE(HW_GPU,
-                      "Loaded {} components of attribute {:x} for vertex {:x} (index {:x}) from "
-                      "0x{:08x} + 0x{:08x} + 0x{:04x}: {} {} {} {}",
-                      vertex_attribute_elements[i], i, vertex, index, base_address,
-                      vertex_attribute_sources[i], vertex_attribute_strides[i] * vertex,
-                      input.attr[i][0].ToFloat32(), input.attr[i][1].ToFloat32(),
-                      input.attr[i][2].ToFloat32(), input.attr[i][3].ToFloat32());
-        } else if (vertex_attribute_is_default[i]) {
-            // Load the default attribute if we're configured to do so
-            input.attr[i] = g_state.input_default_attributes.attr[i];
-            LOG_TRACE(
-                HW_GPU,
-                "Loaded default attribute {:x} for vertex {:x} (index {:x}): ({}, {}, {}, {})", i,
-                vertex, index, input.attr[i][0].ToFloat32(), input.attr[i][1].ToFloat32(),
-                input.attr[i][2].ToFloat32(), input.attr[i][3].ToFloat32());
-        } else {
-            // TODO(yuriks): In this case, no data gets loaded and the vertex
-            // remains with the last value it had. This isn't currently maintained
-            // as global state, however, and so won't work in Citra yet.
+        if (track_memory_accesses) {
+            memory_accesses.AddAccess(source_addr, array_attribute_sizes[n]);
         }
+
+        array_attribute_loaders[n](VideoCore::g_memory->GetPhysicalPointer(source_addr),
+                                   input.attr[i]);
+
+        LOG_TRACE(HW_GPU,
+                  "Loaded {} components of attribute {:x} for vertex {:x} (index {:x}) from "
+                  "0x{:08x} + 0x{:08x} + 0x{:04x}: {} {} {} {}",
+                  vertex_attribute_elements[i], i, vertex, index, base_address,
+                  vertex_attribute_sources[i], vertex_attribute_strides[i] * vertex,
+                  input.attr[i][0].ToFloat32(), input.attr[i][1].ToFloat32(),
+                  input.attr[i][2].ToFloat32(), input.attr[i][3].ToFloat32());
+    }
+
+    for (std::size_t n = 0; n < num_default_attributes; ++n) {
+        const u32 i = default_attributes[n];
+
+        // Load the default attribute if we're configured to do so
+        input.attr[i] = g_state.input_default_attributes.attr[i];
+        LOG_TRACE(HW_GPU,
+                  "Loaded default attribute {:x} for vertex {:x} (index {:x}): ({}, {}, {}, {})",
+                  i, vertex, index, input.attr[i][0].ToFloat32(), input.attr[i][1].ToFloat32(),
+                  input.attr[i][2].ToFloat32(), input.attr[i][3].ToFloat32());
     }
 }
 
@@ -2,6 +2,8 @@
 
 #include <array>
 #include "common/common_types.h"
+#include "common/vector_math.h"
+#include "video_core/pica_types.h"
 #include "video_core/regs_pipeline.h"
 
 namespace Pica {
@@ -23,13 +25,19 @@ public:
 
     void Setup(const PipelineRegs& regs);
     void LoadVertex(u32 base_address, int index, int vertex, Shader::AttributeBuffer& input,
-                    DebugUtils::MemoryAccessTracker& memory_accesses);
+                    DebugUtils::MemoryAccessTracker& memory_accesses) const;
 
     int GetNumTotalAttributes() const {
         return num_total_attributes;
     }
 
 private:
+    /// Converts the elements of an attribute read from a vertex array, and pads them to 4 elements
+    using AttributeLoadFunc = void (*)(const u8* source, Common::Vec4<float24>& attribute);
+
+    static AttributeLoadFunc GetAttributeLoader(PipelineRegs::VertexAttributeFormat format,
+                                                u32 elements);
+
     std::array<u32, 16> vertex_attribute_sources;
     std::array<u32, 16> vertex_attribute_strides{};
     std::array<PipelineRegs::VertexAttributeFormat, 16> vertex_attribute_formats;
@@ -37,6 +45,17 @@ private:
     std::array<bool, 16> vertex_attribute_is_default;
     int num_total_attributes = 0;
     bool is_setup = false;
+
+    /// Attributes loaded from the vertex arrays, along with the loader specialized for their
+    /// format and number of elements
+    std::array<u32, 16> array_attributes;
+    std::array<AttributeLoadFunc, 16> array_attribute_loaders;
+    std::array<u32, 16> array_attribute_sizes;
+    std::size_t num_array_attributes = 0;
+
+    /// Attributes set to their default value
+    std::array<u32, 16> default_attributes;
+    std::size_t num_default_attributes = 0;
 };
 
 } // namespace Pica
@@ -22,6 +22,9 @@ std::unique_ptr<RendererBase> g_renderer; ///< Renderer plugin
 
 std::atomic<bool> g_hw_renderer_enabled;
 std::atomic<bool> g_shader_jit_enabled;
+std::atomic<bool> g_shader_jit_batch_enabled;
+std::atomic<bool> g_shader_jit_disk_cache_enabled;
+std::atomic<bool> g_shader_jit_async_enabled;
 std::atomic<bool> g_hw_shader_enabled;
 std::atomic<bool> g_separable_shader_enabled;
 std::atomic<bool> g_hw_shader_accurate_mul;